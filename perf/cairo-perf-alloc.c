@@ -0,0 +1,407 @@
+/* -*- Mode: c; c-basic-offset: 4; indent-tabs-mode: t; tab-width: 8; -*- */
+/*
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of
+ * the authors not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The authors make no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL,
+ * INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* Allocation accounting for the performance harness.
+ *
+ * This is util/malloc-stats.c folded into cairo-perf: malloc(),
+ * calloc() and realloc() are interposed for the whole process, but the
+ * counters only run between cairo_perf_alloc_start() and
+ * cairo_perf_alloc_stop(), so the timed iterations are unaffected.
+ *
+ * Each allocation is attributed to the innermost frame on the call
+ * stack that belongs to one of the interesting groups of cairo
+ * functions (polygons, boxes, traps, clips, patterns and scaled
+ * glyphs).  As nearly all of those functions are hidden inside
+ * libcairo, we cannot rely upon dladdr() and instead read the function
+ * address ranges straight out of the ELF symbol table of the loaded
+ * library.  If libcairo has been stripped, everything is reported
+ * under "other".
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE 1	/* for dladdr() */
+#endif
+
+#include "cairo-perf.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if CAIRO_HAS_DLSYM && defined (__GLIBC__) && defined (__ELF__) && defined (__GNUC__)
+#define CAIRO_PERF_HAS_ALLOC_STATS 1
+#endif
+
+static const char *site_names[CAIRO_PERF_ALLOC_NUM_SITES] = {
+    "polygon",
+    "boxes",
+    "traps",
+    "clip",
+    "pattern",
+    "scaled-glyph",
+    "other",
+};
+
+const char *
+cairo_perf_alloc_site_name (cairo_perf_alloc_site_t site)
+{
+    if ((unsigned) site >= CAIRO_PERF_ALLOC_NUM_SITES)
+	return "<invalid>";
+
+    return site_names[site];
+}
+
+void
+cairo_perf_alloc_print (FILE				 *file,
+			const cairo_perf_alloc_stats_t	 *stats,
+			unsigned int			  iterations)
+{
+    unsigned long long count = 0, bytes = 0;
+    int n;
+
+    if (iterations == 0)
+	iterations = 1;
+
+    for (n = 0; n < CAIRO_PERF_ALLOC_NUM_SITES; n++) {
+	count += stats->count[n];
+	bytes += stats->bytes[n];
+    }
+
+    fprintf (file, "allocs/iter: %.1f (%.0f bytes)",
+	     count / (double) iterations,
+	     bytes / (double) iterations);
+
+    for (n = 0; n < CAIRO_PERF_ALLOC_NUM_SITES; n++) {
+	if (stats->count[n] == 0)
+	    continue;
+
+	fprintf (file, " %s %.1f (%.0f)",
+		 site_names[n],
+		 stats->count[n] / (double) iterations,
+		 stats->bytes[n] / (double) iterations);
+    }
+
+    fprintf (file, "\n");
+}
+
+#if CAIRO_PERF_HAS_ALLOC_STATS
+
+#include <dlfcn.h>
+#include <elf.h>
+#include <execinfo.h>
+#include <fcntl.h>
+#include <link.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MAX_FRAMES 32
+
+extern void *__libc_malloc (size_t size);
+extern void *__libc_calloc (size_t nmemb, size_t size);
+extern void *__libc_realloc (void *ptr, size_t size);
+
+typedef struct _alloc_range {
+    uintptr_t start, end;
+    cairo_perf_alloc_site_t site;
+} alloc_range_t;
+
+static alloc_range_t *ranges;
+static int num_ranges;
+static cairo_bool_t ranges_loaded;
+
+/* The hooks run on every thread, including cairo's workers, so the
+ * counters are bumped atomically and the recursion guard is per thread.
+ */
+static cairo_perf_alloc_stats_t current;
+static int active;
+static __thread int in_hook;
+
+static cairo_perf_alloc_site_t
+_site_for_symbol (const char *name)
+{
+    if (strstr (name, "scaled_glyph"))
+	return CAIRO_PERF_ALLOC_SCALED_GLYPH;
+    if (strncmp (name, "_cairo_polygon", 14) == 0)
+	return CAIRO_PERF_ALLOC_POLYGON;
+    if (strncmp (name, "_cairo_boxes", 12) == 0)
+	return CAIRO_PERF_ALLOC_BOXES;
+    if (strncmp (name, "_cairo_traps", 12) == 0 ||
+	strncmp (name, "_cairo_tristrip", 15) == 0)
+	return CAIRO_PERF_ALLOC_TRAPS;
+    if (strncmp (name, "_cairo_clip", 11) == 0)
+	return CAIRO_PERF_ALLOC_CLIP;
+    if (strstr (name, "pattern"))
+	return CAIRO_PERF_ALLOC_PATTERN;
+
+    return CAIRO_PERF_ALLOC_OTHER;
+}
+
+static int
+_range_compare (const void *a, const void *b)
+{
+    const alloc_range_t *ra = a, *rb = b;
+
+    if (ra->start < rb->start)
+	return -1;
+    return ra->start > rb->start;
+}
+
+static void
+_load_ranges_from_symtab (const char	     *map,
+			  size_t	      length,
+			  const ElfW(Shdr)   *symtab,
+			  const ElfW(Shdr)   *strtab,
+			  uintptr_t	      base)
+{
+    const ElfW(Sym) *sym;
+    int n, count;
+
+    if (symtab->sh_offset + symtab->sh_size > length ||
+	strtab->sh_offset + strtab->sh_size > length)
+	return;
+
+    sym = (const ElfW(Sym) *) (map + symtab->sh_offset);
+    count = symtab->sh_size / sizeof (ElfW(Sym));
+    for (n = 0; n < count; n++) {
+	cairo_perf_alloc_site_t site;
+	const char *name;
+
+	if (ELF32_ST_TYPE (sym[n].st_info) != STT_FUNC ||
+	    sym[n].st_shndx == SHN_UNDEF ||
+	    sym[n].st_size == 0 ||
+	    sym[n].st_name >= strtab->sh_size)
+	    continue;
+
+	name = map + strtab->sh_offset + sym[n].st_name;
+	site = _site_for_symbol (name);
+	if (site == CAIRO_PERF_ALLOC_OTHER)
+	    continue;
+
+	if ((num_ranges & (num_ranges - 1)) == 0) {
+	    alloc_range_t *new_ranges;
+
+	    new_ranges = realloc (ranges,
+				  sizeof (alloc_range_t) * (num_ranges ? 2 * num_ranges : 64));
+	    if (new_ranges == NULL)
+		return;
+	    ranges = new_ranges;
+	}
+
+	ranges[num_ranges].start = base + sym[n].st_value;
+	ranges[num_ranges].end = base + sym[n].st_value + sym[n].st_size;
+	ranges[num_ranges].site = site;
+	num_ranges++;
+    }
+}
+
+static void
+_load_ranges (void)
+{
+    const ElfW(Ehdr) *ehdr;
+    const ElfW(Shdr) *shdr, *symtab = NULL, *dynsym = NULL;
+    const char *filename;
+    struct stat st;
+    uintptr_t base;
+    Dl_info info;
+    void *map;
+    int fd, n;
+
+    ranges_loaded = TRUE;
+
+    if (! dladdr ((void *) cairo_create, &info))
+	return;
+
+    filename = info.dli_fname;
+    if (filename == NULL || *filename == '\0')
+	filename = "/proc/self/exe";
+
+    fd = open (filename, O_RDONLY);
+    if (fd == -1)
+	return;
+
+    if (fstat (fd, &st) || (size_t) st.st_size < sizeof (ElfW(Ehdr))) {
+	close (fd);
+	return;
+    }
+
+    map = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close (fd);
+    if (map == MAP_FAILED)
+	return;
+
+    ehdr = map;
+    if (memcmp (ehdr->e_ident, ELFMAG, SELFMAG) ||
+	ehdr->e_shentsize != sizeof (ElfW(Shdr)) ||
+	ehdr->e_shoff + ehdr->e_shnum * sizeof (ElfW(Shdr)) > (size_t) st.st_size)
+	goto out;
+
+    /* executables are linked at their final address */
+    base = ehdr->e_type == ET_DYN ? (uintptr_t) info.dli_fbase : 0;
+
+    shdr = (const ElfW(Shdr) *) ((const char *) map + ehdr->e_shoff);
+    for (n = 0; n < ehdr->e_shnum; n++) {
+	if (shdr[n].sh_type == SHT_SYMTAB)
+	    symtab = &shdr[n];
+	else if (shdr[n].sh_type == SHT_DYNSYM)
+	    dynsym = &shdr[n];
+    }
+
+    /* fall back to the exported symbols if the library was stripped */
+    if (symtab == NULL)
+	symtab = dynsym;
+    if (symtab == NULL || symtab->sh_link >= ehdr->e_shnum)
+	goto out;
+
+    _load_ranges_from_symtab (map, st.st_size,
+			      symtab, &shdr[symtab->sh_link],
+			      base);
+
+    qsort (ranges, num_ranges, sizeof (alloc_range_t), _range_compare);
+
+out:
+    munmap (map, st.st_size);
+}
+
+static cairo_perf_alloc_site_t
+_lookup_site (uintptr_t addr)
+{
+    int min = 0, max = num_ranges - 1;
+
+    while (min <= max) {
+	int mid = (min + max) / 2;
+
+	if (addr < ranges[mid].start)
+	    max = mid - 1;
+	else if (addr >= ranges[mid].end)
+	    min = mid + 1;
+	else
+	    return ranges[mid].site;
+    }
+
+    return CAIRO_PERF_ALLOC_OTHER;
+}
+
+static void
+_record (size_t size)
+{
+    void *frames[MAX_FRAMES];
+    cairo_perf_alloc_site_t site = CAIRO_PERF_ALLOC_OTHER;
+    int n, num_frames;
+
+    in_hook++;
+
+    num_frames = backtrace (frames, MAX_FRAMES);
+    for (n = 0; n < num_frames; n++) {
+	/* step back into the call instruction */
+	site = _lookup_site ((uintptr_t) frames[n] - 1);
+	if (site != CAIRO_PERF_ALLOC_OTHER)
+	    break;
+    }
+
+    __atomic_fetch_add (&current.count[site], 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add (&current.bytes[site], size, __ATOMIC_RELAXED);
+
+    in_hook--;
+}
+
+void *
+malloc (size_t size)
+{
+    if (__atomic_load_n (&active, __ATOMIC_ACQUIRE) && ! in_hook)
+	_record (size);
+
+    return __libc_malloc (size);
+}
+
+void *
+calloc (size_t nmemb, size_t size)
+{
+    if (__atomic_load_n (&active, __ATOMIC_ACQUIRE) && ! in_hook)
+	_record (nmemb * size);
+
+    return __libc_calloc (nmemb, size);
+}
+
+void *
+realloc (void *ptr, size_t size)
+{
+    if (__atomic_load_n (&active, __ATOMIC_ACQUIRE) && ! in_hook)
+	_record (size);
+
+    return __libc_realloc (ptr, size);
+}
+
+cairo_bool_t
+cairo_perf_alloc_supported (void)
+{
+    return TRUE;
+}
+
+void
+cairo_perf_alloc_start (void)
+{
+    void *frames[1];
+
+    if (! ranges_loaded) {
+	_load_ranges ();
+
+	/* backtrace() allocates when it is first used, so prime it now */
+	backtrace (frames, 1);
+    }
+
+    memset (&current, 0, sizeof (current));
+    __atomic_store_n (&active, TRUE, __ATOMIC_RELEASE);
+}
+
+void
+cairo_perf_alloc_stop (cairo_perf_alloc_stats_t *stats)
+{
+    int n;
+
+    __atomic_store_n (&active, FALSE, __ATOMIC_RELEASE);
+
+    for (n = 0; n < CAIRO_PERF_ALLOC_NUM_SITES; n++) {
+	stats->count[n] = __atomic_load_n (&current.count[n], __ATOMIC_RELAXED);
+	stats->bytes[n] = __atomic_load_n (&current.bytes[n], __ATOMIC_RELAXED);
+    }
+}
+
+#else /* !CAIRO_PERF_HAS_ALLOC_STATS */
+
+cairo_bool_t
+cairo_perf_alloc_supported (void)
+{
+    return FALSE;
+}
+
+void
+cairo_perf_alloc_start (void)
+{
+}
+
+void
+cairo_perf_alloc_stop (cairo_perf_alloc_stats_t *stats)
+{
+    memset (stats, 0, sizeof (*stats));
+}
+
+#endif
@@ -311,6 +311,32 @@ cairo_perf_run (cairo_perf_t	   *perf,
 	    fflush (perf->summary);
 	}
 
+	if (perf->alloc_stats) {
+	    cairo_perf_alloc_stats_t alloc_stats;
+	    FILE *file = perf->summary ? perf->summary : stdout;
+
+	    if (similar)
+		cairo_push_group_with_content (perf->cr,
+					       cairo_boilerplate_content (perf->target->content));
+	    else
+		cairo_save (perf->cr);
+	    cairo_perf_alloc_start ();
+	    perf_func (perf->cr, perf->size, perf->size, loops);
+	    cairo_perf_alloc_stop (&alloc_stats);
+	    if (similar)
+		cairo_pattern_destroy (cairo_pop_group (perf->cr));
+	    else
+		cairo_restore (perf->cr);
+
+	    fprintf (file,
+		     "[%3d] %8s.%-5s %26s.%-3d ",
+		     perf->test_number, perf->target->name,
+		     _content_to_string (perf->target->content, similar),
+		     name, perf->size);
+	    cairo_perf_alloc_print (file, &alloc_stats, loops);
+	    fflush (file);
+	}
+
 	perf->test_number++;
     }
 }
@@ -319,11 +345,12 @@ static void
 usage (const char *argv0)
 {
     fprintf (stderr,
-"Usage: %s [-flrv] [-i iterations] [test-names ...]\n"
+"Usage: %s [-aflrv] [-i iterations] [test-names ...]\n"
 "\n"
 "Run the cairo performance test suite over the given tests (all by default)\n"
 "The command-line arguments are interpreted as follows:\n"
 "\n"
+"  -a	allocations; report allocations per iteration by call site\n"
 "  -f	fast; faster, less accurate\n"
 "  -i	iterations; specify the number of iterations per test case\n"
 "  -l	list only; just list selected test case names without executing\n"
@@ -360,16 +387,24 @@ parse_options (cairo_perf_t *perf,
 
     perf->raw = FALSE;
     perf->list_only = FALSE;
+    perf->alloc_stats = FALSE;
     perf->names = NULL;
     perf->num_names = 0;
     perf->summary = stdout;
 
     while (1) {
-	c = _cairo_getopt (argc, argv, "fi:lrv");
+	c = _cairo_getopt (argc, argv, "afi:lrv");
 	if (c == -1)
 	    break;
 
 	switch (c) {
+	case 'a':
+	    if (! cairo_perf_alloc_supported ()) {
+		fprintf (stderr, "Allocation statistics are not supported on this platform\n");
+		exit (1);
+	    }
+	    perf->alloc_stats = TRUE;
+	    break;
 	case 'f':
 	    perf->fast_and_sloppy = TRUE;
 	    if (ms == NULL)
@@ -590,5 +625,7 @@ const cairo_perf_case_t perf_cases[] = {
     { FUNC(wave), 500, 500 },
     { FUNC(fill_clip), 16, 512 },
     { FUNC(tiger), 16, 1024 },
+    { FUNC(png_convert), 64, 512 },
+    { FUNC(mesh_pattern), 64, 512 },
     { NULL }
 };
@@ -368,11 +368,12 @@ static void
 usage (const char *argv0)
 {
     fprintf (stderr,
-"Usage: %s [-clrsv] [-i iterations] [-t tile-size] [-x exclude-file] [test-names ... | traces ...]\n"
+"Usage: %s [-aclrsv] [-i iterations] [-t tile-size] [-x exclude-file] [test-names ... | traces ...]\n"
 "\n"
 "Run the cairo performance test suite over the given tests (all by default)\n"
 "The command-line arguments are interpreted as follows:\n"
 "\n"
+"  -a	allocations; report allocations per replay by call site\n"
 "  -c	use surface cache; keep a cache of surfaces to be reused\n"
 "  -i	iterations; specify the number of iterations per test case\n"
 "  -l	list only; just list selected test case names without executing\n"
@@ -450,6 +451,7 @@ parse_options (cairo_perf_t *perf,
 
     perf->raw = FALSE;
     perf->observe = FALSE;
+    perf->alloc_stats = FALSE;
     perf->list_only = FALSE;
     perf->tile_size = 0;
     perf->names = NULL;
@@ -460,11 +462,18 @@ parse_options (cairo_perf_t *perf,
     perf->num_exclude_names = 0;
 
     while (1) {
-	c = _cairo_getopt (argc, argv, "ci:lrst:vx:");
+	c = _cairo_getopt (argc, argv, "aci:lrst:vx:");
 	if (c == -1)
 	    break;
 
 	switch (c) {
+	case 'a':
+	    if (! cairo_perf_alloc_supported ()) {
+		fprintf (stderr, "Allocation statistics are not supported on this platform\n");
+		exit (1);
+	    }
+	    perf->alloc_stats = TRUE;
+	    break;
 	case 'c':
 	    use_surface_cache = 1;
 	    break;
@@ -638,6 +647,59 @@ _tiling_surface_create (void		 *closure,
     return observer;
 }
 
+static void
+cairo_perf_trace_alloc_stats (cairo_perf_t				*perf,
+			      const cairo_boilerplate_target_t		*target,
+			      const char				*trace,
+			      const char				*name,
+			      const cairo_script_interpreter_hooks_t	*hooks,
+			      struct trace				*args)
+{
+    cairo_perf_alloc_stats_t alloc_stats;
+    cairo_script_interpreter_t *csi;
+    FILE *file = perf->summary ? perf->summary : stdout;
+
+    /* Replay the trace once more, outside of the timed runs, so that
+     * the cost of attributing each allocation does not skew the results.
+     */
+    args->surface = target->create_surface (NULL,
+					    CAIRO_CONTENT_COLOR_ALPHA,
+					    1, 1,
+					    1, 1,
+					    CAIRO_BOILERPLATE_MODE_PERF,
+					    &args->closure);
+    fill_surface (args->surface);
+    if (cairo_surface_status (args->surface)) {
+	cairo_surface_destroy (args->surface);
+	return;
+    }
+
+    csi = cairo_script_interpreter_create ();
+    cairo_script_interpreter_install_hooks (csi, hooks);
+
+    cairo_perf_alloc_start ();
+    cairo_script_interpreter_run (csi, trace);
+    cairo_script_interpreter_finish (csi);
+    cairo_perf_alloc_stop (&alloc_stats);
+
+    scache_clear ();
+
+    cairo_surface_destroy (args->surface);
+
+    if (target->cleanup)
+	target->cleanup (args->closure);
+
+    cairo_script_interpreter_destroy (csi);
+
+    fprintf (file,
+	     "[%3d] %8s %28s ",
+	     perf->test_number,
+	     perf->target->name,
+	     name);
+    cairo_perf_alloc_print (file, &alloc_stats, 1);
+    fflush (file);
+}
+
 static void
 cairo_perf_trace (cairo_perf_t			   *perf,
 		  const cairo_boilerplate_target_t *target,
@@ -649,6 +711,7 @@ cairo_perf_trace (cairo_perf_t			   *perf,
     cairo_stats_t stats = {0.0, 0.0};
     struct trace args = { target };
     int low_std_dev_count;
+    cairo_bool_t failed = FALSE;
     char *trace_cpy, *name;
     const cairo_script_interpreter_hooks_t hooks = {
 	&args,
@@ -790,6 +853,7 @@ cairo_perf_trace (cairo_perf_t			   *perf,
 			 line_no,
 			 cairo_status_to_string (status));
 	    }
+	    failed = TRUE;
 	    goto out;
 	}
 
@@ -915,6 +979,9 @@ out:
 	fflush (stdout);
     }
 
+    if (perf->alloc_stats && ! failed)
+	cairo_perf_trace_alloc_stats (perf, target, trace, name, &hooks, &args);
+
     perf->test_number++;
     free (trace_cpy);
 }
@@ -72,6 +72,42 @@ cairo_perf_timer_elapsed (void);
 void
 cairo_perf_yield (void);
 
+/* allocation accounting */
+
+typedef enum _cairo_perf_alloc_site {
+    CAIRO_PERF_ALLOC_POLYGON,
+    CAIRO_PERF_ALLOC_BOXES,
+    CAIRO_PERF_ALLOC_TRAPS,
+    CAIRO_PERF_ALLOC_CLIP,
+    CAIRO_PERF_ALLOC_PATTERN,
+    CAIRO_PERF_ALLOC_SCALED_GLYPH,
+    CAIRO_PERF_ALLOC_OTHER,
+
+    CAIRO_PERF_ALLOC_NUM_SITES
+} cairo_perf_alloc_site_t;
+
+typedef struct _cairo_perf_alloc_stats {
+    unsigned long long count[CAIRO_PERF_ALLOC_NUM_SITES];
+    unsigned long long bytes[CAIRO_PERF_ALLOC_NUM_SITES];
+} cairo_perf_alloc_stats_t;
+
+cairo_bool_t
+cairo_perf_alloc_supported (void);
+
+void
+cairo_perf_alloc_start (void);
+
+void
+cairo_perf_alloc_stop (cairo_perf_alloc_stats_t *stats);
+
+const char *
+cairo_perf_alloc_site_name (cairo_perf_alloc_site_t site);
+
+void
+cairo_perf_alloc_print (FILE				 *file,
+			const cairo_perf_alloc_stats_t	 *stats,
+			unsigned int			  iterations);
+
 /* running a test case */
 typedef struct _cairo_perf {
     FILE *summary;
@@ -83,6 +119,7 @@ typedef struct _cairo_perf {
     cairo_bool_t raw;
     cairo_bool_t list_only;
     cairo_bool_t observe;
+    cairo_bool_t alloc_stats;
     char **names;
     unsigned int num_names;
     char **exclude_names;
@@ -246,5 +283,7 @@ CAIRO_PERF_DECL (a1_pixel);
 CAIRO_PERF_DECL (sierpinski);
 CAIRO_PERF_DECL (fill_clip);
 CAIRO_PERF_DECL (tiger);
+CAIRO_PERF_DECL (png_convert);
+CAIRO_PERF_DECL (mesh_pattern);
 
 #endif
@@ -0,0 +1,94 @@
+/* -*- Mode: c; c-basic-offset: 4; indent-tabs-mode: t; tab-width: 8; -*- */
+/*
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of
+ * the authors not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The authors make no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL,
+ * INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* Paints a mesh gradient of a few curved, overlapping patches, which
+ * the image backend has to rasterize again on every paint.
+ */
+
+#include "cairo-perf.h"
+
+static cairo_pattern_t *mesh;
+
+static cairo_time_t
+do_mesh_paint (cairo_t *cr, int width, int height, int loops)
+{
+    cairo_set_source (cr, mesh);
+
+    cairo_perf_timer_start ();
+
+    while (loops--)
+	cairo_paint (cr);
+
+    cairo_perf_timer_stop ();
+
+    return cairo_perf_timer_elapsed ();
+}
+
+static void
+add_patch (cairo_pattern_t *pattern, double x, double y, double size)
+{
+    cairo_mesh_pattern_begin_patch (pattern);
+
+    cairo_mesh_pattern_move_to (pattern, x, y);
+    cairo_mesh_pattern_curve_to (pattern,
+				 x + size / 3, y - size / 4,
+				 x + 2 * size / 3, y + size / 4,
+				 x + size, y);
+    cairo_mesh_pattern_curve_to (pattern,
+				 x + size + size / 4, y + size / 3,
+				 x + size - size / 4, y + 2 * size / 3,
+				 x + size, y + size);
+    cairo_mesh_pattern_curve_to (pattern,
+				 x + 2 * size / 3, y + size + size / 4,
+				 x + size / 3, y + size - size / 4,
+				 x, y + size);
+    cairo_mesh_pattern_curve_to (pattern,
+				 x - size / 4, y + 2 * size / 3,
+				 x + size / 4, y + size / 3,
+				 x, y);
+
+    cairo_mesh_pattern_set_corner_color_rgb (pattern, 0, 1, 0, 0);
+    cairo_mesh_pattern_set_corner_color_rgba (pattern, 1, 0, 1, 0, 0.5);
+    cairo_mesh_pattern_set_corner_color_rgb (pattern, 2, 0, 0, 1);
+    cairo_mesh_pattern_set_corner_color_rgba (pattern, 3, 1, 1, 0, 0.8);
+
+    cairo_mesh_pattern_end_patch (pattern);
+}
+
+cairo_bool_t
+mesh_pattern_enabled (cairo_perf_t *perf)
+{
+    return cairo_perf_can_run (perf, "mesh-pattern", NULL);
+}
+
+void
+mesh_pattern (cairo_perf_t *perf, cairo_t *cr, int width, int height)
+{
+    mesh = cairo_pattern_create_mesh ();
+    add_patch (mesh, 0.1 * width, 0.1 * height, 0.6 * width);
+    add_patch (mesh, 0.3 * width, 0.3 * height, 0.6 * width);
+    add_patch (mesh, 0.05 * width, 0.5 * height, 0.4 * width);
+
+    cairo_perf_run (perf, "mesh-pattern-paint", do_mesh_paint, NULL);
+
+    cairo_pattern_destroy (mesh);
+}
@@ -0,0 +1,172 @@
+/* -*- Mode: c; c-basic-offset: 4; indent-tabs-mode: t; tab-width: 8; -*- */
+/*
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of
+ * the authors not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The authors make no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL,
+ * INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* Measures the pixel conversions on either side of libpng: the
+ * unpremultiply of ARGB32 and RGBA128F rows when writing, and the
+ * premultiply back when reading.  Compression is turned off so that
+ * zlib does not drown out the conversions.
+ */
+
+#include "cairo-perf.h"
+
+#include <string.h>
+
+typedef struct _png_buffer {
+    unsigned char *data;
+    size_t length, size;
+    size_t pos;
+} png_buffer_t;
+
+static cairo_surface_t *image;
+static cairo_png_options_t *options;
+static png_buffer_t encoded;
+
+static cairo_status_t
+null_write (void *closure, const unsigned char *data, unsigned int length)
+{
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_status_t
+buffer_write (void *closure, const unsigned char *data, unsigned int length)
+{
+    png_buffer_t *buffer = closure;
+
+    if (buffer->length + length > buffer->size) {
+	size_t size = 2 * (buffer->length + length);
+	unsigned char *new_data = realloc (buffer->data, size);
+	if (new_data == NULL)
+	    return CAIRO_STATUS_NO_MEMORY;
+	buffer->data = new_data;
+	buffer->size = size;
+    }
+
+    memcpy (buffer->data + buffer->length, data, length);
+    buffer->length += length;
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_status_t
+buffer_read (void *closure, unsigned char *data, unsigned int length)
+{
+    png_buffer_t *buffer = closure;
+
+    if (buffer->pos + length > buffer->length)
+	return CAIRO_STATUS_READ_ERROR;
+
+    memcpy (data, buffer->data + buffer->pos, length);
+    buffer->pos += length;
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_time_t
+do_png_write (cairo_t *cr, int width, int height, int loops)
+{
+    cairo_perf_timer_start ();
+
+    while (loops--)
+	cairo_surface_write_to_png_stream_with_options (image, null_write, NULL,
+							options);
+
+    cairo_perf_timer_stop ();
+
+    return cairo_perf_timer_elapsed ();
+}
+
+static cairo_time_t
+do_png_read (cairo_t *cr, int width, int height, int loops)
+{
+    cairo_perf_timer_start ();
+
+    while (loops--) {
+	encoded.pos = 0;
+	cairo_surface_destroy (cairo_image_surface_create_from_png_stream (buffer_read,
+									   &encoded));
+    }
+
+    cairo_perf_timer_stop ();
+
+    return cairo_perf_timer_elapsed ();
+}
+
+static cairo_surface_t *
+create_image (cairo_format_t format, int width, int height)
+{
+    cairo_pattern_t *pattern;
+    cairo_surface_t *surface;
+    cairo_t *cr;
+
+    surface = cairo_image_surface_create (format, width, height);
+    cr = cairo_create (surface);
+
+    /* a mix of opaque, clear and translucent pixels */
+    pattern = cairo_pattern_create_linear (0, 0, width, height);
+    cairo_pattern_add_color_stop_rgba (pattern, 0.0, 1, 0, 0, 1);
+    cairo_pattern_add_color_stop_rgba (pattern, 0.5, 0, 1, 0, 0.5);
+    cairo_pattern_add_color_stop_rgba (pattern, 1.0, 0, 0, 1, 0);
+    cairo_set_source (cr, pattern);
+    cairo_pattern_destroy (pattern);
+    cairo_paint (cr);
+
+    cairo_set_source_rgb (cr, 1, 1, 1);
+    cairo_rectangle (cr, 0, 0, width / 4, height);
+    cairo_fill (cr);
+
+    cairo_destroy (cr);
+    return surface;
+}
+
+cairo_bool_t
+png_convert_enabled (cairo_perf_t *perf)
+{
+    return cairo_perf_can_run (perf, "png-convert", NULL);
+}
+
+void
+png_convert (cairo_perf_t *perf, cairo_t *cr, int width, int height)
+{
+    options = cairo_png_options_create ();
+    cairo_png_options_set_compression_level (options, 0);
+    cairo_png_options_set_filter (options, CAIRO_PNG_FILTER_NONE);
+
+    image = create_image (CAIRO_FORMAT_ARGB32, width, height);
+    cairo_perf_run (perf, "png-convert-write-argb32", do_png_write, NULL);
+
+    memset (&encoded, 0, sizeof (encoded));
+    cairo_surface_write_to_png_stream_with_options (image, buffer_write, &encoded,
+						    options);
+    cairo_perf_run (perf, "png-convert-read-argb32", do_png_read, NULL);
+    free (encoded.data);
+    cairo_surface_destroy (image);
+
+    image = create_image (CAIRO_FORMAT_RGBA128F, width, height);
+    cairo_perf_run (perf, "png-convert-write-rgba128f", do_png_write, NULL);
+
+    memset (&encoded, 0, sizeof (encoded));
+    cairo_surface_write_to_png_stream_with_options (image, buffer_write, &encoded,
+						    options);
+    cairo_perf_run (perf, "png-convert-read-rgba128f", do_png_read, NULL);
+    free (encoded.data);
+    cairo_surface_destroy (image);
+
+    cairo_png_options_destroy (options);
+}
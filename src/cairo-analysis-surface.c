@@ -254,6 +254,103 @@ _add_operation (cairo_analysis_surface_t *surface,
 	return status;
 }
 
+/* Page templates such as letterheads and watermarks are drawn from the
+ * same recording surface on every page, so the outcome of the last
+ * analysis of a recording is kept on the surface for as long as it
+ * has not been modified and is drawn with the same pattern matrix and
+ * extend to the same target.  Only one outcome is kept per recording
+ * because the analysis also stores the region of every command in the
+ * recording itself, and those must match the regions that are merged
+ * into the page.  For the same reason recordings that nest other
+ * recordings, or contain tags, are always analysed afresh. */
+typedef struct _cairo_analysis_cache_entry {
+    unsigned int target_id;
+    unsigned int serial;
+    cairo_matrix_t matrix;
+    cairo_extend_t extend;
+
+    cairo_bool_t has_supported;
+    cairo_bool_t has_unsupported;
+    cairo_region_t supported_region;
+    cairo_region_t fallback_region;
+    cairo_rectangle_int_t extents;
+} cairo_analysis_cache_entry_t;
+
+static const cairo_user_data_key_t _cairo_analysis_cache_key;
+
+static void
+_cairo_analysis_cache_entry_destroy (void *closure)
+{
+    cairo_analysis_cache_entry_t *entry = closure;
+
+    _cairo_region_fini (&entry->supported_region);
+    _cairo_region_fini (&entry->fallback_region);
+    free (entry);
+}
+
+static cairo_analysis_cache_entry_t *
+_cairo_analysis_cache_lookup (cairo_analysis_surface_t	*surface,
+			      cairo_surface_t		*source,
+			      const cairo_pattern_t	*pattern)
+{
+    cairo_analysis_cache_entry_t *entry;
+
+    entry = cairo_surface_get_user_data (source, &_cairo_analysis_cache_key);
+    if (entry == NULL)
+	return NULL;
+
+    if (entry->target_id != surface->target->unique_id ||
+	entry->serial != source->serial ||
+	entry->extend != pattern->extend ||
+	memcmp (&entry->matrix, &pattern->matrix, sizeof (cairo_matrix_t)))
+	return NULL;
+
+    return entry;
+}
+
+static void
+_cairo_analysis_cache_store (cairo_analysis_surface_t	*surface,
+			     cairo_surface_t		*source,
+			     const cairo_pattern_t	*pattern,
+			     cairo_analysis_surface_t	*analysis,
+			     const cairo_rectangle_int_t *extents)
+{
+    cairo_analysis_cache_entry_t *entry;
+    cairo_status_t status;
+
+    if (_cairo_recording_surface_has_tags_or_nested_recordings ((cairo_recording_surface_t *) source)) {
+	/* drop any outcome that is now out of date */
+	cairo_surface_set_user_data (source, &_cairo_analysis_cache_key, NULL, NULL);
+	return;
+    }
+
+    entry = _cairo_malloc (sizeof (cairo_analysis_cache_entry_t));
+    if (unlikely (entry == NULL))
+	return;
+
+    entry->target_id = surface->target->unique_id;
+    entry->serial = source->serial;
+    entry->matrix = pattern->matrix;
+    entry->extend = pattern->extend;
+
+    entry->has_supported = analysis->has_supported;
+    entry->has_unsupported = analysis->has_unsupported;
+    _cairo_region_init (&entry->supported_region);
+    _cairo_region_init (&entry->fallback_region);
+    entry->extents = *extents;
+
+    status = cairo_region_union (&entry->supported_region, &analysis->supported_region);
+    if (likely (status == CAIRO_STATUS_SUCCESS))
+	status = cairo_region_union (&entry->fallback_region, &analysis->fallback_region);
+    if (likely (status == CAIRO_STATUS_SUCCESS))
+	status = cairo_surface_set_user_data (source, &_cairo_analysis_cache_key,
+					      entry, _cairo_analysis_cache_entry_destroy);
+    if (unlikely (status)) {
+	_cairo_analysis_cache_entry_destroy (entry);
+	cairo_surface_set_user_data (source, &_cairo_analysis_cache_key, NULL, NULL);
+    }
+}
+
 static cairo_int_status_t
 _analyze_recording_surface_pattern (cairo_analysis_surface_t *surface,
 				    const cairo_pattern_t    *pattern,
@@ -262,6 +359,7 @@ _analyze_recording_surface_pattern (cairo_analysis_surface_t *surface,
     const cairo_surface_pattern_t *surface_pattern;
     cairo_analysis_surface_t *tmp;
     cairo_surface_t *source, *proxy;
+    cairo_analysis_cache_entry_t *cached;
     cairo_matrix_t p2d;
     cairo_int_status_t status;
     cairo_int_status_t analysis_status = CAIRO_INT_STATUS_SUCCESS;
@@ -279,6 +377,22 @@ _analyze_recording_surface_pattern (cairo_analysis_surface_t *surface,
 	return CAIRO_STATUS_SUCCESS;
     }
 
+    cached = _cairo_analysis_cache_lookup (surface, source, pattern);
+    if (cached != NULL) {
+	if (cached->has_supported) {
+	    surface->has_supported = TRUE;
+	    unused = cairo_region_union (&surface->supported_region, &cached->supported_region);
+	}
+
+	if (cached->has_unsupported) {
+	    surface->has_unsupported = TRUE;
+	    unused = cairo_region_union (&surface->fallback_region, &cached->fallback_region);
+	}
+
+	*extents = cached->extents;
+	return cached->has_unsupported ? CAIRO_INT_STATUS_IMAGE_FALLBACK : CAIRO_INT_STATUS_SUCCESS;
+    }
+
     tmp = (cairo_analysis_surface_t *)
 	_cairo_analysis_surface_create (surface->target);
     if (unlikely (tmp->base.status)) {
@@ -341,6 +455,9 @@ _analyze_recording_surface_pattern (cairo_analysis_surface_t *surface,
 	_cairo_box_round_to_rectangle (&tmp->page_bbox, extents);
     }
 
+    if (likely (status == CAIRO_INT_STATUS_SUCCESS))
+	_cairo_analysis_cache_store (surface, surface_pattern->surface, pattern, tmp, extents);
+
   cleanup2:
     detach_proxy (proxy);
   cleanup1:
@@ -82,12 +82,54 @@
  * will be used exclusively as a "key", (indicated by a parameter name
  * of key). In these cases, the value-related fields of the entry need
  * not be initialized if so desired.
+ *
+ * For a cache using %CAIRO_CACHE_POLICY_COST the user should also set
+ * my_entry->base.cost to an estimate of how expensive the entry is to
+ * recreate, in any units consistent across the cache, and may keep
+ * raising it as more work is invested in the entry. The remaining
+ * fields belong to the cache.
  **/
 typedef struct _cairo_cache_entry {
     unsigned long hash;
     unsigned long size;
+
+    unsigned long cost;
+    cairo_list_t link;
+    double credit;
+    cairo_bool_t referenced;
 } cairo_cache_entry_t;
 
+/**
+ * _cairo_cache_policy:
+ *
+ * Selects which entries are ejected when the cache is full:
+ *
+ * %CAIRO_CACHE_POLICY_RANDOM: any removable entry, chosen at random.
+ *
+ * %CAIRO_CACHE_POLICY_LRU: the least recently looked up entry.
+ *
+ * %CAIRO_CACHE_POLICY_CLOCK: the oldest entry that has not been used
+ * since the last sweep over it; cheaper than LRU as a hit only sets a
+ * flag.
+ *
+ * %CAIRO_CACHE_POLICY_COST: among the oldest few entries, the one with
+ * the least cost per unit of size, with costs decaying as other entries
+ * are ejected (GreedyDual-Size).
+ **/
+typedef enum _cairo_cache_policy {
+    CAIRO_CACHE_POLICY_RANDOM,
+    CAIRO_CACHE_POLICY_LRU,
+    CAIRO_CACHE_POLICY_CLOCK,
+    CAIRO_CACHE_POLICY_COST
+} cairo_cache_policy_t;
+
+typedef struct _cairo_cache_stats {
+    unsigned long lookups;
+    unsigned long hits;
+    unsigned long insertions;
+    unsigned long evictions;
+} cairo_cache_stats_t;
+
 typedef cairo_bool_t (*cairo_cache_predicate_func_t) (const void *entry);
 
 struct _cairo_cache {
@@ -100,6 +142,13 @@ struct _cairo_cache {
     unsigned long size;
 
     int freeze_count;
+
+    cairo_cache_policy_t policy;
+    cairo_list_t entries; /* most recently used first */
+    unsigned long num_entries;
+    double inflation;
+
+    cairo_cache_stats_t stats;
 };
 
 typedef cairo_bool_t
@@ -119,6 +168,10 @@ _cairo_cache_init (cairo_cache_t *cache,
 cairo_private void
 _cairo_cache_fini (cairo_cache_t *cache);
 
+cairo_private void
+_cairo_cache_set_policy (cairo_cache_t	      *cache,
+			 cairo_cache_policy_t  policy);
+
 cairo_private void
 _cairo_cache_freeze (cairo_cache_t *cache);
 
@@ -142,4 +195,14 @@ _cairo_cache_foreach (cairo_cache_t		 *cache,
 		      cairo_cache_callback_func_t cache_callback,
 		      void			 *closure);
 
+/* Record a hit on an entry found without going through
+ * _cairo_cache_lookup(). This does not need the lock protecting the
+ * cache, the flag is only ever a hint. */
+static inline void
+_cairo_cache_entry_mark_used (cairo_cache_entry_t *entry)
+{
+    if (! entry->referenced)
+	entry->referenced = TRUE;
+}
+
 #endif
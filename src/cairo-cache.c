@@ -38,6 +38,10 @@
 
 #include "cairoint.h"
 #include "cairo-error-private.h"
+#include "cairo-list-inline.h"
+
+/* How many of the oldest entries CAIRO_CACHE_POLICY_COST compares */
+#define COST_CANDIDATES 8
 
 static void
 _cairo_cache_shrink_to_accommodate (cairo_cache_t *cache,
@@ -72,8 +76,9 @@ _cairo_cache_entry_is_non_zero (const void *entry)
  * consistent with the units of the size field of cache entries. When
  * adding an entry with _cairo_cache_insert() if the total size of
  * entries in the cache would exceed max_size then entries will be
- * removed at random until the new entry would fit or the cache is
- * empty. Then the new entry is inserted.
+ * removed until the new entry would fit or the cache is empty. Then
+ * the new entry is inserted. Entries are removed at random unless a
+ * different policy is selected with _cairo_cache_set_policy().
  *
  * There are cases in which the automatic removal of entries is
  * undesired. If the cache entries have reference counts, then it is a
@@ -106,9 +111,41 @@ _cairo_cache_init (cairo_cache_t		*cache,
 
     cache->freeze_count = 0;
 
+    cache->policy = CAIRO_CACHE_POLICY_RANDOM;
+    cairo_list_init (&cache->entries);
+    cache->num_entries = 0;
+    cache->inflation = 0.;
+
+    memset (&cache->stats, 0, sizeof (cache->stats));
+
     return CAIRO_STATUS_SUCCESS;
 }
 
+/**
+ * _cairo_cache_set_policy:
+ * @cache: a cache, still empty
+ * @policy: the policy to follow when entries need to be ejected
+ *
+ * Selects which entries will make way for new ones once the cache is
+ * full, see #cairo_cache_policy_t. A cache ejects entries at random
+ * until told otherwise.
+ **/
+void
+_cairo_cache_set_policy (cairo_cache_t	      *cache,
+			 cairo_cache_policy_t  policy)
+{
+    assert (cache->num_entries == 0);
+
+    cache->policy = policy;
+}
+
+static double
+_cairo_cache_entry_credit (cairo_cache_t *cache,
+			   cairo_cache_entry_t *entry)
+{
+    return cache->inflation + (double) entry->cost / MAX (entry->size, 1);
+}
+
 static void
 _cairo_cache_pluck (void *entry, void *closure)
 {
@@ -166,8 +203,8 @@ _cairo_cache_freeze (cairo_cache_t *cache)
  * When a number of calls to _cairo_cache_thaw() is made corresponding
  * to the number of calls to _cairo_cache_freeze() the cache will no
  * longer be "frozen". If the cache had grown larger than max_size
- * while frozen, entries will immediately be ejected (by random) from
- * the cache until the cache is smaller than max_size. Also, the
+ * while frozen, entries will immediately be ejected from the cache
+ * until the cache is smaller than max_size. Also, the
  * automatic ejection of entries on _cairo_cache_insert() will resume.
  **/
 void
@@ -197,8 +234,32 @@ void *
 _cairo_cache_lookup (cairo_cache_t	  *cache,
 		     cairo_cache_entry_t  *key)
 {
-    return _cairo_hash_table_lookup (cache->hash_table,
-				     (cairo_hash_entry_t *) key);
+    cairo_cache_entry_t *entry;
+
+    cache->stats.lookups++;
+
+    entry = _cairo_hash_table_lookup (cache->hash_table,
+				      (cairo_hash_entry_t *) key);
+    if (entry == NULL)
+	return NULL;
+
+    cache->stats.hits++;
+
+    switch (cache->policy) {
+    case CAIRO_CACHE_POLICY_RANDOM:
+	break;
+    case CAIRO_CACHE_POLICY_COST:
+	entry->credit = _cairo_cache_entry_credit (cache, entry);
+	/* fall through */
+    case CAIRO_CACHE_POLICY_LRU:
+	cairo_list_move (&entry->link, &cache->entries);
+	break;
+    case CAIRO_CACHE_POLICY_CLOCK:
+	_cairo_cache_entry_mark_used (entry);
+	break;
+    }
+
+    return entry;
 }
 
 /**
@@ -225,13 +286,98 @@ _cairo_cache_remove_random (cairo_cache_t *cache)
     return TRUE;
 }
 
+/* Remove the least recently used entry that may be removed. */
+static cairo_bool_t
+_cairo_cache_remove_lru (cairo_cache_t *cache)
+{
+    cairo_cache_entry_t *entry;
+
+    cairo_list_foreach_entry_reverse (entry, cairo_cache_entry_t,
+				      &cache->entries, link)
+    {
+	if (cache->predicate (entry)) {
+	    _cairo_cache_remove (cache, entry);
+	    return TRUE;
+	}
+    }
+
+    return FALSE;
+}
+
+/* Sweep over the entries from the oldest, clearing the referenced
+ * flag of those used since the last sweep and giving them another
+ * round, and remove the first one that has not been used. */
+static cairo_bool_t
+_cairo_cache_remove_clock (cairo_cache_t *cache)
+{
+    unsigned long n;
+
+    for (n = 0; n < 2 * cache->num_entries; n++) {
+	cairo_cache_entry_t *entry;
+
+	entry = cairo_list_last_entry (&cache->entries,
+				       cairo_cache_entry_t, link);
+	if (! entry->referenced && cache->predicate (entry)) {
+	    _cairo_cache_remove (cache, entry);
+	    return TRUE;
+	}
+
+	entry->referenced = FALSE;
+	cairo_list_move (&entry->link, &cache->entries);
+    }
+
+    return FALSE;
+}
+
+/* Remove the entry with the least credit amongst the oldest few.
+ * An entry's credit is its cost per unit of size on top of the credit
+ * of the last entry removed at the time it was last used, so cheap
+ * entries go first but expensive ones are not kept around forever. */
+static cairo_bool_t
+_cairo_cache_remove_cheapest (cairo_cache_t *cache)
+{
+    cairo_cache_entry_t *entry, *prev, *victim = NULL;
+    unsigned long n = 0, candidates = 0;
+
+    cairo_list_foreach_entry_reverse_safe (entry, prev, cairo_cache_entry_t,
+					   &cache->entries, link)
+    {
+	if (n++ == cache->num_entries || candidates == COST_CANDIDATES)
+	    break;
+
+	/* Pick up hits recorded by _cairo_cache_entry_mark_used() */
+	if (entry->referenced) {
+	    entry->referenced = FALSE;
+	    entry->credit = _cairo_cache_entry_credit (cache, entry);
+	    cairo_list_move (&entry->link, &cache->entries);
+	    continue;
+	}
+
+	if (! cache->predicate (entry))
+	    continue;
+
+	if (victim == NULL || entry->credit < victim->credit)
+	    victim = entry;
+	candidates++;
+    }
+
+    if (victim == NULL)
+	return FALSE;
+
+    if (victim->credit > cache->inflation)
+	cache->inflation = victim->credit;
+    _cairo_cache_remove (cache, victim);
+
+    return TRUE;
+}
+
 /**
  * _cairo_cache_shrink_to_accommodate:
  * @cache: a cache
  * @additional: additional size requested in bytes
  *
- * If cache is not frozen, eject entries randomly until the size of
- * the cache is at least @additional bytes less than
+ * If cache is not frozen, eject entries according to the cache policy
+ * until the size of the cache is at least @additional bytes less than
  * cache->max_size. That is, make enough room to accommodate a new
  * entry of size @additional.
  **/
@@ -240,8 +386,26 @@ _cairo_cache_shrink_to_accommodate (cairo_cache_t *cache,
 				    unsigned long  additional)
 {
     while (cache->size + additional > cache->max_size) {
-	if (! _cairo_cache_remove_random (cache))
+	cairo_bool_t removed = FALSE;
+
+	switch (cache->policy) {
+	case CAIRO_CACHE_POLICY_RANDOM:
+	    removed = _cairo_cache_remove_random (cache);
+	    break;
+	case CAIRO_CACHE_POLICY_LRU:
+	    removed = _cairo_cache_remove_lru (cache);
+	    break;
+	case CAIRO_CACHE_POLICY_CLOCK:
+	    removed = _cairo_cache_remove_clock (cache);
+	    break;
+	case CAIRO_CACHE_POLICY_COST:
+	    removed = _cairo_cache_remove_cheapest (cache);
+	    break;
+	}
+	if (! removed)
 	    return;
+
+	cache->stats.evictions++;
     }
 }
 
@@ -272,6 +436,14 @@ _cairo_cache_insert (cairo_cache_t	 *cache,
 	return status;
 
     cache->size += entry->size;
+    cache->num_entries++;
+    cache->stats.insertions++;
+
+    if (cache->policy != CAIRO_CACHE_POLICY_RANDOM) {
+	entry->referenced = FALSE;
+	entry->credit = _cairo_cache_entry_credit (cache, entry);
+	cairo_list_add (&entry->link, &cache->entries);
+    }
 
     return CAIRO_STATUS_SUCCESS;
 }
@@ -288,10 +460,14 @@ _cairo_cache_remove (cairo_cache_t	 *cache,
 		     cairo_cache_entry_t *entry)
 {
     cache->size -= entry->size;
+    cache->num_entries--;
 
     _cairo_hash_table_remove (cache->hash_table,
 			      (cairo_hash_entry_t *) entry);
 
+    if (cache->policy != CAIRO_CACHE_POLICY_RANDOM)
+	cairo_list_del (&entry->link);
+
     if (cache->entry_destroy)
 	cache->entry_destroy (entry);
 }
@@ -315,24 +491,232 @@ _cairo_cache_foreach (cairo_cache_t		      *cache,
 			       closure);
 }
 
+void
+_cairo_debug_print_cache (FILE *stream, const cairo_cache_t *cache)
+{
+    static const char *policies[] = { "random", "lru", "clock", "cost" };
+    const cairo_cache_stats_t *stats = &cache->stats;
+
+    fprintf (stream,
+	     "cache: policy=%s, entries=%lu, size=%lu/%lu, "
+	     "lookups=%lu, hits=%lu (%.1f%%), insertions=%lu, evictions=%lu\n",
+	     policies[cache->policy],
+	     cache->num_entries, cache->size, cache->max_size,
+	     stats->lookups, stats->hits,
+	     stats->lookups ? 100. * stats->hits / stats->lookups : 0.,
+	     stats->insertions, stats->evictions);
+}
+
+/* The content hash is XXH64 (https://github.com/Cyan4973/xxHash),
+ * reading the input a 64-bit word at a time and, for keys of 32 bytes or
+ * more, running four independent lanes so that the multiplies overlap.
+ * Words are loaded in native byte order, so the hash values differ
+ * between little and big endian machines; they are never stored.
+ */
+#define HASH_PRIME64_1 0x9e3779b185ebca87ull
+#define HASH_PRIME64_2 0xc2b2ae3d27d4eb4full
+#define HASH_PRIME64_3 0x165667b19e3779f9ull
+#define HASH_PRIME64_4 0x85ebca77c2b2ae63ull
+#define HASH_PRIME64_5 0x27d4eb2f165667c5ull
+
+#define HASH_ROTL64(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+static inline uint64_t
+_hash_read64 (const uint8_t *p)
+{
+    uint64_t v;
+    memcpy (&v, p, sizeof (v));
+    return v;
+}
+
+static inline uint32_t
+_hash_read32 (const uint8_t *p)
+{
+    uint32_t v;
+    memcpy (&v, p, sizeof (v));
+    return v;
+}
+
+static inline uint64_t
+_hash_round (uint64_t acc, uint64_t input)
+{
+    acc += input * HASH_PRIME64_2;
+    acc = HASH_ROTL64 (acc, 31);
+    return acc * HASH_PRIME64_1;
+}
+
+static inline uint64_t
+_hash_merge_round (uint64_t acc, uint64_t v)
+{
+    acc ^= _hash_round (0, v);
+    return acc * HASH_PRIME64_1 + HASH_PRIME64_4;
+}
+
+static const uint8_t *
+_hash_stripes (uint64_t v[4], const uint8_t *p, const uint8_t *end)
+{
+    do {
+	v[0] = _hash_round (v[0], _hash_read64 (p));
+	v[1] = _hash_round (v[1], _hash_read64 (p + 8));
+	v[2] = _hash_round (v[2], _hash_read64 (p + 16));
+	v[3] = _hash_round (v[3], _hash_read64 (p + 24));
+	p += 32;
+    } while (p + 32 <= end);
+
+    return p;
+}
+
+static uint64_t
+_hash_finalize (uint64_t h, const uint8_t *p, size_t length)
+{
+    while (length >= 8) {
+	h ^= _hash_round (0, _hash_read64 (p));
+	h = HASH_ROTL64 (h, 27) * HASH_PRIME64_1 + HASH_PRIME64_4;
+	p += 8;
+	length -= 8;
+    }
+
+    if (length >= 4) {
+	h ^= (uint64_t) _hash_read32 (p) * HASH_PRIME64_1;
+	h = HASH_ROTL64 (h, 23) * HASH_PRIME64_2 + HASH_PRIME64_3;
+	p += 4;
+	length -= 4;
+    }
+
+    while (length--) {
+	h ^= *p++ * HASH_PRIME64_5;
+	h = HASH_ROTL64 (h, 11) * HASH_PRIME64_1;
+    }
+
+    h ^= h >> 33;
+    h *= HASH_PRIME64_2;
+    h ^= h >> 29;
+    h *= HASH_PRIME64_3;
+    h ^= h >> 32;
+
+    return h;
+}
+
+static uint64_t
+_hash_converge (const uint64_t v[4])
+{
+    uint64_t h;
+
+    h = HASH_ROTL64 (v[0], 1) + HASH_ROTL64 (v[1], 7) +
+	HASH_ROTL64 (v[2], 12) + HASH_ROTL64 (v[3], 18);
+    h = _hash_merge_round (h, v[0]);
+    h = _hash_merge_round (h, v[1]);
+    h = _hash_merge_round (h, v[2]);
+    h = _hash_merge_round (h, v[3]);
+
+    return h;
+}
+
+void
+_cairo_hash_state_init (cairo_hash_state_t *state,
+			unsigned long seed)
+{
+    state->v[0] = seed + HASH_PRIME64_1 + HASH_PRIME64_2;
+    state->v[1] = seed + HASH_PRIME64_2;
+    state->v[2] = seed;
+    state->v[3] = seed - HASH_PRIME64_1;
+    state->length = 0;
+    state->buf_len = 0;
+}
+
+void
+_cairo_hash_state_update (cairo_hash_state_t *state,
+			  const void *bytes,
+			  size_t length)
+{
+    const uint8_t *p = bytes;
+    const uint8_t *end = p + length;
+
+    state->length += length;
+
+    if (state->buf_len + length < sizeof (state->buf)) {
+	if (length) /* bytes may be NULL for an empty update */
+	    memcpy (state->buf + state->buf_len, p, length);
+	state->buf_len += length;
+	return;
+    }
+
+    if (state->buf_len) {
+	unsigned int fill = sizeof (state->buf) - state->buf_len;
+
+	memcpy (state->buf + state->buf_len, p, fill);
+	_hash_stripes (state->v, state->buf, state->buf + sizeof (state->buf));
+	p += fill;
+	state->buf_len = 0;
+    }
+
+    if (p + 32 <= end)
+	p = _hash_stripes (state->v, p, end);
+
+    state->buf_len = end - p;
+    if (state->buf_len)
+	memcpy (state->buf, p, state->buf_len);
+}
+
+unsigned long
+_cairo_hash_state_finish (const cairo_hash_state_t *state)
+{
+    uint64_t h;
+
+    if (state->length >= 32)
+	h = _hash_converge (state->v);
+    else
+	h = state->v[2] + HASH_PRIME64_5;
+    h += state->length;
+
+    return _hash_finalize (h, state->buf, state->buf_len);
+}
+
 unsigned long
 _cairo_hash_string (const char *c)
 {
-    /* This is the djb2 hash. */
-    unsigned long hash = _CAIRO_HASH_INIT_VALUE;
-    while (c && *c)
-	hash = ((hash << 5) + hash) + *c++;
-    return hash;
+    if (c == NULL)
+	return _CAIRO_HASH_INIT_VALUE;
+
+    return _cairo_hash_bytes (_CAIRO_HASH_INIT_VALUE, c, strlen (c));
 }
 
+/**
+ * _cairo_hash_bytes:
+ * @hash: the seed, typically %_CAIRO_HASH_INIT_VALUE or the hash of
+ * the preceding fields of the key
+ * @bytes: the data to hash
+ * @length: the number of bytes
+ *
+ * Hashes a contiguous block of memory. Chaining calls is fine for
+ * hashing the fields of a structure, but data split across several
+ * buffers must use a #cairo_hash_state_t to get the same hash
+ * regardless of where the splits fall.
+ *
+ * Return value: the hash
+ **/
 unsigned long
 _cairo_hash_bytes (unsigned long hash,
 		   const void *ptr,
 		   unsigned int length)
 {
-    const uint8_t *bytes = ptr;
-    /* This is the djb2 hash. */
-    while (length--)
-	hash = ((hash << 5) + hash) + *bytes++;
-    return hash;
+    const uint8_t *p = ptr;
+    const uint8_t *end = p + length;
+    uint64_t h;
+
+    if (length >= 32) {
+	uint64_t v[4];
+
+	v[0] = hash + HASH_PRIME64_1 + HASH_PRIME64_2;
+	v[1] = hash + HASH_PRIME64_2;
+	v[2] = hash;
+	v[3] = hash - HASH_PRIME64_1;
+	p = _hash_stripes (v, p, end);
+	h = _hash_converge (v);
+    } else {
+	h = hash + HASH_PRIME64_5;
+    }
+    h += length;
+
+    return _hash_finalize (h, p, end - p);
 }
@@ -2598,9 +2598,9 @@ cairo_cff_font_create_set_widths (cairo_cff_font_t *font)
     cairo_int_status_t status;
 
     size = sizeof (tt_hhea_t);
-    status = font->backend->load_truetype_table (font->scaled_font_subset->scaled_font,
-                                                 TT_TAG_hhea, 0,
-                                                 (unsigned char*) &hhea, &size);
+    status = _cairo_scaled_font_subset_load_table (font->scaled_font_subset,
+						   TT_TAG_hhea, 0,
+						   (unsigned char*) &hhea, &size);
     if (unlikely (status))
         return status;
     num_hmetrics = be16_to_cpu (hhea.num_hmetrics);
@@ -2610,21 +2610,21 @@ cairo_cff_font_create_set_widths (cairo_cff_font_t *font)
         long_entry_size = 2 * sizeof (int16_t);
         short_entry_size = sizeof (int16_t);
         if (glyph_index < num_hmetrics) {
-            status = font->backend->load_truetype_table (font->scaled_font_subset->scaled_font,
-                                                         TT_TAG_hmtx,
-                                                         glyph_index * long_entry_size,
-                                                         (unsigned char *) &short_entry,
-							 &short_entry_size);
+            status = _cairo_scaled_font_subset_load_table (font->scaled_font_subset,
+							   TT_TAG_hmtx,
+							   glyph_index * long_entry_size,
+							   (unsigned char *) &short_entry,
+							   &short_entry_size);
             if (unlikely (status))
                 return status;
         }
         else
         {
-            status = font->backend->load_truetype_table (font->scaled_font_subset->scaled_font,
-                                                         TT_TAG_hmtx,
-                                                         (num_hmetrics - 1) * long_entry_size,
-                                                         (unsigned char *) &short_entry,
-							 &short_entry_size);
+            status = _cairo_scaled_font_subset_load_table (font->scaled_font_subset,
+							   TT_TAG_hmtx,
+							   (num_hmetrics - 1) * long_entry_size,
+							   (unsigned char *) &short_entry,
+							   &short_entry_size);
             if (unlikely (status))
                 return status;
         }
@@ -2666,28 +2666,28 @@ _cairo_cff_font_load_opentype_cff (cairo_cff_font_t  *font)
 	return CAIRO_INT_STATUS_UNSUPPORTED;
 
     data_length = 0;
-    status = backend->load_truetype_table (font->scaled_font_subset->scaled_font,
-                                           TT_TAG_CFF, 0, NULL, &data_length);
+    status = _cairo_scaled_font_subset_load_table (font->scaled_font_subset,
+						   TT_TAG_CFF, 0, NULL, &data_length);
     if (status)
         return status;
 
     size = sizeof (tt_head_t);
-    status = backend->load_truetype_table (font->scaled_font_subset->scaled_font,
-                                           TT_TAG_head, 0,
-                                           (unsigned char *) &head, &size);
+    status = _cairo_scaled_font_subset_load_table (font->scaled_font_subset,
+						   TT_TAG_head, 0,
+						   (unsigned char *) &head, &size);
     if (unlikely (status))
         return status;
 
     size = sizeof (tt_hhea_t);
-    status = backend->load_truetype_table (font->scaled_font_subset->scaled_font,
-                                           TT_TAG_hhea, 0,
-                                           (unsigned char *) &hhea, &size);
+    status = _cairo_scaled_font_subset_load_table (font->scaled_font_subset,
+						   TT_TAG_hhea, 0,
+						   (unsigned char *) &hhea, &size);
     if (unlikely (status))
         return status;
 
     size = 0;
-    status = backend->load_truetype_table (font->scaled_font_subset->scaled_font,
-                                           TT_TAG_hmtx, 0, NULL, &size);
+    status = _cairo_scaled_font_subset_load_table (font->scaled_font_subset,
+						   TT_TAG_hmtx, 0, NULL, &size);
     if (unlikely (status))
         return status;
 
@@ -2714,9 +2714,9 @@ _cairo_cff_font_load_opentype_cff (cairo_cff_font_t  *font)
     if (unlikely (font->data == NULL))
         return _cairo_error (CAIRO_STATUS_NO_MEMORY);
 
-    status = font->backend->load_truetype_table (font->scaled_font_subset->scaled_font,
-						 TT_TAG_CFF, 0, font->data,
-						 &font->data_length);
+    status = _cairo_scaled_font_subset_load_table (font->scaled_font_subset,
+						   TT_TAG_CFF, 0, font->data,
+						   &font->data_length);
     if (unlikely (status))
         return status;
 
@@ -151,6 +151,27 @@ _cairo_clip_combine_with_surface (const cairo_clip_t *clip,
 				  cairo_surface_t *dst,
 				  int dst_x, int dst_y);
 
+cairo_private cairo_surface_t *
+_cairo_clip_lookup_mask (const cairo_clip_t *clip,
+			 cairo_surface_t *target,
+			 const cairo_rectangle_int_t *extents,
+			 int *tx, int *ty);
+
+cairo_private void
+_cairo_clip_get_mask_extents (const cairo_clip_t *clip,
+			      cairo_surface_t *target,
+			      const cairo_rectangle_int_t *extents,
+			      cairo_rectangle_int_t *mask_extents);
+
+cairo_private void
+_cairo_clip_cache_mask (const cairo_clip_t *clip,
+			cairo_surface_t *target,
+			const cairo_rectangle_int_t *extents,
+			cairo_surface_t *mask);
+
+cairo_private void
+_cairo_clip_reset_mask (cairo_surface_t *target);
+
 cairo_private cairo_clip_t *
 _cairo_clip_from_boxes (const cairo_boxes_t *boxes);
 
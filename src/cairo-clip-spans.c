@@ -0,0 +1,279 @@
+/* -*- Mode: c; tab-width: 8; c-basic-offset: 4; indent-tabs-mode: t; -*- */
+/* cairo - a vector graphics library with display and print output
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it either under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * (the "LGPL") or, at your option, under the terms of the Mozilla
+ * Public License Version 1.1 (the "MPL"). If you do not alter this
+ * notice, a recipient may use your version of this file under either
+ * the MPL or the LGPL.
+ *
+ * You should have received a copy of the LGPL along with this library
+ * in the file COPYING-LGPL-2.1; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA
+ * You should have received a copy of the MPL along with this library
+ * in the file COPYING-MPL-1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.1 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY
+ * OF ANY KIND, either express or implied. See the LGPL or the MPL for
+ * the specific language governing rights and limitations.
+ *
+ * The Original Code is the cairo graphics library.
+ */
+
+#include "cairoint.h"
+
+#include "cairo-clip-private.h"
+#include "cairo-error-private.h"
+#include "cairo-region-private.h"
+#include "cairo-spans-private.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+/* Returns the first interval from i onwards that ends after x. */
+static cairo_always_inline int
+_skip_intervals (const int32_t *x2, int i, int count, int x)
+{
+#if defined(__SSE2__)
+    __m128i vx = _mm_set1_epi32 (x);
+
+    while (i + 4 <= count) {
+	__m128i v = _mm_loadu_si128 ((const __m128i *) (x2 + i));
+	int mask = _mm_movemask_ps (_mm_castsi128_ps (_mm_cmpgt_epi32 (v, vx)));
+	if (mask)
+	    return i + __builtin_ctz (mask);
+	i += 4;
+    }
+#endif
+
+    while (i < count && x2[i] <= x)
+	i++;
+
+    return i;
+}
+
+/* Appends [x1, x2) with the given coverage, leaving the terminating
+ * span at the end of the list. */
+static cairo_always_inline unsigned int
+_add_run (cairo_half_open_span_t *spans, unsigned int n,
+	  int x1, int x2, uint8_t coverage)
+{
+    if (n && spans[n-1].x == x1) {
+	if (spans[n-2].coverage == coverage) {
+	    spans[n-1].x = x2;
+	    return n;
+	}
+
+	spans[n-1].coverage = coverage;
+    } else {
+	spans[n].x = x1;
+	spans[n].coverage = coverage;
+	spans[n].inverse = 0;
+	n++;
+    }
+
+    spans[n].x = x2;
+    spans[n].coverage = 0;
+    spans[n].inverse = 0;
+    return n + 1;
+}
+
+static cairo_status_t
+_clip_row (cairo_clip_span_renderer_t		*r,
+	   const cairo_clip_span_band_t		*band,
+	   const cairo_half_open_span_t		*spans,
+	   unsigned int				 num_spans,
+	   const cairo_half_open_span_t	       **out,
+	   unsigned int				*num_out)
+{
+    const int32_t *x1 = r->x1 + band->first;
+    const int32_t *x2 = r->x2 + band->first;
+    int count = band->count;
+    unsigned int n, size;
+    int i;
+
+    *num_out = 0;
+
+    i = _skip_intervals (x2, 0, count, spans[0].x);
+    if (i == count || x1[i] >= spans[num_spans-1].x)
+	return CAIRO_STATUS_SUCCESS;
+
+    /* the row lies wholly inside a single interval */
+    if (x1[i] <= spans[0].x && x2[i] >= spans[num_spans-1].x) {
+	*out = spans;
+	*num_out = num_spans;
+	return CAIRO_STATUS_SUCCESS;
+    }
+
+    size = 2 * (num_spans + count - i);
+    if (size > r->spans_size) {
+	cairo_half_open_span_t *new_spans;
+
+	if (size < 2 * r->spans_size)
+	    size = 2 * r->spans_size;
+	new_spans = _cairo_malloc_ab (size, sizeof (cairo_half_open_span_t));
+	if (unlikely (new_spans == NULL))
+	    return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+
+	free (r->spans);
+	r->spans = new_spans;
+	r->spans_size = size;
+    }
+
+    n = 0;
+    for (; num_spans > 1; spans++, num_spans--) {
+	int sx = spans[0].x, ex = spans[1].x;
+	int j;
+
+	if (spans[0].coverage == 0)
+	    continue;
+
+	i = _skip_intervals (x2, i, count, sx);
+	if (i == count)
+	    break;
+
+	for (j = i; j < count && x1[j] < ex; j++) {
+	    n = _add_run (r->spans, n,
+			  MAX (sx, x1[j]), MIN (ex, x2[j]),
+			  spans[0].coverage);
+	}
+    }
+
+    *out = r->spans;
+    *num_out = n;
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_status_t
+_cairo_clip_span_renderer_rows (void				*abstract_renderer,
+				int				 y,
+				int				 height,
+				const cairo_half_open_span_t	*spans,
+				unsigned int			 num_spans)
+{
+    cairo_clip_span_renderer_t *r = abstract_renderer;
+    const cairo_clip_span_band_t *band, *end;
+    int y2 = y + height;
+
+    /* Nothing is drawn outside of the spans of a bounded operation. */
+    if (num_spans == 0)
+	return CAIRO_STATUS_SUCCESS;
+
+    /* Rows arrive from top to bottom, so the band is only ever advanced. */
+    if (r->current && r->bands[r->current - 1].y2 > y)
+	r->current = 0;
+
+    band = r->bands + r->current;
+    end = r->bands + r->num_bands;
+    while (band < end && band->y2 <= y)
+	band++;
+    r->current = band - r->bands;
+
+    for (; band < end && band->y1 < y2; band++) {
+	const cairo_half_open_span_t *out;
+	unsigned int num_out;
+	cairo_status_t status;
+	int top, bottom;
+
+	status = _clip_row (r, band, spans, num_spans, &out, &num_out);
+	if (unlikely (status))
+	    return status;
+
+	top = MAX (y, band->y1);
+	bottom = MIN (y2, band->y2);
+	if (num_out) {
+	    status = r->target->render_rows (r->target,
+					     top, bottom - top,
+					     out, num_out);
+	    if (unlikely (status))
+		return status;
+	}
+    }
+
+    return CAIRO_STATUS_SUCCESS;
+}
+
+cairo_status_t
+_cairo_clip_span_renderer_init (cairo_clip_span_renderer_t	*r,
+				const cairo_clip_t		*clip,
+				const cairo_rectangle_int_t	*extents,
+				cairo_span_renderer_t		*target)
+{
+    cairo_region_t *region;
+    cairo_clip_span_band_t *band;
+    pixman_box32_t *boxes;
+    int num_boxes, num_x, i;
+    size_t size;
+
+    r->base.status = CAIRO_STATUS_SUCCESS;
+    r->base.destroy = NULL;
+    r->base.render_rows = _cairo_clip_span_renderer_rows;
+    r->base.finish = NULL;
+    r->target = target;
+    r->current = 0;
+    r->spans = NULL;
+    r->spans_size = 0;
+    r->data = r->buf;
+
+    region = _cairo_clip_get_region (clip);
+    if (unlikely (region == NULL))
+	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+
+    boxes = pixman_region32_rectangles (&region->rgn, &num_boxes);
+
+    size = num_boxes * (sizeof (cairo_clip_span_band_t) + 2 * sizeof (int32_t));
+    if (size > sizeof (r->buf)) {
+	r->data = _cairo_malloc_ab (num_boxes,
+				    sizeof (cairo_clip_span_band_t) + 2 * sizeof (int32_t));
+	if (unlikely (r->data == NULL))
+	    return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+    }
+
+    r->bands = r->data;
+    r->x1 = (int32_t *) (r->bands + num_boxes);
+    r->x2 = r->x1 + num_boxes;
+
+    /* The region is stored as y-x bands already, so we only need to
+     * find where each band starts and drop what lies outside. */
+    band = NULL;
+    num_x = 0;
+    for (i = 0; i < num_boxes; i++) {
+	const pixman_box32_t *b = &boxes[i];
+
+	if (b->y2 <= extents->y || b->y1 >= extents->y + extents->height ||
+	    b->x2 <= extents->x || b->x1 >= extents->x + extents->width)
+	    continue;
+
+	if (band == NULL || band->y1 != b->y1) {
+	    band = band ? band + 1 : r->bands;
+	    band->y1 = b->y1;
+	    band->y2 = b->y2;
+	    band->first = num_x;
+	    band->count = 0;
+	}
+
+	r->x1[num_x] = b->x1;
+	r->x2[num_x] = b->x2;
+	band->count++;
+	num_x++;
+    }
+    r->num_bands = band ? band - r->bands + 1 : 0;
+
+    return CAIRO_STATUS_SUCCESS;
+}
+
+void
+_cairo_clip_span_renderer_fini (cairo_clip_span_renderer_t *r)
+{
+    free (r->spans);
+    if (r->data != r->buf)
+	free (r->data);
+}
@@ -40,6 +40,7 @@
  */
 
 #include "cairoint.h"
+#include "cairo-clip-inline.h"
 #include "cairo-clip-private.h"
 #include "cairo-error-private.h"
 #include "cairo-freed-pool-private.h"
@@ -118,6 +119,90 @@ _cairo_path_fixed_add_box (cairo_path_fixed_t *path,
     return _cairo_path_fixed_close_path (path);
 }
 
+/* Consecutive operations usually share their clip, for instance the
+ * glyph runs of a paragraph set inside a rounded rectangle.  So the last
+ * mask rendered for a clip is kept upon its target, to be reused by the
+ * following operations for as long as the clip stays equal.
+ */
+
+/* The largest mask, in pixels, rendered for the whole of a clip. */
+#define CLIP_MASK_MAX_AREA (1 << 22)
+
+cairo_surface_t *
+_cairo_clip_lookup_mask (const cairo_clip_t *clip,
+			 cairo_surface_t *target,
+			 const cairo_rectangle_int_t *extents,
+			 int *tx, int *ty)
+{
+    struct _cairo_clip_mask_cache *cache = &target->clip_mask;
+
+    if (cache->mask == NULL ||
+	! _cairo_rectangle_contains_rectangle (&cache->extents, extents) ||
+	! _cairo_clip_equal (cache->clip, clip))
+	return NULL;
+
+    *tx = cache->extents.x;
+    *ty = cache->extents.y;
+    return cairo_surface_reference (cache->mask);
+}
+
+void
+_cairo_clip_get_mask_extents (const cairo_clip_t *clip,
+			      cairo_surface_t *target,
+			      const cairo_rectangle_int_t *extents,
+			      cairo_rectangle_int_t *mask_extents)
+{
+    struct _cairo_clip_mask_cache *cache = &target->clip_mask;
+
+    *mask_extents = *extents;
+
+    /* Only once the clip is seen to be reused do we render all of it. */
+    if (cache->mask != NULL &&
+	(double) clip->extents.width * clip->extents.height <= CLIP_MASK_MAX_AREA &&
+	_cairo_clip_equal (cache->clip, clip))
+    {
+	_cairo_rectangle_union (mask_extents, &clip->extents);
+    }
+}
+
+void
+_cairo_clip_cache_mask (const cairo_clip_t *clip,
+			cairo_surface_t *target,
+			const cairo_rectangle_int_t *extents,
+			cairo_surface_t *mask)
+{
+    struct _cairo_clip_mask_cache *cache = &target->clip_mask;
+    cairo_clip_t *copy;
+
+    if (unlikely (mask->status))
+	return;
+
+    copy = _cairo_clip_copy (clip);
+    if (_cairo_clip_is_all_clipped (copy))
+	return;
+
+    _cairo_clip_reset_mask (target);
+
+    cache->clip = copy;
+    cache->mask = cairo_surface_reference (mask);
+    cache->extents = *extents;
+}
+
+void
+_cairo_clip_reset_mask (cairo_surface_t *target)
+{
+    struct _cairo_clip_mask_cache *cache = &target->clip_mask;
+
+    if (cache->mask == NULL)
+	return;
+
+    _cairo_clip_destroy (cache->clip);
+    cache->clip = NULL;
+
+    cairo_surface_destroy (cache->mask);
+    cache->mask = NULL;
+}
+
 cairo_surface_t *
 _cairo_clip_get_surface (const cairo_clip_t *clip,
 			 cairo_surface_t *target,
@@ -128,6 +213,10 @@ _cairo_clip_get_surface (const cairo_clip_t *clip,
     cairo_clip_t *copy, *region;
     cairo_clip_path_t *copy_path, *clip_path;
 
+    surface = _cairo_clip_lookup_mask (clip, target, &clip->extents, tx, ty);
+    if (surface != NULL)
+	return surface;
+
     if (clip->num_boxes) {
 	cairo_path_fixed_t path;
 	int i;
@@ -205,6 +294,8 @@ _cairo_clip_get_surface (const cairo_clip_t *clip,
 	return _cairo_surface_create_in_error (status);
     }
 
+    _cairo_clip_cache_mask (clip, target, &clip->extents, surface);
+
     *tx = clip->extents.x;
     *ty = clip->extents.y;
     return surface;
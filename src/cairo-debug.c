@@ -35,6 +35,7 @@
 
 #include "cairoint.h"
 #include "cairo-image-surface-private.h"
+#include "cairo-parallel-private.h"
 
 /**
  * cairo_debug_reset_static_data:
@@ -94,6 +95,8 @@ cairo_debug_reset_static_data (void)
 
     _cairo_default_context_reset_static_data ();
 
+    _cairo_parallel_reset_static_data ();
+
 #if CAIRO_HAS_COGL_SURFACE
     _cairo_cogl_context_reset_static_data ();
 #endif
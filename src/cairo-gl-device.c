@@ -304,6 +304,7 @@ _cairo_gl_context_init (cairo_gl_context_t *ctx)
 				CAIRO_GL_GRADIENT_CACHE_SIZE);
     if (unlikely (status))
 	return status;
+    _cairo_cache_set_policy (&ctx->gradients, CAIRO_CACHE_POLICY_LRU);
 
     ctx->vbo_size = _cairo_gl_get_vbo_size();
 
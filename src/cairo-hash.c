@@ -39,88 +39,216 @@
 #include "cairoint.h"
 #include "cairo-error-private.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 /*
- * An entry can be in one of three states:
- *
- * FREE: Entry has never been used, terminates all searches.
- *       Appears in the table as a %NULL pointer.
- *
- * DEAD: Entry had been live in the past. A dead entry can be reused
- *       but does not terminate a search for an exact entry.
- *       Appears in the table as a pointer to DEAD_ENTRY.
- *
- * LIVE: Entry is currently being used.
- *       Appears in the table as any non-%NULL, non-DEAD_ENTRY pointer.
+ * The table is laid out after the "Swiss tables" of abseil: alongside
+ * the array of entry pointers we keep one control byte per slot, so
+ * that a probe only touches a compact run of bytes and dereferences an
+ * entry pointer when its hash is already likely to match. The mixed
+ * hash of every entry is stored inline as well, so that moving entries
+ * about never has to touch the entries themselves.
+ *
+ * A control byte can be in one of three states:
+ *
+ * EMPTY: Slot is unused, terminates all searches.
+ *
+ * DELETED: Slot was emptied while the table was being iterated. It
+ *          does not terminate a search and is purged as soon as the
+ *          iteration completes, so outside of _cairo_hash_table_foreach()
+ *          there are no tombstones at all.
+ *
+ * LIVE: Slot holds an entry. The control byte stores 7 bits of the
+ *       (mixed) hash of the entry as a tag.
+ *
+ * The table uses linear probing over a power-of-two number of slots,
+ * and the control bytes are examined a group at a time: 16 with SSE2,
+ * otherwise 8 packed into a 64-bit word. The first GROUP_WIDTH - 1
+ * control bytes are mirrored past the end of the array so that a group
+ * can be loaded from any position without wrapping.
+ *
+ * Removal shifts the following entries of the probe run back into the
+ * vacated slot instead of leaving a tombstone, so lookups never have to
+ * step over the remains of dead entries.
+ *
+ * The table is kept between 12.5% and 75% full; when its size is
+ * changed the new table is between 25% and 37.5% full. Doubling and
+ * halving in this fashion guarantees amortized O(1) insertion/removal.
  */
 
-#define DEAD_ENTRY ((cairo_hash_entry_t *) 0x1)
+#define CTRL_EMPTY   ((uint8_t) 0x80)
+#define CTRL_DELETED ((uint8_t) 0xfe)
 
-#define ENTRY_IS_FREE(entry) ((entry) == NULL)
-#define ENTRY_IS_DEAD(entry) ((entry) == DEAD_ENTRY)
-#define ENTRY_IS_LIVE(entry) ((entry) >  DEAD_ENTRY)
+#define CTRL_IS_LIVE(c) ((c) < 0x80)
 
-/*
- * This table is open-addressed with double hashing. Each table size
- * is a prime and it makes for the "first" hash modulus; a second
- * prime (2 less than the first prime) serves as the "second" hash
- * modulus, which is smaller and thus guarantees a complete
- * permutation of table indices.
- *
- * Hash tables are rehashed in order to keep between 12.5% and 50%
- * entries in the hash table alive and at least 25% free. When table
- * size is changed, the new table has about 25% live elements.
- *
- * The free entries guarantee an expected constant-time lookup.
- * Doubling/halving the table in the described fashion guarantees
- * amortized O(1) insertion/removal.
- *
- * This structure, and accompanying table, is borrowed/modified from the
- * file xserver/render/glyph.c in the freedesktop.org x server, with
- * permission (and suggested modification of doubling sizes) by Keith
- * Packard.
- */
+#define MIN_SIZE 32
 
-static const unsigned long hash_table_sizes[] = {
-    43,
-    73,
-    151,
-    283,
-    571,
-    1153,
-    2269,
-    4519,
-    9013,
-    18043,
-    36109,
-    72091,
-    144409,
-    288361,
-    576883,
-    1153459,
-    2307163,
-    4613893,
-    9227641,
-    18455029,
-    36911011,
-    73819861,
-    147639589,
-    295279081,
-    590559793
-};
+#if defined(__SSE2__)
+
+#define GROUP_WIDTH 16
+
+typedef __m128i cairo_hash_group_t;
+typedef uint32_t cairo_hash_bitmask_t;
+
+static cairo_always_inline cairo_hash_group_t
+_group_load (const uint8_t *ctrl)
+{
+    return _mm_loadu_si128 ((const __m128i *) ctrl);
+}
+
+static cairo_always_inline cairo_hash_bitmask_t
+_group_match (cairo_hash_group_t group, uint8_t tag)
+{
+    return _mm_movemask_epi8 (_mm_cmpeq_epi8 (group, _mm_set1_epi8 (tag)));
+}
+
+static cairo_always_inline cairo_hash_bitmask_t
+_group_match_empty (cairo_hash_group_t group)
+{
+    return _group_match (group, CTRL_EMPTY);
+}
+
+static cairo_always_inline int
+_bitmask_first (cairo_hash_bitmask_t mask)
+{
+#if __GNUC__ > 3 || (__GNUC__ == 3 && __GNUC_MINOR__ >= 4)
+    return __builtin_ctz (mask);
+#else
+    int i = 0;
+
+    while ((mask & 1) == 0) {
+	mask >>= 1;
+	i++;
+    }
+    return i;
+#endif
+}
+
+#else
+
+#define GROUP_WIDTH 8
+
+#define LSBS 0x0101010101010101ULL
+#define MSBS 0x8080808080808080ULL
+
+typedef uint64_t cairo_hash_group_t;
+typedef uint64_t cairo_hash_bitmask_t;
+
+/* Assemble the bytes in little-endian order whatever the host, so that
+ * byte n of the group is always reported in bit 8n+7 of a match. */
+static cairo_always_inline cairo_hash_group_t
+_group_load (const uint8_t *ctrl)
+{
+    return ((uint64_t) ctrl[0] <<  0) | ((uint64_t) ctrl[1] <<  8) |
+	   ((uint64_t) ctrl[2] << 16) | ((uint64_t) ctrl[3] << 24) |
+	   ((uint64_t) ctrl[4] << 32) | ((uint64_t) ctrl[5] << 40) |
+	   ((uint64_t) ctrl[6] << 48) | ((uint64_t) ctrl[7] << 56);
+}
+
+/* This may report a false positive for a byte following a true match;
+ * every candidate is verified against the entry so that is harmless. */
+static cairo_always_inline cairo_hash_bitmask_t
+_group_match (cairo_hash_group_t group, uint8_t tag)
+{
+    uint64_t x = group ^ (LSBS * tag);
+    return (x - LSBS) & ~x & MSBS;
+}
+
+/* EMPTY is the only control byte with the top bit set and bit 1 clear */
+static cairo_always_inline cairo_hash_bitmask_t
+_group_match_empty (cairo_hash_group_t group)
+{
+    return group & ~(group << 6) & MSBS;
+}
+
+static cairo_always_inline int
+_bitmask_first (cairo_hash_bitmask_t mask)
+{
+#if __GNUC__ > 3 || (__GNUC__ == 3 && __GNUC_MINOR__ >= 4)
+    return __builtin_ctzll (mask) >> 3;
+#else
+    int i = 0;
+
+    while ((mask & 0x80) == 0) {
+	mask >>= 8;
+	i++;
+    }
+    return i;
+#endif
+}
+
+#endif
 
 struct _cairo_hash_table {
     cairo_hash_keys_equal_func_t keys_equal;
 
     cairo_hash_entry_t *cache[32];
 
-    const unsigned long *table_size;
+    unsigned long size; /* a power of two */
     cairo_hash_entry_t **entries;
+    uint32_t *hashes;
+    uint8_t *ctrl;
 
     unsigned long live_entries;
-    unsigned long free_entries;
+    unsigned long deleted_entries;
     unsigned long iterating;   /* Iterating, no insert, no resize */
 };
 
+static cairo_always_inline uint32_t
+_cairo_hash_mix (uintptr_t hash)
+{
+    uint32_t h = hash;
+
+    if (sizeof (hash) > 4)
+	h ^= (uint64_t) hash >> 32;
+
+    /* Many of our hashes are small integers or pointers, so spread the
+     * bits before splitting into the probe position and the tag. */
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+
+    return h;
+}
+
+#define HASH_POSITION(h) ((h) >> 7)
+#define HASH_TAG(h) ((uint8_t) ((h) & 0x7f))
+
+static cairo_always_inline void
+_cairo_hash_table_set_ctrl (cairo_hash_table_t *hash_table,
+			    unsigned long idx,
+			    uint8_t ctrl)
+{
+    hash_table->ctrl[idx] = ctrl;
+    if (idx < GROUP_WIDTH - 1)
+	hash_table->ctrl[hash_table->size + idx] = ctrl;
+}
+
+static cairo_status_t
+_cairo_hash_table_alloc (cairo_hash_table_t *hash_table,
+			 unsigned long size)
+{
+    cairo_hash_entry_t **entries;
+
+    entries = _cairo_malloc_ab_plus_c (size,
+				       sizeof (cairo_hash_entry_t *) + sizeof (uint32_t),
+				       size + GROUP_WIDTH - 1);
+    if (unlikely (entries == NULL))
+	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+
+    hash_table->size = size;
+    hash_table->entries = entries;
+    hash_table->hashes = (uint32_t *) (entries + size);
+    hash_table->ctrl = (uint8_t *) (hash_table->hashes + size);
+    memset (hash_table->ctrl, CTRL_EMPTY, size + GROUP_WIDTH - 1);
+
+    return CAIRO_STATUS_SUCCESS;
+}
+
 /**
  * _cairo_hash_table_uid_keys_equal:
  * @key_a: the first key to be compared
@@ -176,18 +304,14 @@ _cairo_hash_table_create (cairo_hash_keys_equal_func_t keys_equal)
 	hash_table->keys_equal = keys_equal;
 
     memset (&hash_table->cache, 0, sizeof (hash_table->cache));
-    hash_table->table_size = &hash_table_sizes[0];
 
-    hash_table->entries = calloc (*hash_table->table_size,
-				  sizeof (cairo_hash_entry_t *));
-    if (unlikely (hash_table->entries == NULL)) {
-	_cairo_error_throw (CAIRO_STATUS_NO_MEMORY);
+    if (unlikely (_cairo_hash_table_alloc (hash_table, MIN_SIZE))) {
 	free (hash_table);
 	return NULL;
     }
 
     hash_table->live_entries = 0;
-    hash_table->free_entries = *hash_table->table_size;
+    hash_table->deleted_entries = 0;
     hash_table->iterating = 0;
 
     return hash_table;
@@ -222,34 +346,23 @@ _cairo_hash_table_destroy (cairo_hash_table_t *hash_table)
     free (hash_table);
 }
 
-static cairo_hash_entry_t **
-_cairo_hash_table_lookup_unique_key (cairo_hash_table_t *hash_table,
-				     cairo_hash_entry_t *key)
+/* Returns the first EMPTY slot in the probe run of @hash. */
+static unsigned long
+_cairo_hash_table_find_empty (cairo_hash_table_t *hash_table,
+			      uint32_t hash)
 {
-    unsigned long table_size, i, idx, step;
-    cairo_hash_entry_t **entry;
-
-    table_size = *hash_table->table_size;
-    idx = key->hash % table_size;
-
-    entry = &hash_table->entries[idx];
-    if (! ENTRY_IS_LIVE (*entry))
-	return entry;
+    unsigned long mask = hash_table->size - 1;
+    unsigned long pos = HASH_POSITION (hash) & mask;
 
-    i = 1;
-    step = 1 + key->hash % (table_size - 2);
-    do {
-	idx += step;
-	if (idx >= table_size)
-	    idx -= table_size;
+    while (TRUE) {
+	cairo_hash_bitmask_t empty;
 
-	entry = &hash_table->entries[idx];
-	if (! ENTRY_IS_LIVE (*entry))
-	    return entry;
-    } while (++i < table_size);
+	empty = _group_match_empty (_group_load (hash_table->ctrl + pos));
+	if (empty)
+	    return (pos + _bitmask_first (empty)) & mask;
 
-    ASSERT_NOT_REACHED;
-    return NULL;
+	pos = (pos + GROUP_WIDTH) & mask;
+    }
 }
 
 /**
@@ -258,8 +371,7 @@ _cairo_hash_table_lookup_unique_key (cairo_hash_table_t *hash_table,
  *
  * Resize the hash table if the number of entries has gotten much
  * bigger or smaller than the ideal number of entries for the current
- * size and guarantee some free entries to be used as lookup
- * termination points.
+ * size, and purge any tombstones left behind by an iteration.
  *
  * Return value: %CAIRO_STATUS_SUCCESS if successful or
  * %CAIRO_STATUS_NO_MEMORY if out of memory.
@@ -269,56 +381,44 @@ _cairo_hash_table_manage (cairo_hash_table_t *hash_table)
 {
     cairo_hash_table_t tmp;
     unsigned long new_size, i;
+    cairo_status_t status;
 
-    /* Keep between 12.5% and 50% entries in the hash table alive and
-     * at least 25% free. */
-    unsigned long live_high = *hash_table->table_size >> 1;
-    unsigned long live_low = live_high >> 2;
-    unsigned long free_low = live_high >> 1;
-
-    tmp = *hash_table;
+    /* Keep between 12.5% and 75% of the slots alive, counting the
+     * entry that may be about to be inserted. */
+    unsigned long live_high = hash_table->size - (hash_table->size >> 2);
+    unsigned long live_low = hash_table->size >> 3;
 
-    if (hash_table->live_entries > live_high)
-    {
-	tmp.table_size = hash_table->table_size + 1;
-	/* This code is being abused if we can't make a table big enough. */
-	assert (tmp.table_size - hash_table_sizes <
-		ARRAY_LENGTH (hash_table_sizes));
-    }
-    else if (hash_table->live_entries < live_low)
-    {
-	/* Can't shrink if we're at the smallest size */
-	if (hash_table->table_size == &hash_table_sizes[0])
-	    tmp.table_size = hash_table->table_size;
-	else
-	    tmp.table_size = hash_table->table_size - 1;
-    }
+    new_size = hash_table->size;
+    if (hash_table->live_entries + 1 > live_high)
+	new_size <<= 1;
+    else if (hash_table->live_entries < live_low && new_size > MIN_SIZE)
+	new_size >>= 1;
 
-    if (tmp.table_size == hash_table->table_size &&
-	hash_table->free_entries > free_low)
-    {
-	/* The number of live entries is within the desired bounds
-	 * (we're not going to resize the table) and we have enough
-	 * free entries. Do nothing. */
+    if (new_size == hash_table->size && hash_table->deleted_entries == 0)
 	return CAIRO_STATUS_SUCCESS;
-    }
 
-    new_size = *tmp.table_size;
-    tmp.entries = calloc (new_size, sizeof (cairo_hash_entry_t*));
-    if (unlikely (tmp.entries == NULL))
-	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+    status = _cairo_hash_table_alloc (&tmp, new_size);
+    if (unlikely (status))
+	return status;
 
-    for (i = 0; i < *hash_table->table_size; ++i) {
-	if (ENTRY_IS_LIVE (hash_table->entries[i])) {
-	    *_cairo_hash_table_lookup_unique_key (&tmp, hash_table->entries[i])
-		= hash_table->entries[i];
+    for (i = 0; i < hash_table->size; i++) {
+	if (CTRL_IS_LIVE (hash_table->ctrl[i])) {
+	    uint32_t hash = hash_table->hashes[i];
+	    unsigned long idx;
+
+	    idx = _cairo_hash_table_find_empty (&tmp, hash);
+	    tmp.entries[idx] = hash_table->entries[i];
+	    tmp.hashes[idx] = hash;
+	    _cairo_hash_table_set_ctrl (&tmp, idx, HASH_TAG (hash));
 	}
     }
 
     free (hash_table->entries);
+    hash_table->size = tmp.size;
     hash_table->entries = tmp.entries;
-    hash_table->table_size = tmp.table_size;
-    hash_table->free_entries = new_size - hash_table->live_entries;
+    hash_table->hashes = tmp.hashes;
+    hash_table->ctrl = tmp.ctrl;
+    hash_table->deleted_entries = 0;
 
     return CAIRO_STATUS_SUCCESS;
 }
@@ -339,44 +439,43 @@ _cairo_hash_table_lookup (cairo_hash_table_t *hash_table,
 			  cairo_hash_entry_t *key)
 {
     cairo_hash_entry_t *entry;
-    unsigned long table_size, i, idx, step;
-    unsigned long hash = key->hash;
+    unsigned long mask, pos;
+    uint32_t hash;
+    uint8_t tag;
 
-    entry = hash_table->cache[hash & 31];
-    if (entry && entry->hash == hash && hash_table->keys_equal (key, entry))
+    entry = hash_table->cache[key->hash & 31];
+    if (entry && entry->hash == key->hash && hash_table->keys_equal (key, entry))
 	return entry;
 
-    table_size = *hash_table->table_size;
-    idx = hash % table_size;
+    hash = _cairo_hash_mix (key->hash);
+    tag = HASH_TAG (hash);
+    mask = hash_table->size - 1;
+    pos = HASH_POSITION (hash) & mask;
 
-    entry = hash_table->entries[idx];
-    if (ENTRY_IS_LIVE (entry)) {
-	if (entry->hash == hash && hash_table->keys_equal (key, entry))
-		goto insert_cache;
-    } else if (ENTRY_IS_FREE (entry))
-	return NULL;
+    while (TRUE) {
+	cairo_hash_group_t group = _group_load (hash_table->ctrl + pos);
+	cairo_hash_bitmask_t match = _group_match (group, tag);
 
-    i = 1;
-    step = 1 + hash % (table_size - 2);
-    do {
-	idx += step;
-	if (idx >= table_size)
-	    idx -= table_size;
-
-	entry = hash_table->entries[idx];
-	if (ENTRY_IS_LIVE (entry)) {
-	    if (entry->hash == hash && hash_table->keys_equal (key, entry))
-		    goto insert_cache;
-	} else if (ENTRY_IS_FREE (entry))
-	    return NULL;
-    } while (++i < table_size);
+	while (match) {
+	    unsigned long idx = (pos + _bitmask_first (match)) & mask;
 
-    ASSERT_NOT_REACHED;
-    return NULL;
+	    entry = hash_table->entries[idx];
+	    if (CTRL_IS_LIVE (hash_table->ctrl[idx]) &&
+		entry->hash == key->hash &&
+		hash_table->keys_equal (key, entry))
+	    {
+		hash_table->cache[key->hash & 31] = entry;
+		return entry;
+	    }
+
+	    match &= match - 1;
+	}
 
-insert_cache:
-    hash_table->cache[hash & 31] = entry;
-    return entry;
+	if (_group_match_empty (group))
+	    return NULL;
+
+	pos = (pos + GROUP_WIDTH) & mask;
+    }
 }
 
 /**
@@ -387,12 +486,13 @@ insert_cache:
  * Find a random entry in the hash table satisfying the given
  * @predicate.
  *
- * We use the same algorithm as the lookup algorithm to walk over the
- * entries in the hash table in a pseudo-random order. Walking
- * linearly would favor entries following gaps in the hash table. We
- * could also call rand() repeatedly, which works well for almost-full
- * tables, but degrades when the table is almost empty, or predicate
- * returns %TRUE for most entries.
+ * We walk over the slots in a pseudo-random order by starting at a
+ * random slot and advancing by a random odd step, which visits every
+ * slot of a power-of-two sized table exactly once. Walking linearly
+ * would favor entries following gaps in the hash table. We could also
+ * call rand() repeatedly, which works well for almost-full tables,
+ * but degrades when the table is almost empty, or predicate returns
+ * %TRUE for most entries.
  *
  * Return value: a random live entry or %NULL if there are no entries
  * that match the given predicate. In particular, if predicate is
@@ -402,31 +502,25 @@ void *
 _cairo_hash_table_random_entry (cairo_hash_table_t	   *hash_table,
 				cairo_hash_predicate_func_t predicate)
 {
-    cairo_hash_entry_t *entry;
+    unsigned long mask, i, idx, step;
     unsigned long hash;
-    unsigned long table_size, i, idx, step;
 
     assert (predicate != NULL);
 
-    table_size = *hash_table->table_size;
+    mask = hash_table->size - 1;
     hash = rand ();
-    idx = hash % table_size;
-
-    entry = hash_table->entries[idx];
-    if (ENTRY_IS_LIVE (entry) && predicate (entry))
-	return entry;
-
-    i = 1;
-    step = 1 + hash % (table_size - 2);
-    do {
-	idx += step;
-	if (idx >= table_size)
-	    idx -= table_size;
+    idx = hash & mask;
+    step = (hash >> 8) | 1;
+
+    for (i = 0; i < hash_table->size; i++) {
+	if (CTRL_IS_LIVE (hash_table->ctrl[idx]) &&
+	    predicate (hash_table->entries[idx]))
+	{
+	    return hash_table->entries[idx];
+	}
 
-	entry = hash_table->entries[idx];
-	if (ENTRY_IS_LIVE (entry) && predicate (entry))
-	    return entry;
-    } while (++i < table_size);
+	idx = (idx + step) & mask;
+    }
 
     return NULL;
 }
@@ -455,8 +549,9 @@ cairo_status_t
 _cairo_hash_table_insert (cairo_hash_table_t *hash_table,
 			  cairo_hash_entry_t *key_and_value)
 {
-    cairo_hash_entry_t **entry;
     cairo_status_t status;
+    unsigned long idx;
+    uint32_t hash;
 
     /* Insert is illegal while an iterator is running. */
     assert (hash_table->iterating == 0);
@@ -465,47 +560,82 @@ _cairo_hash_table_insert (cairo_hash_table_t *hash_table,
     if (unlikely (status))
 	return status;
 
-    entry = _cairo_hash_table_lookup_unique_key (hash_table, key_and_value);
-
-    if (ENTRY_IS_FREE (*entry))
-	hash_table->free_entries--;
+    hash = _cairo_hash_mix (key_and_value->hash);
+    idx = _cairo_hash_table_find_empty (hash_table, hash);
 
-    *entry = key_and_value;
+    hash_table->entries[idx] = key_and_value;
+    hash_table->hashes[idx] = hash;
+    _cairo_hash_table_set_ctrl (hash_table, idx, HASH_TAG (hash));
     hash_table->cache[key_and_value->hash & 31] = key_and_value;
     hash_table->live_entries++;
 
     return CAIRO_STATUS_SUCCESS;
 }
 
-static cairo_hash_entry_t **
+static unsigned long
 _cairo_hash_table_lookup_exact_key (cairo_hash_table_t *hash_table,
 				    cairo_hash_entry_t *key)
 {
-    unsigned long table_size, i, idx, step;
-    cairo_hash_entry_t **entry;
+    unsigned long mask, pos;
+    uint32_t hash;
+    uint8_t tag;
 
-    table_size = *hash_table->table_size;
-    idx = key->hash % table_size;
+    hash = _cairo_hash_mix (key->hash);
+    tag = HASH_TAG (hash);
+    mask = hash_table->size - 1;
+    pos = HASH_POSITION (hash) & mask;
 
-    entry = &hash_table->entries[idx];
-    if (*entry == key)
-	return entry;
+    while (TRUE) {
+	cairo_hash_bitmask_t match;
 
-    i = 1;
-    step = 1 + key->hash % (table_size - 2);
-    do {
-	idx += step;
-	if (idx >= table_size)
-	    idx -= table_size;
+	match = _group_match (_group_load (hash_table->ctrl + pos), tag);
+	while (match) {
+	    unsigned long idx = (pos + _bitmask_first (match)) & mask;
 
-	entry = &hash_table->entries[idx];
-	if (*entry == key)
-	    return entry;
-    } while (++i < table_size);
+	    if (CTRL_IS_LIVE (hash_table->ctrl[idx]) &&
+		hash_table->entries[idx] == key)
+	    {
+		return idx;
+	    }
 
-    ASSERT_NOT_REACHED;
-    return NULL;
+	    match &= match - 1;
+	}
+
+	pos = (pos + GROUP_WIDTH) & mask;
+    }
 }
+
+/* Close the gap at @idx by moving back every following entry of the
+ * probe run that may legally occupy it. */
+static void
+_cairo_hash_table_shift_back (cairo_hash_table_t *hash_table,
+			      unsigned long idx)
+{
+    unsigned long mask = hash_table->size - 1;
+    unsigned long next = idx;
+
+    while (TRUE) {
+	unsigned long home;
+
+	next = (next + 1) & mask;
+	if (hash_table->ctrl[next] == CTRL_EMPTY)
+	    break;
+
+	home = HASH_POSITION (hash_table->hashes[next]) & mask;
+
+	/* Only move the entry if the gap lies between its home and it */
+	if (((next - home) & mask) >= ((next - idx) & mask)) {
+	    hash_table->entries[idx] = hash_table->entries[next];
+	    hash_table->hashes[idx] = hash_table->hashes[next];
+	    _cairo_hash_table_set_ctrl (hash_table, idx,
+					hash_table->ctrl[next]);
+	    idx = next;
+	}
+    }
+
+    _cairo_hash_table_set_ctrl (hash_table, idx, CTRL_EMPTY);
+}
+
 /**
  * _cairo_hash_table_remove:
  * @hash_table: a hash table
@@ -520,20 +650,27 @@ void
 _cairo_hash_table_remove (cairo_hash_table_t *hash_table,
 			  cairo_hash_entry_t *key)
 {
-    *_cairo_hash_table_lookup_exact_key (hash_table, key) = DEAD_ENTRY;
+    unsigned long idx;
+
+    idx = _cairo_hash_table_lookup_exact_key (hash_table, key);
     hash_table->live_entries--;
     hash_table->cache[key->hash & 31] = NULL;
 
-    /* Check for table resize. Don't do this when iterating as this will
-     * reorder elements of the table and cause the iteration to potentially
-     * skip some elements. */
-    if (hash_table->iterating == 0) {
-	/* This call _can_ fail, but only in failing to allocate new
-	 * memory to shrink the hash table. It does leave the table in a
-	 * consistent state, and we've already succeeded in removing the
-	 * entry, so we don't examine the failure status of this call. */
-	_cairo_hash_table_manage (hash_table);
+    /* Moving entries around would cause a running iteration to skip
+     * or revisit them, so leave a tombstone to be purged afterwards. */
+    if (hash_table->iterating) {
+	_cairo_hash_table_set_ctrl (hash_table, idx, CTRL_DELETED);
+	hash_table->deleted_entries++;
+	return;
     }
+
+    _cairo_hash_table_shift_back (hash_table, idx);
+
+    /* This call _can_ fail, but only in failing to allocate new
+     * memory to shrink the hash table. It does leave the table in a
+     * consistent state, and we've already succeeded in removing the
+     * entry, so we don't examine the failure status of this call. */
+    _cairo_hash_table_manage (hash_table);
 }
 
 /**
@@ -557,21 +694,19 @@ _cairo_hash_table_foreach (cairo_hash_table_t	      *hash_table,
 			   void			      *closure)
 {
     unsigned long i;
-    cairo_hash_entry_t *entry;
 
     /* Mark the table for iteration */
     ++hash_table->iterating;
-    for (i = 0; i < *hash_table->table_size; i++) {
-	entry = hash_table->entries[i];
-	if (ENTRY_IS_LIVE(entry))
-	    hash_callback (entry, closure);
+    for (i = 0; i < hash_table->size; i++) {
+	if (CTRL_IS_LIVE (hash_table->ctrl[i]))
+	    hash_callback (hash_table->entries[i], closure);
     }
-    /* If some elements were deleted during the iteration,
-     * the table may need resizing. Just do this every time
+    /* If some elements were deleted during the iteration, the table
+     * holds tombstones and may need resizing. Just do this every time
      * as the check is inexpensive.
      */
     if (--hash_table->iterating == 0) {
-	/* Should we fail to shrink the hash table, it is left unaltered,
+	/* Should we fail to rebuild the hash table, it is left unaltered,
 	 * and we don't need to propagate the error status. */
 	_cairo_hash_table_manage (hash_table);
     }
@@ -48,6 +48,7 @@
 #include "cairo-compositor-private.h"
 #include "cairo-spans-compositor-private.h"
 
+#include "cairo-parallel-private.h"
 #include "cairo-region-private.h"
 #include "cairo-traps-private.h"
 #include "cairo-tristrip-private.h"
@@ -382,6 +383,138 @@ fill_boxes (void		*_dst,
     return CAIRO_STATUS_SUCCESS;
 }
 
+/* Sampling through a separable convolution filter costs a few dozen
+ * taps per pixel, so large (down)scaled composites are split into bands
+ * of rows that are run on the worker threads. The first band is
+ * composited on the calling thread beforehand, which lets pixman
+ * validate the images before they are shared read-only.
+ */
+#define CONVOLVE_PARALLEL_MIN_PIXELS (256 * 256)
+#define CONVOLVE_PARALLEL_MIN_ROWS 16
+
+struct composite_bands {
+    pixman_op_t op;
+    pixman_image_t *src, *mask, *dst;
+    int src_x, src_y;
+    int mask_x, mask_y;
+    int dst_x, dst_y;
+    int width, height;
+    int band_height;
+};
+
+static void
+composite_band (void *closure, int index)
+{
+    const struct composite_bands *c = closure;
+    int y = (index + 1) * c->band_height;
+
+    pixman_image_composite32 (c->op, c->src, c->mask, c->dst,
+			      c->src_x, c->src_y + y,
+			      c->mask_x, c->mask_y + y,
+			      c->dst_x, c->dst_y + y,
+			      c->width, MIN (c->band_height, c->height - y));
+}
+
+/* Subsurfaces and other views sample straight out of their parent's
+ * pixels, so compare the rows each image spans rather than just the
+ * data pointers. */
+static void
+image_bytes (pixman_image_t *image, uint8_t **first, uint8_t **last)
+{
+    uint8_t *data = (uint8_t *) pixman_image_get_data (image);
+    ptrdiff_t stride = pixman_image_get_stride (image);
+    int height = pixman_image_get_height (image);
+
+    if (stride < 0) {
+	*first = data + stride * (height - 1);
+	*last = data - stride;
+    } else {
+	*first = data;
+	*last = data + stride * height;
+    }
+}
+
+static cairo_bool_t
+images_overlap (pixman_image_t *a, pixman_image_t *b)
+{
+    uint8_t *a_first, *a_last, *b_first, *b_last;
+
+    if (a == NULL || pixman_image_get_data (a) == NULL ||
+	b == NULL || pixman_image_get_data (b) == NULL)
+	return FALSE;
+
+    image_bytes (a, &a_first, &a_last);
+    image_bytes (b, &b_first, &b_last);
+    return a_first < b_last && b_first < a_last;
+}
+
+static cairo_bool_t
+is_convolved (cairo_surface_t *abstract_src)
+{
+    return abstract_src->backend == &_cairo_image_source_backend &&
+	((cairo_image_source_t *) abstract_src)->is_convolved;
+}
+
+static void
+composite_convolved (pixman_op_t	 op,
+		     pixman_image_t	*src,
+		     pixman_image_t	*mask,
+		     pixman_image_t	*dst,
+		     int		 src_x,
+		     int		 src_y,
+		     int		 mask_x,
+		     int		 mask_y,
+		     int		 dst_x,
+		     int		 dst_y,
+		     int		 width,
+		     int		 height)
+{
+    struct composite_bands c;
+    int num_threads, num_bands;
+
+    num_threads = _cairo_parallel_num_threads ();
+    if (num_threads > 1 &&
+	(int64_t) width * height >= CONVOLVE_PARALLEL_MIN_PIXELS &&
+	! images_overlap (src, dst) &&
+	! images_overlap (mask, dst))
+    {
+	c.band_height = (height + 2 * num_threads - 1) / (2 * num_threads);
+	if (c.band_height < CONVOLVE_PARALLEL_MIN_ROWS)
+	    c.band_height = CONVOLVE_PARALLEL_MIN_ROWS;
+	num_bands = (height + c.band_height - 1) / c.band_height;
+    } else
+	num_bands = 1;
+
+    if (num_bands == 1) {
+	pixman_image_composite32 (op, src, mask, dst,
+				  src_x, src_y,
+				  mask_x, mask_y,
+				  dst_x, dst_y,
+				  width, height);
+	return;
+    }
+
+    pixman_image_composite32 (op, src, mask, dst,
+			      src_x, src_y,
+			      mask_x, mask_y,
+			      dst_x, dst_y,
+			      width, c.band_height);
+
+    c.op = op;
+    c.src = src;
+    c.mask = mask;
+    c.dst = dst;
+    c.src_x = src_x;
+    c.src_y = src_y;
+    c.mask_x = mask_x;
+    c.mask_y = mask_y;
+    c.dst_x = dst_x;
+    c.dst_y = dst_y;
+    c.width = width;
+    c.height = height;
+    _cairo_parallel_for (num_bands - 1, composite_band, &c);
+}
+
 static cairo_int_status_t
 composite (void			*_dst,
 	   cairo_operator_t	op,
@@ -401,7 +534,16 @@ composite (void			*_dst,
 
     TRACE ((stderr, "%s\n", __FUNCTION__));
 
-    if (mask) {
+    if (is_convolved (abstract_src)) {
+	composite_convolved (_pixman_operator (op),
+			     src->pixman_image,
+			     mask ? mask->pixman_image : NULL,
+			     to_pixman_image (_dst),
+			     src_x, src_y,
+			     mask_x, mask_y,
+			     dst_x, dst_y,
+			     width, height);
+    } else if (mask) {
 	pixman_image_composite32 (_pixman_operator (op),
 				  src->pixman_image, mask->pixman_image, to_pixman_image (_dst),
 				  src_x, src_y,
@@ -494,6 +636,7 @@ composite_boxes (void			*_dst,
     pixman_image_t *src = ((cairo_image_source_t *)abstract_src)->pixman_image;
     pixman_image_t *mask = abstract_mask ? ((cairo_image_source_t *)abstract_mask)->pixman_image : NULL;
     pixman_image_t *free_src = NULL;
+    cairo_bool_t convolved = is_convolved (abstract_src);
     struct _cairo_boxes_chunk *chunk;
     int i;
 
@@ -513,6 +656,7 @@ composite_boxes (void			*_dst,
 	    free_src = src = _pixman_image_for_color (CAIRO_COLOR_WHITE);
 	    if (unlikely (src == NULL))
 		return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+	    convolved = FALSE;
 	    op = PIXMAN_OP_OUT_REVERSE;
 #endif
 	} else if (op == CAIRO_OPERATOR_SOURCE) {
@@ -535,11 +679,19 @@ composite_boxes (void			*_dst,
 	    int x2 = _cairo_fixed_integer_part (chunk->base[i].p2.x);
 	    int y2 = _cairo_fixed_integer_part (chunk->base[i].p2.y);
 
-	    pixman_image_composite32 (op, src, mask, dst,
-				      x1 + src_x, y1 + src_y,
-				      x1 + mask_x, y1 + mask_y,
-				      x1 + dst_x, y1 + dst_y,
-				      x2 - x1, y2 - y1);
+	    if (convolved) {
+		composite_convolved (op, src, mask, dst,
+				     x1 + src_x, y1 + src_y,
+				     x1 + mask_x, y1 + mask_y,
+				     x1 + dst_x, y1 + dst_y,
+				     x2 - x1, y2 - y1);
+	    } else {
+		pixman_image_composite32 (op, src, mask, dst,
+					  x1 + src_x, y1 + src_y,
+					  x1 + mask_x, y1 + mask_y,
+					  x1 + dst_x, y1 + dst_y,
+					  x2 - x1, y2 - y1);
+	    }
 	}
     }
 
@@ -1261,6 +1413,166 @@ composite_glyphs (void				*_dst,
 }
 #endif
 
+/* Color glyphs are sources rather than masks, so the generic path used
+ * to paint them one at a time, each through the full compositor.
+ * Instead, composite their images straight from the glyph cache of
+ * the scaled font, in one pass under a region clip.
+ */
+struct color_glyph {
+    pixman_image_t *image;
+    int x, y;
+};
+
+/**
+ * _cairo_image_composite_color_glyphs:
+ * @dst: the destination image
+ * @op: the operator
+ * @scaled_font: the font of @glyphs
+ * @glyphs: glyphs in device space
+ * @num_glyphs: the number of @glyphs, updated to the number left over
+ * @clip: the clip
+ *
+ * Composites the color glyphs among @glyphs onto @dst, as painting
+ * each of them with @op would. The remaining glyphs are moved to the
+ * front of @glyphs and left to be shown as usual.
+ *
+ * Return value: %CAIRO_INT_STATUS_UNSUPPORTED, leaving @glyphs
+ * untouched, if @op is unbounded or @clip is not a region.
+ **/
+cairo_int_status_t
+_cairo_image_composite_color_glyphs (cairo_image_surface_t	*dst,
+				     cairo_operator_t		 op,
+				     cairo_scaled_font_t	*scaled_font,
+				     cairo_glyph_t		*glyphs,
+				     int			*num_glyphs,
+				     const cairo_clip_t		*clip)
+{
+    struct color_glyph stack_color[CAIRO_STACK_ARRAY_LENGTH (struct color_glyph)];
+    struct color_glyph *color = stack_color;
+    cairo_scaled_glyph_t *glyph_cache[64];
+    cairo_region_t *clip_region = NULL;
+    cairo_rectangle_int_t extents;
+    cairo_int_status_t status;
+    pixman_op_t pixman_op;
+    int i, num_color, remaining;
+    int x1, y1, x2, y2;
+
+    TRACE ((stderr, "%s x %d\n", __FUNCTION__, *num_glyphs));
+
+    if (op == CAIRO_OPERATOR_SOURCE || op == CAIRO_OPERATOR_CLEAR ||
+	! _cairo_operator_bounded_by_source (op))
+	return CAIRO_INT_STATUS_UNSUPPORTED;
+
+    if (clip != NULL) {
+	if (! _cairo_clip_is_region (clip))
+	    return CAIRO_INT_STATUS_UNSUPPORTED;
+	clip_region = _cairo_clip_get_region (clip);
+    }
+
+    if (*num_glyphs > ARRAY_LENGTH (stack_color)) {
+	color = _cairo_malloc_ab (*num_glyphs, sizeof (struct color_glyph));
+	if (unlikely (color == NULL))
+	    return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+    }
+
+    memset (glyph_cache, 0, sizeof (glyph_cache));
+    status = CAIRO_INT_STATUS_SUCCESS;
+    num_color = remaining = 0;
+    x1 = y1 = INT_MAX;
+    x2 = y2 = INT_MIN;
+
+    _cairo_scaled_font_freeze_cache (scaled_font);
+
+    for (i = 0; i < *num_glyphs; i++) {
+	cairo_image_surface_t *glyph_surface;
+	cairo_scaled_glyph_t *scaled_glyph;
+	unsigned long glyph_index = glyphs[i].index;
+	int cache_index = glyph_index % ARRAY_LENGTH (glyph_cache);
+
+	scaled_glyph = glyph_cache[cache_index];
+	if (scaled_glyph == NULL ||
+	    _cairo_scaled_glyph_index (scaled_glyph) != glyph_index)
+	{
+	    status = _cairo_scaled_glyph_lookup (scaled_font, glyph_index,
+						 CAIRO_SCALED_GLYPH_INFO_SURFACE,
+						 &scaled_glyph);
+	    if (unlikely (status)) {
+		status = _cairo_scaled_font_set_error (scaled_font, status);
+		goto out;
+	    }
+
+	    glyph_cache[cache_index] = scaled_glyph;
+	}
+
+	if ((scaled_glyph->has_info & CAIRO_SCALED_GLYPH_INFO_COLOR_SURFACE) == 0) {
+	    glyphs[remaining++] = glyphs[i];
+	    continue;
+	}
+
+	glyph_surface = scaled_glyph->color_surface;
+	if (glyph_surface->width == 0 || glyph_surface->height == 0)
+	    continue;
+
+	/* Round glyph locations to the nearest pixel.  The device scale
+	 * is already part of the scaled font, so the glyph images are in
+	 * device pixels, and their device transform is only the offset
+	 * to the glyph origin. */
+	color[num_color].image = glyph_surface->pixman_image;
+	color[num_color].x = _cairo_lround (glyphs[i].x -
+					    glyph_surface->base.device_transform.x0);
+	color[num_color].y = _cairo_lround (glyphs[i].y -
+					    glyph_surface->base.device_transform.y0);
+
+	x1 = MIN (x1, color[num_color].x);
+	y1 = MIN (y1, color[num_color].y);
+	x2 = MAX (x2, color[num_color].x + glyph_surface->width);
+	y2 = MAX (y2, color[num_color].y + glyph_surface->height);
+	num_color++;
+    }
+
+    if (num_color == 0) {
+	status = remaining ? CAIRO_INT_STATUS_SUCCESS : CAIRO_INT_STATUS_NOTHING_TO_DO;
+	goto done;
+    }
+
+    extents.x = x1;
+    extents.y = y1;
+    extents.width  = x2 - x1;
+    extents.height = y2 - y1;
+    if (clip != NULL &&
+	! _cairo_rectangle_intersect (&extents, _cairo_clip_get_extents (clip)))
+	goto done;
+    _cairo_image_surface_unshare_extents (dst, &extents);
+
+    status = set_clip_region (dst, clip_region);
+    if (unlikely (status))
+	goto out;
+
+    pixman_op = _pixman_operator (op);
+    for (i = 0; i < num_color; i++) {
+	pixman_image_composite32 (pixman_op,
+				  color[i].image, NULL, dst->pixman_image,
+				  0, 0,
+				  0, 0,
+				  color[i].x, color[i].y,
+				  pixman_image_get_width (color[i].image),
+				  pixman_image_get_height (color[i].image));
+    }
+
+    if (clip_region != NULL)
+	status = set_clip_region (dst, NULL);
+
+done:
+    *num_glyphs = remaining;
+out:
+    _cairo_scaled_font_thaw_cache (scaled_font);
+
+    if (color != stack_color)
+	free (color);
+
+    return status;
+}
+
 static cairo_int_status_t
 check_composite (const cairo_composite_rectangles_t *extents)
 {
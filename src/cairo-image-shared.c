@@ -0,0 +1,251 @@
+/* -*- Mode: c; tab-width: 8; c-basic-offset: 4; indent-tabs-mode: t; -*- */
+/* cairo - a vector graphics library with display and print output
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it either under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * (the "LGPL") or, at your option, under the terms of the Mozilla
+ * Public License Version 1.1 (the "MPL"). If you do not alter this
+ * notice, a recipient may use your version of this file under either
+ * the MPL or the LGPL.
+ *
+ * You should have received a copy of the LGPL along with this library
+ * in the file COPYING-LGPL-2.1; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA
+ * You should have received a copy of the MPL along with this library
+ * in the file COPYING-MPL-1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.1 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY
+ * OF ANY KIND, either express or implied. See the LGPL or the MPL for
+ * the specific language governing rights and limitations.
+ *
+ * The Original Code is the cairo graphics library.
+ */
+
+/* Image surfaces whose pixels live in an anonymous shared-memory file,
+ * so that another process can map the very same pages (by receiving
+ * the file descriptor over a socket, say) and read the rendering
+ * without it ever being copied.
+ *
+ * The rows are padded to a multiple of 64 bytes, which suits both
+ * cache lines and the SIMD loads of typical consumers (video encoders,
+ * compositors), and large buffers are rounded up to a whole number of
+ * huge pages and advised as such.
+ */
+
+#define _GNU_SOURCE /* required for memfd_create */
+#include "cairoint.h"
+
+#include "cairo-error-private.h"
+#include "cairo-image-surface-inline.h"
+
+#if HAVE_MEMFD_CREATE
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define SHARED_STRIDE_ALIGNMENT 64
+#define SHARED_HUGE_PAGE_SIZE (2 << 20)
+
+#define ROUND_UP(x, a) (((x) + (a) - 1) & ~((size_t) (a) - 1))
+
+typedef struct _cairo_image_shared {
+    int fd;
+    void *data;
+    size_t size;
+} cairo_image_shared_t;
+
+static const cairo_user_data_key_t _cairo_image_shared_key;
+
+static cairo_image_shared_t *
+_cairo_image_surface_get_shared (cairo_surface_t *surface)
+{
+    if (surface->status || ! _cairo_surface_is_image (surface))
+	return NULL;
+
+    return _cairo_user_data_array_get_data (&surface->user_data,
+					    &_cairo_image_shared_key);
+}
+
+#if HAVE_MEMFD_CREATE
+
+static void
+_cairo_image_shared_destroy (void *closure)
+{
+    cairo_image_shared_t *shared = closure;
+
+    munmap (shared->data, shared->size);
+    close (shared->fd);
+    free (shared);
+}
+
+static cairo_status_t
+_cairo_image_shared_create (size_t size, cairo_image_shared_t **shared_out)
+{
+    cairo_image_shared_t *shared;
+    long page_size;
+
+    page_size = sysconf (_SC_PAGESIZE);
+    if (page_size <= 0)
+	page_size = 4096;
+
+    if (size >= SHARED_HUGE_PAGE_SIZE)
+	size = ROUND_UP (size, SHARED_HUGE_PAGE_SIZE);
+    else
+	size = ROUND_UP (MAX (size, 1), page_size);
+
+    shared = _cairo_malloc (sizeof (cairo_image_shared_t));
+    if (unlikely (shared == NULL))
+	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+
+    shared->fd = memfd_create ("cairo-image", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (shared->fd == -1)
+	goto err_free;
+
+    if (ftruncate (shared->fd, size) == -1)
+	goto err_close;
+
+#ifdef F_ADD_SEALS
+    /* Promise the receiver that the file will not change size under it */
+    fcntl (shared->fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL);
+#endif
+
+    shared->data = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED,
+			 shared->fd, 0);
+    if (shared->data == MAP_FAILED)
+	goto err_close;
+
+#ifdef MADV_HUGEPAGE
+    if (size >= SHARED_HUGE_PAGE_SIZE)
+	madvise (shared->data, size, MADV_HUGEPAGE);
+#endif
+
+    shared->size = size;
+    *shared_out = shared;
+    return CAIRO_STATUS_SUCCESS;
+
+err_close:
+    close (shared->fd);
+err_free:
+    free (shared);
+    return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+}
+
+#endif
+
+/**
+ * cairo_image_surface_create_shared:
+ * @format: format of pixels in the surface to create
+ * @width: width of the surface, in pixels
+ * @height: height of the surface, in pixels
+ *
+ * Creates an image surface like cairo_image_surface_create(), but with
+ * its pixel data held in an anonymous shared-memory file. The file
+ * descriptor, available from cairo_image_surface_get_shared_fd(), can
+ * be passed to another process, which may then map it and use the
+ * rendering directly, without any copy. The layout of the pixels is
+ * given by cairo_image_surface_get_stride() and the usual format
+ * description; the stride is always a multiple of 64 bytes.
+ *
+ * Rendering into an image surface is complete once cairo_surface_flush()
+ * returns, so call it before telling the other process that the frame
+ * is ready. If the other process writes into the memory, call
+ * cairo_surface_mark_dirty() before drawing to the surface again.
+ *
+ * On systems without anonymous shared memory files, this returns an
+ * ordinary image surface, for which cairo_image_surface_get_shared_fd()
+ * returns -1.
+ *
+ * Return value: a pointer to the newly created surface. The caller
+ * owns the surface and should call cairo_surface_destroy() when done
+ * with it.
+ *
+ * This function always returns a valid pointer, but it will return a
+ * pointer to a "nil" surface if an error such as out of memory
+ * occurs. You can use cairo_surface_status() to check for this.
+ *
+ * Since: 1.18
+ **/
+cairo_surface_t *
+cairo_image_surface_create_shared (cairo_format_t	format,
+				   int			width,
+				   int			height)
+{
+#if HAVE_MEMFD_CREATE
+    cairo_image_shared_t *shared;
+    cairo_surface_t *surface;
+    cairo_status_t status;
+    int stride;
+
+    stride = cairo_format_stride_for_width (format, width);
+    if (stride <= 0 || height < 0)
+	return cairo_image_surface_create (format, width, height);
+
+    if (stride > INT_MAX - (SHARED_STRIDE_ALIGNMENT - 1))
+	return _cairo_surface_create_in_error (_cairo_error (CAIRO_STATUS_INVALID_STRIDE));
+    stride = ROUND_UP (stride, SHARED_STRIDE_ALIGNMENT);
+
+    status = _cairo_image_shared_create ((size_t) stride * height, &shared);
+    if (unlikely (status))
+	return cairo_image_surface_create (format, width, height);
+
+    surface = cairo_image_surface_create_for_data (shared->data,
+						   format, width, height,
+						   stride);
+    if (unlikely (surface->status)) {
+	_cairo_image_shared_destroy (shared);
+	return surface;
+    }
+
+    status = _cairo_user_data_array_set_data (&surface->user_data,
+					      &_cairo_image_shared_key,
+					      shared,
+					      _cairo_image_shared_destroy);
+    if (unlikely (status)) {
+	_cairo_image_shared_destroy (shared);
+	cairo_surface_destroy (surface);
+	return _cairo_surface_create_in_error (status);
+    }
+
+    /* the fresh pages read back as zero */
+    surface->is_clear = TRUE;
+
+    return surface;
+#else
+    return cairo_image_surface_create (format, width, height);
+#endif
+}
+
+/**
+ * cairo_image_surface_get_shared_fd:
+ * @surface: a #cairo_image_surface_t
+ *
+ * Gets the file descriptor of the shared memory holding the pixels of
+ * an image surface created by cairo_image_surface_create_shared(). The
+ * pixel data starts at offset 0 of the file.
+ *
+ * The descriptor remains owned by @surface and is closed when the
+ * surface is destroyed; use dup() to keep it for longer.
+ *
+ * Return value: the file descriptor, or -1 if @surface is not backed
+ * by shared memory.
+ *
+ * Since: 1.18
+ **/
+int
+cairo_image_surface_get_shared_fd (cairo_surface_t *surface)
+{
+    cairo_image_shared_t *shared;
+
+    shared = _cairo_image_surface_get_shared (surface);
+    if (shared == NULL)
+	return -1;
+
+    return shared->fd;
+}
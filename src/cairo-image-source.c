@@ -264,9 +264,14 @@ UNLOCK:
 }
 
 
+static void
+_cairo_image_kernel_cache_reset (void);
+
 void
 _cairo_image_reset_static_data (void)
 {
+    _cairo_image_kernel_cache_reset ();
+
 #if PIXMAN_HAS_ATOMIC_OPS
     while (n_cached)
 	pixman_image_unref (cache[--n_cached].image);
@@ -913,6 +918,85 @@ create_separable_convolution (int *n_values,
     return params;
 }
 
+/* The same few scale factors tend to be used over and over again, for
+ * example when painting a page of thumbnails, so keep the most recent
+ * kernels around rather than evaluating the (windowed sinc, cubic)
+ * functions for every phase of every composite. The subsample bits
+ * are derived from the scale factors, so the key covers them too.
+ */
+#define KERNEL_CACHE_SIZE 16
+static struct {
+    kernel_t xfilter, yfilter;
+    double sx, sy;
+    int n_params;
+    pixman_fixed_t *params;
+} kernel_cache[KERNEL_CACHE_SIZE];
+static int n_cached_kernels;
+static int kernel_cache_evict;
+
+static void
+_pixman_image_set_separable_convolution (pixman_image_t *pixman_image,
+					 kernel_t xfilter,
+					 double sx,
+					 kernel_t yfilter,
+					 double sy)
+{
+    pixman_fixed_t *params;
+    int n_params;
+    int i;
+
+    CAIRO_MUTEX_LOCK (_cairo_image_kernel_cache_mutex);
+    for (i = 0; i < n_cached_kernels; i++) {
+	if (kernel_cache[i].xfilter == xfilter &&
+	    kernel_cache[i].yfilter == yfilter &&
+	    kernel_cache[i].sx == sx &&
+	    kernel_cache[i].sy == sy)
+	{
+	    /* pixman takes its own copy of the parameters */
+	    pixman_image_set_filter (pixman_image,
+				     PIXMAN_FILTER_SEPARABLE_CONVOLUTION,
+				     kernel_cache[i].params,
+				     kernel_cache[i].n_params);
+	    CAIRO_MUTEX_UNLOCK (_cairo_image_kernel_cache_mutex);
+	    return;
+	}
+    }
+    CAIRO_MUTEX_UNLOCK (_cairo_image_kernel_cache_mutex);
+
+    params = create_separable_convolution (&n_params,
+					   xfilter, sx,
+					   yfilter, sy);
+    pixman_image_set_filter (pixman_image,
+			     PIXMAN_FILTER_SEPARABLE_CONVOLUTION,
+			     params, n_params);
+    if (unlikely (params == NULL))
+	return;
+
+    CAIRO_MUTEX_LOCK (_cairo_image_kernel_cache_mutex);
+    if (n_cached_kernels < KERNEL_CACHE_SIZE) {
+	i = n_cached_kernels++;
+    } else {
+	i = kernel_cache_evict;
+	kernel_cache_evict = (i + 1) % KERNEL_CACHE_SIZE;
+	free (kernel_cache[i].params);
+    }
+    kernel_cache[i].xfilter = xfilter;
+    kernel_cache[i].yfilter = yfilter;
+    kernel_cache[i].sx = sx;
+    kernel_cache[i].sy = sy;
+    kernel_cache[i].n_params = n_params;
+    kernel_cache[i].params = params;
+    CAIRO_MUTEX_UNLOCK (_cairo_image_kernel_cache_mutex);
+}
+
+static void
+_cairo_image_kernel_cache_reset (void)
+{
+    while (n_cached_kernels)
+	free (kernel_cache[--n_cached_kernels].params);
+    kernel_cache_evict = 0;
+}
+
 /* ========================================================================== */
 
 static cairo_bool_t
@@ -1014,13 +1098,9 @@ _pixman_image_set_properties (pixman_image_t *pixman_image,
 	}
 
 	if (pixman_filter == PIXMAN_FILTER_SEPARABLE_CONVOLUTION) {
-	    int n_params;
-	    pixman_fixed_t *params;
-	    params = create_separable_convolution
-		(&n_params, kernel, dx, kernel, dy);
-	    pixman_image_set_filter (pixman_image, pixman_filter,
-				     params, n_params);
-	    free (params);
+	    _pixman_image_set_separable_convolution (pixman_image,
+						     kernel, dx,
+						     kernel, dy);
 	} else {
 	    pixman_image_set_filter (pixman_image, pixman_filter, NULL, 0);
 	}
@@ -1259,6 +1339,234 @@ done:
     return pixman_image;
 }
 
+/* A pyramid of successively halved copies of an image surface, used
+ * to minify it with the GOOD filter. Sampling the whole source through
+ * a box wide enough for a 1/16 scale is very slow, and beyond that the
+ * filter is clipped and aliases. The halved copies are box filtered,
+ * so the result differs slightly from the plain GOOD filter and the
+ * pyramid is only used when CAIRO_IMAGE_MIPMAP is set in the
+ * environment. The levels are built on demand and
+ * kept as user data on the image, tagged with its serial, so that they
+ * are rebuilt once it has been drawn to or marked dirty. (A snapshot
+ * would be detached by cairo_surface_flush() instead, but then
+ * cairo_surface_mark_dirty() on its own would trip over it.)
+ */
+#define MIPMAP_MAX_LEVELS 16
+
+struct mipmap {
+    cairo_surface_t base;
+
+    unsigned int serial;
+    int num_levels;
+    pixman_image_t *levels[MIPMAP_MAX_LEVELS]; /* half size and down */
+};
+
+static cairo_status_t
+mipmap_finish (void *abstract_surface)
+{
+    struct mipmap *mipmap = abstract_surface;
+
+    while (mipmap->num_levels)
+	pixman_image_unref (mipmap->levels[--mipmap->num_levels]);
+
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static const cairo_surface_backend_t mipmap_backend  = {
+    CAIRO_INTERNAL_SURFACE_TYPE_NULL,
+    mipmap_finish,
+};
+
+static const cairo_user_data_key_t mipmap_key;
+
+static void
+_mipmap_destroy (void *closure)
+{
+    cairo_surface_destroy (closure);
+}
+
+/* The images returned for a level may be released by any thread, and
+ * pixman's reference counts are not atomic, so the level is kept alive
+ * by an atomic reference to the mipmap rather than to its image.
+ */
+static void
+_mipmap_unref_cleanup (pixman_image_t *pixman_image,
+		       void *closure)
+{
+    _mipmap_destroy (closure);
+}
+
+/* Returns a new image sharing the pixels of @image, so that its
+ * transform and filter can be set without disturbing other users.
+ * The caller must keep @image alive for as long as it is used. */
+static pixman_image_t *
+_pixman_image_share_bits (pixman_image_t *image)
+{
+    return pixman_image_create_bits (pixman_image_get_format (image),
+				     pixman_image_get_width (image),
+				     pixman_image_get_height (image),
+				     pixman_image_get_data (image),
+				     pixman_image_get_stride (image));
+}
+
+static pixman_image_t *
+_pixman_image_downsample (pixman_image_t *image)
+{
+    pixman_image_t *src, *dst;
+    pixman_transform_t transform;
+    int width, height;
+
+    width  = (pixman_image_get_width (image) + 1) / 2;
+    height = (pixman_image_get_height (image) + 1) / 2;
+    dst = pixman_image_create_bits (pixman_image_get_format (image),
+				    width, height, NULL, 0);
+    if (unlikely (dst == NULL))
+	return NULL;
+
+    src = _pixman_image_share_bits (image);
+    if (unlikely (src == NULL)) {
+	pixman_image_unref (dst);
+	return NULL;
+    }
+
+    /* Sampling halfway between each pair of pixels, the bilinear filter
+     * averages each 2x2 block; an odd last row or column is padded.
+     */
+    pixman_transform_init_scale (&transform,
+				 pixman_int_to_fixed (2),
+				 pixman_int_to_fixed (2));
+    pixman_image_set_transform (src, &transform);
+    pixman_image_set_filter (src, PIXMAN_FILTER_BILINEAR, NULL, 0);
+    pixman_image_set_repeat (src, PIXMAN_REPEAT_PAD);
+
+    pixman_image_composite32 (PIXMAN_OP_SRC, src, NULL, dst,
+			      0, 0,
+			      0, 0,
+			      0, 0,
+			      width, height);
+    pixman_image_unref (src);
+
+    return dst;
+}
+
+static pixman_image_t *
+_pixman_image_for_mipmap_level (cairo_image_surface_t *source, int level)
+{
+    struct mipmap *mipmap;
+    pixman_image_t *pixman_image = NULL;
+    cairo_status_t status;
+
+    /* The source may be shared by several threads rasterizing at once */
+    CAIRO_MUTEX_LOCK (_cairo_image_mipmap_mutex);
+
+    mipmap = cairo_surface_get_user_data (&source->base, &mipmap_key);
+    if (mipmap == NULL || mipmap->serial != source->base.serial) {
+	mipmap = _cairo_malloc (sizeof (struct mipmap));
+	if (unlikely (mipmap == NULL))
+	    goto UNLOCK;
+
+	_cairo_surface_init (&mipmap->base, &mipmap_backend, NULL,
+			     source->base.content, FALSE);
+	mipmap->serial = source->base.serial;
+	mipmap->num_levels = 0;
+
+	/* replacing the user data releases any out of date levels */
+	status = cairo_surface_set_user_data (&source->base, &mipmap_key,
+					      mipmap, _mipmap_destroy);
+	if (unlikely (status)) {
+	    cairo_surface_destroy (&mipmap->base);
+	    goto UNLOCK;
+	}
+    }
+
+    while (mipmap->num_levels < level) {
+	pixman_image_t *image;
+
+	if (mipmap->num_levels == 0)
+	    image = source->pixman_image;
+	else
+	    image = mipmap->levels[mipmap->num_levels - 1];
+
+	image = _pixman_image_downsample (image);
+	if (unlikely (image == NULL))
+	    goto UNLOCK;
+
+	mipmap->levels[mipmap->num_levels++] = image;
+    }
+
+    pixman_image = _pixman_image_share_bits (mipmap->levels[level - 1]);
+    if (likely (pixman_image != NULL)) {
+	pixman_image_set_destroy_function (pixman_image,
+					   _mipmap_unref_cleanup,
+					   cairo_surface_reference (&mipmap->base));
+    }
+
+UNLOCK:
+    CAIRO_MUTEX_UNLOCK (_cairo_image_mipmap_mutex);
+    return pixman_image;
+}
+
+static pixman_image_t *
+_pixman_image_for_mipmap (cairo_image_surface_t *source,
+			  const cairo_surface_pattern_t *pattern,
+			  cairo_extend_t extend,
+			  const cairo_rectangle_int_t *extents,
+			  int *ix, int *iy)
+{
+    cairo_pattern_union_t tmp_pattern;
+    pixman_image_t *pixman_image;
+    cairo_matrix_t scale;
+    double dx, dy, s;
+    int level;
+
+    switch (source->format) {
+    case CAIRO_FORMAT_ARGB32:
+    case CAIRO_FORMAT_RGB24:
+    case CAIRO_FORMAT_A8:
+	break;
+    default:
+	return NULL;
+    }
+
+    /* Use the smallest level that still has a pixel for every pixel
+     * drawn, leaving the last (less than 2x) reduction to the filter.
+     */
+    dx = hypot (pattern->base.matrix.xx, pattern->base.matrix.xy);
+    dy = hypot (pattern->base.matrix.yx, pattern->base.matrix.yy);
+    s = MIN (dx, dy);
+    level = 0;
+    while (level < MIPMAP_MAX_LEVELS &&
+	   s >= (2 << level) &&
+	   (source->width >> level) > 1 &&
+	   (source->height >> level) > 1)
+    {
+	level++;
+    }
+    if (level == 0)
+	return NULL;
+
+    if (getenv ("CAIRO_IMAGE_MIPMAP") == NULL)
+	return NULL;
+
+    pixman_image = _pixman_image_for_mipmap_level (source, level);
+    if (unlikely (pixman_image == NULL))
+	return NULL;
+
+    _cairo_pattern_init_static_copy (&tmp_pattern.base, &pattern->base);
+    cairo_matrix_init_scale (&scale, 1. / (1 << level), 1. / (1 << level));
+    cairo_matrix_multiply (&tmp_pattern.base.matrix,
+			   &pattern->base.matrix, &scale);
+    tmp_pattern.base.extend = extend;
+    if (! _pixman_image_set_properties (pixman_image,
+					&tmp_pattern.base, extents,
+					ix, iy)) {
+	pixman_image_unref (pixman_image);
+	pixman_image = NULL;
+    }
+
+    return pixman_image;
+}
+
 static pixman_image_t *
 _pixman_image_for_surface (cairo_image_surface_t *dst,
 			   const cairo_surface_pattern_t *pattern,
@@ -1337,6 +1645,19 @@ _pixman_image_for_surface (cairo_image_surface_t *dst,
 	    }
 #endif
 
+	    if (pattern->base.filter == CAIRO_FILTER_GOOD &&
+		(extend == CAIRO_EXTEND_NONE || extend == CAIRO_EXTEND_PAD) &&
+		source != dst)
+	    {
+		pixman_image = _pixman_image_for_mipmap (source, pattern,
+							 extend, extents,
+							 ix, iy);
+		if (pixman_image) {
+		    cairo_surface_destroy (defer_free);
+		    return pixman_image;
+		}
+	    }
+
 	    pixman_image = pixman_image_create_bits (source->pixman_format,
 						     source->width,
 						     source->height,
@@ -1594,6 +1915,28 @@ _pixman_image_for_pattern (cairo_image_surface_t *dst,
     }
 }
 
+/* Whether sampling the pattern goes through one of the separable
+ * convolution filters, which makes compositing it expensive enough to
+ * be worth splitting across threads.
+ */
+static cairo_bool_t
+_pattern_is_convolved (const cairo_pattern_t *pattern)
+{
+    if (pattern == NULL)
+	return FALSE;
+
+    if (pattern->type != CAIRO_PATTERN_TYPE_SURFACE &&
+	pattern->type != CAIRO_PATTERN_TYPE_RASTER_SOURCE)
+	return FALSE;
+
+    if (pattern->filter != CAIRO_FILTER_GOOD &&
+	pattern->filter != CAIRO_FILTER_BEST)
+	return FALSE;
+
+    return ! _cairo_matrix_is_integer_translation (&pattern->matrix,
+						   NULL, NULL);
+}
+
 static cairo_status_t
 _cairo_image_source_finish (void *abstract_surface)
 {
@@ -1643,6 +1986,7 @@ _cairo_image_source_create_for_pattern (cairo_surface_t *dst,
 
     source->is_opaque_solid =
 	pattern == NULL || _cairo_pattern_is_opaque_solid (pattern);
+    source->is_convolved = _pattern_is_convolved (pattern);
 
     return &source->base;
 }
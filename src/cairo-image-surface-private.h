@@ -78,6 +78,12 @@ struct _cairo_image_surface {
     unsigned owns_data : 1;
     unsigned transparency : 2;
     unsigned color : 2;
+
+    /* Copies of this image that still share some of its tiles, and
+     * for such a copy, the tiles it has yet to take from the original.
+     */
+    cairo_list_t cow_copies;
+    struct _cairo_image_cow *cow;
 };
 #define to_image_surface(S) ((cairo_image_surface_t *)(S))
 
@@ -87,6 +93,7 @@ typedef struct _cairo_image_source {
 
     pixman_image_t *pixman_image;
     unsigned is_opaque_solid : 1;
+    unsigned is_convolved : 1;
 } cairo_image_source_t;
 
 cairo_private extern const cairo_surface_backend_t _cairo_image_surface_backend;
@@ -183,6 +190,24 @@ _cairo_image_surface_release_source_image (void                   *abstract_surf
 cairo_private cairo_surface_t *
 _cairo_image_surface_snapshot (void *abstract_surface);
 
+cairo_private cairo_surface_t *
+_cairo_image_surface_copy_on_write (cairo_image_surface_t *image);
+
+cairo_private void
+_cairo_image_surface_unshare (cairo_image_surface_t *copy);
+
+cairo_private void
+_cairo_image_surface_unshare_extents (cairo_image_surface_t *surface,
+				      const cairo_rectangle_int_t *extents);
+
+cairo_private cairo_int_status_t
+_cairo_image_composite_color_glyphs (cairo_image_surface_t	*dst,
+				     cairo_operator_t		 op,
+				     cairo_scaled_font_t	*scaled_font,
+				     cairo_glyph_t		*glyphs,
+				     int			*num_glyphs,
+				     const cairo_clip_t		*clip);
+
 cairo_private_no_warn cairo_bool_t
 _cairo_image_surface_get_extents (void			  *abstract_surface,
 				  cairo_rectangle_int_t   *rectangle);
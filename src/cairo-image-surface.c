@@ -46,6 +46,7 @@
 #include "cairo-default-context-private.h"
 #include "cairo-error-private.h"
 #include "cairo-image-surface-inline.h"
+#include "cairo-list-inline.h"
 #include "cairo-paginated-private.h"
 #include "cairo-pattern-private.h"
 #include "cairo-pixman-private.h"
@@ -178,6 +179,9 @@ _cairo_image_surface_init (cairo_image_surface_t *surface,
     surface->base.is_clear = surface->width == 0 || surface->height == 0;
 
     surface->compositor = _cairo_image_spans_compositor_get ();
+
+    cairo_list_init (&surface->cow_copies);
+    surface->cow = NULL;
 }
 
 cairo_surface_t *
@@ -820,6 +824,249 @@ _cairo_image_surface_snapshot (void *abstract_surface)
     return &clone->base;
 }
 
+/* Copy-on-write in tiles.
+ *
+ * When a large image that has been snapshotted is about to be
+ * modified, the snapshot is given a copy whose tiles are only taken
+ * from the original just before the original overwrites them, or all
+ * at once when the copy is first read. A canvas that is snapshotted
+ * every frame and then partially redrawn thus only duplicates the
+ * tiles that are redrawn, as long as the old snapshot is not used
+ * again. The copy is created and completed under
+ * _cairo_image_cow_mutex, as the snapshot may be read on another
+ * thread than the one drawing to the original.
+ */
+#define COW_TILE_SIZE 64
+#define COW_MIN_TILES 16
+
+typedef struct _cairo_image_cow {
+    cairo_list_t link;
+
+    cairo_image_surface_t *original;
+    cairo_image_surface_t *copy;
+
+    int tiles_x, tiles_y;
+    int remaining;
+    uint8_t *shared;
+} cairo_image_cow_t;
+
+static void
+_cairo_image_cow_copy_tiles (cairo_image_cow_t *cow,
+			     const cairo_rectangle_int_t *extents)
+{
+    cairo_image_surface_t *original = cow->original;
+    cairo_image_surface_t *copy = cow->copy;
+    int cpp = PIXMAN_FORMAT_BPP (original->pixman_format) / 8;
+    int x1, y1, x2, y2, tx, ty;
+
+    x1 = MAX (extents->x, 0) / COW_TILE_SIZE;
+    y1 = MAX (extents->y, 0) / COW_TILE_SIZE;
+    x2 = MIN (extents->x + extents->width, original->width);
+    y2 = MIN (extents->y + extents->height, original->height);
+    x2 = (x2 + COW_TILE_SIZE - 1) / COW_TILE_SIZE;
+    y2 = (y2 + COW_TILE_SIZE - 1) / COW_TILE_SIZE;
+
+    for (ty = y1; ty < y2; ty++) {
+	uint8_t *shared = cow->shared + ty * cow->tiles_x;
+
+	for (tx = x1; tx < x2; tx++) {
+	    const uint8_t *src;
+	    uint8_t *dst;
+	    int x, y, width, height;
+
+	    if (! shared[tx])
+		continue;
+
+	    x = tx * COW_TILE_SIZE;
+	    y = ty * COW_TILE_SIZE;
+	    width = MIN (COW_TILE_SIZE, original->width - x) * cpp;
+	    height = MIN (COW_TILE_SIZE, original->height - y);
+
+	    src = original->data + y * original->stride + x * cpp;
+	    dst = copy->data + y * copy->stride + x * cpp;
+	    while (height--) {
+		memcpy (dst, src, width);
+		src += original->stride;
+		dst += copy->stride;
+	    }
+
+	    shared[tx] = 0;
+	    cow->remaining--;
+	}
+    }
+}
+
+static void
+_cairo_image_cow_destroy (cairo_image_cow_t *cow)
+{
+    cairo_list_del (&cow->link);
+    cow->copy->cow = NULL;
+    free (cow);
+}
+
+static void
+_cairo_image_cow_complete (cairo_image_cow_t *cow)
+{
+    cairo_rectangle_int_t extents;
+
+    _cairo_image_surface_get_extents (cow->original, &extents);
+    _cairo_image_cow_copy_tiles (cow, &extents);
+    _cairo_image_cow_destroy (cow);
+}
+
+/**
+ * _cairo_image_surface_copy_on_write:
+ * @image: an image surface about to be modified
+ *
+ * Creates a copy of @image for a snapshot, whose tiles are copied
+ * from @image just before it modifies them. The copy must be completed
+ * with _cairo_image_surface_unshare() before its contents are read.
+ *
+ * Return value: the copy, or %NULL if @image is better copied in full.
+ **/
+cairo_surface_t *
+_cairo_image_surface_copy_on_write (cairo_image_surface_t *image)
+{
+    cairo_image_surface_t *copy;
+    cairo_image_cow_t *cow;
+    int tiles_x, tiles_y;
+
+    /* Memory of a dying image is simply stolen by the snapshot */
+    if (image->base.backend != &_cairo_image_surface_backend ||
+	image->base._finishing ||
+	PIXMAN_FORMAT_BPP (image->pixman_format) < 8)
+    {
+	return NULL;
+    }
+
+    tiles_x = (image->width  + COW_TILE_SIZE - 1) / COW_TILE_SIZE;
+    tiles_y = (image->height + COW_TILE_SIZE - 1) / COW_TILE_SIZE;
+    if (tiles_x * tiles_y < COW_MIN_TILES)
+	return NULL;
+
+    cow = _cairo_malloc (sizeof (cairo_image_cow_t) + tiles_x * tiles_y);
+    if (unlikely (cow == NULL))
+	return NULL;
+
+    copy = (cairo_image_surface_t *)
+	_cairo_image_surface_create_with_pixman_format (NULL,
+							image->pixman_format,
+							image->width,
+							image->height,
+							0);
+    if (unlikely (copy->base.status)) {
+	free (cow);
+	return &copy->base;
+    }
+    copy->base.is_clear = FALSE;
+
+    cow->original = image;
+    cow->copy = copy;
+    cow->tiles_x = tiles_x;
+    cow->tiles_y = tiles_y;
+    cow->remaining = tiles_x * tiles_y;
+    cow->shared = (uint8_t *) (cow + 1);
+    memset (cow->shared, 1, cow->remaining);
+
+    CAIRO_MUTEX_LOCK (_cairo_image_cow_mutex);
+    cairo_list_add (&cow->link, &image->cow_copies);
+    copy->cow = cow;
+    CAIRO_MUTEX_UNLOCK (_cairo_image_cow_mutex);
+
+    return &copy->base;
+}
+
+/**
+ * _cairo_image_surface_unshare:
+ * @copy: an image returned by _cairo_image_surface_copy_on_write()
+ *
+ * Takes the tiles that @copy still shares with its original, after
+ * which it is a plain image surface.
+ **/
+void
+_cairo_image_surface_unshare (cairo_image_surface_t *copy)
+{
+    CAIRO_MUTEX_LOCK (_cairo_image_cow_mutex);
+    if (copy->cow != NULL)
+	_cairo_image_cow_complete (copy->cow);
+    CAIRO_MUTEX_UNLOCK (_cairo_image_cow_mutex);
+}
+
+static inline cairo_bool_t
+_cairo_image_surface_is_shared (cairo_image_surface_t *surface)
+{
+    /* Only the thread drawing to the surface adds copies to it */
+    return ! cairo_list_is_empty (&surface->cow_copies);
+}
+
+static void
+_cairo_image_surface_unshare_copies (cairo_image_surface_t *surface)
+{
+    if (! _cairo_image_surface_is_shared (surface))
+	return;
+
+    CAIRO_MUTEX_LOCK (_cairo_image_cow_mutex);
+    while (! cairo_list_is_empty (&surface->cow_copies)) {
+	_cairo_image_cow_complete (cairo_list_first_entry (&surface->cow_copies,
+							   cairo_image_cow_t,
+							   link));
+    }
+    CAIRO_MUTEX_UNLOCK (_cairo_image_cow_mutex);
+}
+
+/* Hands the tiles of @extents over to the copies before they are
+ * overwritten. */
+void
+_cairo_image_surface_unshare_extents (cairo_image_surface_t *surface,
+				      const cairo_rectangle_int_t *extents)
+{
+    cairo_image_cow_t *cow, *next;
+
+    if (! _cairo_image_surface_is_shared (surface))
+	return;
+
+    CAIRO_MUTEX_LOCK (_cairo_image_cow_mutex);
+    cairo_list_foreach_entry_safe (cow, next, cairo_image_cow_t,
+				   &surface->cow_copies, link)
+    {
+	_cairo_image_cow_copy_tiles (cow, extents);
+	if (cow->remaining == 0)
+	    _cairo_image_cow_destroy (cow);
+    }
+    CAIRO_MUTEX_UNLOCK (_cairo_image_cow_mutex);
+}
+
+static void
+_cairo_image_surface_unshare_composite (cairo_image_surface_t *surface,
+					cairo_int_status_t status,
+					cairo_composite_rectangles_t *composite)
+{
+    if (status == CAIRO_INT_STATUS_NOTHING_TO_DO)
+	return;
+
+    if (unlikely (status)) {
+	_cairo_image_surface_unshare_copies (surface);
+	return;
+    }
+
+    _cairo_image_surface_unshare_extents (surface,
+					  composite->is_bounded ?
+					  &composite->bounded :
+					  &composite->unbounded);
+    _cairo_composite_rectangles_fini (composite);
+}
+
+static cairo_status_t
+_cairo_image_surface_flush (void *abstract_surface,
+			    unsigned flags)
+{
+    /* The pixels may be written behind our back from now on */
+    if (flags == 0)
+	_cairo_image_surface_unshare_copies (abstract_surface);
+
+    return CAIRO_STATUS_SUCCESS;
+}
+
 cairo_image_surface_t *
 _cairo_image_surface_map_to_image (void *abstract_other,
 				   const cairo_rectangle_int_t *extents)
@@ -828,6 +1075,8 @@ _cairo_image_surface_map_to_image (void *abstract_other,
     cairo_surface_t *surface;
     uint8_t *data;
 
+    _cairo_image_surface_unshare_extents (other, extents);
+
     data = other->data;
     data += extents->y * other->stride;
     data += extents->x * PIXMAN_FORMAT_BPP (other->pixman_format)/ 8;
@@ -858,6 +1107,14 @@ _cairo_image_surface_finish (void *abstract_surface)
 {
     cairo_image_surface_t *surface = abstract_surface;
 
+    _cairo_image_surface_unshare_copies (surface);
+    if (surface->cow != NULL) {
+	CAIRO_MUTEX_LOCK (_cairo_image_cow_mutex);
+	if (surface->cow != NULL)
+	    _cairo_image_cow_destroy (surface->cow);
+	CAIRO_MUTEX_UNLOCK (_cairo_image_cow_mutex);
+    }
+
     if (surface->pixman_image) {
 	pixman_image_unref (surface->pixman_image);
 	surface->pixman_image = NULL;
@@ -942,6 +1199,16 @@ _cairo_image_surface_paint (void			*abstract_surface,
     TRACE ((stderr, "%s (surface=%d)\n",
 	    __FUNCTION__, surface->base.unique_id));
 
+    if (_cairo_image_surface_is_shared (surface)) {
+	cairo_composite_rectangles_t composite;
+
+	_cairo_image_surface_unshare_composite (surface,
+	    _cairo_composite_rectangles_init_for_paint (&composite,
+							&surface->base,
+							op, source, clip),
+	    &composite);
+    }
+
     return _cairo_compositor_paint (surface->compositor,
 				    &surface->base, op, source, clip);
 }
@@ -958,6 +1225,16 @@ _cairo_image_surface_mask (void				*abstract_surface,
     TRACE ((stderr, "%s (surface=%d)\n",
 	    __FUNCTION__, surface->base.unique_id));
 
+    if (_cairo_image_surface_is_shared (surface)) {
+	cairo_composite_rectangles_t composite;
+
+	_cairo_image_surface_unshare_composite (surface,
+	    _cairo_composite_rectangles_init_for_mask (&composite,
+						       &surface->base,
+						       op, source, mask, clip),
+	    &composite);
+    }
+
     return _cairo_compositor_mask (surface->compositor,
 				   &surface->base, op, source, mask, clip);
 }
@@ -979,6 +1256,18 @@ _cairo_image_surface_stroke (void			*abstract_surface,
     TRACE ((stderr, "%s (surface=%d)\n",
 	    __FUNCTION__, surface->base.unique_id));
 
+    if (_cairo_image_surface_is_shared (surface)) {
+	cairo_composite_rectangles_t composite;
+
+	_cairo_image_surface_unshare_composite (surface,
+	    _cairo_composite_rectangles_init_for_stroke (&composite,
+							 &surface->base,
+							 op, source,
+							 path, style, ctm,
+							 clip),
+	    &composite);
+    }
+
     return _cairo_compositor_stroke (surface->compositor, &surface->base,
 				     op, source, path,
 				     style, ctm, ctm_inverse,
@@ -1000,6 +1289,17 @@ _cairo_image_surface_fill (void				*abstract_surface,
     TRACE ((stderr, "%s (surface=%d)\n",
 	    __FUNCTION__, surface->base.unique_id));
 
+    if (_cairo_image_surface_is_shared (surface)) {
+	cairo_composite_rectangles_t composite;
+
+	_cairo_image_surface_unshare_composite (surface,
+	    _cairo_composite_rectangles_init_for_fill (&composite,
+						       &surface->base,
+						       op, source, path,
+						       clip),
+	    &composite);
+    }
+
     return _cairo_compositor_fill (surface->compositor, &surface->base,
 				   op, source, path,
 				   fill_rule, tolerance, antialias,
@@ -1020,6 +1320,20 @@ _cairo_image_surface_glyphs (void			*abstract_surface,
     TRACE ((stderr, "%s (surface=%d)\n",
 	    __FUNCTION__, surface->base.unique_id));
 
+    if (_cairo_image_surface_is_shared (surface)) {
+	cairo_composite_rectangles_t composite;
+	cairo_bool_t overlap;
+
+	_cairo_image_surface_unshare_composite (surface,
+	    _cairo_composite_rectangles_init_for_glyphs (&composite,
+							 &surface->base,
+							 op, source,
+							 scaled_font,
+							 glyphs, num_glyphs,
+							 clip, &overlap),
+	    &composite);
+    }
+
     return _cairo_compositor_glyphs (surface->compositor, &surface->base,
 				     op, source,
 				     glyphs, num_glyphs, scaled_font,
@@ -1058,7 +1372,7 @@ const cairo_surface_backend_t _cairo_image_surface_backend = {
     _cairo_image_surface_get_extents,
     _cairo_image_surface_get_font_options,
 
-    NULL, /* flush */
+    _cairo_image_surface_flush,
     NULL,
 
     _cairo_image_surface_paint,
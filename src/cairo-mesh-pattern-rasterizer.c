@@ -39,122 +39,58 @@
 #include "cairo-array-private.h"
 #include "cairo-pattern-private.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 /*
  * Rasterizer for mesh patterns.
  *
- * This implementation is based on techniques derived from several
- * papers (available from ACM):
- *
- * - Lien, Shantz and Pratt "Adaptive Forward Differencing for
- *   Rendering Curves and Surfaces" (discussion of the AFD technique,
- *   bound of 1/sqrt(2) on step length without proof)
- *
- * - Popescu and Rosen, "Forward rasterization" (description of
- *   forward rasterization, proof of the previous bound)
- *
- * - Klassen, "Integer Forward Differencing of Cubic Polynomials:
- *   Analysis and Algorithms"
- *
- * - Klassen, "Exact Integer Hybrid Subdivision and Forward
- *   Differencing of Cubics" (improving the bound on the minimum
- *   number of steps)
- *
- * - Chang, Shantz and Rocchetti, "Rendering Cubic Curves and Surfaces
- *   with Integer Adaptive Forward Differencing" (analysis of forward
- *   differencing applied to Bezier patches)
+ * Every patch is evaluated on a grid that is fine enough for the
+ * pieces of the patch between adjacent grid points to be flat, both
+ * in shape and in color, to within a fraction of a pixel and of a
+ * color step. Each cell of the grid is then drawn as two
+ * Gouraud-shaded triangles, one span of pixels at a time.
  *
  * Notes:
- * - Poor performance expected in degenerate cases
- *
- * - Patches mostly outside the drawing area are drawn completely (and
- *   clipped), wasting time
- *
- * - Both previous problems are greatly reduced by splitting until a
- *   reasonably small size and clipping the new tiles: execution time
- *   is quadratic in the convex-hull diameter instead than linear to
- *   the painted area. Splitting the tiles doesn't change the painted
- *   area but (usually) reduces the bounding box area (bbox area can
- *   remain the same after splitting, but cannot grow)
- *
- * - The initial implementation used adaptive forward differencing,
- *   but simple forward differencing scored better in benchmarks
- *
- * Idea:
- *
- * We do a sampling over the cubic patch with step du and dv (in the
- * two parameters) that guarantees that any point of our sampling will
- * be at most at 1/sqrt(2) from its adjacent points. In formulae
- * (assuming B is the patch):
- *
- *   |B(u,v) - B(u+du,v)| < 1/sqrt(2)
- *   |B(u,v) - B(u,v+dv)| < 1/sqrt(2)
- *
- * This means that every pixel covered by the patch will contain at
- * least one of the samples, thus forward rasterization can be
- * performed. Sketch of proof (from Popescu and Rosen):
- *
- * Let's take the P pixel we're interested into. If we assume it to be
- * square, its boundaries define 9 regions on the plane:
- *
- * 1|2|3
- * -+-+-
- * 8|P|4
- * -+-+-
- * 7|6|5
  *
- * Let's check that the pixel P will contain at least one point
- * assuming that it is covered by the patch.
+ * - A pixel is painted if it touches the (closed) patch, so a patch
+ *   always covers the pixels its edges and corners fall into, like
+ *   the forward differencing rasterizer that used to be here did.
+ *   Pixels on the border of a triangle take the color of the nearest
+ *   point inside it (along their span).
  *
- * Since the pixel is covered by the patch, its center will belong to
- * (at least) one of the quads:
+ * - The cells are drawn in order of increasing v and then of
+ *   increasing u, so when a patch folds over itself the part with the
+ *   highest v parameter ends up above and, for the same v, the one
+ *   with the highest u parameter does.
  *
- *   {(B(u,v), B(u+du,v), B(u,v+dv), B(u+du,v+dv)) for u,v in [0,1]}
- *
- * If P doesn't contain any of the corners of the quad:
- *
- * - if one of the corners is in 1,3,5 or 7, other two of them have to
- *   be in 2,4,6 or 8, thus if the last corner is not in P, the length
- *   of one of the edges will be > 1/sqrt(2)
- *
- * - if none of the corners is in 1,3,5 or 7, all of them are in 2,4,6
- *   and/or 8. If they are all in different regions, they can't
- *   satisfy the distance constraint. If two of them are in the same
- *   region (let's say 2), no point is in 6 and again it is impossible
- *   to have the center of P in the quad respecting the distance
- *   constraint (both these assertions can be checked by continuity
- *   considering the length of the edges of a quad with the vertices
- *   on the edges of P)
- *
- * Each of the cases led to a contradiction, so P contains at least
- * one of the corners of the quad.
- */
-
-/*
- * Make sure that errors are less than 1 in fixed point math if you
- * change these values.
- *
- * The error is amplified by about steps^3/4 times.
- * The rasterizer always uses a number of steps that is a power of 2.
- *
- * 256 is the maximum allowed number of steps (to have error < 1)
- * using 8.24 for the differences.
+ * - Patches that are only partially visible are split (in the v
+ *   direction, to preserve the stacking order) to clip away the parts
+ *   outside the image before building their grid.
  */
-#define STEPS_MAX_V 256.0
-#define STEPS_MAX_U 256.0
 
 /*
- * If the patch/curve is only partially visible, split it to a finer
+ * If the patch is only partially visible, split it to a finer
  * resolution to get higher chances to clip (part of) it.
  *
  * These values have not been computed, but simply obtained
- * empirically (by benchmarking some patches). They should never be
- * greater than STEPS_MAX_V (or STEPS_MAX_U), but they can be as small
- * as 1 (depending on how much you want to spend time in splitting the
- * patch/curve when trying to save some rasterization time).
+ * empirically (by benchmarking some patches). They can be as small as
+ * 1 (depending on how much you want to spend time in splitting the
+ * patch when trying to save some rasterization time).
  */
 #define STEPS_CLIP_V 64.0
-#define STEPS_CLIP_U 64.0
 
+/*
+ * Maximum distance, in pixels, between the patch and the flat cells
+ * that approximate it, and maximum error in the interpolated colors
+ * (in units of the 0..1 range of a color component).
+ */
+#define GRID_TOLERANCE 0.25
+#define GRID_COLOR_TOLERANCE (1. / 512)
+
+/* Upper bound on the number of cells along each direction */
+#define GRID_MAX 1024
 
 /* Utils */
 static inline double
@@ -168,174 +104,22 @@ sqlen (cairo_point_double_t p0, cairo_point_double_t p1)
     return delta.x * delta.x + delta.y * delta.y;
 }
 
-static inline int16_t
-_color_delta_to_shifted_short (int32_t from, int32_t to, int shift)
-{
-    int32_t delta = to - from;
-
-    /* We need to round toward zero, because otherwise adding the
-     * delta 2^shift times can overflow */
-    if (delta >= 0)
-	return delta >> shift;
-    else
-	return -((-delta) >> shift);
-}
-
-/*
- * Convert a number of steps to the equivalent shift.
- *
- * Input: the square of the minimum number of steps
- *
- * Output: the smallest integer x such that 2^x > steps
- */
-static inline int
-sqsteps2shift (double steps_sq)
-{
-    int r;
-    frexp (MAX (1.0, steps_sq), &r);
-    return (r + 1) >> 1;
-}
-
-/*
- * FD functions
- *
- * A Bezier curve is defined (with respect to a parameter t in
- * [0,1]) from its nodes (x,y,z,w) like this:
- *
- *   B(t) = x(1-t)^3 + 3yt(1-t)^2 + 3zt^2(1-t) + wt^3
- *
- * To efficiently evaluate a Bezier curve, the rasterizer uses forward
- * differences. Given x, y, z, w (the 4 nodes of the Bezier curve), it
- * is possible to convert them to forward differences form and walk
- * over the curve using fd_init (), fd_down () and fd_fwd ().
- *
- * f[0] is always the value of the Bezier curve for "current" t.
- */
-
-/*
- * Initialize the coefficient for forward differences.
- *
- * Input: x,y,z,w are the 4 nodes of the Bezier curve
- *
- * Output: f[i] is the i-th difference of the curve
- *
- * f[0] is the value of the curve for t==0, i.e. f[0]==x.
- *
- * The initial step is 1; this means that each step increases t by 1
- * (so fd_init () immediately followed by fd_fwd (f) n times makes
- * f[0] be the value of the curve for t==n).
- */
-static inline void
-fd_init (double x, double y, double z, double w, double f[4])
-{
-    f[0] = x;
-    f[1] = w - x;
-    f[2] = 6. * (w - 2. * z + y);
-    f[3] = 6. * (w - 3. * z + 3. * y - x);
-}
-
 /*
- * Halve the step of the coefficients for forward differences.
- *
- * Input: f[i] is the i-th difference of the curve
- *
- * Output: f[i] is the i-th difference of the curve with half the
- *         original step
- *
- * f[0] is not affected, so the current t is not changed.
- *
- * The other coefficients are changed so that the step is half the
- * original step. This means that doing fd_fwd (f) n times with the
- * input f results in the same f[0] as doing fd_fwd (f) 2n times with
- * the output f.
- */
-static inline void
-fd_down (double f[4])
-{
-    f[3] *= 0.125;
-    f[2] = f[2] * 0.25 - f[3];
-    f[1] = (f[1] - f[2]) * 0.5;
-}
-
-/*
- * Perform one step of forward differences along the curve.
- *
- * Input: f[i] is the i-th difference of the curve
- *
- * Output: f[i] is the i-th difference of the curve after one step
- */
-static inline void
-fd_fwd (double f[4])
-{
-    f[0] += f[1];
-    f[1] += f[2];
-    f[2] += f[3];
-}
-
-/*
- * Transform to integer forward differences.
- *
- * Input: d[n] is the n-th difference (in double precision)
- *
- * Output: i[n] is the n-th difference (in fixed point precision)
- *
- * i[0] is 9.23 fixed point, other differences are 4.28 fixed point.
- */
-static inline void
-fd_fixed (double d[4], int32_t i[4])
-{
-    i[0] = _cairo_fixed_16_16_from_double (256 *  2 * d[0]);
-    i[1] = _cairo_fixed_16_16_from_double (256 * 16 * d[1]);
-    i[2] = _cairo_fixed_16_16_from_double (256 * 16 * d[2]);
-    i[3] = _cairo_fixed_16_16_from_double (256 * 16 * d[3]);
-}
-
-/*
- * Perform one step of integer forward differences along the curve.
- *
- * Input: f[n] is the n-th difference
- *
- * Output: f[n] is the n-th difference
- *
- * f[0] is 9.23 fixed point, other differences are 4.28 fixed point.
- */
-static inline void
-fd_fixed_fwd (int32_t f[4])
-{
-    f[0] += (f[1] >> 5) + ((f[1] >> 4) & 1);
-    f[1] += f[2];
-    f[2] += f[3];
-}
-
-/*
- * Compute the minimum number of steps that guarantee that walking
- * over a curve will leave no holes.
+ * Compute an upper bound on the square of the length of a Bezier
+ * curve's derivative, scaled to give the square of the number of
+ * steps needed to walk along the curve moving by less than 1/sqrt(2)
+ * at each step.
  *
  * Input: p[0..3] the nodes of the Bezier curve
  *
  * Returns: the square of the number of steps
  *
- * Idea:
- *
- * We want to make sure that at every step we move by less than
- * 1/sqrt(2).
- *
  * The derivative of the cubic Bezier with nodes (p0, p1, p2, p3) is
  * the quadratic Bezier with nodes (p1-p0, p2-p1, p3-p2) scaled by 3,
- * so (since a Bezier curve is always bounded by its convex hull), we
- * can say that:
- *
- *  max(|B'(t)|) <= 3 max (|p1-p0|, |p2-p1|, |p3-p2|)
- *
- * We can improve this by noticing that a quadratic Bezier (a,b,c) is
- * bounded by the quad (a,lerp(a,b,t),lerp(b,c,t),c) for any t, so
- * (substituting the previous values, using t=0.5 and simplifying):
+ * and a quadratic Bezier (a,b,c) is bounded by the quad
+ * (a,lerp(a,b,t),lerp(b,c,t),c) for any t, so (using t=0.5):
  *
  *  max(|B'(t)|) <= 3 max (|p1-p0|, |p2-p0|/2, |p3-p1|/2, |p3-p2|)
- *
- * So, to guarantee a maximum step length of 1/sqrt(2) we must do:
- *
- *   3 max (|p1-p0|, |p2-p0|/2, |p3-p1|/2, |p3-p2|) sqrt(2) steps
  */
 static inline double
 bezier_steps_sq (cairo_point_double_t p[4])
@@ -436,229 +220,328 @@ intersect_interval (double a, double b, double c, double d)
 }
 
 /*
- * Set the color of a pixel.
+ * Premultiply and pack a color.
  *
- * Input: data is the base pointer of the image
- *        width, height are the dimensions of the image
- *        stride is the stride in bytes between adjacent rows
- *        x, y are the coordinates of the pixel to be colored
- *        r,g,b,a are the color components of the color to be set
+ * Input: r,g,b,a are the color components (not premultiplied)
  *
- * Output: the (x,y) pixel in data has the (r,g,b,a) color
+ * Returns: the color in CAIRO_FORMAT_ARGB32 (8 bpc, premultiplied)
+ */
+static inline uint32_t
+premultiply_pixel (uint32_t r, uint32_t g, uint32_t b, uint32_t a)
+{
+    uint32_t tr, tg, tb;
+
+    /* Premultiply and round */
+    tr = r * a + 0x8000;
+    tg = g * a + 0x8000;
+    tb = b * a + 0x8000;
+
+    tr += tr >> 16;
+    tg += tg >> 16;
+    tb += tb >> 16;
+
+    return ((a << 16) & 0xff000000) |
+	((tr >> 8) & 0xff0000) | ((tg >> 16) & 0xff00) | (tb >> 24);
+}
+
+/*
+ * Fill a span of pixels with linearly interpolated colors.
  *
- * The input color components are not premultiplied, but the data
- * stored in the image is assumed to be in CAIRO_FORMAT_ARGB32 (8 bpc,
- * premultiplied).
+ * Input: row points to the first pixel of the span
+ *        n is the number of pixels in the span
+ *        c[i] is the i-th color component of the first pixel
+ *        dc[i] is the increment of the i-th color component
  *
- * If the pixel to be set is outside the image, this function does
- * nothing.
+ * The color components are red, green, blue and alpha, in this order,
+ * as 16-bit values with 8 more fractional bits. They are not
+ * premultiplied, and every value along the span must fit the range of
+ * a color component.
  */
-static inline void
-draw_pixel (unsigned char *data, int width, int height, int stride,
-	    int x, int y, uint16_t r, uint16_t g, uint16_t b, uint16_t a)
+static void
+fill_span (uint32_t *row, int n, const int32_t c[4], const int32_t dc[4])
 {
-    if (likely (0 <= x && 0 <= y && x < width && y < height)) {
-	uint32_t tr, tg, tb, ta;
+    int32_t r = c[0], g = c[1], b = c[2], a = c[3];
+    int i = 0;
+
+#if defined(__SSE2__)
+    if (n >= 4) {
+	__m128i vr, vg, vb, va, dr, dg, db, da;
+	__m128i half = _mm_set1_epi32 (0x8000);
+
+	vr = _mm_set_epi32 (r + 3 * dc[0], r + 2 * dc[0], r + dc[0], r);
+	vg = _mm_set_epi32 (g + 3 * dc[1], g + 2 * dc[1], g + dc[1], g);
+	vb = _mm_set_epi32 (b + 3 * dc[2], b + 2 * dc[2], b + dc[2], b);
+	va = _mm_set_epi32 (a + 3 * dc[3], a + 2 * dc[3], a + dc[3], a);
+	dr = _mm_set1_epi32 (4 * dc[0]);
+	dg = _mm_set1_epi32 (4 * dc[1]);
+	db = _mm_set1_epi32 (4 * dc[2]);
+	da = _mm_set1_epi32 (4 * dc[3]);
+
+	for (; i + 4 <= n; i += 4) {
+	    __m128i sa = _mm_srli_epi32 (va, 8);
+	    __m128i tr, tg, tb, p;
+
+	    /* Each lane holds a 16-bit value, so the 32-bit products
+	     * are pieced together from the 16-bit multiplies */
+#define PREMULTIPLY(t, v) \
+	    t = _mm_srli_epi32 (v, 8); \
+	    t = _mm_or_si128 (_mm_mullo_epi16 (t, sa), \
+			      _mm_slli_epi32 (_mm_mulhi_epu16 (t, sa), 16)); \
+	    t = _mm_add_epi32 (t, half); \
+	    t = _mm_add_epi32 (t, _mm_srli_epi32 (t, 16))
+
+	    PREMULTIPLY (tr, vr);
+	    PREMULTIPLY (tg, vg);
+	    PREMULTIPLY (tb, vb);
+#undef PREMULTIPLY
+
+	    p = _mm_slli_epi32 (_mm_srli_epi32 (sa, 8), 24);
+	    p = _mm_or_si128 (p, _mm_slli_epi32 (_mm_srli_epi32 (tr, 24), 16));
+	    p = _mm_or_si128 (p, _mm_slli_epi32 (_mm_srli_epi32 (tg, 24), 8));
+	    p = _mm_or_si128 (p, _mm_srli_epi32 (tb, 24));
+	    _mm_storeu_si128 ((__m128i *) (row + i), p);
+
+	    vr = _mm_add_epi32 (vr, dr);
+	    vg = _mm_add_epi32 (vg, dg);
+	    vb = _mm_add_epi32 (vb, db);
+	    va = _mm_add_epi32 (va, da);
+	}
 
-	/* Premultiply and round */
-	ta = a;
-	tr = r * ta + 0x8000;
-	tg = g * ta + 0x8000;
-	tb = b * ta + 0x8000;
+	r += i * dc[0];
+	g += i * dc[1];
+	b += i * dc[2];
+	a += i * dc[3];
+    }
+#endif
+
+    for (; i < n; i++) {
+	row[i] = premultiply_pixel (r >> 8, g >> 8, b >> 8, a >> 8);
+	r += dc[0];
+	g += dc[1];
+	b += dc[2];
+	a += dc[3];
+    }
+}
 
-	tr += tr >> 16;
-	tg += tg >> 16;
-	tb += tb >> 16;
+typedef struct _mesh_vertex {
+    double x, y;
+    double c[4];
+} mesh_vertex_t;
 
-	*((uint32_t*) (data + y*(ptrdiff_t)stride + 4*x)) = ((ta << 16) & 0xff000000) |
-	    ((tr >> 8) & 0xff0000) | ((tg >> 16) & 0xff00) | (tb >> 24);
-    }
+static inline void
+span_add_point (double x, double *left, double *right)
+{
+    *left = MIN (*left, x);
+    *right = MAX (*right, x);
 }
 
 /*
- * Forward-rasterize a cubic curve using forward differences.
+ * Compute the horizontal extent of a triangle within a horizontal
+ * strip.
  *
- * Input: data is the base pointer of the image
- *        width, height are the dimensions of the image
- *        stride is the stride in bytes between adjacent rows
- *        ushift is log2(n) if n is the number of desired steps
- *        dxu[i], dyu[i] are the x,y forward differences of the curve
- *        r0,g0,b0,a0 are the color components of the start point
- *        r3,g3,b3,a3 are the color components of the end point
- *
- * Output: data will be changed to have the requested curve drawn in
- *         the specified colors
+ * Input: v[0..2] are the vertices of the triangle
+ *        top, bottom are the extrema of the strip
  *
- * The input color components are not premultiplied, but the data
- * stored in the image is assumed to be in CAIRO_FORMAT_ARGB32 (8 bpc,
- * premultiplied).
+ * Output: left, right are the extrema of the intersection of the
+ *         (closed) triangle and the strip, left > right if they do
+ *         not intersect
  *
- * The function draws n+1 pixels, that is from the point at step 0 to
- * the point at step n, both included. This is the discrete equivalent
- * to drawing the curve for values of the interpolation parameter in
- * [0,1] (including both extremes).
+ * As the triangle is convex, the extrema lie either on the borders of
+ * the strip or on one of the vertices.
  */
-static inline void
-rasterize_bezier_curve (unsigned char *data, int width, int height, int stride,
-			int ushift, double dxu[4], double dyu[4],
-			uint16_t r0, uint16_t g0, uint16_t b0, uint16_t a0,
-			uint16_t r3, uint16_t g3, uint16_t b3, uint16_t a3)
+static void
+triangle_span (const mesh_vertex_t *v[3], double top, double bottom,
+	       double *left, double *right)
 {
-    int32_t xu[4], yu[4];
-    int x0, y0, u, usteps = 1 << ushift;
-
-    uint16_t r = r0, g = g0, b = b0, a = a0;
-    int16_t dr = _color_delta_to_shifted_short (r0, r3, ushift);
-    int16_t dg = _color_delta_to_shifted_short (g0, g3, ushift);
-    int16_t db = _color_delta_to_shifted_short (b0, b3, ushift);
-    int16_t da = _color_delta_to_shifted_short (a0, a3, ushift);
-
-    fd_fixed (dxu, xu);
-    fd_fixed (dyu, yu);
-
-    /*
-     * Use (dxu[0],dyu[0]) as origin for the forward differences.
-     *
-     * This makes it possible to handle much larger coordinates (the
-     * ones that can be represented as cairo_fixed_t)
-     */
-    x0 = _cairo_fixed_from_double (dxu[0]);
-    y0 = _cairo_fixed_from_double (dyu[0]);
-    xu[0] = 0;
-    yu[0] = 0;
-
-    for (u = 0; u <= usteps; ++u) {
-	/*
-	 * This rasterizer assumes that pixels are integer aligned
-	 * squares, so a generic (x,y) point belongs to the pixel with
-	 * top-left coordinates (floor(x), floor(y))
-	 */
-
-	int x = _cairo_fixed_integer_floor (x0 + (xu[0] >> 15) + ((xu[0] >> 14) & 1));
-	int y = _cairo_fixed_integer_floor (y0 + (yu[0] >> 15) + ((yu[0] >> 14) & 1));
-
-	draw_pixel (data, width, height, stride, x, y, r, g, b, a);
-
-	fd_fixed_fwd (xu);
-	fd_fixed_fwd (yu);
-	r += dr;
-	g += dg;
-	b += db;
-	a += da;
+    int i;
+
+    *left = HUGE_VAL;
+    *right = -HUGE_VAL;
+
+    for (i = 0; i < 3; i++) {
+	const mesh_vertex_t *p = v[i], *q = v[(i + 1) % 3];
+	double t;
+
+	if (top <= p->y && p->y <= bottom)
+	    span_add_point (p->x, left, right);
+
+	if (p->y == q->y)
+	    continue;
+
+	if ((p->y < top) != (q->y < top)) {
+	    t = (top - p->y) / (q->y - p->y);
+	    span_add_point (p->x + t * (q->x - p->x), left, right);
+	}
+
+	if ((p->y < bottom) != (q->y < bottom)) {
+	    t = (bottom - p->y) / (q->y - p->y);
+	    span_add_point (p->x + t * (q->x - p->x), left, right);
+	}
     }
 }
 
+static inline int32_t
+color_to_span_fixed (double c)
+{
+    return c * (65535. * 256.) + 0.5;
+}
+
 /*
- * Clip, split and rasterize a Bezier curve.
+ * Rasterize a Gouraud-shaded triangle.
  *
  * Input: data is the base pointer of the image
  *        width, height are the dimensions of the image
  *        stride is the stride in bytes between adjacent rows
- *        p[i] is the i-th node of the Bezier curve
- *        c0[i] is the i-th color component at the start point
- *        c3[i] is the i-th color component at the end point
- *
- * Output: data will be changed to have the requested curve drawn in
- *         the specified colors
- *
- * The input color components are not premultiplied, but the data
- * stored in the image is assumed to be in CAIRO_FORMAT_ARGB32 (8 bpc,
- * premultiplied).
+ *        a, b, c are the vertices of the triangle, with their colors
  *
- * The color components are red, green, blue and alpha, in this order.
+ * Output: data will be changed to have the triangle drawn on it
  *
- * The function guarantees that it will draw the curve with a step
- * small enough to never have a distance above 1/sqrt(2) between two
- * consecutive points (which is needed to ensure that no hole can
- * appear when using this function to rasterize a patch).
+ * Every pixel that touches the triangle is painted with the color the
+ * triangle has at the center of the pixel or, for pixels whose center
+ * lies outside of the triangle, with a color clamped to the range
+ * spanned by the vertices.
  */
 static void
-draw_bezier_curve (unsigned char *data, int width, int height, int stride,
-		   cairo_point_double_t p[4], double c0[4], double c3[4])
+draw_triangle (unsigned char *data, int width, int height, int stride,
+	       const mesh_vertex_t *a, const mesh_vertex_t *b, const mesh_vertex_t *c)
 {
-    double top, bottom, left, right, steps_sq;
-    int i, v;
+    const mesh_vertex_t *v[3] = { a, b, c };
+    double top, bottom, left, right, area;
+    double dcdx[4], dcdy[4], cmin[4], cmax[4];
+    int x0, x1, y, y0, y1, i;
+
+    top    = MIN (a->y, MIN (b->y, c->y));
+    bottom = MAX (a->y, MAX (b->y, c->y));
+    left   = MIN (a->x, MIN (b->x, c->x));
+    right  = MAX (a->x, MAX (b->x, c->x));
+    if (bottom < 0 || top >= height || right < 0 || left >= width)
+	return;
 
-    top = bottom = p[0].y;
-    for (i = 1; i < 4; ++i) {
-	top    = MIN (top,    p[i].y);
-	bottom = MAX (bottom, p[i].y);
+    area = (b->x - a->x) * (c->y - a->y) - (c->x - a->x) * (b->y - a->y);
+    for (i = 0; i < 4; i++) {
+	if (area != 0) {
+	    dcdx[i] = ((b->c[i] - a->c[i]) * (c->y - a->y) -
+		       (c->c[i] - a->c[i]) * (b->y - a->y)) / area;
+	    dcdy[i] = ((c->c[i] - a->c[i]) * (b->x - a->x) -
+		       (b->c[i] - a->c[i]) * (c->x - a->x)) / area;
+	} else {
+	    dcdx[i] = dcdy[i] = 0;
+	}
+
+	cmin[i] = MIN (a->c[i], MIN (b->c[i], c->c[i]));
+	cmax[i] = MAX (a->c[i], MAX (b->c[i], c->c[i]));
     }
 
-    /* Check visibility */
-    v = intersect_interval (top, bottom, 0, height);
-    if (v == OUTSIDE)
-	return;
+    y0 = top < 0 ? 0 : floor (top);
+    y1 = bottom >= height ? height - 1 : floor (bottom);
+    for (y = y0; y <= y1; y++) {
+	int32_t cstart[4], cend[4], dc[4];
+	double cy;
+	int n;
+
+	triangle_span (v, MAX (top, y), MIN (bottom, y + 1), &left, &right);
+	if (left > right || right < 0 || left >= width)
+	    continue;
+
+	x0 = left < 0 ? 0 : floor (left);
+	x1 = right >= width ? width - 1 : floor (right);
+	n = x1 - x0 + 1;
+
+	cy = y + 0.5 - a->y;
+	for (i = 0; i < 4; i++) {
+	    double base = a->c[i] + dcdy[i] * cy;
+	    double c0 = base + dcdx[i] * (x0 + 0.5 - a->x);
+	    double c1 = base + dcdx[i] * (x1 + 0.5 - a->x);
+
+	    cstart[i] = color_to_span_fixed (MAX (cmin[i], MIN (cmax[i], c0)));
+	    cend[i]   = color_to_span_fixed (MAX (cmin[i], MIN (cmax[i], c1)));
+
+	    /* truncating keeps every value between the two (clamped) ends */
+	    dc[i] = n > 1 ? (cend[i] - cstart[i]) / (n - 1) : 0;
+	}
 
-    left = right = p[0].x;
-    for (i = 1; i < 4; ++i) {
-	left  = MIN (left,  p[i].x);
-	right = MAX (right, p[i].x);
+	fill_span ((uint32_t *) (data + y * (ptrdiff_t) stride) + x0, n, cstart, dc);
     }
+}
 
-    v &= intersect_interval (left, right, 0, width);
-    if (v == OUTSIDE)
-	return;
+/* The largest second difference of the nodes of a Bezier curve. */
+static inline double
+bezier_flatness (cairo_point_double_t p0, cairo_point_double_t p1,
+		 cairo_point_double_t p2, cairo_point_double_t p3)
+{
+    double ax = p0.x - 2 * p1.x + p2.x, ay = p0.y - 2 * p1.y + p2.y;
+    double bx = p1.x - 2 * p2.x + p3.x, by = p1.y - 2 * p2.y + p3.y;
 
-    steps_sq = bezier_steps_sq (p);
-    if (steps_sq >= (v == INSIDE ? STEPS_MAX_U * STEPS_MAX_U : STEPS_CLIP_U * STEPS_CLIP_U)) {
-	/*
-	 * The number of steps is greater than the threshold. This
-	 * means that either the error would become too big if we
-	 * directly rasterized it or that we can probably save some
-	 * time by splitting the curve and clipping part of it
-	 */
-	cairo_point_double_t first[4], second[4];
-	double midc[4];
-	split_bezier (p, first, second);
-	midc[0] = (c0[0] + c3[0]) * 0.5;
-	midc[1] = (c0[1] + c3[1]) * 0.5;
-	midc[2] = (c0[2] + c3[2]) * 0.5;
-	midc[3] = (c0[3] + c3[3]) * 0.5;
-	draw_bezier_curve (data, width, height, stride, first, c0, midc);
-	draw_bezier_curve (data, width, height, stride, second, midc, c3);
-    } else {
-	double xu[4], yu[4];
-	int ushift = sqsteps2shift (steps_sq), k;
+    return sqrt (MAX (ax * ax + ay * ay, bx * bx + by * by));
+}
+
+static inline void
+bernstein (double t, double b[4])
+{
+    double s = 1 - t;
+
+    b[0] = s * s * s;
+    b[1] = 3 * t * s * s;
+    b[2] = 3 * t * t * s;
+    b[3] = t * t * t;
+}
 
-	fd_init (p[0].x, p[1].x, p[2].x, p[3].x, xu);
-	fd_init (p[0].y, p[1].y, p[2].y, p[3].y, yu);
+/*
+ * Compute the size of the grid used to rasterize a patch.
+ *
+ * A cubic Bezier with nodes (p0, p1, p2, p3) has a second derivative
+ * bounded by 6 max (|p0-2p1+p2|, |p1-2p2+p3|), so replacing the curve
+ * between steps of 1/n with straight segments moves it by at most
+ * 6/8 of that over n^2. Inside each cell, drawing the patch (and its
+ * bilinear colors) as two triangles instead of a curved quad adds an
+ * error bounded by the mixed derivative times the area of the cell
+ * over 4.
+ */
+static void
+patch_grid_size (cairo_point_double_t p[4][4], double col[4][4],
+		 int *nu, int *nv)
+{
+    double du = 0, dv = 0, twist = 0, color_twist = 0, need;
+    double u, v;
+    int i, j;
 
-	for (k = 0; k < ushift; ++k) {
-	    fd_down (xu);
-	    fd_down (yu);
+    for (i = 0; i < 4; i++) {
+	dv = MAX (dv, bezier_flatness (p[i][0], p[i][1], p[i][2], p[i][3]));
+	du = MAX (du, bezier_flatness (p[0][i], p[1][i], p[2][i], p[3][i]));
+    }
+
+    for (i = 0; i < 3; i++) {
+	for (j = 0; j < 3; j++) {
+	    double x = p[i][j].x - p[i+1][j].x - p[i][j+1].x + p[i+1][j+1].x;
+	    double y = p[i][j].y - p[i+1][j].y - p[i][j+1].y + p[i+1][j+1].y;
+	    twist = MAX (twist, sqrt (x * x + y * y));
 	}
+    }
 
-	rasterize_bezier_curve (data, width, height, stride, ushift,
-				xu, yu,
-				_cairo_color_double_to_short (c0[0]),
-				_cairo_color_double_to_short (c0[1]),
-				_cairo_color_double_to_short (c0[2]),
-				_cairo_color_double_to_short (c0[3]),
-				_cairo_color_double_to_short (c3[0]),
-				_cairo_color_double_to_short (c3[1]),
-				_cairo_color_double_to_short (c3[2]),
-				_cairo_color_double_to_short (c3[3]));
-
-	/* Draw the end point, to make sure that we didn't leave it
-	 * out because of rounding */
-	draw_pixel (data, width, height, stride,
-		    _cairo_fixed_integer_floor (_cairo_fixed_from_double (p[3].x)),
-		    _cairo_fixed_integer_floor (_cairo_fixed_from_double (p[3].y)),
-		    _cairo_color_double_to_short (c3[0]),
-		    _cairo_color_double_to_short (c3[1]),
-		    _cairo_color_double_to_short (c3[2]),
-		    _cairo_color_double_to_short (c3[3]));
+    for (i = 0; i < 4; i++)
+	color_twist = MAX (color_twist, fabs (col[0][i] - col[1][i] - col[2][i] + col[3][i]));
+
+    u = MAX (1, ceil (sqrt (0.75 * du / GRID_TOLERANCE)));
+    v = MAX (1, ceil (sqrt (0.75 * dv / GRID_TOLERANCE)));
+
+    need = MAX (9 * twist / (4 * GRID_TOLERANCE),
+		color_twist / (4 * GRID_COLOR_TOLERANCE));
+    if (u * v < need) {
+	double f = sqrt (need / (u * v));
+	u = ceil (u * f);
+	v = ceil (v * f);
     }
+
+    *nu = MIN (u, GRID_MAX);
+    *nv = MIN (v, GRID_MAX);
 }
 
 /*
- * Forward-rasterize a cubic Bezier patch using forward differences.
+ * Rasterize a cubic Bezier patch.
  *
  * Input: data is the base pointer of the image
  *        width, height are the dimensions of the image
  *        stride is the stride in bytes between adjacent rows
- *        vshift is log2(n) if n is the number of desired steps
  *        p[i][j], p[i][j] are the the nodes of the Bezier patch
  *        col[i][j] is the j-th color component of the i-th corner
  *
@@ -686,65 +569,72 @@ draw_bezier_curve (unsigned char *data, int width, int height, int stride,
  * If the patch folds over itself, the part with the highest v
  * parameter is considered above. If both have the same v, the one
  * with the highest u parameter is above.
- *
- * The function draws n+1 curves, that is from the curve at step 0 to
- * the curve at step n, both included. This is the discrete equivalent
- * to drawing the patch for values of the interpolation parameter in
- * [0,1] (including both extremes).
  */
-static inline void
-rasterize_bezier_patch (unsigned char *data, int width, int height, int stride, int vshift,
+static void
+rasterize_bezier_patch (unsigned char *data, int width, int height, int stride,
 			cairo_point_double_t p[4][4], double col[4][4])
 {
-    double pv[4][2][4], cstart[4], cend[4], dcstart[4], dcend[4];
-    int v, i, k;
-
-    v = 1 << vshift;
-
-    /*
-     * pv[i][0] is the function (represented using forward
-     * differences) mapping v to the x coordinate of the i-th node of
-     * the Bezier curve with parameter u.
-     * (Likewise p[i][0] gives the y coordinate).
-     *
-     * This means that (pv[0][0][0],pv[0][1][0]),
-     * (pv[1][0][0],pv[1][1][0]), (pv[2][0][0],pv[2][1][0]) and
-     * (pv[3][0][0],pv[3][1][0]) are the nodes of the Bezier curve for
-     * the "current" v value (see the FD comments for more details).
-     */
-    for (i = 0; i < 4; ++i) {
-	fd_init (p[i][0].x, p[i][1].x, p[i][2].x, p[i][3].x, pv[i][0]);
-	fd_init (p[i][0].y, p[i][1].y, p[i][2].y, p[i][3].y, pv[i][1]);
-	for (k = 0; k < vshift; ++k) {
-	    fd_down (pv[i][0]);
-	    fd_down (pv[i][1]);
+    mesh_vertex_t stack_rows[2 * (CAIRO_STACK_BUFFER_SIZE / sizeof (mesh_vertex_t))];
+    mesh_vertex_t *rows, *prev, *cur, *tmp;
+    int nu, nv, i, j, k, l;
+
+    patch_grid_size (p, col, &nu, &nv);
+
+    rows = stack_rows;
+    if (2 * (nu + 1) > ARRAY_LENGTH (stack_rows)) {
+	rows = _cairo_malloc_ab (2 * (nu + 1), sizeof (mesh_vertex_t));
+	if (unlikely (rows == NULL)) {
+	    /* draw it coarser rather than not at all */
+	    rows = stack_rows;
+	    nu = ARRAY_LENGTH (stack_rows) / 2 - 1;
 	}
     }
+    prev = rows;
+    cur = rows + nu + 1;
 
-    for (i = 0; i < 4; ++i) {
-	cstart[i]  = col[0][i];
-	cend[i]    = col[1][i];
-	dcstart[i] = (col[2][i] - col[0][i]) / v;
-	dcend[i]   = (col[3][i] - col[1][i]) / v;
-    }
+    for (j = 0; j <= nv; j++) {
+	cairo_point_double_t q[4];
+	double bv[4], v = (double) j / nv;
 
-    v++;
-    while (v--) {
-	cairo_point_double_t nodes[4];
-	for (i = 0; i < 4; ++i) {
-	    nodes[i].x = pv[i][0][0];
-	    nodes[i].y = pv[i][1][0];
+	/* the nodes of the curve along u for this value of v */
+	bernstein (v, bv);
+	for (i = 0; i < 4; i++) {
+	    q[i].x = q[i].y = 0;
+	    for (k = 0; k < 4; k++) {
+		q[i].x += bv[k] * p[i][k].x;
+		q[i].y += bv[k] * p[i][k].y;
+	    }
 	}
 
-	draw_bezier_curve (data, width, height, stride, nodes, cstart, cend);
+	for (i = 0; i <= nu; i++) {
+	    double bu[4], u = (double) i / nu;
 
-	for (i = 0; i < 4; ++i) {
-	    fd_fwd (pv[i][0]);
-	    fd_fwd (pv[i][1]);
-	    cstart[i] += dcstart[i];
-	    cend[i] += dcend[i];
+	    bernstein (u, bu);
+	    cur[i].x = bu[0] * q[0].x + bu[1] * q[1].x + bu[2] * q[2].x + bu[3] * q[3].x;
+	    cur[i].y = bu[0] * q[0].y + bu[1] * q[1].y + bu[2] * q[2].y + bu[3] * q[3].y;
+
+	    for (l = 0; l < 4; l++) {
+		cur[i].c[l] = (1 - v) * ((1 - u) * col[0][l] + u * col[1][l]) +
+			      v * ((1 - u) * col[2][l] + u * col[3][l]);
+	    }
+	}
+
+	if (j > 0) {
+	    for (i = 0; i < nu; i++) {
+		draw_triangle (data, width, height, stride,
+			       &prev[i], &prev[i+1], &cur[i+1]);
+		draw_triangle (data, width, height, stride,
+			       &prev[i], &cur[i+1], &cur[i]);
+	    }
 	}
+
+	tmp = prev;
+	prev = cur;
+	cur = tmp;
     }
+
+    if (rows != stack_rows)
+	free (rows);
 }
 
 /*
@@ -759,31 +649,7 @@ rasterize_bezier_patch (unsigned char *data, int width, int height, int stride,
  * Output: data will be changed to have the requested patch drawn in
  *         the specified colors
  *
- * The nodes of the patch are as follows:
- *
- * u\v 0    - >    1
- * 0  p00 p01 p02 p03
- * |  p10 p11 p12 p13
- * v  p20 p21 p22 p23
- * 1  p30 p31 p32 p33
- *
- * i.e. u varies along the first component (rows), v varies along the
- * second one (columns).
- *
- * The color components are red, green, blue and alpha, in this order.
- * c[0..3] are the colors in p00, p30, p03, p33 respectively
- *
- * The input color components are not premultiplied, but the data
- * stored in the image is assumed to be in CAIRO_FORMAT_ARGB32 (8 bpc,
- * premultiplied).
- *
- * If the patch folds over itself, the part with the highest v
- * parameter is considered above. If both have the same v, the one
- * with the highest u parameter is above.
- *
- * The function guarantees that it will draw the patch with a step
- * small enough to never have a distance above 1/sqrt(2) between two
- * adjacent points (which guarantees that no hole can appear).
+ * The nodes and colors are laid out as for rasterize_bezier_patch ().
  *
  * This function can be used to rasterize a tile of PDF type 7
  * shadings (see http://www.adobe.com/devnet/pdf/pdf_reference.html).
@@ -823,14 +689,12 @@ draw_bezier_patch (unsigned char *data, int width, int height, int stride,
     for (i = 0; i < 4; ++i)
 	steps_sq = MAX (steps_sq, bezier_steps_sq (p[i]));
 
-    if (steps_sq >= (v == INSIDE ? STEPS_MAX_V * STEPS_MAX_V : STEPS_CLIP_V * STEPS_CLIP_V)) {
-	/* The number of steps is greater than the threshold. This
-	 * means that either the error would become too big if we
-	 * directly rasterized it or that we can probably save some
-	 * time by splitting the curve and clipping part of it. The
-	 * patch is only split in the v direction to guarantee that
-	 * rasterizing each part will overwrite parts with low v with
-	 * overlapping parts with higher v. */
+    if (v == PARTIAL && steps_sq >= STEPS_CLIP_V * STEPS_CLIP_V) {
+	/* The patch is large and only partially visible, so we can
+	 * probably save some time by splitting it and clipping part
+	 * of it. The patch is only split in the v direction to
+	 * guarantee that rasterizing each part will overwrite parts
+	 * with low v with overlapping parts with higher v. */
 
 	cairo_point_double_t first[4][4], second[4][4];
 	double subc[4][4];
@@ -855,7 +719,7 @@ draw_bezier_patch (unsigned char *data, int width, int height, int stride,
 	}
 	draw_bezier_patch (data, width, height, stride, second, subc);
     } else {
-	rasterize_bezier_patch (data, width, height, stride, sqsteps2shift (steps_sq), p, c);
+	rasterize_bezier_patch (data, width, height, stride, p, c);
     }
 }
 
@@ -39,6 +39,9 @@
 CAIRO_MUTEX_DECLARE (_cairo_pattern_solid_surface_cache_lock)
 
 CAIRO_MUTEX_DECLARE (_cairo_image_solid_cache_mutex)
+CAIRO_MUTEX_DECLARE (_cairo_image_kernel_cache_mutex)
+CAIRO_MUTEX_DECLARE (_cairo_image_mipmap_mutex)
+CAIRO_MUTEX_DECLARE (_cairo_image_cow_mutex)
 
 CAIRO_MUTEX_DECLARE (_cairo_toy_font_face_mutex)
 CAIRO_MUTEX_DECLARE (_cairo_intern_string_mutex)
@@ -46,6 +49,7 @@ CAIRO_MUTEX_DECLARE (_cairo_scaled_font_map_mutex)
 CAIRO_MUTEX_DECLARE (_cairo_scaled_glyph_page_cache_mutex)
 CAIRO_MUTEX_DECLARE (_cairo_scaled_font_error_mutex)
 CAIRO_MUTEX_DECLARE (_cairo_glyph_cache_mutex)
+CAIRO_MUTEX_DECLARE (_cairo_recording_surface_bbtree_mutex)
 
 #if CAIRO_HAS_FT_FONT
 CAIRO_MUTEX_DECLARE (_cairo_ft_unscaled_font_map_mutex)
@@ -50,6 +50,7 @@
 #include "cairo-analysis-surface-private.h"
 #include "cairo-error-private.h"
 #include "cairo-image-surface-private.h"
+#include "cairo-parallel-private.h"
 #include "cairo-surface-subsurface-inline.h"
 
 static const cairo_surface_backend_t cairo_paginated_surface_backend;
@@ -347,37 +348,39 @@ _paint_thumbnail_image (cairo_paginated_surface_t *surface,
     return status;
 }
 
-static cairo_int_status_t
-_paint_fallback_image (cairo_paginated_surface_t *surface,
-		       cairo_rectangle_int_t     *rect)
+static cairo_surface_t *
+_create_fallback_image (cairo_paginated_surface_t	*surface,
+			const cairo_rectangle_int_t	*rect)
 {
     double x_scale = surface->base.x_fallback_resolution / surface->target->x_resolution;
     double y_scale = surface->base.y_fallback_resolution / surface->target->y_resolution;
-    int x, y, width, height;
-    cairo_status_t status;
     cairo_surface_t *image;
-    cairo_surface_pattern_t pattern;
-    cairo_clip_t *clip;
 
-    x = rect->x;
-    y = rect->y;
-    width = rect->width;
-    height = rect->height;
     image = _cairo_paginated_surface_create_image_surface (surface,
-							   ceil (width  * x_scale),
-							   ceil (height * y_scale));
+							   ceil (rect->width  * x_scale),
+							   ceil (rect->height * y_scale));
     cairo_surface_set_device_scale (image, x_scale, y_scale);
     /* set_device_offset just sets the x0/y0 components of the matrix;
      * so we have to do the scaling manually. */
-    cairo_surface_set_device_offset (image, -x*x_scale, -y*y_scale);
+    cairo_surface_set_device_offset (image, -rect->x*x_scale, -rect->y*y_scale);
 
-    status = _cairo_recording_surface_replay (surface->recording_surface, image);
-    if (unlikely (status))
-	goto CLEANUP_IMAGE;
+    return image;
+}
+
+static cairo_int_status_t
+_paint_fallback_image_to_target (cairo_paginated_surface_t	*surface,
+				 const cairo_rectangle_int_t	*rect,
+				 cairo_surface_t		*image)
+{
+    double x_scale = surface->base.x_fallback_resolution / surface->target->x_resolution;
+    double y_scale = surface->base.y_fallback_resolution / surface->target->y_resolution;
+    cairo_surface_pattern_t pattern;
+    cairo_int_status_t status;
+    cairo_clip_t *clip;
 
     _cairo_pattern_init_for_surface (&pattern, image);
     cairo_matrix_init (&pattern.base.matrix,
-		       x_scale, 0, 0, y_scale, -x*x_scale, -y*y_scale);
+		       x_scale, 0, 0, y_scale, -rect->x*x_scale, -rect->y*y_scale);
     /* the fallback should be rendered at native resolution, so disable
      * filtering (if possible) to avoid introducing potential artifacts. */
     pattern.base.filter = CAIRO_FILTER_NEAREST;
@@ -389,12 +392,216 @@ _paint_fallback_image (cairo_paginated_surface_t *surface,
     _cairo_clip_destroy (clip);
     _cairo_pattern_fini (&pattern.base);
 
-CLEANUP_IMAGE:
+    return status;
+}
+
+static cairo_int_status_t
+_paint_fallback_image (cairo_paginated_surface_t *surface,
+		       cairo_rectangle_int_t     *rect)
+{
+    cairo_status_t status;
+    cairo_surface_t *image;
+
+    image = _create_fallback_image (surface, rect);
+    status = _cairo_recording_surface_replay (surface->recording_surface, image);
+    if (likely (status == CAIRO_STATUS_SUCCESS))
+	status = _paint_fallback_image_to_target (surface, rect, image);
     cairo_surface_destroy (image);
 
     return status;
 }
 
+/* Rasterizing the fallback images at print resolution is the expensive
+ * part of emitting a page with unsupported operations, so when the
+ * recording allows it, every fallback region is cut into bands of rows
+ * that are replayed by the worker threads at the same time, each into
+ * its own slice of the region's image.  The images are then painted to
+ * the target one after another, in the same order and with the same
+ * geometry as _paint_fallback_image() would, so the output does not
+ * depend upon the number of threads.
+ *
+ * A region's image is only created when its bands are about to be
+ * replayed and is released as soon as it has been painted, so that a
+ * page with many fallback regions never holds more of their images at
+ * once than it takes to keep the threads busy. */
+
+#define FALLBACK_MIN_BAND_HEIGHT 32
+
+typedef struct _cairo_paginated_fallback_band {
+    int region;
+    int y, height;
+    cairo_status_t status;
+} cairo_paginated_fallback_band_t;
+
+typedef struct _cairo_paginated_fallback_bands {
+    cairo_surface_t *recording;
+    cairo_surface_t **images;
+    cairo_paginated_fallback_band_t *bands;
+} cairo_paginated_fallback_bands_t;
+
+static void
+_replay_fallback_band (void *closure, int index)
+{
+    cairo_paginated_fallback_bands_t *bands = closure;
+    cairo_paginated_fallback_band_t *band = &bands->bands[index];
+    cairo_image_surface_t *image = (cairo_image_surface_t *) bands->images[band->region];
+    cairo_font_options_t options;
+    cairo_surface_t *slice;
+
+    slice = cairo_image_surface_create_for_data (image->data + band->y * image->stride,
+						 image->format,
+						 image->width,
+						 band->height,
+						 image->stride);
+    if (unlikely (slice->status)) {
+	band->status = slice->status;
+	cairo_surface_destroy (slice);
+	return;
+    }
+
+    cairo_surface_get_font_options (&image->base, &options);
+    _cairo_surface_set_font_options (slice, &options);
+    cairo_surface_set_device_scale (slice,
+				    image->base.device_transform.xx,
+				    image->base.device_transform.yy);
+    cairo_surface_set_device_offset (slice,
+				     image->base.device_transform.x0,
+				     image->base.device_transform.y0 - band->y);
+
+    band->status = _cairo_recording_surface_replay (bands->recording, slice);
+    cairo_surface_destroy (slice);
+}
+
+static cairo_int_status_t
+_paint_fallback_images (cairo_paginated_surface_t	*surface,
+			const cairo_rectangle_int_t	*rects,
+			int				 num_rects)
+{
+    double y_scale = surface->base.y_fallback_resolution / surface->target->y_resolution;
+    cairo_paginated_fallback_bands_t bands;
+    cairo_paginated_fallback_band_t *all_bands;
+    cairo_surface_t *stack_images[CAIRO_STACK_ARRAY_LENGTH (cairo_surface_t *)];
+    cairo_int_status_t status = CAIRO_INT_STATUS_SUCCESS;
+    int num_threads, num_bands, total_height, band_height;
+    int first, last, first_band, last_band;
+    int i, n;
+
+    num_threads = _cairo_parallel_num_threads ();
+    if (num_threads == 1 ||
+	! _cairo_recording_surface_can_replay_concurrently ((cairo_recording_surface_t *) surface->recording_surface))
+    {
+	for (i = 0; i < num_rects; i++) {
+	    status = _paint_fallback_image (surface, (cairo_rectangle_int_t *) &rects[i]);
+	    if (unlikely (status))
+		return status;
+	}
+
+	return CAIRO_INT_STATUS_SUCCESS;
+    }
+
+    /* the image heights, as _create_fallback_image() will make them */
+    total_height = 0;
+    for (i = 0; i < num_rects; i++)
+	total_height += ceil (rects[i].height * y_scale);
+
+    /* enough bands to keep all the threads busy even if the cost of
+     * the rows is uneven, but not so thin that replaying the recording
+     * over and over starts to dominate */
+    band_height = (total_height + 4 * num_threads - 1) / (4 * num_threads);
+    if (band_height < FALLBACK_MIN_BAND_HEIGHT)
+	band_height = FALLBACK_MIN_BAND_HEIGHT;
+
+    num_bands = 0;
+    for (i = 0; i < num_rects; i++) {
+	int height = ceil (rects[i].height * y_scale);
+	num_bands += (height + band_height - 1) / band_height;
+    }
+
+    bands.recording = surface->recording_surface;
+    bands.images = stack_images;
+    if (num_rects > ARRAY_LENGTH (stack_images)) {
+	bands.images = _cairo_malloc_ab (num_rects, sizeof (cairo_surface_t *));
+	if (unlikely (bands.images == NULL))
+	    return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+    }
+
+    all_bands = _cairo_malloc_ab (num_bands, sizeof (cairo_paginated_fallback_band_t));
+    if (unlikely (all_bands == NULL)) {
+	status = _cairo_error (CAIRO_STATUS_NO_MEMORY);
+	goto CLEANUP_IMAGES;
+    }
+
+    n = 0;
+    for (i = 0; i < num_rects; i++) {
+	int height = ceil (rects[i].height * y_scale);
+	int y;
+
+	for (y = 0; y < height; y += band_height) {
+	    all_bands[n].region = i;
+	    all_bands[n].y = y;
+	    all_bands[n].height = MIN (band_height, height - y);
+	    all_bands[n].status = CAIRO_STATUS_SUCCESS;
+	    n++;
+	}
+    }
+    assert (n == num_bands);
+
+    /* Take the regions in batches that are just large enough to give
+     * every thread several bands. */
+    first = first_band = 0;
+    while (status == CAIRO_INT_STATUS_SUCCESS && first < num_rects) {
+	last = first;
+	last_band = first_band;
+	do {
+	    while (last_band < num_bands && all_bands[last_band].region == last)
+		last_band++;
+	    last++;
+	} while (last < num_rects && last_band - first_band < 4 * num_threads);
+
+	for (i = first; i < last; i++) {
+	    bands.images[i] = _create_fallback_image (surface, &rects[i]);
+	    if (unlikely (bands.images[i]->status)) {
+		status = bands.images[i]->status;
+		last = i + 1;
+		break;
+	    }
+	}
+
+	if (status == CAIRO_INT_STATUS_SUCCESS) {
+	    bands.bands = all_bands + first_band;
+	    _cairo_parallel_for (last_band - first_band,
+				 _replay_fallback_band, &bands);
+
+	    for (n = first_band; n < last_band; n++) {
+		if (unlikely (all_bands[n].status)) {
+		    status = all_bands[n].status;
+		    break;
+		}
+	    }
+	}
+
+	for (i = first; i < last; i++) {
+	    if (status == CAIRO_INT_STATUS_SUCCESS) {
+		cairo_surface_mark_dirty (bands.images[i]);
+		status = _paint_fallback_image_to_target (surface, &rects[i],
+							  bands.images[i]);
+	    }
+	    cairo_surface_destroy (bands.images[i]);
+	}
+
+	first = last;
+	first_band = last_band;
+    }
+
+    free (all_bands);
+
+CLEANUP_IMAGES:
+    if (bands.images != stack_images)
+	free (bands.images);
+
+    return status;
+}
+
 static cairo_int_status_t
 _paint_page (cairo_paginated_surface_t *surface)
 {
@@ -490,13 +697,15 @@ _paint_page (cairo_paginated_surface_t *surface)
 	    goto FAIL;
 	}
 
-	status = _paint_fallback_image (surface, &extents);
+	status = _paint_fallback_images (surface, &extents, 1);
 	if (unlikely (status))
 	    goto FAIL;
     }
 
     if (has_finegrained_fallback) {
         cairo_region_t *region;
+	cairo_rectangle_int_t stack_rects[CAIRO_STACK_ARRAY_LENGTH (cairo_rectangle_int_t)];
+	cairo_rectangle_int_t *rects;
         int num_rects, i;
 
 	status = surface->backend->set_paginated_mode (surface->target,
@@ -507,14 +716,23 @@ _paint_page (cairo_paginated_surface_t *surface)
 	region = _cairo_analysis_surface_get_unsupported (analysis);
 
 	num_rects = cairo_region_num_rectangles (region);
-	for (i = 0; i < num_rects; i++) {
-	    cairo_rectangle_int_t rect;
-
-	    cairo_region_get_rectangle (region, i, &rect);
-	    status = _paint_fallback_image (surface, &rect);
-	    if (unlikely (status))
+	rects = stack_rects;
+	if (num_rects > ARRAY_LENGTH (stack_rects)) {
+	    rects = _cairo_malloc_ab (num_rects, sizeof (cairo_rectangle_int_t));
+	    if (unlikely (rects == NULL)) {
+		status = _cairo_error (CAIRO_STATUS_NO_MEMORY);
 		goto FAIL;
+	    }
 	}
+
+	for (i = 0; i < num_rects; i++)
+	    cairo_region_get_rectangle (region, i, &rects[i]);
+
+	status = _paint_fallback_images (surface, rects, num_rects);
+	if (rects != stack_rects)
+	    free (rects);
+	if (unlikely (status))
+	    goto FAIL;
     }
 
     if (surface->backend->requires_thumbnail_image) {
@@ -0,0 +1,78 @@
+/* -*- Mode: c; tab-width: 8; c-basic-offset: 4; indent-tabs-mode: t; -*- */
+/* cairo - a vector graphics library with display and print output
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it either under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * (the "LGPL") or, at your option, under the terms of the Mozilla
+ * Public License Version 1.1 (the "MPL"). If you do not alter this
+ * notice, a recipient may use your version of this file under either
+ * the MPL or the LGPL.
+ *
+ * You should have received a copy of the LGPL along with this library
+ * in the file COPYING-LGPL-2.1; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA
+ * You should have received a copy of the MPL along with this library
+ * in the file COPYING-MPL-1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.1 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY
+ * OF ANY KIND, either express or implied. See the LGPL or the MPL for
+ * the specific language governing rights and limitations.
+ *
+ * The Original Code is the cairo graphics library.
+ */
+
+#ifndef CAIRO_PARALLEL_PRIVATE_H
+#define CAIRO_PARALLEL_PRIVATE_H
+
+#include "cairo-compiler-private.h"
+
+CAIRO_BEGIN_DECLS
+
+typedef void
+(*cairo_parallel_func_t) (void *closure, int index);
+
+/**
+ * _cairo_parallel_for:
+ * @count: the number of tasks
+ * @func: the function to run for each task
+ * @closure: data passed to @func
+ *
+ * Calls @func once for every index in [0, @count), spread across a
+ * process-wide pool of worker threads, and returns once all of the
+ * calls have completed. The calling thread runs tasks too, so it is
+ * safe to call _cairo_parallel_for() from within a task. The tasks may
+ * run in any order and concurrently, so they must only write to
+ * state of their own; results that have to come out in order should
+ * be stored per index and consumed after this returns.
+ *
+ * Without thread support, or when the environment variable
+ * CAIRO_NUM_THREADS is set to 1, the tasks are run in order on the
+ * calling thread.
+ **/
+cairo_private void
+_cairo_parallel_for (int		    count,
+		     cairo_parallel_func_t  func,
+		     void		   *closure);
+
+/**
+ * _cairo_parallel_num_threads:
+ *
+ * Return value: the number of threads, including the caller, that
+ * _cairo_parallel_for() spreads tasks across. Useful for sizing the
+ * batches of work.
+ **/
+cairo_private int
+_cairo_parallel_num_threads (void);
+
+cairo_private void
+_cairo_parallel_reset_static_data (void);
+
+CAIRO_END_DECLS
+
+#endif /* CAIRO_PARALLEL_PRIVATE_H */
@@ -0,0 +1,253 @@
+/* -*- Mode: c; tab-width: 8; c-basic-offset: 4; indent-tabs-mode: t; -*- */
+/* cairo - a vector graphics library with display and print output
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it either under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * (the "LGPL") or, at your option, under the terms of the Mozilla
+ * Public License Version 1.1 (the "MPL"). If you do not alter this
+ * notice, a recipient may use your version of this file under either
+ * the MPL or the LGPL.
+ *
+ * You should have received a copy of the LGPL along with this library
+ * in the file COPYING-LGPL-2.1; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA
+ * You should have received a copy of the MPL along with this library
+ * in the file COPYING-MPL-1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.1 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY
+ * OF ANY KIND, either express or implied. See the LGPL or the MPL for
+ * the specific language governing rights and limitations.
+ *
+ * The Original Code is the cairo graphics library.
+ */
+
+#include "cairoint.h"
+
+#include "cairo-list-inline.h"
+#include "cairo-parallel-private.h"
+
+/* A small pool of worker threads shared by everything that wants to
+ * split work into independent tasks. Jobs are queued in FIFO order and
+ * every thread, the submitter included, claims the next unstarted
+ * index of the oldest job. The pool is only started on first use.
+ */
+
+#define MAX_THREADS 16
+
+#if CAIRO_MUTEX_IMPL_PTHREAD
+
+#include <pthread.h>
+#include <unistd.h>
+
+typedef struct _cairo_parallel_job {
+    cairo_list_t link;
+    cairo_parallel_func_t func;
+    void *closure;
+    int count;
+    int next;
+    int done;
+} cairo_parallel_job_t;
+
+static pthread_mutex_t pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t pool_work = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t pool_done = PTHREAD_COND_INITIALIZER;
+static cairo_list_t pool_jobs = { &pool_jobs, &pool_jobs };
+static pthread_t pool_threads[MAX_THREADS];
+static int pool_num_threads = -1;
+static cairo_bool_t pool_shutdown;
+static cairo_bool_t pool_atfork_registered;
+
+/* Called with pool_mutex held, returns with it held */
+static void
+_cairo_parallel_job_run_one (cairo_parallel_job_t *job)
+{
+    int index;
+
+    index = job->next++;
+    if (job->next == job->count)
+	cairo_list_del (&job->link);
+
+    pthread_mutex_unlock (&pool_mutex);
+    job->func (job->closure, index);
+    pthread_mutex_lock (&pool_mutex);
+
+    if (++job->done == job->count)
+	pthread_cond_broadcast (&pool_done);
+}
+
+static void *
+_cairo_parallel_worker (void *arg)
+{
+    pthread_mutex_lock (&pool_mutex);
+    for (;;) {
+	while (! pool_shutdown && cairo_list_is_empty (&pool_jobs))
+	    pthread_cond_wait (&pool_work, &pool_mutex);
+
+	if (pool_shutdown)
+	    break;
+
+	_cairo_parallel_job_run_one (cairo_list_first_entry (&pool_jobs,
+							     cairo_parallel_job_t,
+							     link));
+    }
+    pthread_mutex_unlock (&pool_mutex);
+
+    return NULL;
+}
+
+/* The worker threads do not survive a fork, start afresh in the child */
+static void
+_cairo_parallel_atfork_child (void)
+{
+    pthread_mutex_init (&pool_mutex, NULL);
+    pthread_cond_init (&pool_work, NULL);
+    pthread_cond_init (&pool_done, NULL);
+    cairo_list_init (&pool_jobs);
+    pool_num_threads = -1;
+    pool_shutdown = FALSE;
+}
+
+static int
+_cairo_parallel_num_cpus (void)
+{
+    const char *env;
+    long n = 1;
+
+    env = getenv ("CAIRO_NUM_THREADS");
+    if (env != NULL)
+	n = atoi (env);
+#ifdef _SC_NPROCESSORS_ONLN
+    else
+	n = sysconf (_SC_NPROCESSORS_ONLN);
+#endif
+
+    if (n < 1)
+	n = 1;
+    if (n > MAX_THREADS + 1)
+	n = MAX_THREADS + 1;
+
+    return n;
+}
+
+/* Called with pool_mutex held */
+static void
+_cairo_parallel_start_pool (void)
+{
+    int n, num_cpus;
+
+    if (! pool_atfork_registered) {
+	pthread_atfork (NULL, NULL, _cairo_parallel_atfork_child);
+	pool_atfork_registered = TRUE;
+    }
+
+    num_cpus = _cairo_parallel_num_cpus ();
+    for (n = 0; n < num_cpus - 1; n++) {
+	if (pthread_create (&pool_threads[n], NULL,
+			    _cairo_parallel_worker, NULL))
+	    break;
+    }
+    pool_num_threads = n;
+}
+
+static int
+_cairo_parallel_get_pool (void)
+{
+    int n;
+
+    pthread_mutex_lock (&pool_mutex);
+    if (pool_num_threads < 0)
+	_cairo_parallel_start_pool ();
+    n = pool_num_threads;
+    pthread_mutex_unlock (&pool_mutex);
+
+    return n;
+}
+
+void
+_cairo_parallel_for (int		    count,
+		     cairo_parallel_func_t  func,
+		     void		   *closure)
+{
+    cairo_parallel_job_t job;
+    int i;
+
+    if (count > 1 && _cairo_parallel_get_pool ()) {
+	job.func = func;
+	job.closure = closure;
+	job.count = count;
+	job.next = 0;
+	job.done = 0;
+
+	pthread_mutex_lock (&pool_mutex);
+	cairo_list_add_tail (&job.link, &pool_jobs);
+	pthread_cond_broadcast (&pool_work);
+
+	while (job.next < job.count)
+	    _cairo_parallel_job_run_one (&job);
+	while (job.done < job.count)
+	    pthread_cond_wait (&pool_done, &pool_mutex);
+	pthread_mutex_unlock (&pool_mutex);
+	return;
+    }
+
+    for (i = 0; i < count; i++)
+	func (closure, i);
+}
+
+int
+_cairo_parallel_num_threads (void)
+{
+    return _cairo_parallel_get_pool () + 1;
+}
+
+void
+_cairo_parallel_reset_static_data (void)
+{
+    int n, num_threads;
+
+    pthread_mutex_lock (&pool_mutex);
+    num_threads = pool_num_threads;
+    pool_shutdown = TRUE;
+    pthread_cond_broadcast (&pool_work);
+    pthread_mutex_unlock (&pool_mutex);
+
+    for (n = 0; n < num_threads; n++)
+	pthread_join (pool_threads[n], NULL);
+
+    pthread_mutex_lock (&pool_mutex);
+    pool_num_threads = -1;
+    pool_shutdown = FALSE;
+    pthread_mutex_unlock (&pool_mutex);
+}
+
+#else /* !CAIRO_MUTEX_IMPL_PTHREAD */
+
+void
+_cairo_parallel_for (int		    count,
+		     cairo_parallel_func_t  func,
+		     void		   *closure)
+{
+    int i;
+
+    for (i = 0; i < count; i++)
+	func (closure, i);
+}
+
+int
+_cairo_parallel_num_threads (void)
+{
+    return 1;
+}
+
+void
+_cairo_parallel_reset_static_data (void)
+{
+}
+
+#endif
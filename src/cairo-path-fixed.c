@@ -175,27 +175,30 @@ _cairo_path_fixed_init_copy (cairo_path_fixed_t *path,
 unsigned long
 _cairo_path_fixed_hash (const cairo_path_fixed_t *path)
 {
-    unsigned long hash = _CAIRO_HASH_INIT_VALUE;
+    cairo_hash_state_t state;
     const cairo_path_buf_t *buf;
     unsigned int count;
 
+    /* Equal paths may be split differently across their buffers */
+    _cairo_hash_state_init (&state, _CAIRO_HASH_INIT_VALUE);
+
     count = 0;
     cairo_path_foreach_buf_start (buf, path) {
-	hash = _cairo_hash_bytes (hash, buf->op,
-			          buf->num_ops * sizeof (buf->op[0]));
+	_cairo_hash_state_update (&state, buf->op,
+				  buf->num_ops * sizeof (buf->op[0]));
 	count += buf->num_ops;
     } cairo_path_foreach_buf_end (buf, path);
-    hash = _cairo_hash_bytes (hash, &count, sizeof (count));
+    _cairo_hash_state_update (&state, &count, sizeof (count));
 
     count = 0;
     cairo_path_foreach_buf_start (buf, path) {
-	hash = _cairo_hash_bytes (hash, buf->points,
-			          buf->num_points * sizeof (buf->points[0]));
+	_cairo_hash_state_update (&state, buf->points,
+				  buf->num_points * sizeof (buf->points[0]));
 	count += buf->num_points;
     } cairo_path_foreach_buf_end (buf, path);
-    hash = _cairo_hash_bytes (hash, &count, sizeof (count));
+    _cairo_hash_state_update (&state, &count, sizeof (count));
 
-    return hash;
+    return _cairo_hash_state_finish (&state);
 }
 
 unsigned long
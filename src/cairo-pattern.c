@@ -3876,22 +3876,13 @@ static unsigned long
 _cairo_gradient_color_stops_hash (unsigned long hash,
 				  const cairo_gradient_pattern_t *gradient)
 {
-    unsigned int n;
-
     hash = _cairo_hash_bytes (hash,
 			      &gradient->n_stops,
 			      sizeof (gradient->n_stops));
 
-    for (n = 0; n < gradient->n_stops; n++) {
-	hash = _cairo_hash_bytes (hash,
-				  &gradient->stops[n].offset,
-				  sizeof (double));
-	hash = _cairo_hash_bytes (hash,
-				  &gradient->stops[n].color,
-				  sizeof (cairo_color_stop_t));
-    }
-
-    return hash;
+    return _cairo_hash_bytes (hash,
+			      gradient->stops,
+			      gradient->n_stops * sizeof (cairo_gradient_stop_t));
 }
 
 unsigned long
@@ -3920,12 +3911,9 @@ static unsigned long
 _cairo_mesh_pattern_hash (unsigned long hash, const cairo_mesh_pattern_t *mesh)
 {
     const cairo_mesh_patch_t *patch = _cairo_array_index_const (&mesh->patches, 0);
-    unsigned int i, n = _cairo_array_num_elements (&mesh->patches);
+    unsigned int n = _cairo_array_num_elements (&mesh->patches);
 
-    for (i = 0; i < n; i++)
-       hash = _cairo_hash_bytes (hash, patch + i, sizeof (cairo_mesh_patch_t));
-
-    return hash;
+    return _cairo_hash_bytes (hash, patch, n * sizeof (cairo_mesh_patch_t));
 }
 
 static unsigned long
@@ -4697,6 +4685,7 @@ _cairo_debug_print_surface_pattern (FILE *file,
     case CAIRO_SURFACE_TYPE_SKIA: s = "skia"; break; /* Deprecated */
     case CAIRO_SURFACE_TYPE_SUBSURFACE: s = "subsurface"; break;
     case CAIRO_SURFACE_TYPE_COGL: s = "cogl"; break;
+    case CAIRO_SURFACE_TYPE_TILED: s = "tiled"; break;
     default: s = "invalid"; ASSERT_NOT_REACHED; break;
     }
     fprintf (file, "  surface type: %s\n", s);
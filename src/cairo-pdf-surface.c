@@ -5630,53 +5630,6 @@ _cairo_pdf_surface_emit_cff_font (cairo_pdf_surface_t		*surface,
     return status;
 }
 
-static cairo_int_status_t
-_cairo_pdf_surface_emit_cff_font_subset (cairo_pdf_surface_t	     *surface,
-                                         cairo_scaled_font_subset_t  *font_subset)
-{
-    cairo_int_status_t status;
-    cairo_cff_subset_t subset;
-    char name[64];
-
-    snprintf (name, sizeof name, "CairoFont-%d-%d",
-              font_subset->font_id, font_subset->subset_id);
-    status = _cairo_cff_subset_init (&subset, name, font_subset);
-    if (unlikely (status))
-        return status;
-
-    status = _cairo_pdf_surface_emit_cff_font (surface, font_subset, &subset);
-
-    _cairo_cff_subset_fini (&subset);
-
-    return status;
-}
-
-static cairo_int_status_t
-_cairo_pdf_surface_emit_cff_fallback_font (cairo_pdf_surface_t	       *surface,
-                                           cairo_scaled_font_subset_t  *font_subset)
-{
-    cairo_int_status_t status;
-    cairo_cff_subset_t subset;
-    char name[64];
-
-    /* CFF fallback subsetting does not work with 8-bit glyphs unless
-     * they are a latin subset */
-    if (!font_subset->is_composite && !font_subset->is_latin)
-	return CAIRO_INT_STATUS_UNSUPPORTED;
-
-    snprintf (name, sizeof name, "CairoFont-%d-%d",
-              font_subset->font_id, font_subset->subset_id);
-    status = _cairo_cff_fallback_init (&subset, name, font_subset);
-    if (unlikely (status))
-        return status;
-
-    status = _cairo_pdf_surface_emit_cff_font (surface, font_subset, &subset);
-
-    _cairo_cff_fallback_fini (&subset);
-
-    return status;
-}
-
 static cairo_int_status_t
 _cairo_pdf_surface_emit_type1_font (cairo_pdf_surface_t		*surface,
                                     cairo_scaled_font_subset_t	*font_subset,
@@ -5820,62 +5773,14 @@ _cairo_pdf_surface_emit_type1_font (cairo_pdf_surface_t		*surface,
 }
 
 static cairo_int_status_t
-_cairo_pdf_surface_emit_type1_font_subset (cairo_pdf_surface_t		*surface,
-					   cairo_scaled_font_subset_t	*font_subset)
-{
-    cairo_int_status_t status;
-    cairo_type1_subset_t subset;
-    char name[64];
-
-    /* 16-bit glyphs not compatible with Type 1 fonts */
-    if (font_subset->is_composite && !font_subset->is_latin)
-	return CAIRO_INT_STATUS_UNSUPPORTED;
-
-    snprintf (name, sizeof name, "CairoFont-%d-%d",
-	      font_subset->font_id, font_subset->subset_id);
-    status = _cairo_type1_subset_init (&subset, name, font_subset, FALSE);
-    if (unlikely (status))
-	return status;
-
-    status = _cairo_pdf_surface_emit_type1_font (surface, font_subset, &subset);
-
-    _cairo_type1_subset_fini (&subset);
-    return status;
-}
-
-static cairo_int_status_t
-_cairo_pdf_surface_emit_type1_fallback_font (cairo_pdf_surface_t	*surface,
-                                             cairo_scaled_font_subset_t	*font_subset)
-{
-    cairo_int_status_t status;
-    cairo_type1_subset_t subset;
-    char name[64];
-
-    /* 16-bit glyphs not compatible with Type 1 fonts */
-    if (font_subset->is_composite && !font_subset->is_latin)
-	return CAIRO_INT_STATUS_UNSUPPORTED;
-
-    snprintf (name, sizeof name, "CairoFont-%d-%d",
-	      font_subset->font_id, font_subset->subset_id);
-    status = _cairo_type1_fallback_init_binary (&subset, name, font_subset);
-    if (unlikely (status))
-	return status;
-
-    status = _cairo_pdf_surface_emit_type1_font (surface, font_subset, &subset);
-
-    _cairo_type1_fallback_fini (&subset);
-    return status;
-}
-
-static cairo_int_status_t
-_cairo_pdf_surface_emit_truetype_font_subset (cairo_pdf_surface_t		*surface,
-					      cairo_scaled_font_subset_t	*font_subset)
+_cairo_pdf_surface_emit_truetype_font (cairo_pdf_surface_t		*surface,
+				       cairo_scaled_font_subset_t	*font_subset,
+				       cairo_truetype_subset_t		*subset)
 {
     cairo_pdf_resource_t stream, descriptor, cidfont_dict;
     cairo_pdf_resource_t subset_resource, to_unicode_stream;
     cairo_int_status_t status;
     cairo_pdf_font_t font;
-    cairo_truetype_subset_t subset;
     unsigned int i, last_glyph;
     char tag[10];
 
@@ -5885,44 +5790,32 @@ _cairo_pdf_surface_emit_truetype_font_subset (cairo_pdf_surface_t		*surface,
     if (subset_resource.id == 0)
 	return CAIRO_STATUS_SUCCESS;
 
-    status = _cairo_truetype_subset_init_pdf (&subset, font_subset);
-    if (unlikely (status))
-	return status;
-
-    _create_font_subset_tag (font_subset, subset.ps_name, tag);
+    _create_font_subset_tag (font_subset, subset->ps_name, tag);
 
     status = _cairo_pdf_surface_open_stream (surface,
 					     NULL,
 					     TRUE,
 					     "   /Length1 %lu\n",
-					     subset.data_length);
-    if (unlikely (status)) {
-	_cairo_truetype_subset_fini (&subset);
+					     subset->data_length);
+    if (unlikely (status))
 	return status;
-    }
 
     stream = surface->pdf_stream.self;
     _cairo_output_stream_write (surface->output,
-				subset.data, subset.data_length);
+				subset->data, subset->data_length);
     status = _cairo_pdf_surface_close_stream (surface);
-    if (unlikely (status)) {
-	_cairo_truetype_subset_fini (&subset);
+    if (unlikely (status))
 	return status;
-    }
 
     status = _cairo_pdf_surface_emit_to_unicode_stream (surface,
 	                                                font_subset,
 							&to_unicode_stream);
-    if (_cairo_int_status_is_error (status)) {
-	_cairo_truetype_subset_fini (&subset);
+    if (_cairo_int_status_is_error (status))
 	return status;
-    }
 
     descriptor = _cairo_pdf_surface_new_object (surface);
-    if (descriptor.id == 0) {
-	_cairo_truetype_subset_fini (&subset);
+    if (descriptor.id == 0)
 	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
-    }
 
     _cairo_output_stream_printf (surface->output,
 				 "%d 0 obj\n"
@@ -5930,12 +5823,12 @@ _cairo_pdf_surface_emit_truetype_font_subset (cairo_pdf_surface_t		*surface,
 				 "   /FontName /%s+%s\n",
 				 descriptor.id,
 				 tag,
-				 subset.ps_name);
+				 subset->ps_name);
 
-    if (subset.family_name_utf8) {
+    if (subset->family_name_utf8) {
 	char *pdf_str;
 
-	status = _cairo_utf8_to_pdf_string (subset.family_name_utf8, &pdf_str);
+	status = _cairo_utf8_to_pdf_string (subset->family_name_utf8, &pdf_str);
 	if (likely (status == CAIRO_INT_STATUS_SUCCESS)) {
 	    _cairo_output_stream_printf (surface->output,
 					 "   /FontFamily %s\n",
@@ -5959,13 +5852,13 @@ _cairo_pdf_surface_emit_truetype_font_subset (cairo_pdf_surface_t		*surface,
 				 ">>\n"
 				 "endobj\n",
 				 font_subset->is_latin ? 32 : 4,
-				 (long)(subset.x_min*PDF_UNITS_PER_EM),
-				 (long)(subset.y_min*PDF_UNITS_PER_EM),
-                                 (long)(subset.x_max*PDF_UNITS_PER_EM),
-				 (long)(subset.y_max*PDF_UNITS_PER_EM),
-				 (long)(subset.ascent*PDF_UNITS_PER_EM),
-				 (long)(subset.descent*PDF_UNITS_PER_EM),
-				 (long)(subset.y_max*PDF_UNITS_PER_EM),
+				 (long)(subset->x_min*PDF_UNITS_PER_EM),
+				 (long)(subset->y_min*PDF_UNITS_PER_EM),
+                                 (long)(subset->x_max*PDF_UNITS_PER_EM),
+				 (long)(subset->y_max*PDF_UNITS_PER_EM),
+				 (long)(subset->ascent*PDF_UNITS_PER_EM),
+				 (long)(subset->descent*PDF_UNITS_PER_EM),
+				 (long)(subset->y_max*PDF_UNITS_PER_EM),
 				 stream.id);
 
     if (font_subset->is_latin) {
@@ -5988,7 +5881,7 @@ _cairo_pdf_surface_emit_truetype_font_subset (cairo_pdf_surface_t		*surface,
 				     "   /Widths [",
 				     subset_resource.id,
 				     tag,
-				     subset.ps_name,
+				     subset->ps_name,
 				     last_glyph,
 				     descriptor.id);
 
@@ -5997,7 +5890,7 @@ _cairo_pdf_surface_emit_truetype_font_subset (cairo_pdf_surface_t		*surface,
 	    if (glyph > 0) {
 		_cairo_output_stream_printf (surface->output,
 					     " %ld",
-					     (long)(subset.widths[glyph]*PDF_UNITS_PER_EM));
+					     (long)(subset->widths[glyph]*PDF_UNITS_PER_EM));
 	    } else {
 		_cairo_output_stream_printf (surface->output, " 0");
 	    }
@@ -6016,10 +5909,8 @@ _cairo_pdf_surface_emit_truetype_font_subset (cairo_pdf_surface_t		*surface,
 				     "endobj\n");
     } else {
 	cidfont_dict = _cairo_pdf_surface_new_object (surface);
-	if (cidfont_dict.id == 0) {
-	    _cairo_truetype_subset_fini (&subset);
+	if (cidfont_dict.id == 0)
 	    return _cairo_error (CAIRO_STATUS_NO_MEMORY);
-	}
 
 	_cairo_output_stream_printf (surface->output,
 				     "%d 0 obj\n"
@@ -6035,13 +5926,13 @@ _cairo_pdf_surface_emit_truetype_font_subset (cairo_pdf_surface_t		*surface,
 				     "   /W [0 [",
 				     cidfont_dict.id,
 				     tag,
-				     subset.ps_name,
+				     subset->ps_name,
 				     descriptor.id);
 
 	for (i = 0; i < font_subset->num_glyphs; i++)
 	    _cairo_output_stream_printf (surface->output,
 					 " %ld",
-					 (long)(subset.widths[i]*PDF_UNITS_PER_EM));
+					 (long)(subset->widths[i]*PDF_UNITS_PER_EM));
 
 	_cairo_output_stream_printf (surface->output,
 				     " ]]\n"
@@ -6058,7 +5949,7 @@ _cairo_pdf_surface_emit_truetype_font_subset (cairo_pdf_surface_t		*surface,
 				     "   /DescendantFonts [ %d 0 R]\n",
 				     subset_resource.id,
 				     tag,
-				     subset.ps_name,
+				     subset->ps_name,
 				     cidfont_dict.id);
 
 	if (to_unicode_stream.id != 0)
@@ -6074,11 +5965,7 @@ _cairo_pdf_surface_emit_truetype_font_subset (cairo_pdf_surface_t		*surface,
     font.font_id = font_subset->font_id;
     font.subset_id = font_subset->subset_id;
     font.subset_resource = subset_resource;
-    status = _cairo_array_append (&surface->fonts, &font);
-
-    _cairo_truetype_subset_fini (&subset);
-
-    return status;
+    return _cairo_array_append (&surface->fonts, &font);
 }
 
 static cairo_int_status_t
@@ -6348,37 +6235,157 @@ _cairo_pdf_surface_emit_type3_font_subset (cairo_pdf_surface_t		*surface,
     return _cairo_array_append (&surface->fonts, &font);
 }
 
+typedef enum {
+    CAIRO_PDF_FONT_SUBSET_NONE,
+    CAIRO_PDF_FONT_SUBSET_CFF,
+    CAIRO_PDF_FONT_SUBSET_CFF_FALLBACK,
+    CAIRO_PDF_FONT_SUBSET_TRUETYPE,
+    CAIRO_PDF_FONT_SUBSET_TYPE1,
+    CAIRO_PDF_FONT_SUBSET_TYPE1_FALLBACK
+} cairo_pdf_font_subset_type_t;
+
+typedef struct _cairo_pdf_font_subset_data {
+    cairo_pdf_font_subset_type_t type;
+    union {
+	cairo_cff_subset_t cff;
+	cairo_truetype_subset_t truetype;
+	cairo_type1_subset_t type1;
+    } u;
+} cairo_pdf_font_subset_data_t;
+
+/* Runs the font subsetters, in order of preference, on a worker
+ * thread. Nothing is written to the surface here; the subsets are
+ * emitted in order afterwards by _cairo_pdf_surface_emit_unscaled_font_subset().
+ */
 static cairo_int_status_t
-_cairo_pdf_surface_emit_unscaled_font_subset (cairo_scaled_font_subset_t *font_subset,
-                                              void			 *closure)
+_cairo_pdf_surface_prepare_unscaled_font_subset (cairo_scaled_font_subset_t *font_subset,
+						 void			    *closure,
+						 void			   **prepared)
 {
     cairo_pdf_surface_t *surface = closure;
+    cairo_pdf_font_subset_data_t *data;
+    cairo_pdf_resource_t subset_resource;
     cairo_int_status_t status;
+    char name[64];
 
-    status = _cairo_pdf_surface_emit_cff_font_subset (surface, font_subset);
-    if (status != CAIRO_INT_STATUS_UNSUPPORTED)
-	return status;
+    data = _cairo_malloc (sizeof (cairo_pdf_font_subset_data_t));
+    if (unlikely (data == NULL))
+	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
 
-    status = _cairo_pdf_surface_emit_truetype_font_subset (surface, font_subset);
-    if (status != CAIRO_INT_STATUS_UNSUPPORTED)
-	return status;
+    *prepared = data;
+    data->type = CAIRO_PDF_FONT_SUBSET_NONE;
 
-    status = _cairo_pdf_surface_emit_type1_font_subset (surface, font_subset);
-    if (status != CAIRO_INT_STATUS_UNSUPPORTED)
-	return status;
+    /* surface->fonts is only appended to between batches of subsets */
+    subset_resource = _cairo_pdf_surface_get_font_resource (surface,
+							    font_subset->font_id,
+							    font_subset->subset_id);
+    if (subset_resource.id == 0)
+	return CAIRO_STATUS_SUCCESS;
 
-    status = _cairo_pdf_surface_emit_cff_fallback_font (surface, font_subset);
-    if (status != CAIRO_INT_STATUS_UNSUPPORTED)
+    snprintf (name, sizeof name, "CairoFont-%d-%d",
+	      font_subset->font_id, font_subset->subset_id);
+
+    status = _cairo_cff_subset_init (&data->u.cff, name, font_subset);
+    if (status != CAIRO_INT_STATUS_UNSUPPORTED) {
+	if (status == CAIRO_INT_STATUS_SUCCESS)
+	    data->type = CAIRO_PDF_FONT_SUBSET_CFF;
 	return status;
+    }
 
-    status = _cairo_pdf_surface_emit_type1_fallback_font (surface, font_subset);
-    if (status != CAIRO_INT_STATUS_UNSUPPORTED)
+    status = _cairo_truetype_subset_init_pdf (&data->u.truetype, font_subset);
+    if (status != CAIRO_INT_STATUS_UNSUPPORTED) {
+	if (status == CAIRO_INT_STATUS_SUCCESS)
+	    data->type = CAIRO_PDF_FONT_SUBSET_TRUETYPE;
 	return status;
+    }
+
+    /* 16-bit glyphs not compatible with Type 1 fonts */
+    if (! font_subset->is_composite || font_subset->is_latin) {
+	status = _cairo_type1_subset_init (&data->u.type1, name, font_subset, FALSE);
+	if (status != CAIRO_INT_STATUS_UNSUPPORTED) {
+	    if (status == CAIRO_INT_STATUS_SUCCESS)
+		data->type = CAIRO_PDF_FONT_SUBSET_TYPE1;
+	    return status;
+	}
+    }
+
+    /* CFF fallback subsetting does not work with 8-bit glyphs unless
+     * they are a latin subset */
+    if (font_subset->is_composite || font_subset->is_latin) {
+	status = _cairo_cff_fallback_init (&data->u.cff, name, font_subset);
+	if (status != CAIRO_INT_STATUS_UNSUPPORTED) {
+	    if (status == CAIRO_INT_STATUS_SUCCESS)
+		data->type = CAIRO_PDF_FONT_SUBSET_CFF_FALLBACK;
+	    return status;
+	}
+    }
+
+    if (! font_subset->is_composite || font_subset->is_latin) {
+	status = _cairo_type1_fallback_init_binary (&data->u.type1, name, font_subset);
+	if (status != CAIRO_INT_STATUS_UNSUPPORTED) {
+	    if (status == CAIRO_INT_STATUS_SUCCESS)
+		data->type = CAIRO_PDF_FONT_SUBSET_TYPE1_FALLBACK;
+	    return status;
+	}
+    }
+
+    ASSERT_NOT_REACHED;
+    return CAIRO_INT_STATUS_SUCCESS;
+}
+
+static cairo_int_status_t
+_cairo_pdf_surface_emit_unscaled_font_subset (cairo_scaled_font_subset_t *font_subset,
+					      void			 *prepared,
+					      void			 *closure)
+{
+    cairo_pdf_surface_t *surface = closure;
+    cairo_pdf_font_subset_data_t *data = prepared;
+
+    switch (data->type) {
+    case CAIRO_PDF_FONT_SUBSET_NONE:
+	return CAIRO_STATUS_SUCCESS;
+    case CAIRO_PDF_FONT_SUBSET_CFF:
+    case CAIRO_PDF_FONT_SUBSET_CFF_FALLBACK:
+	return _cairo_pdf_surface_emit_cff_font (surface, font_subset, &data->u.cff);
+    case CAIRO_PDF_FONT_SUBSET_TRUETYPE:
+	return _cairo_pdf_surface_emit_truetype_font (surface, font_subset, &data->u.truetype);
+    case CAIRO_PDF_FONT_SUBSET_TYPE1:
+    case CAIRO_PDF_FONT_SUBSET_TYPE1_FALLBACK:
+	return _cairo_pdf_surface_emit_type1_font (surface, font_subset, &data->u.type1);
+    }
 
     ASSERT_NOT_REACHED;
     return CAIRO_INT_STATUS_SUCCESS;
 }
 
+static void
+_cairo_pdf_font_subset_data_destroy (void *prepared)
+{
+    cairo_pdf_font_subset_data_t *data = prepared;
+
+    switch (data->type) {
+    case CAIRO_PDF_FONT_SUBSET_NONE:
+	break;
+    case CAIRO_PDF_FONT_SUBSET_CFF:
+	_cairo_cff_subset_fini (&data->u.cff);
+	break;
+    case CAIRO_PDF_FONT_SUBSET_CFF_FALLBACK:
+	_cairo_cff_fallback_fini (&data->u.cff);
+	break;
+    case CAIRO_PDF_FONT_SUBSET_TRUETYPE:
+	_cairo_truetype_subset_fini (&data->u.truetype);
+	break;
+    case CAIRO_PDF_FONT_SUBSET_TYPE1:
+	_cairo_type1_subset_fini (&data->u.type1);
+	break;
+    case CAIRO_PDF_FONT_SUBSET_TYPE1_FALLBACK:
+	_cairo_type1_fallback_fini (&data->u.type1);
+	break;
+    }
+
+    free (data);
+}
+
 static cairo_int_status_t
 _cairo_pdf_surface_emit_scaled_font_subset (cairo_scaled_font_subset_t *font_subset,
                                             void		       *closure)
@@ -6405,9 +6412,11 @@ _cairo_pdf_surface_emit_font_subsets (cairo_pdf_surface_t *surface)
     if (unlikely (status))
 	goto BAIL;
 
-    status = _cairo_scaled_font_subsets_foreach_unscaled (surface->font_subsets,
-                                                          _cairo_pdf_surface_emit_unscaled_font_subset,
-                                                          surface);
+    status = _cairo_scaled_font_subsets_foreach_unscaled_parallel (surface->font_subsets,
+								   _cairo_pdf_surface_prepare_unscaled_font_subset,
+								   _cairo_pdf_surface_emit_unscaled_font_subset,
+								   _cairo_pdf_font_subset_data_destroy,
+								   surface);
     if (unlikely (status))
 	goto BAIL;
 
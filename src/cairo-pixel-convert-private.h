@@ -0,0 +1,85 @@
+/* -*- Mode: c; tab-width: 8; c-basic-offset: 4; indent-tabs-mode: t; -*- */
+/* cairo - a vector graphics library with display and print output
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it either under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * (the "LGPL") or, at your option, under the terms of the Mozilla
+ * Public License Version 1.1 (the "MPL"). If you do not alter this
+ * notice, a recipient may use your version of this file under either
+ * the MPL or the LGPL.
+ *
+ * You should have received a copy of the LGPL along with this library
+ * in the file COPYING-LGPL-2.1; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA
+ * You should have received a copy of the MPL along with this library
+ * in the file COPYING-MPL-1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.1 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY
+ * OF ANY KIND, either express or implied. See the LGPL or the MPL for
+ * the specific language governing rights and limitations.
+ *
+ * The Original Code is the cairo graphics library.
+ */
+
+#ifndef CAIRO_PIXEL_CONVERT_PRIVATE_H
+#define CAIRO_PIXEL_CONVERT_PRIVATE_H
+
+#include "cairo-compiler-private.h"
+#include "cairo-wideint-type-private.h"
+
+CAIRO_BEGIN_DECLS
+
+/* Row conversions between cairo's pixel formats and the byte layouts
+ * used by image codecs.  Each function converts @width pixels; unless
+ * noted otherwise @dst may be the same buffer as @src.
+ *
+ * The implementation is chosen once, on first use, from the SIMD
+ * instruction sets available at run time (SSE2 and AVX2 on x86, NEON
+ * on ARM).  Setting the environment variable CAIRO_DISABLE_SIMD forces
+ * the portable C versions.  All implementations produce identical
+ * results.
+ */
+
+/* native endian premultiplied ARGB32 => unpremultiplied RGBA bytes */
+cairo_private void
+_cairo_pixel_unpremultiply_argb32 (uint8_t *dst, const uint8_t *src, unsigned int width);
+
+/* unpremultiplied RGBA bytes => native endian premultiplied ARGB32 */
+cairo_private void
+_cairo_pixel_premultiply_rgba (uint8_t *dst, const uint8_t *src, unsigned int width);
+
+/* RGBx bytes => native endian xRGB32, with the x set to 0xff */
+cairo_private void
+_cairo_pixel_rgbx_to_xrgb32 (uint8_t *dst, const uint8_t *src, unsigned int width);
+
+/* native endian xRGB32 => RGBx bytes, with the x set to 0 */
+cairo_private void
+_cairo_pixel_xrgb32_to_rgbx (uint8_t *dst, const uint8_t *src, unsigned int width);
+
+/* premultiplied RGBA128F => unpremultiplied 16-bit RGBA; must not overlap */
+cairo_private void
+_cairo_pixel_unpremultiply_rgbaf (uint16_t *dst, const float *src, unsigned int width);
+
+/* RGB96F => 16-bit RGBx, with the x set to 0; must not overlap */
+cairo_private void
+_cairo_pixel_rgbf_to_rgbx16 (uint16_t *dst, const float *src, unsigned int width);
+
+/* unpremultiplied 16-bit RGBA => premultiplied RGBA128F.  The row is
+ * converted from its end, so @dst may start at the same address as
+ * @src to expand the row in place. */
+cairo_private void
+_cairo_pixel_premultiply_rgba16 (float *dst, const uint16_t *src, unsigned int width);
+
+/* 16-bit RGBx => RGB96F, expanding in place like the above */
+cairo_private void
+_cairo_pixel_rgbx16_to_rgbf (float *dst, const uint16_t *src, unsigned int width);
+
+CAIRO_END_DECLS
+
+#endif /* CAIRO_PIXEL_CONVERT_PRIVATE_H */
@@ -0,0 +1,924 @@
+/* -*- Mode: c; tab-width: 8; c-basic-offset: 4; indent-tabs-mode: t; -*- */
+/* cairo - a vector graphics library with display and print output
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it either under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * (the "LGPL") or, at your option, under the terms of the Mozilla
+ * Public License Version 1.1 (the "MPL"). If you do not alter this
+ * notice, a recipient may use your version of this file under either
+ * the MPL or the LGPL.
+ *
+ * You should have received a copy of the LGPL along with this library
+ * in the file COPYING-LGPL-2.1; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA
+ * You should have received a copy of the MPL along with this library
+ * in the file COPYING-MPL-1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.1 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY
+ * OF ANY KIND, either express or implied. See the LGPL or the MPL for
+ * the specific language governing rights and limitations.
+ *
+ * The Original Code is the cairo graphics library.
+ */
+
+#include "cairoint.h"
+
+#include "cairo-atomic-private.h"
+#include "cairo-pixel-convert-private.h"
+
+#if defined(__SSE2__)
+#define CAIRO_PIXEL_HAS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+/* AVX2 is only compiled in where the compiler can target it per
+ * function, so that the library itself still runs on any x86. */
+#if CAIRO_PIXEL_HAS_SSE2 && defined(__GNUC__) && \
+    (defined(__x86_64__) || defined(__i386__)) && \
+    (__GNUC__ >= 5 || defined(__clang__))
+#define CAIRO_PIXEL_HAS_AVX2 1
+#include <immintrin.h>
+#define CAIRO_TARGET_AVX2 __attribute__((target ("avx2")))
+#endif
+
+#if (defined(__ARM_NEON) || defined(__ARM_NEON__)) && !defined(WORDS_BIGENDIAN)
+#define CAIRO_PIXEL_HAS_NEON 1
+#include <arm_neon.h>
+#endif
+
+typedef struct _cairo_pixel_convert_funcs {
+    void (*unpremultiply_argb32) (uint8_t *dst, const uint8_t *src, unsigned int width);
+    void (*premultiply_rgba) (uint8_t *dst, const uint8_t *src, unsigned int width);
+    void (*rgbx_to_xrgb32) (uint8_t *dst, const uint8_t *src, unsigned int width);
+    void (*xrgb32_to_rgbx) (uint8_t *dst, const uint8_t *src, unsigned int width);
+    void (*unpremultiply_rgbaf) (uint16_t *dst, const float *src, unsigned int width);
+    void (*rgbf_to_rgbx16) (uint16_t *dst, const float *src, unsigned int width);
+    void (*premultiply_rgba16) (float *dst, const uint16_t *src, unsigned int width);
+    void (*rgbx16_to_rgbf) (float *dst, const uint16_t *src, unsigned int width);
+} cairo_pixel_convert_funcs_t;
+
+/* ceil(2^24 / alpha): for any x < 2^16, (x * r) >> 24 == x / alpha,
+ * which covers every (color * 255 + alpha / 2) of a premultiplied pixel.
+ */
+static const uint32_t unpremultiply_reciprocal[256] = {
+    0x0000000, 0x1000000, 0x0800000, 0x0555556, 0x0400000, 0x0333334,
+    0x02aaaab, 0x024924a, 0x0200000, 0x01c71c8, 0x019999a, 0x01745d2,
+    0x0155556, 0x013b13c, 0x0124925, 0x0111112, 0x0100000, 0x00f0f10,
+    0x00e38e4, 0x00d7944, 0x00ccccd, 0x00c30c4, 0x00ba2e9, 0x00b2165,
+    0x00aaaab, 0x00a3d71, 0x009d89e, 0x0097b43, 0x0092493, 0x008d3dd,
+    0x0088889, 0x0084211, 0x0080000, 0x007c1f1, 0x0078788, 0x0075076,
+    0x0071c72, 0x006eb3f, 0x006bca2, 0x006906a, 0x0066667, 0x0063e71,
+    0x0061862, 0x005f418, 0x005d175, 0x005b05c, 0x00590b3, 0x0057263,
+    0x0055556, 0x0053979, 0x0051eb9, 0x0050506, 0x004ec4f, 0x004d488,
+    0x004bda2, 0x004a791, 0x004924a, 0x0047dc2, 0x00469ef, 0x00456c8,
+    0x0044445, 0x004325d, 0x0042109, 0x0041042, 0x0040000, 0x003f040,
+    0x003e0f9, 0x003d227, 0x003c3c4, 0x003b5cd, 0x003a83b, 0x0039b0b,
+    0x0038e39, 0x00381c1, 0x00375a0, 0x00369d1, 0x0035e51, 0x003531e,
+    0x0034835, 0x0033d92, 0x0033334, 0x0032917, 0x0031f39, 0x0031598,
+    0x0030c31, 0x0030304, 0x002fa0c, 0x002f14a, 0x002e8bb, 0x002e05d,
+    0x002d82e, 0x002d02e, 0x002c85a, 0x002c0b1, 0x002b932, 0x002b1db,
+    0x002aaab, 0x002a3a1, 0x0029cbd, 0x00295fb, 0x0028f5d, 0x00288e0,
+    0x0028283, 0x0027c46, 0x0027628, 0x0027028, 0x0026a44, 0x002647d,
+    0x0025ed1, 0x0025940, 0x00253c9, 0x0024e6b, 0x0024925, 0x00243f7,
+    0x0023ee1, 0x00239e1, 0x00234f8, 0x0023024, 0x0022b64, 0x00226ba,
+    0x0022223, 0x0021d9f, 0x002192f, 0x00214d1, 0x0021085, 0x0020c4a,
+    0x0020821, 0x0020409, 0x0020000, 0x001fc08, 0x001f820, 0x001f447,
+    0x001f07d, 0x001ecc1, 0x001e914, 0x001e574, 0x001e1e2, 0x001de5e,
+    0x001dae7, 0x001d77c, 0x001d41e, 0x001d0cc, 0x001cd86, 0x001ca4c,
+    0x001c71d, 0x001c3f9, 0x001c0e1, 0x001bdd3, 0x001bad0, 0x001b7d7,
+    0x001b4e9, 0x001b204, 0x001af29, 0x001ac58, 0x001a98f, 0x001a6d1,
+    0x001a41b, 0x001a16e, 0x0019ec9, 0x0019c2e, 0x001999a, 0x001970f,
+    0x001948c, 0x0019210, 0x0018f9d, 0x0018d31, 0x0018acc, 0x001886f,
+    0x0018619, 0x00183ca, 0x0018182, 0x0017f41, 0x0017d06, 0x0017ad3,
+    0x00178a5, 0x001767e, 0x001745e, 0x0017243, 0x001702f, 0x0016e20,
+    0x0016c17, 0x0016a14, 0x0016817, 0x001661f, 0x001642d, 0x0016240,
+    0x0016059, 0x0015e76, 0x0015c99, 0x0015ac1, 0x00158ee, 0x001571f,
+    0x0015556, 0x0015391, 0x00151d1, 0x0015016, 0x0014e5f, 0x0014cac,
+    0x0014afe, 0x0014954, 0x00147af, 0x001460d, 0x0014470, 0x00142d7,
+    0x0014142, 0x0013fb1, 0x0013e23, 0x0013c9a, 0x0013b14, 0x0013992,
+    0x0013814, 0x0013699, 0x0013522, 0x00133af, 0x001323f, 0x00130d2,
+    0x0012f69, 0x0012e03, 0x0012ca0, 0x0012b41, 0x00129e5, 0x001288c,
+    0x0012736, 0x00125e3, 0x0012493, 0x0012346, 0x00121fc, 0x00120b5,
+    0x0011f71, 0x0011e2f, 0x0011cf1, 0x0011bb5, 0x0011a7c, 0x0011946,
+    0x0011812, 0x00116e1, 0x00115b2, 0x0011486, 0x001135d, 0x0011236,
+    0x0011112, 0x0010ff0, 0x0010ed0, 0x0010db3, 0x0010c98, 0x0010b7f,
+    0x0010a69, 0x0010954, 0x0010843, 0x0010733, 0x0010625, 0x001051a,
+    0x0010411, 0x001030a, 0x0010205, 0x0010102
+};
+
+/* C implementations */
+
+static inline uint32_t
+unpremultiply_pixel (uint32_t pixel)
+{
+    uint32_t alpha = pixel >> 24;
+    uint64_t r;
+
+    if (alpha == 0)
+	return 0;
+    if (alpha == 0xff)
+	return (pixel & 0xff00ff00) |
+	       ((pixel >> 16) & 0xff) |
+	       ((pixel & 0xff) << 16);
+
+    /* out of range colors wrap around, as they always have */
+    r = unpremultiply_reciprocal[alpha];
+    return (alpha << 24) |
+	   ((uint32_t) (((((pixel >>  0) & 0xff) * 255 + alpha / 2) * r) >> 24) & 0xff) << 16 |
+	   ((uint32_t) (((((pixel >>  8) & 0xff) * 255 + alpha / 2) * r) >> 24) & 0xff) <<  8 |
+	   ((uint32_t) (((((pixel >> 16) & 0xff) * 255 + alpha / 2) * r) >> 24) & 0xff) <<  0;
+}
+
+static inline uint32_t
+to_bytes (uint32_t pixel)
+{
+#ifdef WORDS_BIGENDIAN
+    pixel = bswap_32 (pixel);
+#endif
+    return pixel;
+}
+
+static void
+unpremultiply_argb32_c (uint8_t *dst, const uint8_t *src, unsigned int width)
+{
+    unsigned int i;
+
+    for (i = 0; i < width; i++) {
+	uint32_t pixel;
+
+	memcpy (&pixel, src + 4 * i, sizeof (uint32_t));
+	pixel = to_bytes (unpremultiply_pixel (pixel));
+	memcpy (dst + 4 * i, &pixel, sizeof (uint32_t));
+    }
+}
+
+static inline int
+multiply_alpha (int alpha, int color)
+{
+    int temp = (alpha * color) + 0x80;
+    return ((temp + (temp >> 8)) >> 8);
+}
+
+static void
+premultiply_rgba_c (uint8_t *dst, const uint8_t *src, unsigned int width)
+{
+    unsigned int i;
+
+    for (i = 0; i < width; i++) {
+	const uint8_t *base = &src[4 * i];
+	uint8_t  alpha = base[3];
+	uint32_t p;
+
+	if (alpha == 0) {
+	    p = 0;
+	} else {
+	    uint8_t  red   = base[0];
+	    uint8_t  green = base[1];
+	    uint8_t  blue  = base[2];
+
+	    if (alpha != 0xff) {
+		red   = multiply_alpha (alpha, red);
+		green = multiply_alpha (alpha, green);
+		blue  = multiply_alpha (alpha, blue);
+	    }
+	    p = ((uint32_t) alpha << 24) | (red << 16) | (green << 8) | (blue << 0);
+	}
+	memcpy (dst + 4 * i, &p, sizeof (uint32_t));
+    }
+}
+
+static void
+rgbx_to_xrgb32_c (uint8_t *dst, const uint8_t *src, unsigned int width)
+{
+    unsigned int i;
+
+    for (i = 0; i < width; i++) {
+	const uint8_t *base = &src[4 * i];
+	uint32_t pixel;
+
+	pixel = (0xffu << 24) | (base[0] << 16) | (base[1] << 8) | (base[2] << 0);
+	memcpy (dst + 4 * i, &pixel, sizeof (uint32_t));
+    }
+}
+
+static void
+xrgb32_to_rgbx_c (uint8_t *dst, const uint8_t *src, unsigned int width)
+{
+    unsigned int i;
+
+    for (i = 0; i < width; i++) {
+	uint8_t *b = &dst[4 * i];
+	uint32_t pixel;
+
+	memcpy (&pixel, src + 4 * i, sizeof (uint32_t));
+
+	b[0] = (pixel & 0xff0000) >> 16;
+	b[1] = (pixel & 0x00ff00) >>  8;
+	b[2] = (pixel & 0x0000ff) >>  0;
+	b[3] = 0;
+    }
+}
+
+static inline uint16_t
+f_to_u16 (float val)
+{
+    if (val < 0)
+	return 0;
+    else if (val > 1)
+	return 65535;
+    else
+	return (uint16_t)(val * 65535.f);
+}
+
+static void
+unpremultiply_rgbaf_c (uint16_t *d16, const float *f, unsigned int width)
+{
+    unsigned int i;
+
+    for (i = 0; i < width; i++) {
+	float r, g, b, a;
+
+	r = *f++;
+	g = *f++;
+	b = *f++;
+	a = *f++;
+
+	if (a > 0) {
+	    *d16++ = f_to_u16 (r / a);
+	    *d16++ = f_to_u16 (g / a);
+	    *d16++ = f_to_u16 (b / a);
+	    *d16++ = f_to_u16 (a);
+	} else {
+	    *d16++ = 0;
+	    *d16++ = 0;
+	    *d16++ = 0;
+	    *d16++ = 0;
+	}
+    }
+}
+
+static void
+rgbf_to_rgbx16_c (uint16_t *d16, const float *f, unsigned int width)
+{
+    unsigned int i;
+
+    for (i = 0; i < width; i++) {
+	*d16++ = f_to_u16 (*f++);
+	*d16++ = f_to_u16 (*f++);
+	*d16++ = f_to_u16 (*f++);
+	*d16++ = 0;
+    }
+}
+
+static void
+premultiply_rgba16_c (float *f, const uint16_t *d16, unsigned int width)
+{
+    unsigned int i = width;
+
+    while (i--) {
+	float a = d16[i * 4 + 3] / 65535.f;
+
+	f[i * 4 + 3] = a;
+	f[i * 4 + 2] = (float)d16[i * 4 + 2] / 65535.f * a;
+	f[i * 4 + 1] = (float)d16[i * 4 + 1] / 65535.f * a;
+	f[i * 4] = (float)d16[i * 4] / 65535.f * a;
+    }
+}
+
+static void
+rgbx16_to_rgbf_c (float *f, const uint16_t *d16, unsigned int width)
+{
+    unsigned int i = width;
+
+    while (i--) {
+	f[i * 3 + 2] = (float)d16[i * 4 + 2] / 65535.f;
+	f[i * 3 + 1] = (float)d16[i * 4 + 1] / 65535.f;
+	f[i * 3] = (float)d16[i * 4] / 65535.f;
+    }
+}
+
+static const cairo_pixel_convert_funcs_t c_funcs = {
+    unpremultiply_argb32_c,
+    premultiply_rgba_c,
+    rgbx_to_xrgb32_c,
+    xrgb32_to_rgbx_c,
+    unpremultiply_rgbaf_c,
+    rgbf_to_rgbx16_c,
+    premultiply_rgba16_c,
+    rgbx16_to_rgbf_c,
+};
+
+#if CAIRO_PIXEL_HAS_SSE2
+
+/* Divides the 32-bit lanes of @x, each below 2^16, by the alphas whose
+ * reciprocals are in @recip, keeping the low byte (@mask) of the
+ * quotient. */
+static inline __m128i
+divide_sse2 (__m128i x, __m128i recip, __m128i mask)
+{
+    __m128i even, odd;
+
+    even = _mm_srli_epi64 (_mm_mul_epu32 (x, recip), 24);
+    odd = _mm_srli_epi64 (_mm_mul_epu32 (_mm_srli_epi64 (x, 32),
+					 _mm_srli_epi64 (recip, 32)), 24);
+    return _mm_and_si128 (_mm_or_si128 (even, _mm_slli_epi64 (odd, 32)), mask);
+}
+
+static inline __m128i
+unpremultiply_4_sse2 (__m128i p, __m128i a, __m128i mask)
+{
+    __m128i half, recip, r, g, b;
+    uint32_t alpha[4];
+
+    half = _mm_srli_epi32 (a, 1);
+
+    _mm_storeu_si128 ((__m128i *) alpha, a);
+    recip = _mm_setr_epi32 (unpremultiply_reciprocal[alpha[0]],
+			    unpremultiply_reciprocal[alpha[1]],
+			    unpremultiply_reciprocal[alpha[2]],
+			    unpremultiply_reciprocal[alpha[3]]);
+
+    /* c * 255 + alpha / 2 */
+    r = _mm_and_si128 (_mm_srli_epi32 (p, 16), mask);
+    r = divide_sse2 (_mm_add_epi32 (_mm_sub_epi32 (_mm_slli_epi32 (r, 8), r), half), recip, mask);
+    g = _mm_and_si128 (_mm_srli_epi32 (p, 8), mask);
+    g = divide_sse2 (_mm_add_epi32 (_mm_sub_epi32 (_mm_slli_epi32 (g, 8), g), half), recip, mask);
+    b = _mm_and_si128 (p, mask);
+    b = divide_sse2 (_mm_add_epi32 (_mm_sub_epi32 (_mm_slli_epi32 (b, 8), b), half), recip, mask);
+
+    return _mm_or_si128 (_mm_or_si128 (_mm_slli_epi32 (a, 24), _mm_slli_epi32 (b, 16)),
+			 _mm_or_si128 (_mm_slli_epi32 (g, 8), r));
+}
+
+/* Swaps the red and blue bytes of each pixel and ORs in @x */
+static inline __m128i
+swap_rb_sse2 (__m128i p, __m128i x)
+{
+    const __m128i rb = _mm_set1_epi32 (0x00ff00ff);
+    __m128i t;
+
+    t = _mm_and_si128 (p, rb);
+    t = _mm_shufflehi_epi16 (_mm_shufflelo_epi16 (t, _MM_SHUFFLE (2, 3, 0, 1)),
+			     _MM_SHUFFLE (2, 3, 0, 1));
+    return _mm_or_si128 (_mm_or_si128 (_mm_andnot_si128 (rb, p), x), t);
+}
+
+/* Runs of opaque or clear pixels, which make up most of a typical
+ * image, skip the division. */
+static void
+unpremultiply_argb32_sse2 (uint8_t *dst, const uint8_t *src, unsigned int width)
+{
+    const __m128i mask = _mm_set1_epi32 (0xff);
+    unsigned int i;
+
+    for (i = 0; i + 4 <= width; i += 4) {
+	__m128i p = _mm_loadu_si128 ((const __m128i *) (src + 4 * i));
+	__m128i a = _mm_srli_epi32 (p, 24);
+
+	if (_mm_movemask_epi8 (_mm_cmpeq_epi32 (a, mask)) == 0xffff)
+	    p = swap_rb_sse2 (p, _mm_setzero_si128 ());
+	else if (_mm_movemask_epi8 (_mm_cmpeq_epi32 (a, _mm_setzero_si128 ())) == 0xffff)
+	    p = _mm_setzero_si128 ();
+	else
+	    p = unpremultiply_4_sse2 (p, a, mask);
+	_mm_storeu_si128 ((__m128i *) (dst + 4 * i), p);
+    }
+
+    unpremultiply_argb32_c (dst + 4 * i, src + 4 * i, width - i);
+}
+
+/* (alpha * color + 0x80) / 255 on 16-bit lanes, exactly as
+ * multiply_alpha(), for two pixels unpacked to RGBA words; the alpha
+ * word is multiplied by 255 to keep it as it is.  The result is
+ * swizzled to BGRA, i.e. native endian ARGB32. */
+static inline __m128i
+premultiply_2_sse2 (__m128i c)
+{
+    __m128i a, t;
+
+    a = _mm_shufflehi_epi16 (_mm_shufflelo_epi16 (c, _MM_SHUFFLE (3, 3, 3, 3)),
+			     _MM_SHUFFLE (3, 3, 3, 3));
+    a = _mm_or_si128 (a, _mm_setr_epi16 (0, 0, 0, 0xff, 0, 0, 0, 0xff));
+
+    t = _mm_add_epi16 (_mm_mullo_epi16 (c, a), _mm_set1_epi16 (0x80));
+    t = _mm_srli_epi16 (_mm_add_epi16 (t, _mm_srli_epi16 (t, 8)), 8);
+
+    return _mm_shufflehi_epi16 (_mm_shufflelo_epi16 (t, _MM_SHUFFLE (3, 0, 1, 2)),
+				_MM_SHUFFLE (3, 0, 1, 2));
+}
+
+static void
+premultiply_rgba_sse2 (uint8_t *dst, const uint8_t *src, unsigned int width)
+{
+    const __m128i zero = _mm_setzero_si128 ();
+    unsigned int i;
+
+    for (i = 0; i + 4 <= width; i += 4) {
+	__m128i p = _mm_loadu_si128 ((const __m128i *) (src + 4 * i));
+
+	p = _mm_packus_epi16 (premultiply_2_sse2 (_mm_unpacklo_epi8 (p, zero)),
+			      premultiply_2_sse2 (_mm_unpackhi_epi8 (p, zero)));
+	_mm_storeu_si128 ((__m128i *) (dst + 4 * i), p);
+    }
+
+    premultiply_rgba_c (dst + 4 * i, src + 4 * i, width - i);
+}
+
+static void
+rgbx_to_xrgb32_sse2 (uint8_t *dst, const uint8_t *src, unsigned int width)
+{
+    const __m128i x = _mm_set1_epi32 (0xff000000);
+    unsigned int i;
+
+    for (i = 0; i + 4 <= width; i += 4) {
+	__m128i p = _mm_loadu_si128 ((const __m128i *) (src + 4 * i));
+
+	p = swap_rb_sse2 (_mm_and_si128 (p, _mm_set1_epi32 (0x00ffffff)), x);
+	_mm_storeu_si128 ((__m128i *) (dst + 4 * i), p);
+    }
+
+    rgbx_to_xrgb32_c (dst + 4 * i, src + 4 * i, width - i);
+}
+
+static void
+xrgb32_to_rgbx_sse2 (uint8_t *dst, const uint8_t *src, unsigned int width)
+{
+    unsigned int i;
+
+    for (i = 0; i + 4 <= width; i += 4) {
+	__m128i p = _mm_loadu_si128 ((const __m128i *) (src + 4 * i));
+
+	p = swap_rb_sse2 (_mm_and_si128 (p, _mm_set1_epi32 (0x00ffffff)),
+			  _mm_setzero_si128 ());
+	_mm_storeu_si128 ((__m128i *) (dst + 4 * i), p);
+    }
+
+    xrgb32_to_rgbx_c (dst + 4 * i, src + 4 * i, width - i);
+}
+
+/* f_to_u16() of each lane; @v must already be clamped to [0, 1] */
+static inline __m128i
+float_to_u16_sse2 (__m128 v)
+{
+    return _mm_cvttps_epi32 (_mm_mul_ps (v, _mm_set1_ps (65535.f)));
+}
+
+/* Packs two pixels of 32-bit lanes in [0, 65535] into 16 bits; SSE2
+ * only has a signed saturating pack, so bias the values around it. */
+static inline __m128i
+pack_u16_sse2 (__m128i lo, __m128i hi)
+{
+    const __m128i bias = _mm_set1_epi32 (0x8000);
+
+    return _mm_xor_si128 (_mm_packs_epi32 (_mm_sub_epi32 (lo, bias),
+					   _mm_sub_epi32 (hi, bias)),
+			  _mm_set1_epi16 ((short) 0x8000));
+}
+
+static inline __m128i
+unpremultiply_rgbaf_1_sse2 (const float *f)
+{
+    const __m128 alpha = _mm_castsi128_ps (_mm_setr_epi32 (0, 0, 0, -1));
+    const __m128 zero = _mm_setzero_ps ();
+    __m128 v, a, q;
+
+    v = _mm_loadu_ps (f);
+    a = _mm_shuffle_ps (v, v, _MM_SHUFFLE (3, 3, 3, 3));
+
+    q = _mm_div_ps (v, a);
+    q = _mm_or_ps (_mm_andnot_ps (alpha, q), _mm_and_ps (alpha, v));
+    q = _mm_min_ps (_mm_max_ps (q, zero), _mm_set1_ps (1.f));
+    q = _mm_and_ps (q, _mm_cmpgt_ps (a, zero));
+
+    return float_to_u16_sse2 (q);
+}
+
+static void
+unpremultiply_rgbaf_sse2 (uint16_t *d16, const float *f, unsigned int width)
+{
+    unsigned int i;
+
+    for (i = 0; i + 2 <= width; i += 2) {
+	__m128i p = pack_u16_sse2 (unpremultiply_rgbaf_1_sse2 (f + 4 * i),
+				   unpremultiply_rgbaf_1_sse2 (f + 4 * i + 4));
+	_mm_storeu_si128 ((__m128i *) (d16 + 4 * i), p);
+    }
+
+    unpremultiply_rgbaf_c (d16 + 4 * i, f + 4 * i, width - i);
+}
+
+static inline __m128i
+rgbf_to_rgbx16_1_sse2 (const float *f)
+{
+    const __m128 rgb = _mm_castsi128_ps (_mm_setr_epi32 (-1, -1, -1, 0));
+    __m128 v;
+
+    v = _mm_min_ps (_mm_max_ps (_mm_loadu_ps (f), _mm_setzero_ps ()),
+		    _mm_set1_ps (1.f));
+    return float_to_u16_sse2 (_mm_and_ps (v, rgb));
+}
+
+static void
+rgbf_to_rgbx16_sse2 (uint16_t *d16, const float *f, unsigned int width)
+{
+    unsigned int i;
+
+    /* Each load reads the red of the next pixel, so stop short of the
+     * last one. */
+    for (i = 0; i + 2 < width; i += 2) {
+	__m128i p = pack_u16_sse2 (rgbf_to_rgbx16_1_sse2 (f + 3 * i),
+				   rgbf_to_rgbx16_1_sse2 (f + 3 * i + 3));
+	_mm_storeu_si128 ((__m128i *) (d16 + 4 * i), p);
+    }
+
+    rgbf_to_rgbx16_c (d16 + 4 * i, f + 3 * i, width - i);
+}
+
+static void
+premultiply_rgba16_sse2 (float *f, const uint16_t *d16, unsigned int width)
+{
+    const __m128 alpha = _mm_castsi128_ps (_mm_setr_epi32 (0, 0, 0, -1));
+    const __m128 scale = _mm_set1_ps (65535.f);
+    unsigned int i = width;
+
+    /* One pixel at a time from the end, reading each before it is
+     * overwritten, as for the in place C version. */
+    while (i--) {
+	__m128i p = _mm_loadl_epi64 ((const __m128i *) (d16 + 4 * i));
+	__m128 v, a;
+
+	v = _mm_div_ps (_mm_cvtepi32_ps (_mm_unpacklo_epi16 (p, _mm_setzero_si128 ())),
+			scale);
+	a = _mm_shuffle_ps (v, v, _MM_SHUFFLE (3, 3, 3, 3));
+	v = _mm_or_ps (_mm_andnot_ps (alpha, _mm_mul_ps (v, a)),
+		       _mm_and_ps (alpha, v));
+	_mm_storeu_ps (f + 4 * i, v);
+    }
+}
+
+static const cairo_pixel_convert_funcs_t sse2_funcs = {
+    unpremultiply_argb32_sse2,
+    premultiply_rgba_sse2,
+    rgbx_to_xrgb32_sse2,
+    xrgb32_to_rgbx_sse2,
+    unpremultiply_rgbaf_sse2,
+    rgbf_to_rgbx16_sse2,
+    premultiply_rgba16_sse2,
+    rgbx16_to_rgbf_c,
+};
+
+#endif /* CAIRO_PIXEL_HAS_SSE2 */
+
+#if CAIRO_PIXEL_HAS_AVX2
+
+static inline CAIRO_TARGET_AVX2 __m256i
+divide_avx2 (__m256i x, __m256i recip)
+{
+    __m256i even, odd;
+
+    even = _mm256_srli_epi64 (_mm256_mul_epu32 (x, recip), 24);
+    odd = _mm256_srli_epi64 (_mm256_mul_epu32 (_mm256_srli_epi64 (x, 32),
+					       _mm256_srli_epi64 (recip, 32)), 24);
+    return _mm256_and_si256 (_mm256_or_si256 (even, _mm256_slli_epi64 (odd, 32)),
+			     _mm256_set1_epi32 (0xff));
+}
+
+static CAIRO_TARGET_AVX2 void
+unpremultiply_argb32_avx2 (uint8_t *dst, const uint8_t *src, unsigned int width)
+{
+    const __m256i mask = _mm256_set1_epi32 (0xff);
+    unsigned int i;
+
+    for (i = 0; i + 8 <= width; i += 8) {
+	__m256i p = _mm256_loadu_si256 ((const __m256i *) (src + 4 * i));
+	__m256i a = _mm256_srli_epi32 (p, 24);
+
+	if (_mm256_movemask_epi8 (_mm256_cmpeq_epi32 (a, mask)) == -1) {
+	    p = _mm256_or_si256 (_mm256_and_si256 (p, _mm256_set1_epi32 (0xff00ff00)),
+				 _mm256_or_si256 (_mm256_and_si256 (_mm256_srli_epi32 (p, 16), mask),
+						  _mm256_slli_epi32 (_mm256_and_si256 (p, mask), 16)));
+	} else if (_mm256_testz_si256 (a, a)) {
+	    p = _mm256_setzero_si256 ();
+	} else {
+	    __m256i half, recip, r, g, b;
+
+	    half = _mm256_srli_epi32 (a, 1);
+	    recip = _mm256_i32gather_epi32 ((const int *) unpremultiply_reciprocal, a, 4);
+
+	    r = _mm256_and_si256 (_mm256_srli_epi32 (p, 16), mask);
+	    r = divide_avx2 (_mm256_add_epi32 (_mm256_sub_epi32 (_mm256_slli_epi32 (r, 8), r), half), recip);
+	    g = _mm256_and_si256 (_mm256_srli_epi32 (p, 8), mask);
+	    g = divide_avx2 (_mm256_add_epi32 (_mm256_sub_epi32 (_mm256_slli_epi32 (g, 8), g), half), recip);
+	    b = _mm256_and_si256 (p, mask);
+	    b = divide_avx2 (_mm256_add_epi32 (_mm256_sub_epi32 (_mm256_slli_epi32 (b, 8), b), half), recip);
+
+	    p = _mm256_or_si256 (_mm256_or_si256 (_mm256_slli_epi32 (a, 24), _mm256_slli_epi32 (b, 16)),
+				 _mm256_or_si256 (_mm256_slli_epi32 (g, 8), r));
+	}
+	_mm256_storeu_si256 ((__m256i *) (dst + 4 * i), p);
+    }
+
+    unpremultiply_argb32_sse2 (dst + 4 * i, src + 4 * i, width - i);
+}
+
+static inline CAIRO_TARGET_AVX2 __m256i
+premultiply_4_avx2 (__m256i c)
+{
+    __m256i a, t;
+
+    a = _mm256_shufflehi_epi16 (_mm256_shufflelo_epi16 (c, _MM_SHUFFLE (3, 3, 3, 3)),
+				_MM_SHUFFLE (3, 3, 3, 3));
+    a = _mm256_or_si256 (a, _mm256_set1_epi64x (0x00ff000000000000LL));
+
+    t = _mm256_add_epi16 (_mm256_mullo_epi16 (c, a), _mm256_set1_epi16 (0x80));
+    t = _mm256_srli_epi16 (_mm256_add_epi16 (t, _mm256_srli_epi16 (t, 8)), 8);
+
+    return _mm256_shufflehi_epi16 (_mm256_shufflelo_epi16 (t, _MM_SHUFFLE (3, 0, 1, 2)),
+				   _MM_SHUFFLE (3, 0, 1, 2));
+}
+
+static CAIRO_TARGET_AVX2 void
+premultiply_rgba_avx2 (uint8_t *dst, const uint8_t *src, unsigned int width)
+{
+    const __m256i zero = _mm256_setzero_si256 ();
+    unsigned int i;
+
+    /* unpack and pack both work within the 128-bit halves, so the
+     * pixels come out in the order they went in */
+    for (i = 0; i + 8 <= width; i += 8) {
+	__m256i p = _mm256_loadu_si256 ((const __m256i *) (src + 4 * i));
+
+	p = _mm256_packus_epi16 (premultiply_4_avx2 (_mm256_unpacklo_epi8 (p, zero)),
+				 premultiply_4_avx2 (_mm256_unpackhi_epi8 (p, zero)));
+	_mm256_storeu_si256 ((__m256i *) (dst + 4 * i), p);
+    }
+
+    premultiply_rgba_sse2 (dst + 4 * i, src + 4 * i, width - i);
+}
+
+static inline CAIRO_TARGET_AVX2 __m256i
+unpremultiply_rgbaf_2_avx2 (const float *f)
+{
+    const __m256 alpha = _mm256_castsi256_ps (_mm256_setr_epi32 (0, 0, 0, -1, 0, 0, 0, -1));
+    const __m256 zero = _mm256_setzero_ps ();
+    __m256 v, a, q;
+
+    v = _mm256_loadu_ps (f);
+    a = _mm256_shuffle_ps (v, v, _MM_SHUFFLE (3, 3, 3, 3));
+
+    q = _mm256_div_ps (v, a);
+    q = _mm256_blendv_ps (q, v, alpha);
+    q = _mm256_min_ps (_mm256_max_ps (q, zero), _mm256_set1_ps (1.f));
+    q = _mm256_and_ps (q, _mm256_cmp_ps (a, zero, _CMP_GT_OQ));
+
+    return _mm256_cvttps_epi32 (_mm256_mul_ps (q, _mm256_set1_ps (65535.f)));
+}
+
+static CAIRO_TARGET_AVX2 void
+unpremultiply_rgbaf_avx2 (uint16_t *d16, const float *f, unsigned int width)
+{
+    unsigned int i;
+
+    for (i = 0; i + 4 <= width; i += 4) {
+	__m256i p;
+
+	/* the pack interleaves the halves: pixels 0, 2, 1, 3 */
+	p = _mm256_packus_epi32 (unpremultiply_rgbaf_2_avx2 (f + 4 * i),
+				 unpremultiply_rgbaf_2_avx2 (f + 4 * i + 8));
+	p = _mm256_permute4x64_epi64 (p, _MM_SHUFFLE (3, 1, 2, 0));
+	_mm256_storeu_si256 ((__m256i *) (d16 + 4 * i), p);
+    }
+
+    unpremultiply_rgbaf_sse2 (d16 + 4 * i, f + 4 * i, width - i);
+}
+
+static const cairo_pixel_convert_funcs_t avx2_funcs = {
+    unpremultiply_argb32_avx2,
+    premultiply_rgba_avx2,
+    rgbx_to_xrgb32_sse2,
+    xrgb32_to_rgbx_sse2,
+    unpremultiply_rgbaf_avx2,
+    rgbf_to_rgbx16_sse2,
+    premultiply_rgba16_sse2,
+    rgbx16_to_rgbf_c,
+};
+
+#endif /* CAIRO_PIXEL_HAS_AVX2 */
+
+#if CAIRO_PIXEL_HAS_NEON
+
+/* (t + 0x80 + ((t + 0x80) >> 8)) >> 8, the same as multiply_alpha() */
+static inline uint8x8_t
+div255_neon (uint16x8_t t)
+{
+    return vrshrn_n_u16 (vrsraq_n_u16 (t, t, 8), 8);
+}
+
+static inline uint32x4_t
+divide_neon (uint32x4_t x, uint32x4_t recip)
+{
+    uint64x2_t lo, hi;
+
+    lo = vmull_u32 (vget_low_u32 (x), vget_low_u32 (recip));
+    hi = vmull_u32 (vget_high_u32 (x), vget_high_u32 (recip));
+    return vandq_u32 (vcombine_u32 (vshrn_n_u64 (lo, 24), vshrn_n_u64 (hi, 24)),
+		      vdupq_n_u32 (0xff));
+}
+
+static void
+unpremultiply_argb32_neon (uint8_t *dst, const uint8_t *src, unsigned int width)
+{
+    const uint32x4_t mask = vdupq_n_u32 (0xff);
+    unsigned int i;
+
+    for (i = 0; i + 4 <= width; i += 4) {
+	uint32x4_t p = vreinterpretq_u32_u8 (vld1q_u8 (src + 4 * i));
+	uint32x4_t a, half, recip, r, g, b;
+	uint32_t alpha[4], rcp[4];
+
+	a = vshrq_n_u32 (p, 24);
+	half = vshrq_n_u32 (a, 1);
+
+	vst1q_u32 (alpha, a);
+	rcp[0] = unpremultiply_reciprocal[alpha[0]];
+	rcp[1] = unpremultiply_reciprocal[alpha[1]];
+	rcp[2] = unpremultiply_reciprocal[alpha[2]];
+	rcp[3] = unpremultiply_reciprocal[alpha[3]];
+	recip = vld1q_u32 (rcp);
+
+	r = divide_neon (vmlaq_n_u32 (half, vandq_u32 (vshrq_n_u32 (p, 16), mask), 255), recip);
+	g = divide_neon (vmlaq_n_u32 (half, vandq_u32 (vshrq_n_u32 (p, 8), mask), 255), recip);
+	b = divide_neon (vmlaq_n_u32 (half, vandq_u32 (p, mask), 255), recip);
+
+	p = vorrq_u32 (vorrq_u32 (vshlq_n_u32 (a, 24), vshlq_n_u32 (b, 16)),
+		       vorrq_u32 (vshlq_n_u32 (g, 8), r));
+	vst1q_u8 (dst + 4 * i, vreinterpretq_u8_u32 (p));
+    }
+
+    unpremultiply_argb32_c (dst + 4 * i, src + 4 * i, width - i);
+}
+
+static void
+premultiply_rgba_neon (uint8_t *dst, const uint8_t *src, unsigned int width)
+{
+    unsigned int i;
+
+    for (i = 0; i + 8 <= width; i += 8) {
+	uint8x8x4_t v = vld4_u8 (src + 4 * i);
+	uint8x8x4_t o;
+
+	o.val[0] = div255_neon (vmull_u8 (v.val[2], v.val[3]));
+	o.val[1] = div255_neon (vmull_u8 (v.val[1], v.val[3]));
+	o.val[2] = div255_neon (vmull_u8 (v.val[0], v.val[3]));
+	o.val[3] = v.val[3];
+	vst4_u8 (dst + 4 * i, o);
+    }
+
+    premultiply_rgba_c (dst + 4 * i, src + 4 * i, width - i);
+}
+
+static void
+rgbx_to_xrgb32_neon (uint8_t *dst, const uint8_t *src, unsigned int width)
+{
+    unsigned int i;
+
+    for (i = 0; i + 8 <= width; i += 8) {
+	uint8x8x4_t v = vld4_u8 (src + 4 * i);
+	uint8x8x4_t o;
+
+	o.val[0] = v.val[2];
+	o.val[1] = v.val[1];
+	o.val[2] = v.val[0];
+	o.val[3] = vdup_n_u8 (0xff);
+	vst4_u8 (dst + 4 * i, o);
+    }
+
+    rgbx_to_xrgb32_c (dst + 4 * i, src + 4 * i, width - i);
+}
+
+static void
+xrgb32_to_rgbx_neon (uint8_t *dst, const uint8_t *src, unsigned int width)
+{
+    unsigned int i;
+
+    for (i = 0; i + 8 <= width; i += 8) {
+	uint8x8x4_t v = vld4_u8 (src + 4 * i);
+	uint8x8x4_t o;
+
+	o.val[0] = v.val[2];
+	o.val[1] = v.val[1];
+	o.val[2] = v.val[0];
+	o.val[3] = vdup_n_u8 (0);
+	vst4_u8 (dst + 4 * i, o);
+    }
+
+    xrgb32_to_rgbx_c (dst + 4 * i, src + 4 * i, width - i);
+}
+
+static const cairo_pixel_convert_funcs_t neon_funcs = {
+    unpremultiply_argb32_neon,
+    premultiply_rgba_neon,
+    rgbx_to_xrgb32_neon,
+    xrgb32_to_rgbx_neon,
+    unpremultiply_rgbaf_c,
+    rgbf_to_rgbx16_c,
+    premultiply_rgba16_c,
+    rgbx16_to_rgbf_c,
+};
+
+#endif /* CAIRO_PIXEL_HAS_NEON */
+
+static const cairo_pixel_convert_funcs_t *
+_cairo_pixel_convert_choose (void)
+{
+    const char *env;
+
+    env = getenv ("CAIRO_DISABLE_SIMD");
+    if (env != NULL)
+	return &c_funcs;
+
+#if CAIRO_PIXEL_HAS_AVX2
+    __builtin_cpu_init ();
+    if (__builtin_cpu_supports ("avx2"))
+	return &avx2_funcs;
+#endif
+#if CAIRO_PIXEL_HAS_SSE2
+    return &sse2_funcs;
+#elif CAIRO_PIXEL_HAS_NEON
+    return &neon_funcs;
+#else
+    return &c_funcs;
+#endif
+}
+
+static void *_cairo_pixel_convert_funcs;
+
+static inline const cairo_pixel_convert_funcs_t *
+_cairo_pixel_convert_get_funcs (void)
+{
+    const cairo_pixel_convert_funcs_t *funcs;
+
+    funcs = _cairo_atomic_ptr_get (&_cairo_pixel_convert_funcs);
+    if (unlikely (funcs == NULL)) {
+	/* every thread comes to the same choice */
+	funcs = _cairo_pixel_convert_choose ();
+	_cairo_atomic_ptr_cmpxchg (&_cairo_pixel_convert_funcs,
+				   NULL, (void *) funcs);
+    }
+
+    return funcs;
+}
+
+void
+_cairo_pixel_unpremultiply_argb32 (uint8_t *dst, const uint8_t *src, unsigned int width)
+{
+    _cairo_pixel_convert_get_funcs ()->unpremultiply_argb32 (dst, src, width);
+}
+
+void
+_cairo_pixel_premultiply_rgba (uint8_t *dst, const uint8_t *src, unsigned int width)
+{
+    _cairo_pixel_convert_get_funcs ()->premultiply_rgba (dst, src, width);
+}
+
+void
+_cairo_pixel_rgbx_to_xrgb32 (uint8_t *dst, const uint8_t *src, unsigned int width)
+{
+    _cairo_pixel_convert_get_funcs ()->rgbx_to_xrgb32 (dst, src, width);
+}
+
+void
+_cairo_pixel_xrgb32_to_rgbx (uint8_t *dst, const uint8_t *src, unsigned int width)
+{
+    _cairo_pixel_convert_get_funcs ()->xrgb32_to_rgbx (dst, src, width);
+}
+
+void
+_cairo_pixel_unpremultiply_rgbaf (uint16_t *dst, const float *src, unsigned int width)
+{
+    _cairo_pixel_convert_get_funcs ()->unpremultiply_rgbaf (dst, src, width);
+}
+
+void
+_cairo_pixel_rgbf_to_rgbx16 (uint16_t *dst, const float *src, unsigned int width)
+{
+    _cairo_pixel_convert_get_funcs ()->rgbf_to_rgbx16 (dst, src, width);
+}
+
+void
+_cairo_pixel_premultiply_rgba16 (float *dst, const uint16_t *src, unsigned int width)
+{
+    _cairo_pixel_convert_get_funcs ()->premultiply_rgba16 (dst, src, width);
+}
+
+void
+_cairo_pixel_rgbx16_to_rgbf (float *dst, const uint16_t *src, unsigned int width)
+{
+    _cairo_pixel_convert_get_funcs ()->rgbx16_to_rgbf (dst, src, width);
+}
@@ -41,11 +41,17 @@
 #include "cairo-error-private.h"
 #include "cairo-image-surface-private.h"
 #include "cairo-output-stream-private.h"
+#include "cairo-parallel-private.h"
+#include "cairo-pixel-convert-private.h"
 
 #include <stdio.h>
 #include <errno.h>
 #include <png.h>
 
+#if HAVE_ZLIB
+#include <zlib.h>
+#endif
+
 /**
  * SECTION:cairo-png
  * @Title: PNG Support
@@ -62,6 +68,11 @@
  * cairo_image_surface_get_data() or a backend-specific access
  * function, and process it with another library, e.g. gdk-pixbuf or
  * libpng.
+ *
+ * A #cairo_png_decoder_t decodes an image from data that is pushed
+ * into it piece by piece, e.g. as it comes in over a network, and
+ * makes the rows available as soon as they are decoded, so that the
+ * image can be shown while it loads.
  **/
 
 /**
@@ -81,127 +92,330 @@ struct png_read_closure_t {
 };
 
 
+struct _cairo_png_options {
+    int compression_level;
+    cairo_png_filter_t filter;
+    cairo_bool_t parallel;
+    int decode_scale;
+};
+
+static const cairo_png_options_t _cairo_png_options_default = {
+    -1,				/* compression_level */
+    CAIRO_PNG_FILTER_DEFAULT,	/* filter */
+    FALSE,			/* parallel */
+    1,				/* decode_scale */
+};
+
 /* Unpremultiplies data and converts native endian ARGB => RGBA bytes */
 static void
 unpremultiply_data (png_structp png, png_row_infop row_info, png_bytep data)
 {
-    unsigned int i;
-
-    for (i = 0; i < row_info->rowbytes; i += 4) {
-        uint8_t *b = &data[i];
-        uint32_t pixel;
-        uint8_t  alpha;
-
-	memcpy (&pixel, b, sizeof (uint32_t));
-	alpha = (pixel & 0xff000000) >> 24;
-        if (alpha == 0) {
-	    b[0] = b[1] = b[2] = b[3] = 0;
-	} else {
-            b[0] = (((pixel & 0xff0000) >> 16) * 255 + alpha / 2) / alpha;
-            b[1] = (((pixel & 0x00ff00) >>  8) * 255 + alpha / 2) / alpha;
-            b[2] = (((pixel & 0x0000ff) >>  0) * 255 + alpha / 2) / alpha;
-	    b[3] = alpha;
-	}
-    }
+    _cairo_pixel_unpremultiply_argb32 (data, data, row_info->rowbytes / 4);
 }
 
-static uint16_t f_to_u16(float val)
+/* Converts native endian xRGB => RGBx bytes */
+static void
+convert_data_to_bytes (png_structp png, png_row_infop row_info, png_bytep data)
 {
-    if (val < 0)
-	return 0;
-    else if (val > 1)
-	return 65535;
-    else
-	return (uint16_t)(val * 65535.f);
+    _cairo_pixel_xrgb32_to_rgbx (data, data, row_info->rowbytes / 4);
 }
 
+#if HAVE_ZLIB
+
+/* Large images can be compressed in parallel, pigz-style: the filtered
+ * rows are cut into bands, each band is deflated on its own, ending on
+ * a byte boundary with a sync flush, and the pieces are concatenated
+ * into a single zlib stream whose checksum is combined from theirs.
+ * Each band starts without the window of the previous one, which costs
+ * a little compression, and the same row filters as libpng are used.
+ */
+#define PNG_PARALLEL_MIN_SIZE (1 << 20)
+#define PNG_PARALLEL_BAND_SIZE (256 << 10)
+
+typedef struct _png_band {
+    unsigned char *data;
+    unsigned long length;
+    unsigned long adler;
+    unsigned long raw_length;
+    cairo_status_t status;
+} png_band_t;
+
+typedef struct _png_deflate {
+    const cairo_image_surface_t *image;
+    int channels;
+    int level;
+    cairo_png_filter_t filter;
+    int rows_per_band;
+    int num_bands;
+    png_band_t *bands;
+} png_deflate_t;
+
+/* Converts a row of the image to the bytes of a PNG scanline */
 static void
-unpremultiply_float (float *f, uint16_t *d16, unsigned width)
+png_convert_row (const png_deflate_t *state, int y, uint8_t *dst)
 {
-    unsigned int i;
-
-    for (i = 0; i < width; i++) {
-	float r, g, b, a;
+    const cairo_image_surface_t *image = state->image;
+    const uint8_t *src = image->data + y * image->stride;
+    int x;
 
-	r = *f++;
-	g = *f++;
-	b = *f++;
-	a = *f++;
-
-	if (a > 0) {
-	    *d16++ = f_to_u16(r / a);
-	    *d16++ = f_to_u16(g / a);
-	    *d16++ = f_to_u16(b / a);
-	    *d16++ = f_to_u16(a);
-	} else {
-	    *d16++ = 0;
-	    *d16++ = 0;
-	    *d16++ = 0;
-	    *d16++ = 0;
+    switch (state->channels) {
+    case 4:
+	_cairo_pixel_unpremultiply_argb32 (dst, src, image->width);
+	break;
+    case 3:
+	for (x = 0; x < image->width; x++) {
+	    uint32_t pixel;
+
+	    memcpy (&pixel, src + 4 * x, sizeof (uint32_t));
+	    *dst++ = pixel >> 16;
+	    *dst++ = pixel >> 8;
+	    *dst++ = pixel;
 	}
+	break;
+    case 1:
+	memcpy (dst, src, image->width);
+	break;
     }
 }
 
-static void
-premultiply_float (float *f, const uint16_t *d16, unsigned int width)
+static inline int
+paeth_predictor (int a, int b, int c)
 {
-    unsigned int i = width;
-
-    /* Convert d16 in place back to float */
-    while (i--) {
-	float a = d16[i * 4 + 3] / 65535.f;
-
-	f[i * 4 + 3] = a;
-	f[i * 4 + 2] = (float)d16[i * 4 + 2] / 65535.f * a;
-	f[i * 4 + 1] = (float)d16[i * 4 + 1] / 65535.f * a;
-	f[i * 4] = (float)d16[i * 4] / 65535.f * a;
-    }
+    int p = a + b - c;
+    int pa = abs (p - a), pb = abs (p - b), pc = abs (p - c);
+
+    if (pa <= pb && pa <= pc)
+	return a;
+    if (pb <= pc)
+	return b;
+    return c;
 }
 
-static void convert_u16_to_float (float *f, const uint16_t *d16, unsigned int width)
+/* Writes the filter type byte and the filtered scanline into @out, and
+ * returns the sum of the bytes taken as signed, the heuristic libpng
+ * uses to pick a filter per row.
+ */
+static unsigned int
+png_filter_row (int type, const uint8_t *cur, const uint8_t *prev,
+		int len, int bpp, uint8_t *out)
 {
-    /* Convert d16 in place back to float */
-    unsigned int i = width;
+    unsigned int sum = 0;
+    int i;
+
+    *out++ = type;
+    for (i = 0; i < len; i++) {
+	int left = i >= bpp ? cur[i - bpp] : 0;
+	int up = prev ? prev[i] : 0;
+	int upleft = i >= bpp && prev ? prev[i - bpp] : 0;
+	uint8_t v = cur[i];
+
+	switch (type) {
+	case PNG_FILTER_VALUE_SUB:   v -= left; break;
+	case PNG_FILTER_VALUE_UP:    v -= up; break;
+	case PNG_FILTER_VALUE_AVG:   v -= (left + up) >> 1; break;
+	case PNG_FILTER_VALUE_PAETH: v -= paeth_predictor (left, up, upleft); break;
+	default: break;
+	}
 
-    while (i--) {
-	f[i * 3 + 2] = (float)d16[i * 4 + 2] / 65535.f;
-	f[i * 3 + 1] = (float)d16[i * 4 + 1] / 65535.f;
-	f[i * 3] = (float)d16[i * 4] / 65535.f;
+	out[i] = v;
+	sum += v < 128 ? v : 256 - v;
     }
+
+    return sum;
 }
 
 static void
-convert_float_to_u16 (float *f, uint16_t *d16, unsigned int width)
+png_deflate_band (void *closure, int index)
 {
-    unsigned int i;
+    png_deflate_t *state = closure;
+    png_band_t *band = &state->bands[index];
+    const cairo_image_surface_t *image = state->image;
+    int rowbytes = image->width * state->channels;
+    int y1 = index * state->rows_per_band;
+    int y2 = MIN (y1 + state->rows_per_band, image->height);
+    uint8_t *rows, *prev, *cur, *tmp, *filtered, *out, *candidate;
+    z_stream zs;
+    int y, err;
+
+    band->raw_length = (unsigned long) (y2 - y1) * (rowbytes + 1);
+
+    /* two scanlines, a scratch row for trying filters and the output */
+    rows = _cairo_malloc_ab (3 * (rowbytes + 1) + band->raw_length, 1);
+    if (unlikely (rows == NULL)) {
+	band->status = _cairo_error (CAIRO_STATUS_NO_MEMORY);
+	return;
+    }
+    prev = rows;
+    cur = prev + rowbytes;
+    candidate = cur + rowbytes;
+    filtered = candidate + rowbytes + 1;
+
+    if (y1 > 0)
+	png_convert_row (state, y1 - 1, prev);
+
+    out = filtered;
+    for (y = y1; y < y2; y++) {
+	png_convert_row (state, y, cur);
+
+	if (state->filter == CAIRO_PNG_FILTER_DEFAULT) {
+	    unsigned int best, sum;
+	    int type;
+
+	    best = png_filter_row (PNG_FILTER_VALUE_NONE, cur,
+				   y ? prev : NULL, rowbytes,
+				   state->channels, out);
+	    for (type = PNG_FILTER_VALUE_SUB; type <= PNG_FILTER_VALUE_PAETH; type++) {
+		sum = png_filter_row (type, cur, y ? prev : NULL, rowbytes,
+				      state->channels, candidate);
+		if (sum < best) {
+		    memcpy (out, candidate, rowbytes + 1);
+		    best = sum;
+		}
+	    }
+	} else {
+	    static const int filter_value[] = {
+		PNG_FILTER_VALUE_NONE,	/* DEFAULT, unused */
+		PNG_FILTER_VALUE_NONE,
+		PNG_FILTER_VALUE_SUB,
+		PNG_FILTER_VALUE_UP,
+		PNG_FILTER_VALUE_AVG,
+		PNG_FILTER_VALUE_PAETH,
+	    };
+
+	    png_filter_row (filter_value[state->filter], cur,
+			    y ? prev : NULL, rowbytes,
+			    state->channels, out);
+	}
+	out += rowbytes + 1;
+
+	tmp = prev;
+	prev = cur;
+	cur = tmp;
+    }
+
+    band->adler = adler32 (adler32 (0, NULL, 0), filtered, band->raw_length);
+
+    memset (&zs, 0, sizeof (zs));
+    err = deflateInit2 (&zs, state->level, Z_DEFLATED, -15, 8,
+			Z_DEFAULT_STRATEGY);
+    if (unlikely (err != Z_OK)) {
+	band->status = _cairo_error (CAIRO_STATUS_NO_MEMORY);
+	free (rows);
+	return;
+    }
 
-    for (i = 0; i < width; i++) {
-	*d16++ = f_to_u16(*f++);
-	*d16++ = f_to_u16(*f++);
-	*d16++ = f_to_u16(*f++);
-	*d16++ = 0;
+    /* room for the sync flush marker too */
+    band->length = deflateBound (&zs, band->raw_length) + 16;
+    band->data = _cairo_malloc (band->length);
+    if (unlikely (band->data == NULL)) {
+	band->status = _cairo_error (CAIRO_STATUS_NO_MEMORY);
+	deflateEnd (&zs);
+	free (rows);
+	return;
     }
+
+    zs.next_in = filtered;
+    zs.avail_in = band->raw_length;
+    zs.next_out = band->data;
+    zs.avail_out = band->length;
+    err = deflate (&zs, index == state->num_bands - 1 ? Z_FINISH : Z_SYNC_FLUSH);
+    if (unlikely (zs.avail_in != 0 || (err != Z_OK && err != Z_STREAM_END)))
+	band->status = _cairo_error (CAIRO_STATUS_PNG_ERROR);
+    band->length -= zs.avail_out;
+
+    deflateEnd (&zs);
+    free (rows);
 }
 
-/* Converts native endian xRGB => RGBx bytes */
-static void
-convert_data_to_bytes (png_structp png, png_row_infop row_info, png_bytep data)
+/* Writes the IDAT and IEND chunks for @image, in place of
+ * png_write_image() and png_write_end().
+ */
+static cairo_status_t
+png_write_parallel (png_structp png,
+		    const cairo_image_surface_t *image,
+		    int channels,
+		    const cairo_png_options_t *options)
 {
-    unsigned int i;
+    png_deflate_t state;
+    cairo_status_t status = CAIRO_STATUS_SUCCESS;
+    unsigned long adler;
+    uint8_t header[2], trailer[4];
+    int level, i;
+
+    level = options->compression_level;
+    if (level < 0)
+	level = Z_DEFAULT_COMPRESSION;
+
+    state.image = image;
+    state.channels = channels;
+    state.level = level;
+    state.filter = options->filter;
+    state.rows_per_band =
+	MAX (1, PNG_PARALLEL_BAND_SIZE / (image->width * channels + 1));
+    state.num_bands =
+	(image->height + state.rows_per_band - 1) / state.rows_per_band;
+    state.bands = calloc (state.num_bands, sizeof (png_band_t));
+    if (unlikely (state.bands == NULL))
+	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+
+    _cairo_parallel_for (state.num_bands, png_deflate_band, &state);
+
+    for (i = 0; i < state.num_bands; i++) {
+	if (unlikely (state.bands[i].status)) {
+	    status = state.bands[i].status;
+	    goto BAIL;
+	}
+    }
+
+    /* zlib header: deflate with a 32K window, and the level as a hint */
+    header[0] = 0x78;
+    if (level == Z_DEFAULT_COMPRESSION || level == 6)
+	header[1] = 2 << 6;
+    else if (level < 2)
+	header[1] = 0 << 6;
+    else if (level < 6)
+	header[1] = 1 << 6;
+    else
+	header[1] = 3 << 6;
+    header[1] += 31 - (header[0] * 256 + header[1]) % 31;
+
+    adler = state.bands[0].adler;
+    for (i = 1; i < state.num_bands; i++)
+	adler = adler32_combine (adler,
+				 state.bands[i].adler,
+				 state.bands[i].raw_length);
+    trailer[0] = adler >> 24;
+    trailer[1] = adler >> 16;
+    trailer[2] = adler >> 8;
+    trailer[3] = adler;
+
+    for (i = 0; i < state.num_bands; i++) {
+	png_band_t *band = &state.bands[i];
+	cairo_bool_t first = i == 0;
+	cairo_bool_t last = i == state.num_bands - 1;
+
+	png_write_chunk_start (png, (png_const_bytep) "IDAT",
+			       band->length + (first ? 2 : 0) + (last ? 4 : 0));
+	if (first)
+	    png_write_chunk_data (png, header, 2);
+	png_write_chunk_data (png, band->data, band->length);
+	if (last)
+	    png_write_chunk_data (png, trailer, 4);
+	png_write_chunk_end (png);
+    }
 
-    for (i = 0; i < row_info->rowbytes; i += 4) {
-        uint8_t *b = &data[i];
-        uint32_t pixel;
+    png_write_chunk (png, (png_const_bytep) "IEND", NULL, 0);
 
-	memcpy (&pixel, b, sizeof (uint32_t));
+BAIL:
+    for (i = 0; i < state.num_bands; i++)
+	free (state.bands[i].data);
+    free (state.bands);
 
-	b[0] = (pixel & 0xff0000) >> 16;
-	b[1] = (pixel & 0x00ff00) >>  8;
-	b[2] = (pixel & 0x0000ff) >>  0;
-	b[3] = 0;
-    }
+    return status;
 }
 
+#endif
+
 /* Use a couple of simple error callbacks that do not print anything to
  * stderr and rely on the user to check for errors via the #cairo_status_t
  * return.
@@ -245,9 +459,10 @@ png_simple_output_flush_fn (png_structp png_ptr)
 }
 
 static cairo_status_t
-write_png (cairo_surface_t	*surface,
-	   png_rw_ptr		write_func,
-	   void			*closure)
+write_png (cairo_surface_t		*surface,
+	   png_rw_ptr			 write_func,
+	   void				*closure,
+	   const cairo_png_options_t	*options)
 {
     int i;
     cairo_int_status_t status;
@@ -311,9 +526,9 @@ write_png (cairo_surface_t	*surface,
 	    uint16_t *u16_line = (uint16_t *)&u16_copy[i * clone->width * 8];
 
 	    if (image->format == CAIRO_FORMAT_RGBA128F)
-		unpremultiply_float (float_line, u16_line, clone->width);
+		_cairo_pixel_unpremultiply_rgbaf (u16_line, float_line, clone->width);
 	    else
-		convert_float_to_u16 (float_line, u16_line, clone->width);
+		_cairo_pixel_rgbf_to_rgbx16 (u16_line, float_line, clone->width);
 
 	    rows[i] = (png_byte *)u16_line;
 	}
@@ -340,6 +555,30 @@ write_png (cairo_surface_t	*surface,
 
     png_set_write_fn (png, closure, write_func, png_simple_output_flush_fn);
 
+    if (options->compression_level >= 0)
+	png_set_compression_level (png, options->compression_level);
+
+    switch (options->filter) {
+    case CAIRO_PNG_FILTER_NONE:
+	png_set_filter (png, PNG_FILTER_TYPE_BASE, PNG_FILTER_NONE);
+	break;
+    case CAIRO_PNG_FILTER_SUB:
+	png_set_filter (png, PNG_FILTER_TYPE_BASE, PNG_FILTER_SUB);
+	break;
+    case CAIRO_PNG_FILTER_UP:
+	png_set_filter (png, PNG_FILTER_TYPE_BASE, PNG_FILTER_UP);
+	break;
+    case CAIRO_PNG_FILTER_AVERAGE:
+	png_set_filter (png, PNG_FILTER_TYPE_BASE, PNG_FILTER_AVG);
+	break;
+    case CAIRO_PNG_FILTER_PAETH:
+	png_set_filter (png, PNG_FILTER_TYPE_BASE, PNG_FILTER_PAETH);
+	break;
+    case CAIRO_PNG_FILTER_DEFAULT:
+    default:
+	break;
+    }
+
     switch (clone->format) {
     case CAIRO_FORMAT_ARGB32:
 	bpc = 8;
@@ -407,6 +646,28 @@ write_png (cairo_surface_t	*surface,
      */
     png_write_info (png, info);
 
+#if HAVE_ZLIB
+    if (options->parallel && bpc == 8 &&
+	(clone->format == CAIRO_FORMAT_ARGB32 ||
+	 clone->format == CAIRO_FORMAT_RGB24 ||
+	 clone->format == CAIRO_FORMAT_A8) &&
+	(size_t) clone->stride * clone->height >= PNG_PARALLEL_MIN_SIZE &&
+	_cairo_parallel_num_threads () > 1)
+    {
+	int channels;
+
+	if (png_color_type == PNG_COLOR_TYPE_RGB_ALPHA)
+	    channels = 4;
+	else if (png_color_type == PNG_COLOR_TYPE_RGB)
+	    channels = 3;
+	else
+	    channels = 1;
+
+	status = png_write_parallel (png, clone, channels, options);
+	goto BAIL4;
+    }
+#endif
+
     if (png_color_type == PNG_COLOR_TYPE_RGB_ALPHA) {
 	if (clone->format != CAIRO_FORMAT_RGBA128F)
 	    png_set_write_user_transform_fn (png, unpremultiply_data);
@@ -451,6 +712,212 @@ stdio_write_func (png_structp png, png_bytep data, png_size_t size)
     }
 }
 
+/**
+ * cairo_png_options_create:
+ *
+ * Allocates a new set of PNG options, initialized to the defaults
+ * used by cairo_surface_write_to_png() and
+ * cairo_image_surface_create_from_png(): the default zlib compression
+ * level, adaptive row filtering, a single thread and decoding at full
+ * size.
+ *
+ * Return value: a newly allocated #cairo_png_options_t, to be freed
+ * with cairo_png_options_destroy(), or %NULL if out of memory. All the
+ * functions taking options accept %NULL.
+ *
+ * Since: 1.18
+ **/
+cairo_png_options_t *
+cairo_png_options_create (void)
+{
+    cairo_png_options_t *options;
+
+    options = _cairo_malloc (sizeof (cairo_png_options_t));
+    if (unlikely (options == NULL)) {
+	_cairo_error_throw (CAIRO_STATUS_NO_MEMORY);
+	return NULL;
+    }
+
+    *options = _cairo_png_options_default;
+    return options;
+}
+
+/**
+ * cairo_png_options_destroy:
+ * @options: a #cairo_png_options_t
+ *
+ * Frees a set of PNG options.
+ *
+ * Since: 1.18
+ **/
+void
+cairo_png_options_destroy (cairo_png_options_t *options)
+{
+    free (options);
+}
+
+/**
+ * cairo_png_options_set_compression_level:
+ * @options: a #cairo_png_options_t
+ * @level: the zlib compression level, from 0 (store only) to 9 (best),
+ *   or -1 for the zlib default
+ *
+ * Sets the compression level. Low levels are much faster to encode at
+ * the cost of larger files; level 1 with %CAIRO_PNG_FILTER_SUB or
+ * %CAIRO_PNG_FILTER_UP is usually a good fast mode.
+ *
+ * Since: 1.18
+ **/
+void
+cairo_png_options_set_compression_level (cairo_png_options_t	*options,
+					 int			 level)
+{
+    if (options == NULL)
+	return;
+
+    options->compression_level = MAX (-1, MIN (level, 9));
+}
+
+/**
+ * cairo_png_options_get_compression_level:
+ * @options: a #cairo_png_options_t
+ *
+ * Return value: the compression level set on @options.
+ *
+ * Since: 1.18
+ **/
+int
+cairo_png_options_get_compression_level (const cairo_png_options_t *options)
+{
+    if (options == NULL)
+	return _cairo_png_options_default.compression_level;
+
+    return options->compression_level;
+}
+
+/**
+ * cairo_png_options_set_filter:
+ * @options: a #cairo_png_options_t
+ * @filter: the row filter to use
+ *
+ * Sets the filter applied to each row before compression. The default,
+ * %CAIRO_PNG_FILTER_DEFAULT, tries every filter on every row and keeps
+ * the most promising one, which is the slowest choice.
+ *
+ * Since: 1.18
+ **/
+void
+cairo_png_options_set_filter (cairo_png_options_t	*options,
+			      cairo_png_filter_t	 filter)
+{
+    if (options == NULL)
+	return;
+
+    if ((unsigned) filter > CAIRO_PNG_FILTER_PAETH)
+	filter = CAIRO_PNG_FILTER_DEFAULT;
+
+    options->filter = filter;
+}
+
+/**
+ * cairo_png_options_get_filter:
+ * @options: a #cairo_png_options_t
+ *
+ * Return value: the row filter set on @options.
+ *
+ * Since: 1.18
+ **/
+cairo_png_filter_t
+cairo_png_options_get_filter (const cairo_png_options_t *options)
+{
+    if (options == NULL)
+	return _cairo_png_options_default.filter;
+
+    return options->filter;
+}
+
+/**
+ * cairo_png_options_set_parallel:
+ * @options: a #cairo_png_options_t
+ * @parallel: whether to compress large images on several threads
+ *
+ * Allows large images with 8-bit channels to be filtered and compressed
+ * in bands on several threads (see CAIRO_NUM_THREADS). The result is
+ * a standard PNG file, slightly larger than a single-threaded one.
+ * Small images and other formats are always written on one thread.
+ *
+ * Since: 1.18
+ **/
+void
+cairo_png_options_set_parallel (cairo_png_options_t	*options,
+				cairo_bool_t		 parallel)
+{
+    if (options == NULL)
+	return;
+
+    options->parallel = parallel;
+}
+
+/**
+ * cairo_png_options_get_parallel:
+ * @options: a #cairo_png_options_t
+ *
+ * Return value: whether parallel compression is allowed by @options.
+ *
+ * Since: 1.18
+ **/
+cairo_bool_t
+cairo_png_options_get_parallel (const cairo_png_options_t *options)
+{
+    if (options == NULL)
+	return _cairo_png_options_default.parallel;
+
+    return options->parallel;
+}
+
+/**
+ * cairo_png_options_set_decode_scale:
+ * @options: a #cairo_png_options_t
+ * @scale: the factor, from 1 to 256, to reduce the image by
+ *
+ * Makes the readers taking @options, such as
+ * cairo_image_surface_create_from_png_stream_with_options() and
+ * #cairo_png_decoder_t, shrink the image by @scale in each direction
+ * while it is decoded, averaging each @scale by @scale block of
+ * pixels into one. Only a few rows of the full size image are held
+ * in memory at a time, unless the PNG is interlaced. A reduced image
+ * always has 8-bit channels, and does not carry the PNG data as
+ * %CAIRO_MIME_TYPE_PNG.
+ *
+ * Since: 1.18
+ **/
+void
+cairo_png_options_set_decode_scale (cairo_png_options_t	*options,
+				    int			 scale)
+{
+    if (options == NULL)
+	return;
+
+    options->decode_scale = MAX (1, MIN (scale, 256));
+}
+
+/**
+ * cairo_png_options_get_decode_scale:
+ * @options: a #cairo_png_options_t
+ *
+ * Return value: the decode scale set on @options.
+ *
+ * Since: 1.18
+ **/
+int
+cairo_png_options_get_decode_scale (const cairo_png_options_t *options)
+{
+    if (options == NULL)
+	return _cairo_png_options_default.decode_scale;
+
+    return options->decode_scale;
+}
+
 /**
  * cairo_surface_write_to_png:
  * @surface: a #cairo_surface_t with pixel contents
@@ -473,10 +940,35 @@ stdio_write_func (png_structp png, png_bytep data, png_size_t size)
 cairo_status_t
 cairo_surface_write_to_png (cairo_surface_t	*surface,
 			    const char		*filename)
+{
+    return cairo_surface_write_to_png_with_options (surface, filename, NULL);
+}
+
+/**
+ * cairo_surface_write_to_png_with_options:
+ * @surface: a #cairo_surface_t with pixel contents
+ * @filename: the name of a file to write to; on Windows this filename
+ *   is encoded in UTF-8.
+ * @options: a #cairo_png_options_t, or %NULL for the defaults
+ *
+ * Like cairo_surface_write_to_png(), but lets the caller trade file
+ * size for encoding speed through @options.
+ *
+ * Return value: as for cairo_surface_write_to_png().
+ *
+ * Since: 1.18
+ **/
+cairo_status_t
+cairo_surface_write_to_png_with_options (cairo_surface_t		*surface,
+					 const char			*filename,
+					 const cairo_png_options_t	*options)
 {
     FILE *fp;
     cairo_status_t status;
 
+    if (options == NULL)
+	options = &_cairo_png_options_default;
+
     if (surface->status)
 	return surface->status;
 
@@ -497,7 +989,7 @@ cairo_surface_write_to_png (cairo_surface_t	*surface,
 	}
     }
 
-    status = write_png (surface, stdio_write_func, fp);
+    status = write_png (surface, stdio_write_func, fp, options);
 
     if (fclose (fp) && status == CAIRO_STATUS_SUCCESS)
 	status = _cairo_error (CAIRO_STATUS_WRITE_ERROR);
@@ -547,9 +1039,39 @@ cairo_status_t
 cairo_surface_write_to_png_stream (cairo_surface_t	*surface,
 				   cairo_write_func_t	write_func,
 				   void			*closure)
+{
+    return cairo_surface_write_to_png_stream_with_options (surface,
+							    write_func,
+							    closure,
+							    NULL);
+}
+slim_hidden_def (cairo_surface_write_to_png_stream);
+
+/**
+ * cairo_surface_write_to_png_stream_with_options:
+ * @surface: a #cairo_surface_t with pixel contents
+ * @write_func: a #cairo_write_func_t
+ * @closure: closure data for the write function
+ * @options: a #cairo_png_options_t, or %NULL for the defaults
+ *
+ * Like cairo_surface_write_to_png_stream(), but lets the caller trade
+ * file size for encoding speed through @options.
+ *
+ * Return value: as for cairo_surface_write_to_png_stream().
+ *
+ * Since: 1.18
+ **/
+cairo_status_t
+cairo_surface_write_to_png_stream_with_options (cairo_surface_t		*surface,
+						cairo_write_func_t		 write_func,
+						void				*closure,
+						const cairo_png_options_t	*options)
 {
     struct png_write_closure_t png_closure;
 
+    if (options == NULL)
+	options = &_cairo_png_options_default;
+
     if (surface->status)
 	return surface->status;
 
@@ -559,15 +1081,7 @@ cairo_surface_write_to_png_stream (cairo_surface_t	*surface,
     png_closure.write_func = write_func;
     png_closure.closure = closure;
 
-    return write_png (surface, stream_write_func, &png_closure);
-}
-slim_hidden_def (cairo_surface_write_to_png_stream);
-
-static inline int
-multiply_alpha (int alpha, int color)
-{
-    int temp = (alpha * color) + 0x80;
-    return ((temp + (temp >> 8)) >> 8);
+    return write_png (surface, stream_write_func, &png_closure, options);
 }
 
 /* Premultiplies data and converts RGBA bytes => native endian */
@@ -576,47 +1090,14 @@ premultiply_data (png_structp   png,
                   png_row_infop row_info,
                   png_bytep     data)
 {
-    unsigned int i;
-
-    for (i = 0; i < row_info->rowbytes; i += 4) {
-	uint8_t *base  = &data[i];
-	uint8_t  alpha = base[3];
-	uint32_t p;
-
-	if (alpha == 0) {
-	    p = 0;
-	} else {
-	    uint8_t  red   = base[0];
-	    uint8_t  green = base[1];
-	    uint8_t  blue  = base[2];
-
-	    if (alpha != 0xff) {
-		red   = multiply_alpha (alpha, red);
-		green = multiply_alpha (alpha, green);
-		blue  = multiply_alpha (alpha, blue);
-	    }
-	    p = (alpha << 24) | (red << 16) | (green << 8) | (blue << 0);
-	}
-	memcpy (base, &p, sizeof (uint32_t));
-    }
+    _cairo_pixel_premultiply_rgba (data, data, row_info->rowbytes / 4);
 }
 
 /* Converts RGBx bytes to native endian xRGB */
 static void
 convert_bytes_to_data (png_structp png, png_row_infop row_info, png_bytep data)
 {
-    unsigned int i;
-
-    for (i = 0; i < row_info->rowbytes; i += 4) {
-	uint8_t *base  = &data[i];
-	uint8_t  red   = base[0];
-	uint8_t  green = base[1];
-	uint8_t  blue  = base[2];
-	uint32_t pixel;
-
-	pixel = (0xff << 24) | (red << 16) | (green << 8) | (blue << 0);
-	memcpy (base, &pixel, sizeof (uint32_t));
-    }
+    _cairo_pixel_rgbx_to_xrgb32 (data, data, row_info->rowbytes / 4);
 }
 
 static cairo_status_t
@@ -653,83 +1134,50 @@ stream_read_func (png_structp png, png_bytep data, png_size_t size)
 	png_error (png, NULL);
     }
 
-    _cairo_output_stream_write (png_closure->png_data, data, size);
+    if (png_closure->png_data != NULL)
+	_cairo_output_stream_write (png_closure->png_data, data, size);
 }
 
-static cairo_surface_t *
-read_png (struct png_read_closure_t *png_closure)
+/* Sets up the transforms that turn the rows of any PNG into one of
+ * cairo's formats, with 16-bit channels reduced to 8 if @strip_16, and
+ * reports that format.
+ */
+static cairo_status_t
+png_setup_read_transforms (png_structp	     png,
+			   png_infop	     info,
+			   cairo_bool_t	     strip_16,
+			   cairo_format_t   *format_out)
 {
-    cairo_surface_t * volatile surface;
-    png_struct *png = NULL;
-    png_info *info;
-    png_byte * volatile data = NULL;
-    png_byte ** volatile row_pointers = NULL;
     png_uint_32 png_width, png_height;
-    int depth, color_type, interlace, stride;
-    unsigned int i;
-    cairo_format_t format;
-    cairo_status_t status;
-    unsigned char *mime_data;
-    unsigned long mime_data_length;
+    int depth, color_type, interlace;
 
-    png_closure->png_data = _cairo_memory_stream_create ();
+    png_get_IHDR (png, info,
+                  &png_width, &png_height, &depth,
+                  &color_type, &interlace, NULL, NULL);
 
-    /* XXX: Perhaps we'll want some other error handlers? */
-    png = png_create_read_struct (PNG_LIBPNG_VER_STRING,
-                                  &status,
-	                          png_simple_error_callback,
-	                          png_simple_warning_callback);
-    if (unlikely (png == NULL)) {
-	surface = _cairo_surface_create_in_error (_cairo_error (CAIRO_STATUS_NO_MEMORY));
-	goto BAIL;
-    }
+    /* convert palette/gray image to rgb */
+    if (color_type == PNG_COLOR_TYPE_PALETTE)
+        png_set_palette_to_rgb (png);
 
-    info = png_create_info_struct (png);
-    if (unlikely (info == NULL)) {
-	surface = _cairo_surface_create_in_error (_cairo_error (CAIRO_STATUS_NO_MEMORY));
-	goto BAIL;
+    /* expand gray bit depth if needed */
+    if (color_type == PNG_COLOR_TYPE_GRAY) {
+#if PNG_LIBPNG_VER >= 10209
+        png_set_expand_gray_1_2_4_to_8 (png);
+#else
+        png_set_gray_1_2_4_to_8 (png);
+#endif
     }
 
-    png_set_read_fn (png, png_closure, stream_read_func);
-
-    status = CAIRO_STATUS_SUCCESS;
-#ifdef PNG_SETJMP_SUPPORTED
-    if (setjmp (png_jmpbuf (png))) {
-	surface = _cairo_surface_create_in_error (status);
-	goto BAIL;
-    }
-#endif
-
-    png_read_info (png, info);
-
-    png_get_IHDR (png, info,
-                  &png_width, &png_height, &depth,
-                  &color_type, &interlace, NULL, NULL);
-    if (unlikely (status)) { /* catch any early warnings */
-	surface = _cairo_surface_create_in_error (status);
-	goto BAIL;
-    }
-
-    /* convert palette/gray image to rgb */
-    if (color_type == PNG_COLOR_TYPE_PALETTE)
-        png_set_palette_to_rgb (png);
-
-    /* expand gray bit depth if needed */
-    if (color_type == PNG_COLOR_TYPE_GRAY) {
-#if PNG_LIBPNG_VER >= 10209
-        png_set_expand_gray_1_2_4_to_8 (png);
-#else
-        png_set_gray_1_2_4_to_8 (png);
-#endif
-    }
-
-    /* transform transparency to alpha */
-    if (png_get_valid (png, info, PNG_INFO_tRNS))
-        png_set_tRNS_to_alpha (png);
+    /* transform transparency to alpha */
+    if (png_get_valid (png, info, PNG_INFO_tRNS))
+        png_set_tRNS_to_alpha (png);
 
     if (depth < 8)
         png_set_packing (png);
 
+    if (depth == 16 && strip_16)
+	png_set_strip_16 (png);
+
     /* convert grayscale to RGB */
     if (color_type == PNG_COLOR_TYPE_GRAY ||
 	color_type == PNG_COLOR_TYPE_GRAY_ALPHA)
@@ -751,8 +1199,7 @@ read_png (struct png_read_closure_t *png_closure)
 	! (color_type == PNG_COLOR_TYPE_RGB ||
 	   color_type == PNG_COLOR_TYPE_RGB_ALPHA))
     {
-	surface = _cairo_surface_create_in_error (_cairo_error (CAIRO_STATUS_READ_ERROR));
-	goto BAIL;
+	return _cairo_error (CAIRO_STATUS_READ_ERROR);
     }
 
     switch (color_type) {
@@ -762,23 +1209,249 @@ read_png (struct png_read_closure_t *png_closure)
 
 	case PNG_COLOR_TYPE_RGB_ALPHA:
 	    if (depth == 8) {
-		format = CAIRO_FORMAT_ARGB32;
+		*format_out = CAIRO_FORMAT_ARGB32;
 		png_set_read_user_transform_fn (png, premultiply_data);
 	    } else {
-		format = CAIRO_FORMAT_RGBA128F;
+		*format_out = CAIRO_FORMAT_RGBA128F;
 	    }
 	    break;
 
 	case PNG_COLOR_TYPE_RGB:
 	    if (depth == 8) {
-		format = CAIRO_FORMAT_RGB24;
+		*format_out = CAIRO_FORMAT_RGB24;
 		png_set_read_user_transform_fn (png, convert_bytes_to_data);
 	    } else {
-		format = CAIRO_FORMAT_RGB96F;
+		*format_out = CAIRO_FORMAT_RGB96F;
 	    }
 	    break;
     }
 
+    return CAIRO_STATUS_SUCCESS;
+}
+
+/* Shrinks an image by an integer factor as its rows come in, keeping
+ * only the sums of the current band of rows.  The rows are ARGB32 or
+ * RGB24, so premultiplied colors are averaged.
+ */
+typedef struct _png_scaler {
+    cairo_image_surface_t *image;
+    int scale;
+    int src_width, src_height;
+    int src_y;
+    int rows;
+    uint32_t *sums;
+} png_scaler_t;
+
+static png_scaler_t *
+png_scaler_create (cairo_image_surface_t *image,
+		   int			  scale,
+		   int			  src_width,
+		   int			  src_height)
+{
+    png_scaler_t *scaler;
+
+    scaler = _cairo_malloc (sizeof (png_scaler_t));
+    if (unlikely (scaler == NULL))
+	return NULL;
+
+    scaler->sums = calloc (image->width, 4 * sizeof (uint32_t));
+    if (unlikely (scaler->sums == NULL)) {
+	free (scaler);
+	return NULL;
+    }
+
+    scaler->image = image;
+    scaler->scale = scale;
+    scaler->src_width = src_width;
+    scaler->src_height = src_height;
+    scaler->src_y = 0;
+    scaler->rows = 0;
+
+    return scaler;
+}
+
+static void
+png_scaler_destroy (png_scaler_t *scaler)
+{
+    if (scaler == NULL)
+	return;
+
+    free (scaler->sums);
+    free (scaler);
+}
+
+/* Adds the next row of the full size image, and returns the row of the
+ * reduced image that it completed, or -1. */
+static int
+png_scaler_add_row (png_scaler_t *scaler, const uint8_t *row)
+{
+    cairo_image_surface_t *image = scaler->image;
+    const uint32_t *src = (const uint32_t *) row;
+    uint32_t *sums = scaler->sums;
+    uint32_t *dst;
+    int x, y;
+
+    for (x = 0; x < scaler->src_width; x++) {
+	uint32_t *s = sums + 4 * (x / scaler->scale);
+	uint32_t p = src[x];
+
+	s[0] += p & 0xff;
+	s[1] += (p >> 8) & 0xff;
+	s[2] += (p >> 16) & 0xff;
+	s[3] += p >> 24;
+    }
+
+    scaler->src_y++;
+    if (++scaler->rows < scaler->scale && scaler->src_y < scaler->src_height)
+	return -1;
+
+    y = (scaler->src_y - 1) / scaler->scale;
+    dst = (uint32_t *) (image->data + y * image->stride);
+    for (x = 0; x < image->width; x++) {
+	uint32_t *s = sums + 4 * x;
+	uint32_t n = scaler->rows * MIN (scaler->scale, scaler->src_width - x * scaler->scale);
+	uint32_t a;
+
+	a = image->format == CAIRO_FORMAT_RGB24 ? 0xff : (s[3] + n / 2) / n;
+	dst[x] = a << 24 |
+		 (s[2] + n / 2) / n << 16 |
+		 (s[1] + n / 2) / n << 8 |
+		 (s[0] + n / 2) / n;
+    }
+
+    memset (sums, 0, 4 * sizeof (uint32_t) * image->width);
+    scaler->rows = 0;
+
+    return y;
+}
+
+static cairo_surface_t *
+read_png (struct png_read_closure_t	*png_closure,
+	  const cairo_png_options_t	*options)
+{
+    cairo_surface_t * volatile surface;
+    cairo_surface_t * volatile image = NULL;
+    png_scaler_t * volatile scaler = NULL;
+    png_struct *png = NULL;
+    png_info *info;
+    png_byte * volatile data = NULL;
+    png_byte ** volatile row_pointers = NULL;
+    png_uint_32 png_width, png_height;
+    int depth, color_type, interlace, stride;
+    int scale = options->decode_scale;
+    unsigned int i;
+    cairo_format_t format;
+    cairo_status_t status;
+    unsigned char *mime_data;
+    unsigned long mime_data_length;
+
+    png_closure->png_data = NULL;
+    if (scale == 1)
+	png_closure->png_data = _cairo_memory_stream_create ();
+
+    /* XXX: Perhaps we'll want some other error handlers? */
+    png = png_create_read_struct (PNG_LIBPNG_VER_STRING,
+                                  &status,
+	                          png_simple_error_callback,
+	                          png_simple_warning_callback);
+    if (unlikely (png == NULL)) {
+	surface = _cairo_surface_create_in_error (_cairo_error (CAIRO_STATUS_NO_MEMORY));
+	goto BAIL;
+    }
+
+    info = png_create_info_struct (png);
+    if (unlikely (info == NULL)) {
+	surface = _cairo_surface_create_in_error (_cairo_error (CAIRO_STATUS_NO_MEMORY));
+	goto BAIL;
+    }
+
+    png_set_read_fn (png, png_closure, stream_read_func);
+
+    status = CAIRO_STATUS_SUCCESS;
+#ifdef PNG_SETJMP_SUPPORTED
+    if (setjmp (png_jmpbuf (png))) {
+	surface = _cairo_surface_create_in_error (status);
+	goto BAIL;
+    }
+#endif
+
+    png_read_info (png, info);
+
+    if (unlikely (status)) { /* catch any early warnings */
+	surface = _cairo_surface_create_in_error (status);
+	goto BAIL;
+    }
+
+    status = png_setup_read_transforms (png, info, scale > 1, &format);
+    if (unlikely (status)) {
+	surface = _cairo_surface_create_in_error (status);
+	goto BAIL;
+    }
+
+    png_get_IHDR (png, info,
+                  &png_width, &png_height, &depth,
+                  &color_type, &interlace, NULL, NULL);
+
+    if (scale > 1) {
+	image = cairo_image_surface_create (format,
+					    (png_width + scale - 1) / scale,
+					    (png_height + scale - 1) / scale);
+	if (unlikely (image->status)) {
+	    surface = image;
+	    image = NULL;
+	    goto BAIL;
+	}
+
+	scaler = png_scaler_create ((cairo_image_surface_t *) image,
+				    scale, png_width, png_height);
+	if (unlikely (scaler == NULL)) {
+	    surface = _cairo_surface_create_in_error (_cairo_error (CAIRO_STATUS_NO_MEMORY));
+	    goto BAIL;
+	}
+
+	/* The passes of an interlaced image only complete the rows at
+	 * the very end, so that has to be read whole. */
+	stride = png_width * 4;
+	data = _cairo_malloc_ab (interlace != PNG_INTERLACE_NONE ? png_height : 1,
+				 stride);
+	if (unlikely (data == NULL)) {
+	    surface = _cairo_surface_create_in_error (_cairo_error (CAIRO_STATUS_NO_MEMORY));
+	    goto BAIL;
+	}
+
+	if (interlace != PNG_INTERLACE_NONE) {
+	    row_pointers = _cairo_malloc_ab (png_height, sizeof (char *));
+	    if (unlikely (row_pointers == NULL)) {
+		surface = _cairo_surface_create_in_error (_cairo_error (CAIRO_STATUS_NO_MEMORY));
+		goto BAIL;
+	    }
+
+	    for (i = 0; i < png_height; i++)
+		row_pointers[i] = &data[i * (ptrdiff_t)stride];
+
+	    png_read_image (png, row_pointers);
+	    for (i = 0; i < png_height; i++)
+		png_scaler_add_row (scaler, row_pointers[i]);
+	} else {
+	    for (i = 0; i < png_height; i++) {
+		png_read_row (png, data, NULL);
+		png_scaler_add_row (scaler, data);
+	    }
+	}
+	png_read_end (png, info);
+
+	if (unlikely (status)) {
+	    surface = _cairo_surface_create_in_error (status);
+	    goto BAIL;
+	}
+
+	/* the PNG data does not describe the reduced image */
+	cairo_surface_mark_dirty (image);
+	surface = image;
+	image = NULL;
+	goto BAIL;
+    }
+
     stride = cairo_format_stride_for_width (format, png_width);
     if (stride < 0) {
 	surface = _cairo_surface_create_in_error (_cairo_error (CAIRO_STATUS_INVALID_STRIDE));
@@ -815,7 +1488,7 @@ read_png (struct png_read_closure_t *png_closure)
 	    float *float_line = (float *)row_pointers[i];
 	    uint16_t *u16_line = (uint16_t *)row_pointers[i];
 
-	    premultiply_float (float_line, u16_line, png_width);
+	    _cairo_pixel_premultiply_rgba16 (float_line, u16_line, png_width);
 	}
     } else if (format == CAIRO_FORMAT_RGB96F) {
 	i = png_height;
@@ -824,7 +1497,7 @@ read_png (struct png_read_closure_t *png_closure)
 	    float *float_line = (float *)row_pointers[i];
 	    uint16_t *u16_line = (uint16_t *)row_pointers[i];
 
-	    convert_u16_to_float (float_line, u16_line, png_width);
+	    _cairo_pixel_rgbx16_to_rgbf (float_line, u16_line, png_width);
 	}
     }
 
@@ -865,6 +1538,9 @@ read_png (struct png_read_closure_t *png_closure)
  BAIL:
     free (row_pointers);
     free (data);
+    png_scaler_destroy (scaler);
+    if (image != NULL)
+	cairo_surface_destroy (image);
     if (png != NULL)
 	png_destroy_read_struct (&png, &info, NULL);
     if (png_closure->png_data != NULL) {
@@ -902,6 +1578,29 @@ read_png (struct png_read_closure_t *png_closure)
  **/
 cairo_surface_t *
 cairo_image_surface_create_from_png (const char *filename)
+{
+    return cairo_image_surface_create_from_png_with_options (filename, NULL);
+}
+
+/**
+ * cairo_image_surface_create_from_png_with_options:
+ * @filename: name of PNG file to load. On Windows this filename
+ *   is encoded in UTF-8.
+ * @options: a #cairo_png_options_t, or %NULL for the defaults
+ *
+ * Like cairo_image_surface_create_from_png(), but decodes the image
+ * as set by @options, e.g. reduced in size by
+ * cairo_png_options_set_decode_scale().
+ *
+ * Return value: a new #cairo_surface_t initialized with the contents
+ * of the PNG file, or a "nil" surface if any error occurred, as for
+ * cairo_image_surface_create_from_png().
+ *
+ * Since: 1.18
+ **/
+cairo_surface_t *
+cairo_image_surface_create_from_png_with_options (const char			*filename,
+						  const cairo_png_options_t	*options)
 {
     struct png_read_closure_t png_closure;
     cairo_surface_t *surface;
@@ -929,7 +1628,10 @@ cairo_image_surface_create_from_png (const char *filename)
 
     png_closure.read_func = stdio_read_func;
 
-    surface = read_png (&png_closure);
+    if (options == NULL)
+	options = &_cairo_png_options_default;
+
+    surface = read_png (&png_closure, options);
 
     fclose (png_closure.closure);
 
@@ -963,11 +1665,445 @@ cairo_image_surface_create_from_png (const char *filename)
 cairo_surface_t *
 cairo_image_surface_create_from_png_stream (cairo_read_func_t	read_func,
 					    void		*closure)
+{
+    return cairo_image_surface_create_from_png_stream_with_options (read_func,
+								    closure,
+								    NULL);
+}
+
+/**
+ * cairo_image_surface_create_from_png_stream_with_options:
+ * @read_func: function called to read the data of the file
+ * @closure: data to pass to @read_func.
+ * @options: a #cairo_png_options_t, or %NULL for the defaults
+ *
+ * Like cairo_image_surface_create_from_png_stream(), but decodes the
+ * image as set by @options, e.g. reduced in size by
+ * cairo_png_options_set_decode_scale().
+ *
+ * Return value: a new #cairo_surface_t initialized with the contents
+ * of the PNG file or a "nil" surface if the data read is not a valid
+ * PNG image or memory could not be allocated for the operation, as for
+ * cairo_image_surface_create_from_png_stream().
+ *
+ * Since: 1.18
+ **/
+cairo_surface_t *
+cairo_image_surface_create_from_png_stream_with_options (cairo_read_func_t		 read_func,
+							 void				*closure,
+							 const cairo_png_options_t	*options)
 {
     struct png_read_closure_t png_closure;
 
+    if (options == NULL)
+	options = &_cairo_png_options_default;
+
     png_closure.read_func = read_func;
     png_closure.closure = closure;
 
-    return read_png (&png_closure);
+    return read_png (&png_closure, options);
+}
+
+struct _cairo_png_decoder {
+    cairo_status_t status;
+    png_structp png;
+    png_infop info;
+    int scale;
+
+    cairo_png_decoder_rows_func_t rows_func;
+    void *rows_closure;
+
+    int width, height;
+    cairo_bool_t interlaced;
+    cairo_bool_t complete;
+    cairo_image_surface_t *image;
+    png_scaler_t *scaler;
+    uint8_t *rows;
+    cairo_output_stream_t *png_data;
+};
+
+static void
+png_decoder_fail (cairo_png_decoder_t *decoder, cairo_status_t status)
+{
+    if (decoder->status == CAIRO_STATUS_SUCCESS)
+	decoder->status = status;
+    png_error (decoder->png, NULL);
+}
+
+static void
+png_decoder_rows_ready (cairo_png_decoder_t *decoder, int y, int height)
+{
+    cairo_surface_mark_dirty_rectangle (&decoder->image->base,
+					0, y, decoder->image->width, height);
+    if (decoder->rows_func != NULL)
+	decoder->rows_func (decoder->rows_closure, y, height);
+}
+
+static void
+png_decoder_info (png_structp png, png_infop info)
+{
+    cairo_png_decoder_t *decoder = png_get_progressive_ptr (png);
+    png_uint_32 png_width, png_height;
+    int depth, color_type, interlace;
+    cairo_surface_t *image;
+    cairo_format_t format;
+    cairo_status_t status;
+    int scale = decoder->scale;
+
+    status = png_setup_read_transforms (png, info, scale > 1, &format);
+    if (unlikely (status))
+	png_decoder_fail (decoder, status);
+
+    png_get_IHDR (png, info,
+                  &png_width, &png_height, &depth,
+                  &color_type, &interlace, NULL, NULL);
+    decoder->width = png_width;
+    decoder->height = png_height;
+    decoder->interlaced = interlace != PNG_INTERLACE_NONE;
+
+    image = cairo_image_surface_create (format,
+					(png_width + scale - 1) / scale,
+					(png_height + scale - 1) / scale);
+    if (unlikely (image->status)) {
+	status = image->status;
+	cairo_surface_destroy (image);
+	png_decoder_fail (decoder, status);
+    }
+    decoder->image = (cairo_image_surface_t *) image;
+
+    if (scale > 1) {
+	decoder->scaler = png_scaler_create (decoder->image, scale,
+					     png_width, png_height);
+	if (unlikely (decoder->scaler == NULL))
+	    png_decoder_fail (decoder, _cairo_error (CAIRO_STATUS_NO_MEMORY));
+
+	/* the passes are combined at full size before reducing */
+	if (decoder->interlaced) {
+	    decoder->rows = _cairo_malloc_abc (png_height, png_width, 4);
+	    if (unlikely (decoder->rows == NULL))
+		png_decoder_fail (decoder, _cairo_error (CAIRO_STATUS_NO_MEMORY));
+	}
+    }
+}
+
+static void
+png_decoder_row (png_structp png, png_bytep row, png_uint_32 y, int pass)
+{
+    cairo_png_decoder_t *decoder = png_get_progressive_ptr (png);
+    cairo_image_surface_t *image = decoder->image;
+    uint8_t *dst;
+
+    /* nothing new for this row in this pass */
+    if (row == NULL)
+	return;
+
+    /* detach any snapshot taken of the rows decoded so far */
+    cairo_surface_flush (&image->base);
+
+    if (decoder->scaler != NULL) {
+	if (decoder->interlaced) {
+	    png_progressive_combine_row (png,
+					 decoder->rows + y * (ptrdiff_t) decoder->width * 4,
+					 row);
+	} else {
+	    int n = png_scaler_add_row (decoder->scaler, row);
+	    if (n >= 0)
+		png_decoder_rows_ready (decoder, n, 1);
+	}
+	return;
+    }
+
+    dst = image->data + y * (ptrdiff_t) image->stride;
+    if (decoder->interlaced) {
+	png_progressive_combine_row (png, dst, row);
+    } else {
+	memcpy (dst, row, png_get_rowbytes (png, decoder->info));
+    }
+
+    /* Floating point rows are expanded in place from 16 bits once
+     * complete; for an interlaced image that is only at the end. */
+    if (image->format == CAIRO_FORMAT_RGBA128F ||
+	image->format == CAIRO_FORMAT_RGB96F)
+    {
+	if (decoder->interlaced)
+	    return;
+
+	if (image->format == CAIRO_FORMAT_RGBA128F)
+	    _cairo_pixel_premultiply_rgba16 ((float *) dst, (uint16_t *) dst, image->width);
+	else
+	    _cairo_pixel_rgbx16_to_rgbf ((float *) dst, (uint16_t *) dst, image->width);
+    }
+
+    png_decoder_rows_ready (decoder, y, 1);
+}
+
+static void
+png_decoder_end (png_structp png, png_infop info)
+{
+    cairo_png_decoder_t *decoder = png_get_progressive_ptr (png);
+    cairo_image_surface_t *image = decoder->image;
+    int y;
+
+    if (decoder->interlaced) {
+	cairo_surface_flush (&image->base);
+	if (decoder->scaler != NULL) {
+	    for (y = 0; y < decoder->height; y++)
+		png_scaler_add_row (decoder->scaler,
+				    decoder->rows + y * (ptrdiff_t) decoder->width * 4);
+	    png_decoder_rows_ready (decoder, 0, image->height);
+	} else if (image->format == CAIRO_FORMAT_RGBA128F ||
+		   image->format == CAIRO_FORMAT_RGB96F)
+	{
+	    for (y = 0; y < image->height; y++) {
+		uint8_t *row = image->data + y * (ptrdiff_t) image->stride;
+
+		if (image->format == CAIRO_FORMAT_RGBA128F)
+		    _cairo_pixel_premultiply_rgba16 ((float *) row, (uint16_t *) row, image->width);
+		else
+		    _cairo_pixel_rgbx16_to_rgbf ((float *) row, (uint16_t *) row, image->width);
+	    }
+	    png_decoder_rows_ready (decoder, 0, image->height);
+	}
+    }
+
+    decoder->complete = TRUE;
+}
+
+/**
+ * cairo_png_decoder_create:
+ * @options: a #cairo_png_options_t, or %NULL for the defaults
+ *
+ * Creates a decoder for a PNG image whose data will be passed to
+ * cairo_png_decoder_write(). The decode scale of @options applies, so
+ * that a large image can be reduced while it is decoded, holding
+ * neither the file nor the full size image in memory.
+ *
+ * Return value: a newly allocated #cairo_png_decoder_t, to be freed
+ * with cairo_png_decoder_destroy(), or %NULL if out of memory. All the
+ * decoder functions accept %NULL.
+ *
+ * Since: 1.18
+ **/
+cairo_png_decoder_t *
+cairo_png_decoder_create (const cairo_png_options_t *options)
+{
+    cairo_png_decoder_t *decoder;
+
+    if (options == NULL)
+	options = &_cairo_png_options_default;
+
+    decoder = calloc (1, sizeof (cairo_png_decoder_t));
+    if (unlikely (decoder == NULL)) {
+	_cairo_error_throw (CAIRO_STATUS_NO_MEMORY);
+	return NULL;
+    }
+
+    decoder->status = CAIRO_STATUS_SUCCESS;
+    decoder->scale = options->decode_scale;
+
+    decoder->png = png_create_read_struct (PNG_LIBPNG_VER_STRING,
+					   &decoder->status,
+					   png_simple_error_callback,
+					   png_simple_warning_callback);
+    if (unlikely (decoder->png == NULL))
+	goto BAIL;
+
+    decoder->info = png_create_info_struct (decoder->png);
+    if (unlikely (decoder->info == NULL))
+	goto BAIL;
+
+    png_set_progressive_read_fn (decoder->png, decoder,
+				 png_decoder_info,
+				 png_decoder_row,
+				 png_decoder_end);
+
+    /* the PNG data does not describe a reduced image */
+    if (decoder->scale == 1)
+	decoder->png_data = _cairo_memory_stream_create ();
+
+    return decoder;
+
+  BAIL:
+    cairo_png_decoder_destroy (decoder);
+    _cairo_error_throw (CAIRO_STATUS_NO_MEMORY);
+    return NULL;
+}
+
+/**
+ * cairo_png_decoder_destroy:
+ * @decoder: a #cairo_png_decoder_t
+ *
+ * Frees the decoder. A reference to its surface, taken with
+ * cairo_surface_reference() or returned by cairo_png_decoder_finish(),
+ * remains valid.
+ *
+ * Since: 1.18
+ **/
+void
+cairo_png_decoder_destroy (cairo_png_decoder_t *decoder)
+{
+    if (decoder == NULL)
+	return;
+
+    if (decoder->png != NULL)
+	png_destroy_read_struct (&decoder->png, &decoder->info, NULL);
+
+    if (decoder->png_data != NULL) {
+	cairo_status_t status_ignored;
+
+	status_ignored = _cairo_output_stream_destroy (decoder->png_data);
+    }
+
+    png_scaler_destroy (decoder->scaler);
+    free (decoder->rows);
+    if (decoder->image != NULL)
+	cairo_surface_destroy (&decoder->image->base);
+
+    free (decoder);
+}
+
+/**
+ * cairo_png_decoder_set_rows_func:
+ * @decoder: a #cairo_png_decoder_t
+ * @rows_func: a #cairo_png_decoder_rows_func_t, or %NULL
+ * @closure: data to pass to @rows_func
+ *
+ * Sets a function to be called, from within cairo_png_decoder_write(),
+ * whenever rows of the surface have been decoded. Rows of an
+ * interlaced image are reported again as later passes refine them.
+ *
+ * Since: 1.18
+ **/
+void
+cairo_png_decoder_set_rows_func (cairo_png_decoder_t		*decoder,
+				 cairo_png_decoder_rows_func_t	 rows_func,
+				 void				*closure)
+{
+    if (decoder == NULL)
+	return;
+
+    decoder->rows_func = rows_func;
+    decoder->rows_closure = closure;
+}
+
+/**
+ * cairo_png_decoder_write:
+ * @decoder: a #cairo_png_decoder_t
+ * @data: the next bytes of the PNG file
+ * @length: the number of bytes in @data
+ *
+ * Decodes as much of the image as @data, following the data passed
+ * before it, allows. Data after the end of the image is ignored.
+ *
+ * Return value: %CAIRO_STATUS_SUCCESS, or the error that stopped the
+ * decoding, such as %CAIRO_STATUS_PNG_ERROR for a malformed image.
+ * Once an error has occurred, the same error is returned for any
+ * further data.
+ *
+ * Since: 1.18
+ **/
+cairo_status_t
+cairo_png_decoder_write (cairo_png_decoder_t	*decoder,
+			 const unsigned char	*data,
+			 unsigned int		 length)
+{
+    if (decoder == NULL)
+	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+
+    if (decoder->status || decoder->complete)
+	return decoder->status;
+
+    if (decoder->png_data != NULL)
+	_cairo_output_stream_write (decoder->png_data, data, length);
+
+#ifdef PNG_SETJMP_SUPPORTED
+    if (setjmp (png_jmpbuf (decoder->png)))
+	return decoder->status;
+#endif
+
+    png_process_data (decoder->png, decoder->info, (png_bytep) data, length);
+
+    return decoder->status;
+}
+
+/**
+ * cairo_png_decoder_get_surface:
+ * @decoder: a #cairo_png_decoder_t
+ *
+ * Gets the image surface being decoded into. Rows that have not been
+ * decoded yet are transparent, or black for an opaque image. The
+ * surface is owned by the decoder; call cairo_surface_reference() to
+ * keep it beyond cairo_png_decoder_destroy().
+ *
+ * Return value: the surface, or %NULL if the header of the image has
+ * not been decoded yet.
+ *
+ * Since: 1.18
+ **/
+cairo_surface_t *
+cairo_png_decoder_get_surface (cairo_png_decoder_t *decoder)
+{
+    if (decoder == NULL || decoder->image == NULL)
+	return NULL;
+
+    return &decoder->image->base;
+}
+
+/**
+ * cairo_png_decoder_finish:
+ * @decoder: a #cairo_png_decoder_t
+ *
+ * Checks that the whole image has been decoded and returns it, as
+ * cairo_image_surface_create_from_png_stream() would have.
+ *
+ * Return value: a new reference to the decoded surface, or a "nil"
+ * surface with the status %CAIRO_STATUS_READ_ERROR if the data ended
+ * before the image did, or the error that stopped the decoding.
+ *
+ * Since: 1.18
+ **/
+cairo_surface_t *
+cairo_png_decoder_finish (cairo_png_decoder_t *decoder)
+{
+    cairo_surface_t *surface;
+    cairo_status_t status;
+
+    if (decoder == NULL)
+	return _cairo_surface_create_in_error (_cairo_error (CAIRO_STATUS_NO_MEMORY));
+
+    if (decoder->status == CAIRO_STATUS_SUCCESS && ! decoder->complete)
+	decoder->status = _cairo_error (CAIRO_STATUS_READ_ERROR);
+    if (unlikely (decoder->status))
+	return _cairo_surface_create_in_error (decoder->status);
+
+    surface = cairo_surface_reference (&decoder->image->base);
+    _cairo_debug_check_image_surface_is_defined (surface);
+
+    if (decoder->png_data != NULL) {
+	unsigned char *mime_data;
+	unsigned long mime_data_length;
+
+	status = _cairo_memory_stream_destroy (decoder->png_data,
+					       &mime_data,
+					       &mime_data_length);
+	decoder->png_data = NULL;
+	if (unlikely (status)) {
+	    cairo_surface_destroy (surface);
+	    return _cairo_surface_create_in_error (status);
+	}
+
+	status = cairo_surface_set_mime_data (surface,
+					      CAIRO_MIME_TYPE_PNG,
+					      mime_data,
+					      mime_data_length,
+					      free,
+					      mime_data);
+	if (unlikely (status)) {
+	    free (mime_data);
+	    cairo_surface_destroy (surface);
+	    return _cairo_surface_create_in_error (status);
+	}
+    }
+
+    return surface;
 }
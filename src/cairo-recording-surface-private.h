@@ -209,4 +209,10 @@ _cairo_recording_surface_has_only_bilevel_alpha (cairo_recording_surface_t *surf
 cairo_private cairo_bool_t
 _cairo_recording_surface_has_only_op_over (cairo_recording_surface_t *surface);
 
+cairo_private cairo_bool_t
+_cairo_recording_surface_can_replay_concurrently (cairo_recording_surface_t *surface);
+
+cairo_private cairo_bool_t
+_cairo_recording_surface_has_tags_or_nested_recordings (cairo_recording_surface_t *surface);
+
 #endif /* CAIRO_RECORDING_SURFACE_H */
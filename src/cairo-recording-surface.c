@@ -88,6 +88,7 @@
 #include "cairo-image-surface-private.h"
 #include "cairo-recording-surface-inline.h"
 #include "cairo-surface-snapshot-inline.h"
+#include "cairo-surface-subsurface-inline.h"
 #include "cairo-surface-wrapper-private.h"
 #include "cairo-traps-private.h"
 
@@ -1724,11 +1725,16 @@ _cairo_recording_surface_get_path (cairo_surface_t    *abstract_surface,
     return status;
 }
 
+/* The indices of the visible commands are written to the caller's
+ * array, which must have room for every command, rather than to
+ * surface->indices so that several threads may replay the same surface
+ * into different targets at once. */
 static int
 _cairo_recording_surface_get_visible_commands (cairo_recording_surface_t *surface,
-					       const cairo_rectangle_int_t *extents)
+					       const cairo_rectangle_int_t *extents,
+					       unsigned int *indices)
 {
-    unsigned int num_visible, *indices;
+    unsigned int num_visible, *end;
     cairo_box_t box;
 
     if (surface->commands.num_elements == 0)
@@ -1736,14 +1742,16 @@ _cairo_recording_surface_get_visible_commands (cairo_recording_surface_t *surfac
 
     _cairo_box_from_rectangle (&box, extents);
 
+    CAIRO_MUTEX_LOCK (_cairo_recording_surface_bbtree_mutex);
     if (surface->bbtree.chain == INVALID_CHAIN)
 	_cairo_recording_surface_create_bbtree (surface);
+    CAIRO_MUTEX_UNLOCK (_cairo_recording_surface_bbtree_mutex);
 
-    indices = surface->indices;
-    bbtree_foreach_mark_visible (&surface->bbtree, &box, &indices);
-    num_visible = indices - surface->indices;
+    end = indices;
+    bbtree_foreach_mark_visible (&surface->bbtree, &box, &end);
+    num_visible = end - indices;
     if (num_visible > 1)
-	sort_indices (surface->indices, num_visible);
+	sort_indices (indices, num_visible);
 
     return num_visible;
 }
@@ -1826,7 +1834,8 @@ _cairo_recording_surface_replay_internal (cairo_recording_surface_t	*surface,
 	type == CAIRO_RECORDING_CREATE_REGIONS || region == CAIRO_RECORDING_REGION_ALL;
     cairo_int_status_t status = CAIRO_STATUS_SUCCESS;
     cairo_rectangle_int_t extents;
-    cairo_bool_t use_indices = FALSE;
+    unsigned int stack_indices[CAIRO_STACK_ARRAY_LENGTH (unsigned int)];
+    unsigned int *indices = NULL;
     const cairo_rectangle_int_t *r;
     unsigned int i, num_elements;
 
@@ -1859,19 +1868,35 @@ _cairo_recording_surface_replay_internal (cairo_recording_surface_t	*surface,
     if (! _cairo_surface_wrapper_get_target_extents (&wrapper, surface_is_unbounded, &extents))
 	goto done;
 
-    surface->has_bilevel_alpha = TRUE;
-    surface->has_only_op_over = TRUE;
+    if (type == CAIRO_RECORDING_CREATE_REGIONS) {
+	surface->has_bilevel_alpha = TRUE;
+	surface->has_only_op_over = TRUE;
+    }
 
     num_elements = surface->commands.num_elements;
     elements = _cairo_array_index (&surface->commands, 0);
     if (extents.width < r->width || extents.height < r->height) {
+	indices = stack_indices;
+	if (num_elements > ARRAY_LENGTH (stack_indices)) {
+	    indices = _cairo_malloc_ab (num_elements, sizeof (unsigned int));
+	    if (unlikely (indices == NULL)) {
+		status = _cairo_error (CAIRO_STATUS_NO_MEMORY);
+		goto done;
+	    }
+	}
+
 	num_elements =
-	    _cairo_recording_surface_get_visible_commands (surface, &extents);
-	use_indices = num_elements != surface->commands.num_elements;
+	    _cairo_recording_surface_get_visible_commands (surface, &extents,
+							   indices);
+	if (num_elements == surface->commands.num_elements) {
+	    if (indices != stack_indices)
+		free (indices);
+	    indices = NULL;
+	}
     }
 
     for (i = 0; i < num_elements; i++) {
-	cairo_command_t *command = elements[use_indices ? surface->indices[i] : i];
+	cairo_command_t *command = elements[indices ? indices[i] : i];
 
 	if (! replay_all && command->header.region != region)
 	    continue;
@@ -2041,6 +2066,9 @@ _cairo_recording_surface_replay_internal (cairo_recording_surface_t	*surface,
 	    break;
     }
 
+    if (indices != stack_indices)
+	free (indices);
+
 done:
     _cairo_surface_wrapper_fini (&wrapper);
     return _cairo_surface_set_error (&surface->base, status);
@@ -2355,3 +2383,164 @@ _cairo_recording_surface_has_only_op_over (cairo_recording_surface_t *surface)
 {
     return surface->has_only_op_over;
 }
+
+/* The type of the surface that a surface pattern ultimately draws from */
+static cairo_surface_type_t
+_pattern_get_surface_type (const cairo_pattern_t *pattern)
+{
+    cairo_surface_t *surface, *free_me = NULL;
+    cairo_surface_type_t type;
+
+    surface = ((const cairo_surface_pattern_t *) pattern)->surface;
+    if (_cairo_surface_is_snapshot (surface))
+	free_me = surface = _cairo_surface_snapshot_get_target (surface);
+    if (_cairo_surface_is_subsurface (surface))
+	surface = _cairo_surface_subsurface_get_target (surface);
+
+    type = surface->type;
+    cairo_surface_destroy (free_me);
+
+    return type;
+}
+
+static cairo_bool_t
+_pattern_can_replay_concurrently (const cairo_pattern_t *pattern)
+{
+    if (pattern->type == CAIRO_PATTERN_TYPE_RASTER_SOURCE)
+	return FALSE;
+
+    if (pattern->type != CAIRO_PATTERN_TYPE_SURFACE)
+	return TRUE;
+
+    return _pattern_get_surface_type (pattern) == CAIRO_SURFACE_TYPE_IMAGE;
+}
+
+/**
+ * _cairo_recording_surface_can_replay_concurrently:
+ * @surface: a #cairo_recording_surface_t
+ *
+ * Checks whether the recording may be replayed into several image
+ * surfaces by different threads at the same time.  That is not the
+ * case when any of the commands draws from a raster source, whose
+ * callbacks need not be thread safe, or from another recording
+ * surface, as rendering one of those to an image attaches state to
+ * the source surface.
+ *
+ * Return value: %TRUE if concurrent replays are safe.
+ **/
+cairo_bool_t
+_cairo_recording_surface_can_replay_concurrently (cairo_recording_surface_t *surface)
+{
+    cairo_command_t **elements;
+    int i, num_elements;
+
+    num_elements = surface->commands.num_elements;
+    elements = _cairo_array_index (&surface->commands, 0);
+    for (i = 0; i < num_elements; i++) {
+	cairo_command_t *command = elements[i];
+
+	switch (command->header.type) {
+	case CAIRO_COMMAND_PAINT:
+	    if (! _pattern_can_replay_concurrently (&command->paint.source.base))
+		return FALSE;
+	    break;
+
+	case CAIRO_COMMAND_MASK:
+	    if (! _pattern_can_replay_concurrently (&command->mask.source.base) ||
+		! _pattern_can_replay_concurrently (&command->mask.mask.base))
+		return FALSE;
+	    break;
+
+	case CAIRO_COMMAND_STROKE:
+	    if (! _pattern_can_replay_concurrently (&command->stroke.source.base))
+		return FALSE;
+	    break;
+
+	case CAIRO_COMMAND_FILL:
+	    if (! _pattern_can_replay_concurrently (&command->fill.source.base))
+		return FALSE;
+	    break;
+
+	case CAIRO_COMMAND_SHOW_TEXT_GLYPHS:
+	    if (! _pattern_can_replay_concurrently (&command->show_text_glyphs.source.base))
+		return FALSE;
+	    break;
+
+	case CAIRO_COMMAND_TAG:
+	    break;
+
+	default:
+	    ASSERT_NOT_REACHED;
+	}
+    }
+
+    return TRUE;
+}
+
+static cairo_bool_t
+_pattern_is_recording (const cairo_pattern_t *pattern)
+{
+    return pattern->type == CAIRO_PATTERN_TYPE_SURFACE &&
+	_pattern_get_surface_type (pattern) == CAIRO_SURFACE_TYPE_RECORDING;
+}
+
+/**
+ * _cairo_recording_surface_has_tags_or_nested_recordings:
+ * @surface: a #cairo_recording_surface_t
+ *
+ * Checks whether any of the commands is a tag or draws from another
+ * recording surface.  Analysing such a recording has effects beyond
+ * the regions of its own commands: tags are added to the document
+ * structure of the target and the regions of the nested recordings
+ * are updated as well.
+ *
+ * Return value: %TRUE if there is a tag or a nested recording.
+ **/
+cairo_bool_t
+_cairo_recording_surface_has_tags_or_nested_recordings (cairo_recording_surface_t *surface)
+{
+    cairo_command_t **elements;
+    int i, num_elements;
+
+    num_elements = surface->commands.num_elements;
+    elements = _cairo_array_index (&surface->commands, 0);
+    for (i = 0; i < num_elements; i++) {
+	cairo_command_t *command = elements[i];
+
+	switch (command->header.type) {
+	case CAIRO_COMMAND_PAINT:
+	    if (_pattern_is_recording (&command->paint.source.base))
+		return TRUE;
+	    break;
+
+	case CAIRO_COMMAND_MASK:
+	    if (_pattern_is_recording (&command->mask.source.base) ||
+		_pattern_is_recording (&command->mask.mask.base))
+		return TRUE;
+	    break;
+
+	case CAIRO_COMMAND_STROKE:
+	    if (_pattern_is_recording (&command->stroke.source.base))
+		return TRUE;
+	    break;
+
+	case CAIRO_COMMAND_FILL:
+	    if (_pattern_is_recording (&command->fill.source.base))
+		return TRUE;
+	    break;
+
+	case CAIRO_COMMAND_SHOW_TEXT_GLYPHS:
+	    if (_pattern_is_recording (&command->show_text_glyphs.source.base))
+		return TRUE;
+	    break;
+
+	case CAIRO_COMMAND_TAG:
+	    return TRUE;
+
+	default:
+	    ASSERT_NOT_REACHED;
+	}
+    }
+
+    return FALSE;
+}
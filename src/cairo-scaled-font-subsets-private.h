@@ -224,6 +224,16 @@ typedef cairo_int_status_t
 (*cairo_scaled_font_subset_callback_func_t) (cairo_scaled_font_subset_t	*font_subset,
 					     void			*closure);
 
+typedef cairo_int_status_t
+(*cairo_scaled_font_subset_prepare_func_t) (cairo_scaled_font_subset_t	*font_subset,
+					    void			*closure,
+					    void		       **prepared);
+
+typedef cairo_int_status_t
+(*cairo_scaled_font_subset_emit_func_t) (cairo_scaled_font_subset_t	*font_subset,
+					 void				*prepared,
+					 void				*closure);
+
 /**
  * _cairo_scaled_font_subsets_foreach_scaled:
  * @font_subsets: a #cairo_scaled_font_subsets_t
@@ -294,6 +304,41 @@ _cairo_scaled_font_subsets_foreach_unscaled (cairo_scaled_font_subsets_t
                                              cairo_scaled_font_subset_callback_func_t  font_subset_callback,
 				             void				      *closure);
 
+/**
+ * _cairo_scaled_font_subsets_foreach_unscaled_parallel:
+ * @font_subsets: a #cairo_scaled_font_subsets_t
+ * @prepare: a function to be called for each font subset, concurrently
+ * @emit: a function to be called for each prepared font subset, in order
+ * @destroy: a function to free the data returned by @prepare
+ * @closure: closure data for the callback functions
+ *
+ * Like _cairo_scaled_font_subsets_foreach_unscaled(), but with the
+ * work for each subset split in two. @prepare is called on worker
+ * threads for several subsets at once and may store the expensive
+ * part of the work, such as the subset font program, in *prepared.
+ * It must not modify anything shared between subsets. It may call into
+ * the font backend, which is only done concurrently for FreeType fonts;
+ * if any subset uses another backend, @prepare is called for one subset
+ * at a time on the calling thread. @emit is then
+ * called for every subset in the same order as
+ * _cairo_scaled_font_subsets_foreach_unscaled() would, so the output
+ * does not depend upon the number of threads.
+ *
+ * @destroy is called for every non-%NULL prepared pointer, whether or
+ * not it was passed to @emit. If @prepare fails, the error is returned
+ * once all the preceding subsets have been emitted.
+ *
+ * Return value: %CAIRO_STATUS_SUCCESS if successful, or a non-zero
+ * value indicating an error. Possible errors include
+ * %CAIRO_STATUS_NO_MEMORY.
+ **/
+cairo_private cairo_status_t
+_cairo_scaled_font_subsets_foreach_unscaled_parallel (cairo_scaled_font_subsets_t	     *font_subsets,
+						      cairo_scaled_font_subset_prepare_func_t prepare,
+						      cairo_scaled_font_subset_emit_func_t    emit,
+						      cairo_destroy_func_t		      destroy,
+						      void				     *closure);
+
 /**
  * _cairo_scaled_font_subsets_foreach_user:
  * @font_subsets: a #cairo_scaled_font_subsets_t
@@ -344,6 +389,33 @@ _cairo_scaled_font_subsets_foreach_user (cairo_scaled_font_subsets_t		  *font_su
 cairo_private cairo_int_status_t
 _cairo_scaled_font_subset_create_glyph_names (cairo_scaled_font_subset_t *subset);
 
+/**
+ * _cairo_scaled_font_subset_load_table:
+ * @subset: a #cairo_scaled_font_subset_t
+ * @tag: the TrueType table tag
+ * @offset: the offset into the table
+ * @buffer: the buffer to copy the table into, or %NULL to query its size
+ * @length: the number of bytes to read, returns the table size if
+ * @buffer is %NULL
+ *
+ * Reads a TrueType table of the font being subset, with the same
+ * semantics as the load_truetype_table backend function. The tables
+ * are loaded once and shared between all the subsets of a font, so
+ * the subsetters do not go back to the font backend for every subset
+ * of a large document.
+ *
+ * Return value: %CAIRO_STATUS_SUCCESS if successful,
+ * %CAIRO_INT_STATUS_UNSUPPORTED if the font does not have the table or
+ * the read is out of bounds. Possible errors include
+ * %CAIRO_STATUS_NO_MEMORY.
+ **/
+cairo_private cairo_int_status_t
+_cairo_scaled_font_subset_load_table (cairo_scaled_font_subset_t *subset,
+				      unsigned long		  tag,
+				      long			  offset,
+				      unsigned char		 *buffer,
+				      unsigned long		 *length);
+
 typedef struct _cairo_cff_subset {
     char *family_name_utf8;
     char *ps_name;
@@ -42,7 +42,9 @@
 
 #define _DEFAULT_SOURCE /* for snprintf(), strdup() */
 #include "cairoint.h"
+#include "cairo-array-private.h"
 #include "cairo-error-private.h"
+#include "cairo-parallel-private.h"
 
 #if CAIRO_HAS_FONT_SUBSET
 
@@ -52,6 +54,10 @@
 #define MAX_GLYPHS_PER_SIMPLE_FONT 256
 #define MAX_GLYPHS_PER_COMPOSITE_FONT 65536
 
+/* Tables larger than this are only cached when read in full, so that
+ * reading a few glyphs from a large glyf table does not load all of it. */
+#define MAX_PARTIAL_TABLE_CACHE_SIZE (256 * 1024)
+
 typedef enum {
     CAIRO_SUBSETS_SCALED,
     CAIRO_SUBSETS_SIMPLE,
@@ -64,6 +70,18 @@ typedef enum {
     CAIRO_SUBSETS_FOREACH_USER
 } cairo_subsets_foreach_type_t;
 
+typedef struct _cairo_font_table {
+    unsigned long tag;
+    cairo_int_status_t status;
+    unsigned long length;
+    unsigned char *data; /* NULL if not cached */
+} cairo_font_table_t;
+
+typedef struct _cairo_font_table_cache {
+    cairo_mutex_t mutex;
+    cairo_array_t tables;
+} cairo_font_table_cache_t;
+
 typedef struct _cairo_sub_font {
     cairo_hash_entry_t base;
 
@@ -83,6 +101,7 @@ typedef struct _cairo_sub_font {
     char latin_char_map[256];
 
     cairo_hash_table_t *sub_font_glyphs;
+    cairo_font_table_cache_t table_cache;
     struct _cairo_sub_font *next;
 } cairo_sub_font_t;
 
@@ -316,11 +335,28 @@ _cairo_sub_font_create (cairo_scaled_font_subsets_t	*parent,
 	free (sub_font);
 	return _cairo_error (CAIRO_STATUS_NO_MEMORY);
     }
+    CAIRO_MUTEX_INIT (sub_font->table_cache.mutex);
+    _cairo_array_init (&sub_font->table_cache.tables, sizeof (cairo_font_table_t));
     sub_font->next = NULL;
     *sub_font_out = sub_font;
     return CAIRO_STATUS_SUCCESS;
 }
 
+static void
+_cairo_font_table_cache_fini (cairo_font_table_cache_t *cache)
+{
+    cairo_font_table_t *tables;
+    unsigned int i, num_tables;
+
+    tables = _cairo_array_index (&cache->tables, 0);
+    num_tables = _cairo_array_num_elements (&cache->tables);
+    for (i = 0; i < num_tables; i++)
+	free (tables[i].data);
+
+    _cairo_array_fini (&cache->tables);
+    CAIRO_MUTEX_FINI (cache->mutex);
+}
+
 static void
 _cairo_sub_font_destroy (cairo_sub_font_t *sub_font)
 {
@@ -328,6 +364,7 @@ _cairo_sub_font_destroy (cairo_sub_font_t *sub_font)
 			       _cairo_sub_font_glyph_pluck,
 			       sub_font->sub_font_glyphs);
     _cairo_hash_table_destroy (sub_font->sub_font_glyphs);
+    _cairo_font_table_cache_fini (&sub_font->table_cache);
     cairo_scaled_font_destroy (sub_font->scaled_font);
     free (sub_font);
 }
@@ -728,6 +765,8 @@ _cairo_sub_font_collect (void *entry, void *closure)
 	subset.num_glyphs = collection->num_glyphs;
         subset.glyph_names = NULL;
 
+	subset.table_cache = &sub_font->table_cache;
+
 	subset.is_latin = FALSE;
 	if (sub_font->use_latin_subset && i == 0) {
 	    subset.is_latin = TRUE;
@@ -1104,6 +1143,188 @@ _cairo_scaled_font_subsets_foreach_user (cairo_scaled_font_subsets_t		  *font_su
 							CAIRO_SUBSETS_FOREACH_USER);
 }
 
+typedef struct _cairo_subset_job {
+    cairo_scaled_font_subset_t subset;
+    void *prepared;
+    cairo_int_status_t status;
+} cairo_subset_job_t;
+
+typedef struct _cairo_subset_jobs {
+    cairo_array_t jobs;
+    unsigned int first;
+    cairo_scaled_font_subset_prepare_func_t prepare;
+    void *closure;
+} cairo_subset_jobs_t;
+
+/* The arrays of the subset passed to a foreach callback are reused for
+ * the next subset, keep a copy of them. The utf8 strings belong to the
+ * sub font and outlive the jobs. */
+static cairo_int_status_t
+_cairo_subset_jobs_add (cairo_scaled_font_subset_t *font_subset,
+			void			   *closure)
+{
+    cairo_subset_jobs_t *jobs = closure;
+    cairo_subset_job_t job;
+    cairo_int_status_t status;
+    unsigned int n = font_subset->num_glyphs;
+
+    job.subset = *font_subset;
+    job.prepared = NULL;
+    job.status = CAIRO_INT_STATUS_SUCCESS;
+
+    job.subset.glyphs = _cairo_malloc_ab (n, sizeof (unsigned long));
+    job.subset.utf8 = _cairo_malloc_ab (n, sizeof (char *));
+    job.subset.to_latin_char = NULL;
+    job.subset.latin_to_subset_glyph_index = NULL;
+    if (font_subset->to_latin_char) {
+	job.subset.to_latin_char = _cairo_malloc_ab (n, sizeof (int));
+	job.subset.latin_to_subset_glyph_index = _cairo_malloc_ab (256, sizeof (unsigned long));
+    }
+    if (unlikely (job.subset.glyphs == NULL ||
+		  job.subset.utf8 == NULL ||
+		  (font_subset->to_latin_char &&
+		   (job.subset.to_latin_char == NULL ||
+		    job.subset.latin_to_subset_glyph_index == NULL))))
+    {
+	status = _cairo_error (CAIRO_STATUS_NO_MEMORY);
+	goto fail;
+    }
+
+    memcpy (job.subset.glyphs, font_subset->glyphs, n * sizeof (unsigned long));
+    memcpy (job.subset.utf8, font_subset->utf8, n * sizeof (char *));
+    if (font_subset->to_latin_char) {
+	memcpy (job.subset.to_latin_char, font_subset->to_latin_char,
+		n * sizeof (int));
+	memcpy (job.subset.latin_to_subset_glyph_index,
+		font_subset->latin_to_subset_glyph_index,
+		256 * sizeof (unsigned long));
+    }
+
+    status = _cairo_array_append (&jobs->jobs, &job);
+    if (unlikely (status))
+	goto fail;
+
+    return CAIRO_INT_STATUS_SUCCESS;
+
+fail:
+    free (job.subset.glyphs);
+    free (job.subset.utf8);
+    free (job.subset.to_latin_char);
+    free (job.subset.latin_to_subset_glyph_index);
+    return status;
+}
+
+static void
+_cairo_subset_job_fini (cairo_subset_job_t *job,
+			cairo_destroy_func_t destroy)
+{
+    unsigned int j;
+
+    if (job->prepared)
+	destroy (job->prepared);
+
+    if (job->subset.glyph_names != NULL) {
+	for (j = 0; j < job->subset.num_glyphs; j++)
+	    free (job->subset.glyph_names[j]);
+	free (job->subset.glyph_names);
+    }
+
+    free (job->subset.glyphs);
+    free (job->subset.utf8);
+    free (job->subset.to_latin_char);
+    free (job->subset.latin_to_subset_glyph_index);
+}
+
+static void
+_cairo_subset_jobs_prepare (void *closure, int index)
+{
+    cairo_subset_jobs_t *jobs = closure;
+    cairo_subset_job_t *job;
+
+    job = _cairo_array_index (&jobs->jobs, jobs->first + index);
+    job->status = jobs->prepare (&job->subset, jobs->closure, &job->prepared);
+}
+
+/* The subsetters call into the font backend (to load tables and glyph
+ * outlines, or map glyphs to unicode), so preparing two subsets at once
+ * is only safe if the backend allows two calls on the same font at once.
+ * The FreeType backend does: every call locks the face of the unscaled
+ * font around its use, opening faces goes through the font map lock,
+ * and the fallback subsetters get glyphs through a scaled font with a
+ * frozen cache, which holds the scaled font mutex. Other backends, such
+ * as win32 which selects fonts into a shared device context, make no
+ * such promise, so their subsets are prepared one after another.
+ */
+static cairo_bool_t
+_cairo_subset_jobs_can_run_in_parallel (cairo_subset_jobs_t *jobs)
+{
+    const cairo_subset_job_t *job;
+    unsigned int i, num_jobs;
+
+    num_jobs = _cairo_array_num_elements (&jobs->jobs);
+    for (i = 0; i < num_jobs; i++) {
+	job = _cairo_array_index_const (&jobs->jobs, i);
+	if (job->subset.scaled_font->backend->type != CAIRO_FONT_TYPE_FT)
+	    return FALSE;
+    }
+
+    return TRUE;
+}
+
+cairo_status_t
+_cairo_scaled_font_subsets_foreach_unscaled_parallel (cairo_scaled_font_subsets_t	     *font_subsets,
+						      cairo_scaled_font_subset_prepare_func_t prepare,
+						      cairo_scaled_font_subset_emit_func_t    emit,
+						      cairo_destroy_func_t		      destroy,
+						      void				     *closure)
+{
+    cairo_subset_jobs_t jobs;
+    cairo_subset_job_t *job;
+    cairo_int_status_t status;
+    unsigned int i, num_jobs, batch;
+    cairo_bool_t parallel;
+
+    _cairo_array_init (&jobs.jobs, sizeof (cairo_subset_job_t));
+    jobs.prepare = prepare;
+    jobs.closure = closure;
+
+    status = _cairo_scaled_font_subsets_foreach_internal (font_subsets,
+							  _cairo_subset_jobs_add,
+							  &jobs,
+							  CAIRO_SUBSETS_FOREACH_UNSCALED);
+    num_jobs = _cairo_array_num_elements (&jobs.jobs);
+    parallel = _cairo_subset_jobs_can_run_in_parallel (&jobs);
+
+    /* Prepare a few subsets per thread at a time to bound the memory
+     * held by prepared subsets that are waiting to be emitted. */
+    batch = parallel ? 2 * _cairo_parallel_num_threads () : 1;
+    for (jobs.first = 0; status == CAIRO_INT_STATUS_SUCCESS && jobs.first < num_jobs; jobs.first += batch) {
+	unsigned int count = MIN (batch, num_jobs - jobs.first);
+
+	if (parallel)
+	    _cairo_parallel_for (count, _cairo_subset_jobs_prepare, &jobs);
+	else
+	    _cairo_subset_jobs_prepare (&jobs, 0);
+
+	for (i = jobs.first; i < jobs.first + count; i++) {
+	    job = _cairo_array_index (&jobs.jobs, i);
+	    status = job->status;
+	    if (unlikely (status))
+		break;
+
+	    status = emit (&job->subset, job->prepared, closure);
+	    if (unlikely (status))
+		break;
+	}
+    }
+
+    for (i = 0; i < num_jobs; i++)
+	_cairo_subset_job_fini (_cairo_array_index (&jobs.jobs, i), destroy);
+    _cairo_array_fini (&jobs.jobs);
+
+    return status;
+}
+
 static cairo_bool_t
 _cairo_string_equal (const void *key_a, const void *key_b)
 {
@@ -1378,4 +1599,133 @@ _cairo_escape_ps_name (char **ps_name)
     return status;
 }
 
+static cairo_int_status_t
+_cairo_font_table_cache_load (cairo_font_table_cache_t	*cache,
+			      cairo_scaled_font_t	*scaled_font,
+			      unsigned long		 tag,
+			      unsigned long		 wanted,
+			      cairo_font_table_t	**table_out)
+{
+    const cairo_scaled_font_backend_t *backend = scaled_font->backend;
+    cairo_font_table_t table;
+    cairo_int_status_t status;
+
+    table.tag = tag;
+    table.length = 0;
+    table.data = NULL;
+    table.status = backend->load_truetype_table (scaled_font, tag, 0,
+						 NULL, &table.length);
+    if (table.status == CAIRO_INT_STATUS_SUCCESS &&
+	(wanted >= table.length || table.length <= MAX_PARTIAL_TABLE_CACHE_SIZE))
+    {
+	table.data = _cairo_malloc (table.length);
+	if (unlikely (table.data == NULL && table.length))
+	    return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+
+	table.status = backend->load_truetype_table (scaled_font, tag, 0,
+						     table.data, &table.length);
+	if (table.status) {
+	    free (table.data);
+	    table.data = NULL;
+	}
+    }
+
+    /* Real errors are not cached and are returned to the caller. Only
+     * an UNSUPPORTED result, for a table the font does not have, is
+     * remembered, so that the font is not asked for it again. */
+    if (_cairo_int_status_is_error (table.status)) {
+	free (table.data);
+	return table.status;
+    }
+
+    status = _cairo_array_append (&cache->tables, &table);
+    if (unlikely (status)) {
+	free (table.data);
+	return status;
+    }
+
+    *table_out = _cairo_array_index (&cache->tables,
+				     _cairo_array_num_elements (&cache->tables) - 1);
+    return CAIRO_INT_STATUS_SUCCESS;
+}
+
+cairo_int_status_t
+_cairo_scaled_font_subset_load_table (cairo_scaled_font_subset_t *subset,
+				      unsigned long		  tag,
+				      long			  offset,
+				      unsigned char		 *buffer,
+				      unsigned long		 *length)
+{
+    const cairo_scaled_font_backend_t *backend = subset->scaled_font->backend;
+    cairo_font_table_cache_t *cache = subset->table_cache;
+    cairo_font_table_t *table = NULL;
+    cairo_font_table_t found;
+    cairo_int_status_t status;
+    unsigned int i, num_tables;
+
+    if (backend->load_truetype_table == NULL)
+	return CAIRO_INT_STATUS_UNSUPPORTED;
+
+    if (cache == NULL)
+	return backend->load_truetype_table (subset->scaled_font, tag, offset,
+					     buffer, length);
+
+    /* Subsets of the same font may be generated concurrently. Loaded
+     * tables are never modified or freed until the cache is destroyed,
+     * so only the lookup needs the lock. */
+    CAIRO_MUTEX_LOCK (cache->mutex);
+    num_tables = _cairo_array_num_elements (&cache->tables);
+    for (i = 0; i < num_tables; i++) {
+	cairo_font_table_t *t = _cairo_array_index (&cache->tables, i);
+	if (t->tag == tag) {
+	    table = t;
+	    break;
+	}
+    }
+
+    if (table == NULL) {
+	unsigned long wanted;
+
+	/* A size query is nearly always followed by reading the table */
+	if (buffer == NULL || *length == 0)
+	    wanted = ULONG_MAX;
+	else if (offset == 0)
+	    wanted = *length;
+	else
+	    wanted = 0;
+
+	status = _cairo_font_table_cache_load (cache, subset->scaled_font, tag,
+					       wanted, &table);
+	if (unlikely (status)) {
+	    CAIRO_MUTEX_UNLOCK (cache->mutex);
+	    return status;
+	}
+    }
+    found = *table;
+    CAIRO_MUTEX_UNLOCK (cache->mutex);
+
+    if (found.status)
+	return found.status;
+
+    if (buffer == NULL || *length == 0) {
+	*length = found.length;
+	return CAIRO_INT_STATUS_SUCCESS;
+    }
+
+    /* too large to keep around, read the piece asked for directly */
+    if (found.data == NULL)
+	return backend->load_truetype_table (subset->scaled_font, tag, offset,
+					     buffer, length);
+
+    if (offset < 0 ||
+	(unsigned long) offset > found.length ||
+	*length > found.length - offset)
+    {
+	return CAIRO_INT_STATUS_UNSUPPORTED;
+    }
+
+    memcpy (buffer, found.data + offset, *length);
+    return CAIRO_INT_STATUS_SUCCESS;
+}
+
 #endif /* CAIRO_HAS_FONT_SUBSET */
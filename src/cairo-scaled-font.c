@@ -45,6 +45,7 @@
 #include "cairo-pattern-private.h"
 #include "cairo-scaled-font-private.h"
 #include "cairo-surface-backend-private.h"
+#include "cairo-time-private.h"
 
 /**
  * SECTION:cairo-scaled-font
@@ -822,14 +823,16 @@ _cairo_scaled_font_reset_cache (cairo_scaled_font_t *scaled_font)
     assert (! scaled_font->global_cache_frozen);
     CAIRO_MUTEX_LOCK (_cairo_scaled_glyph_page_cache_mutex);
 
+    /* Temporarily disconnect callback to avoid recursive locking */
+    cairo_scaled_glyph_page_cache.entry_destroy = NULL;
     cairo_list_foreach_entry (page,
 			      cairo_scaled_glyph_page_t,
 			      &scaled_font->glyph_pages,
 			      link) {
-	cairo_scaled_glyph_page_cache.size -= page->cache_entry.size;
-	_cairo_hash_table_remove (cairo_scaled_glyph_page_cache.hash_table,
-				  (cairo_hash_entry_t *) &page->cache_entry);
+	_cairo_cache_remove (&cairo_scaled_glyph_page_cache,
+			     &page->cache_entry);
     }
+    cairo_scaled_glyph_page_cache.entry_destroy = _cairo_scaled_glyph_page_pluck;
 
     CAIRO_MUTEX_UNLOCK (_cairo_scaled_glyph_page_cache_mutex);
 
@@ -2855,6 +2858,22 @@ _cairo_scaled_glyph_page_can_remove (const void *closure)
     return scaled_font->cache_frozen == 0;
 }
 
+/* Charge the time spent rendering a glyph to its page, in microseconds.
+ * The cost is shared with the eviction in the global page cache, so it
+ * is updated under the page cache mutex. */
+static void
+_cairo_scaled_glyph_page_add_cost (cairo_scaled_glyph_page_t *page,
+				   cairo_time_t start)
+{
+    unsigned long cost;
+
+    cost = _cairo_time_to_ns (_cairo_time_get_delta (start)) / 1000 + 1;
+
+    CAIRO_MUTEX_LOCK (_cairo_scaled_glyph_page_cache_mutex);
+    page->cache_entry.cost += cost;
+    CAIRO_MUTEX_UNLOCK (_cairo_scaled_glyph_page_cache_mutex);
+}
+
 static cairo_status_t
 _cairo_scaled_font_allocate_glyph (cairo_scaled_font_t *scaled_font,
 				   cairo_scaled_glyph_t **scaled_glyph)
@@ -2882,6 +2901,7 @@ _cairo_scaled_font_allocate_glyph (cairo_scaled_font_t *scaled_font,
     page->cache_entry.hash = (unsigned long) scaled_font;
     page->scaled_font = scaled_font;
     page->cache_entry.size = 1; /* XXX occupancy weighting? */
+    page->cache_entry.cost = 0;
     page->num_glyphs = 0;
 
     CAIRO_MUTEX_LOCK (_cairo_scaled_glyph_page_cache_mutex);
@@ -2897,6 +2917,10 @@ _cairo_scaled_font_allocate_glyph (cairo_scaled_font_t *scaled_font,
 		free (page);
 		return status;
 	    }
+
+	    /* Keep the pages whose glyphs took longest to render */
+	    _cairo_cache_set_policy (&cairo_scaled_glyph_page_cache,
+				     CAIRO_CACHE_POLICY_COST);
 	}
 
 	_cairo_cache_freeze (&cairo_scaled_glyph_page_cache);
@@ -2986,6 +3010,7 @@ _cairo_scaled_glyph_lookup (cairo_scaled_font_t *scaled_font,
     cairo_int_status_t		 status = CAIRO_INT_STATUS_SUCCESS;
     cairo_scaled_glyph_t	*scaled_glyph;
     cairo_scaled_glyph_info_t	 need_info;
+    cairo_time_t		 start;
 
     *scaled_glyph_ret = NULL;
 
@@ -3011,12 +3036,18 @@ _cairo_scaled_glyph_lookup (cairo_scaled_font_t *scaled_font,
 	memset (scaled_glyph, 0, sizeof (cairo_scaled_glyph_t));
 	_cairo_scaled_glyph_set_index (scaled_glyph, index);
 	cairo_list_init (&scaled_glyph->dev_privates);
+	/* glyphs are always allocated from the last page */
+	scaled_glyph->page = cairo_list_last_entry (&scaled_font->glyph_pages,
+						    cairo_scaled_glyph_page_t,
+						    link);
 
 	/* ask backend to initialize metrics and shape fields */
+	start = _cairo_time_get ();
 	status =
 	    scaled_font->backend->scaled_glyph_init (scaled_font,
 						     scaled_glyph,
 						     info | CAIRO_SCALED_GLYPH_INFO_METRICS);
+	_cairo_scaled_glyph_page_add_cost (scaled_glyph->page, start);
 	if (unlikely (status)) {
 	    _cairo_scaled_font_free_last_glyph (scaled_font, scaled_glyph);
 	    goto err;
@@ -3028,6 +3059,10 @@ _cairo_scaled_glyph_lookup (cairo_scaled_font_t *scaled_font,
 	    _cairo_scaled_font_free_last_glyph (scaled_font, scaled_glyph);
 	    goto err;
 	}
+    } else {
+	/* Only a hint for the eviction, so no need for the page cache
+	 * mutex (see _cairo_cache_entry_mark_used()). */
+	_cairo_cache_entry_mark_used (&scaled_glyph->page->cache_entry);
     }
 
     /*
@@ -3036,9 +3071,11 @@ _cairo_scaled_glyph_lookup (cairo_scaled_font_t *scaled_font,
      */
     need_info = info & ~scaled_glyph->has_info;
     if (need_info) {
+	start = _cairo_time_get ();
 	status = scaled_font->backend->scaled_glyph_init (scaled_font,
 							  scaled_glyph,
 							  need_info);
+	_cairo_scaled_glyph_page_add_cost (scaled_glyph->page, start);
 	if (unlikely (status))
 	    goto err;
 
@@ -79,10 +79,10 @@ clip_and_composite_polygon (const cairo_spans_compositor_t	*compositor,
 			    cairo_fill_rule_t			 fill_rule,
 			    cairo_antialias_t			 antialias);
 static cairo_surface_t *
-get_clip_surface (const cairo_spans_compositor_t *compositor,
-		  cairo_surface_t *dst,
-		  const cairo_clip_t *clip,
-		  const cairo_rectangle_int_t *extents)
+create_clip_surface (const cairo_spans_compositor_t *compositor,
+		     cairo_surface_t *dst,
+		     const cairo_clip_t *clip,
+		     const cairo_rectangle_int_t *extents)
 {
     cairo_composite_rectangles_t composite;
     cairo_surface_t *surface;
@@ -238,6 +238,32 @@ error:
     return _cairo_int_surface_create_in_error (status);
 }
 
+/* As create_clip_surface(), but the mask may be shared with other
+ * operations under the same clip and so must not be modified.  It covers
+ * at least @extents, with its origin at (*tx, *ty). */
+static cairo_surface_t *
+get_clip_surface (const cairo_spans_compositor_t *compositor,
+		  cairo_surface_t *dst,
+		  const cairo_clip_t *clip,
+		  const cairo_rectangle_int_t *extents,
+		  int *tx, int *ty)
+{
+    cairo_rectangle_int_t r;
+    cairo_surface_t *surface;
+
+    surface = _cairo_clip_lookup_mask (clip, dst, extents, tx, ty);
+    if (surface != NULL)
+	return surface;
+
+    _cairo_clip_get_mask_extents (clip, dst, extents, &r);
+    surface = create_clip_surface (compositor, dst, clip, &r);
+    _cairo_clip_cache_mask (clip, dst, &r, surface);
+
+    *tx = r.x;
+    *ty = r.y;
+    return surface;
+}
+
 static cairo_int_status_t
 fixup_unbounded_mask (const cairo_spans_compositor_t *compositor,
 		      const cairo_composite_rectangles_t *extents,
@@ -246,11 +272,12 @@ fixup_unbounded_mask (const cairo_spans_compositor_t *compositor,
     cairo_composite_rectangles_t composite;
     cairo_surface_t *clip;
     cairo_int_status_t status;
+    int clip_x, clip_y;
 
     TRACE((stderr, "%s\n", __FUNCTION__));
 
     clip = get_clip_surface (compositor, extents->surface, extents->clip,
-			     &extents->unbounded);
+			     &extents->unbounded, &clip_x, &clip_y);
     if (unlikely (clip->status)) {
 	if ((cairo_int_status_t)clip->status == CAIRO_INT_STATUS_NOTHING_TO_DO)
 	    return CAIRO_STATUS_SUCCESS;
@@ -268,6 +295,8 @@ fixup_unbounded_mask (const cairo_spans_compositor_t *compositor,
 	goto cleanup_clip;
 
     _cairo_pattern_init_for_surface (&composite.mask_pattern.surface, clip);
+    cairo_matrix_init_translate (&composite.mask_pattern.base.matrix,
+				 -clip_x, -clip_y);
     composite.mask_pattern.base.filter = CAIRO_FILTER_NEAREST;
     composite.mask_pattern.base.extend = CAIRO_EXTEND_NONE;
 
@@ -541,6 +570,18 @@ _clip_is_region (const cairo_clip_t *clip)
     return TRUE;
 }
 
+/* A pixel-aligned clip of many boxes is applied to the spans of a
+ * bounded operation as they are rendered, instead of first cutting the
+ * polygon against every box. */
+static cairo_bool_t
+_clip_is_banded_region (const cairo_composite_rectangles_t *extents)
+{
+    return extents->is_bounded &&
+	   extents->clip->num_boxes > 1 &&
+	   extents->clip->path == NULL &&
+	   _clip_is_region (extents->clip);
+}
+
 static cairo_int_status_t
 composite_aligned_boxes (const cairo_spans_compositor_t		*compositor,
 			 const cairo_composite_rectangles_t	*extents,
@@ -637,13 +678,22 @@ composite_aligned_boxes (const cairo_spans_compositor_t		*compositor,
 
 	/* All typical cases will have been resolved before now... */
 	if (need_clip_mask) {
-	    mask = get_clip_surface (compositor, dst, extents->clip,
-				     &extents->bounded);
+	    /* the mask pattern is combined into the clip below */
+	    if (no_mask) {
+		mask = get_clip_surface (compositor, dst, extents->clip,
+					 &extents->bounded,
+					 &mask_x, &mask_y);
+	    } else {
+		mask = create_clip_surface (compositor, dst, extents->clip,
+					    &extents->bounded);
+		mask_x = extents->bounded.x;
+		mask_y = extents->bounded.y;
+	    }
 	    if (unlikely (mask->status))
 		return mask->status;
 
-	    mask_x = -extents->bounded.x;
-	    mask_y = -extents->bounded.y;
+	    mask_x = -mask_x;
+	    mask_y = -mask_y;
 	}
 
 	/* XXX but this is still ugly */
@@ -797,8 +847,24 @@ composite_polygon (const cairo_spans_compositor_t	*compositor,
 
     status = compositor->renderer_init (&renderer, extents,
 					antialias, needs_clip);
-    if (likely (status == CAIRO_INT_STATUS_SUCCESS))
-	status = converter->generate (converter, &renderer.base);
+    if (likely (status == CAIRO_INT_STATUS_SUCCESS)) {
+	if (_clip_is_banded_region (extents)) {
+	    cairo_clip_span_renderer_t clipper;
+
+	    TRACE ((stderr, "%s - clipping spans to %d boxes\n",
+		    __FUNCTION__, extents->clip->num_boxes));
+	    status = _cairo_clip_span_renderer_init (&clipper,
+						     extents->clip,
+						     &extents->unbounded,
+						     &renderer.base);
+	    if (likely (status == CAIRO_INT_STATUS_SUCCESS)) {
+		status = converter->generate (converter, &clipper.base);
+		_cairo_clip_span_renderer_fini (&clipper);
+	    }
+	} else {
+	    status = converter->generate (converter, &renderer.base);
+	}
+    }
     compositor->renderer_fini (&renderer, status);
 
 cleanup_converter:
@@ -1042,6 +1108,7 @@ _cairo_spans_compositor_stroke (const cairo_compositor_t	*_compositor,
     if (status == CAIRO_INT_STATUS_UNSUPPORTED) {
 	cairo_polygon_t polygon;
 	cairo_fill_rule_t fill_rule = CAIRO_FILL_RULE_WINDING;
+	cairo_bool_t clip_spans = _clip_is_banded_region (extents);
 
 	if (! _cairo_rectangle_contains_rectangle (&extents->unbounded,
 						   &extents->mask))
@@ -1066,7 +1133,9 @@ _cairo_spans_compositor_stroke (const cairo_compositor_t	*_compositor,
 	TRACE_ (_cairo_debug_print_polygon (stderr, &polygon));
 	polygon.num_limits = 0;
 
-	if (status == CAIRO_INT_STATUS_SUCCESS && extents->clip->num_boxes > 1) {
+	if (status == CAIRO_INT_STATUS_SUCCESS && extents->clip->num_boxes > 1 &&
+	    ! clip_spans)
+	{
 	    status = _cairo_polygon_intersect_with_boxes (&polygon, &fill_rule,
 							  extents->clip->boxes,
 							  extents->clip->num_boxes);
@@ -1074,7 +1143,7 @@ _cairo_spans_compositor_stroke (const cairo_compositor_t	*_compositor,
 	if (likely (status == CAIRO_INT_STATUS_SUCCESS)) {
 	    cairo_clip_t *saved_clip = extents->clip;
 
-	    if (extents->is_bounded) {
+	    if (extents->is_bounded && ! clip_spans) {
 		extents->clip = _cairo_clip_copy_path (extents->clip);
 		extents->clip = _cairo_clip_intersect_box(extents->clip,
 							  &polygon.extents);
@@ -1083,7 +1152,7 @@ _cairo_spans_compositor_stroke (const cairo_compositor_t	*_compositor,
 	    status = clip_and_composite_polygon (compositor, extents, &polygon,
 						 fill_rule, antialias);
 
-	    if (extents->is_bounded) {
+	    if (extents->is_bounded && ! clip_spans) {
 		_cairo_clip_destroy (extents->clip);
 		extents->clip = saved_clip;
 	    }
@@ -1128,6 +1197,7 @@ _cairo_spans_compositor_fill (const cairo_compositor_t		*_compositor,
     }
     if (status == CAIRO_INT_STATUS_UNSUPPORTED) {
 	cairo_polygon_t polygon;
+	cairo_bool_t clip_spans = _clip_is_banded_region (extents);
 
 	TRACE((stderr, "%s - polygon\n", __FUNCTION__));
 
@@ -1152,7 +1222,9 @@ _cairo_spans_compositor_fill (const cairo_compositor_t		*_compositor,
 	TRACE_ (_cairo_debug_print_polygon (stderr, &polygon));
 	polygon.num_limits = 0;
 
-	if (status == CAIRO_INT_STATUS_SUCCESS && extents->clip->num_boxes > 1) {
+	if (status == CAIRO_INT_STATUS_SUCCESS && extents->clip->num_boxes > 1 &&
+	    ! clip_spans)
+	{
 	    TRACE((stderr, "%s - polygon intersect with %d clip boxes\n",
 		   __FUNCTION__, extents->clip->num_boxes));
 	    status = _cairo_polygon_intersect_with_boxes (&polygon, &fill_rule,
@@ -1163,7 +1235,7 @@ _cairo_spans_compositor_fill (const cairo_compositor_t		*_compositor,
 	if (likely (status == CAIRO_INT_STATUS_SUCCESS)) {
 	    cairo_clip_t *saved_clip = extents->clip;
 
-	    if (extents->is_bounded) {
+	    if (extents->is_bounded && ! clip_spans) {
 		TRACE((stderr, "%s - polygon discard clip boxes\n",
 		       __FUNCTION__));
 		extents->clip = _cairo_clip_copy_path (extents->clip);
@@ -1174,7 +1246,7 @@ _cairo_spans_compositor_fill (const cairo_compositor_t		*_compositor,
 	    status = clip_and_composite_polygon (compositor, extents, &polygon,
 						 fill_rule, antialias);
 
-	    if (extents->is_bounded) {
+	    if (extents->is_bounded && ! clip_spans) {
 		_cairo_clip_destroy (extents->clip);
 		extents->clip = saved_clip;
 	    }
@@ -172,6 +172,46 @@ cairo_private cairo_status_t
 _cairo_botor_scan_converter_add_polygon (cairo_botor_scan_converter_t *converter,
 					const cairo_polygon_t *polygon);
 
+/* A span renderer that restricts the spans of a bounded operation to a
+ * pixel-aligned clip made of many rectangles before passing them on to
+ * the real renderer.  The clip is held as y-x bands (the intervals of
+ * each band are sorted and disjoint), so every row is clipped with a
+ * single merge against the intervals of the band it falls into, rather
+ * than intersecting the polygon with each clip box beforehand. */
+typedef struct _cairo_clip_span_band {
+    int y1, y2;
+    int first, count;
+} cairo_clip_span_band_t;
+
+typedef struct _cairo_clip_span_renderer {
+    cairo_span_renderer_t base;
+    cairo_span_renderer_t *target;
+
+    cairo_clip_span_band_t *bands;
+    int num_bands;
+    int current;
+
+    /* the x1 and x2 of the intervals are kept apart for scanning */
+    int32_t *x1, *x2;
+
+    cairo_half_open_span_t *spans;
+    unsigned int spans_size;
+
+    void *data;
+    char buf[CAIRO_STACK_BUFFER_SIZE];
+} cairo_clip_span_renderer_t;
+
+/* cairo-clip-spans.c: */
+
+cairo_private cairo_status_t
+_cairo_clip_span_renderer_init (cairo_clip_span_renderer_t	*renderer,
+				const cairo_clip_t		*clip,
+				const cairo_rectangle_int_t	*extents,
+				cairo_span_renderer_t		*target);
+
+cairo_private void
+_cairo_clip_span_renderer_fini (cairo_clip_span_renderer_t *renderer);
+
 /* cairo-spans.c: */
 
 cairo_private cairo_scan_converter_t *
@@ -104,6 +104,14 @@ struct _cairo_surface {
      * cairo_surface_create_similar().
      */
     cairo_font_options_t font_options;
+
+    /* The mask last rendered for a clip of this surface, see
+     * cairo-clip-surface.c. */
+    struct _cairo_clip_mask_cache {
+	cairo_clip_t *clip;
+	cairo_surface_t *mask;
+	cairo_rectangle_int_t extents;
+    } clip_mask;
 };
 
 cairo_private cairo_surface_t *
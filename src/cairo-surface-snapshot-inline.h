@@ -37,6 +37,7 @@
 #define CAIRO_SURFACE_SNAPSHOT_INLINE_H
 
 #include "cairo-surface-snapshot-private.h"
+#include "cairo-image-surface-private.h"
 #include "cairo-surface-inline.h"
 
 static inline cairo_bool_t
@@ -52,6 +53,10 @@ _cairo_surface_snapshot_get_target (cairo_surface_t *surface)
     cairo_surface_t *target;
 
     CAIRO_MUTEX_LOCK (snapshot->mutex);
+    if (unlikely (snapshot->is_shared)) {
+	_cairo_image_surface_unshare ((cairo_image_surface_t *) snapshot->clone);
+	snapshot->is_shared = FALSE;
+    }
     target = _cairo_surface_reference (snapshot->target);
     CAIRO_MUTEX_UNLOCK (snapshot->mutex);
 
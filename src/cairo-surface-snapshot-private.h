@@ -46,6 +46,9 @@ struct _cairo_surface_snapshot {
     cairo_mutex_t mutex;
     cairo_surface_t *target;
     cairo_surface_t *clone;
+
+    /* the clone still shares tiles with the original image */
+    cairo_bool_t is_shared;
 };
 
 #endif /* CAIRO_SURFACE_SNAPSHOT_PRIVATE_H */
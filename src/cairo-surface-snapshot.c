@@ -40,7 +40,7 @@
 #include "cairoint.h"
 
 #include "cairo-error-private.h"
-#include "cairo-image-surface-private.h"
+#include "cairo-image-surface-inline.h"
 #include "cairo-surface-snapshot-inline.h"
 
 static cairo_status_t
@@ -82,7 +82,14 @@ _cairo_surface_snapshot_source (void                    *abstract_surface,
 				cairo_rectangle_int_t *extents)
 {
     cairo_surface_snapshot_t *surface = abstract_surface;
-    return _cairo_surface_get_source (surface->target, extents); /* XXX racy */
+    cairo_surface_t *target, *source;
+
+    /* complete the copy before handing out its pixels */
+    target = _cairo_surface_snapshot_get_target (&surface->base);
+    source = _cairo_surface_get_source (target, extents); /* XXX racy */
+    cairo_surface_destroy (target);
+
+    return source;
 }
 
 struct snapshot_extra {
@@ -137,7 +144,12 @@ _cairo_surface_snapshot_get_extents (void                  *abstract_surface,
     cairo_surface_t *target;
     cairo_bool_t bounded;
 
-    target = _cairo_surface_snapshot_get_target (&surface->base);
+    /* A clone still sharing tiles with the original image already has
+     * its size, so there is no need to complete the copy. */
+    CAIRO_MUTEX_LOCK (surface->mutex);
+    target = _cairo_surface_reference (surface->target);
+    CAIRO_MUTEX_UNLOCK (surface->mutex);
+
     bounded = _cairo_surface_get_extents (target, extents);
     cairo_surface_destroy (target);
 
@@ -188,6 +200,15 @@ _cairo_surface_snapshot_copy_on_write (cairo_surface_t *surface)
 
     CAIRO_MUTEX_LOCK (snapshot->mutex);
 
+    /* Large images only hand over the tiles about to be overwritten */
+    if (_cairo_surface_is_image (snapshot->target)) {
+	clone = _cairo_image_surface_copy_on_write ((cairo_image_surface_t *) snapshot->target);
+	if (clone != NULL) {
+	    snapshot->is_shared = clone->status == CAIRO_STATUS_SUCCESS;
+	    goto done;
+	}
+    }
+
     if (snapshot->target->backend->snapshot != NULL) {
 	clone = snapshot->target->backend->snapshot (snapshot->target);
 	if (clone != NULL) {
@@ -275,6 +296,7 @@ _cairo_surface_snapshot (cairo_surface_t *surface)
     CAIRO_MUTEX_INIT (snapshot->mutex);
     snapshot->target = surface;
     snapshot->clone = NULL;
+    snapshot->is_shared = FALSE;
 
     status = _cairo_surface_copy_mime_data (&snapshot->base, surface);
     if (unlikely (status)) {
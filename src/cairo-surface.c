@@ -439,6 +439,9 @@ _cairo_surface_init (cairo_surface_t			*surface,
     surface->snapshot_of = NULL;
 
     surface->has_font_options = FALSE;
+
+    surface->clip_mask.clip = NULL;
+    surface->clip_mask.mask = NULL;
 }
 
 static void
@@ -1025,6 +1028,8 @@ _cairo_surface_finish (cairo_surface_t *surface)
 {
     cairo_status_t status;
 
+    _cairo_clip_reset_mask (surface);
+
     /* call finish even if in error mode */
     if (surface->backend->finish) {
 	status = surface->backend->finish (surface);
@@ -2685,6 +2690,17 @@ composite_color_glyphs (cairo_surface_t             *surface,
     int gp;
     cairo_scaled_glyph_t *glyph_cache[GLYPH_CACHE_SIZE];
 
+    /* Without clusters to keep in step, the image backend blits all the
+     * color glyphs in one batch. */
+    if (clusters == NULL && surface->backend == &_cairo_image_surface_backend) {
+	status = _cairo_image_composite_color_glyphs ((cairo_image_surface_t *) surface,
+						      op, scaled_font,
+						      glyphs, num_glyphs,
+						      clip);
+	if (status != CAIRO_INT_STATUS_UNSUPPORTED)
+	    return status;
+    }
+
     memset (glyph_cache, 0, sizeof (glyph_cache));
 
     status = CAIRO_INT_STATUS_SUCCESS;
@@ -0,0 +1,768 @@
+/* -*- Mode: c; tab-width: 8; c-basic-offset: 4; indent-tabs-mode: t; -*- */
+/* cairo - a vector graphics library with display and print output
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it either under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * (the "LGPL") or, at your option, under the terms of the Mozilla
+ * Public License Version 1.1 (the "MPL"). If you do not alter this
+ * notice, a recipient may use your version of this file under either
+ * the MPL or the LGPL.
+ *
+ * You should have received a copy of the LGPL along with this library
+ * in the file COPYING-LGPL-2.1; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA
+ * You should have received a copy of the MPL along with this library
+ * in the file COPYING-MPL-1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.1 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY
+ * OF ANY KIND, either express or implied. See the LGPL or the MPL for
+ * the specific language governing rights and limitations.
+ *
+ * The Original Code is the cairo graphics library.
+ */
+
+#include "cairoint.h"
+
+#include "cairo-clip-private.h"
+#include "cairo-composite-rectangles-private.h"
+#include "cairo-default-context-private.h"
+#include "cairo-error-private.h"
+#include "cairo-image-surface-private.h"
+#include "cairo-pattern-private.h"
+#include "cairo-surface-wrapper-private.h"
+
+/**
+ * SECTION:cairo-tiled
+ * @Title: Tiled Surfaces
+ * @Short_Description: Rendering to sparse, very large canvases
+ * @See_Also: #cairo_surface_t
+ *
+ * A tiled surface is an image surface that is split into fixed-size
+ * tiles which are only allocated once they are drawn upon.  Tiles that
+ * have never been touched cost no memory and tiles that have been
+ * covered by a single opaque color are stored as just that color, so a
+ * mostly empty canvas many times larger than an image surface could
+ * hold remains cheap.  All rendering is performed by the image
+ * compositor, one tile at a time.
+ *
+ * Use cairo_surface_map_to_image() to read back a region of interest;
+ * using the whole surface as a source assembles a complete image.
+ */
+
+#define TILE_SIZE 256
+
+typedef struct _cairo_tiled_surface_tile {
+    cairo_surface_t *image;
+    cairo_bool_t is_solid;
+    cairo_color_t color;
+} cairo_tiled_surface_tile_t;
+
+typedef struct _cairo_tiled_surface {
+    cairo_surface_t base;
+
+    cairo_format_t format;
+    int width, height;
+
+    int tiles_x, tiles_y;
+    cairo_tiled_surface_tile_t *tiles;
+} cairo_tiled_surface_t;
+
+typedef cairo_status_t
+(*cairo_tiled_surface_op_func_t) (cairo_surface_wrapper_t *wrapper,
+				  const void *closure);
+
+static const cairo_surface_backend_t _cairo_tiled_surface_backend;
+
+static void
+_cairo_tiled_surface_tile_extents (cairo_tiled_surface_t *surface,
+				   int tx, int ty,
+				   cairo_rectangle_int_t *extents)
+{
+    extents->x = tx * TILE_SIZE;
+    extents->y = ty * TILE_SIZE;
+    extents->width  = MIN (TILE_SIZE, surface->width  - extents->x);
+    extents->height = MIN (TILE_SIZE, surface->height - extents->y);
+}
+
+static void
+_fill_rectangle (cairo_image_surface_t *image,
+		 const cairo_color_t *color,
+		 int x, int y, int width, int height)
+{
+    pixman_color_t pixel;
+    pixman_rectangle16_t rect;
+
+    pixel.red   = color->red_short;
+    pixel.green = color->green_short;
+    pixel.blue  = color->blue_short;
+    pixel.alpha = color->alpha_short;
+
+    rect.x = x;
+    rect.y = y;
+    rect.width  = width;
+    rect.height = height;
+
+    pixman_image_fill_rectangles (PIXMAN_OP_SRC, image->pixman_image,
+				  &pixel, 1, &rect);
+    image->base.is_clear = FALSE;
+}
+
+static void
+_cairo_tiled_surface_tile_reset (cairo_tiled_surface_tile_t *tile)
+{
+    cairo_surface_destroy (tile->image);
+    tile->image = NULL;
+    tile->is_solid = FALSE;
+}
+
+/* Give the tile real storage, filled with its current contents. */
+static cairo_status_t
+_cairo_tiled_surface_tile_realize (cairo_tiled_surface_t *surface,
+				   cairo_tiled_surface_tile_t *tile,
+				   const cairo_rectangle_int_t *extents)
+{
+    cairo_surface_t *image;
+
+    if (tile->image != NULL)
+	return CAIRO_STATUS_SUCCESS;
+
+    image = cairo_image_surface_create (surface->format,
+					extents->width, extents->height);
+    if (unlikely (image->status))
+	return image->status;
+
+    if (tile->is_solid) {
+	_fill_rectangle ((cairo_image_surface_t *) image, &tile->color,
+			 0, 0, extents->width, extents->height);
+	tile->is_solid = FALSE;
+    }
+
+    cairo_surface_set_device_offset (image, -extents->x, -extents->y);
+    tile->image = image;
+
+    return CAIRO_STATUS_SUCCESS;
+}
+
+/* Replay the operation upon every tile that it may alter.
+ *
+ * A transparent tile outside of the bounded extents is left untouched
+ * by every operator, so such tiles are not allocated.  If @color is
+ * given, the operation replaces the tile with that color wherever it
+ * covers the tile completely, which we record without any storage.
+ */
+static cairo_int_status_t
+_cairo_tiled_surface_composite (cairo_tiled_surface_t *surface,
+				const cairo_composite_rectangles_t *composite,
+				const cairo_color_t *color,
+				cairo_tiled_surface_op_func_t func,
+				const void *closure)
+{
+    const cairo_rectangle_int_t *unbounded = &composite->unbounded;
+    int x1, y1, x2, y2, tx, ty;
+
+    x1 = unbounded->x / TILE_SIZE;
+    y1 = unbounded->y / TILE_SIZE;
+    x2 = (unbounded->x + unbounded->width  + TILE_SIZE - 1) / TILE_SIZE;
+    y2 = (unbounded->y + unbounded->height + TILE_SIZE - 1) / TILE_SIZE;
+
+    for (ty = y1; ty < y2; ty++) {
+	for (tx = x1; tx < x2; tx++) {
+	    cairo_tiled_surface_tile_t *tile;
+	    cairo_rectangle_int_t extents;
+	    cairo_surface_wrapper_t wrapper;
+	    cairo_int_status_t status;
+
+	    tile = &surface->tiles[ty * surface->tiles_x + tx];
+	    _cairo_tiled_surface_tile_extents (surface, tx, ty, &extents);
+
+	    if (color != NULL &&
+		_cairo_clip_contains_rectangle (composite->clip, &extents))
+	    {
+		_cairo_tiled_surface_tile_reset (tile);
+		if (! CAIRO_COLOR_IS_CLEAR (color)) {
+		    tile->is_solid = TRUE;
+		    tile->color = *color;
+		}
+		continue;
+	    }
+
+	    if (tile->image == NULL && ! tile->is_solid &&
+		! _cairo_rectangle_intersects (&extents, &composite->bounded))
+	    {
+		continue;
+	    }
+
+	    status = _cairo_tiled_surface_tile_realize (surface, tile, &extents);
+	    if (unlikely (status))
+		return status;
+
+	    _cairo_surface_wrapper_init (&wrapper, tile->image);
+	    status = func (&wrapper, closure);
+	    _cairo_surface_wrapper_fini (&wrapper);
+	    if (unlikely (status && status != CAIRO_INT_STATUS_NOTHING_TO_DO))
+		return status;
+	}
+    }
+
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_status_t
+_cairo_tiled_surface_finish (void *abstract_surface)
+{
+    cairo_tiled_surface_t *surface = abstract_surface;
+    int n;
+
+    for (n = 0; n < surface->tiles_x * surface->tiles_y; n++)
+	cairo_surface_destroy (surface->tiles[n].image);
+    free (surface->tiles);
+
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_surface_t *
+_cairo_tiled_surface_create_similar (void	       *abstract_surface,
+				     cairo_content_t	content,
+				     int		width,
+				     int		height)
+{
+    /* Only bother with tiles when an image would be wasteful */
+    if ((double) width * height <= 4. * TILE_SIZE * TILE_SIZE)
+	return _cairo_image_surface_create_with_content (content, width, height);
+
+    return cairo_tiled_surface_create (_cairo_format_from_content (content),
+				       width, height);
+}
+
+static cairo_image_surface_t *
+_cairo_tiled_surface_map_to_image (void *abstract_surface,
+				   const cairo_rectangle_int_t *extents)
+{
+    cairo_tiled_surface_t *surface = abstract_surface;
+    cairo_image_surface_t *image;
+    int x1, y1, x2, y2, tx, ty;
+
+    image = (cairo_image_surface_t *)
+	cairo_image_surface_create (surface->format,
+				    extents->width, extents->height);
+    if (unlikely (image->base.status))
+	return image;
+
+    x1 = MAX (extents->x, 0) / TILE_SIZE;
+    y1 = MAX (extents->y, 0) / TILE_SIZE;
+    x2 = MIN (extents->x + extents->width, surface->width);
+    y2 = MIN (extents->y + extents->height, surface->height);
+    x2 = (x2 + TILE_SIZE - 1) / TILE_SIZE;
+    y2 = (y2 + TILE_SIZE - 1) / TILE_SIZE;
+
+    for (ty = y1; ty < y2; ty++) {
+	for (tx = x1; tx < x2; tx++) {
+	    cairo_tiled_surface_tile_t *tile;
+	    cairo_rectangle_int_t rect;
+
+	    tile = &surface->tiles[ty * surface->tiles_x + tx];
+	    if (tile->image == NULL && ! tile->is_solid)
+		continue;
+
+	    _cairo_tiled_surface_tile_extents (surface, tx, ty, &rect);
+	    if (! _cairo_rectangle_intersect (&rect, extents))
+		continue;
+
+	    if (tile->is_solid) {
+		_fill_rectangle (image, &tile->color,
+				 rect.x - extents->x, rect.y - extents->y,
+				 rect.width, rect.height);
+	    } else {
+		pixman_image_composite32 (PIXMAN_OP_SRC,
+					  ((cairo_image_surface_t *) tile->image)->pixman_image,
+					  NULL,
+					  image->pixman_image,
+					  rect.x % TILE_SIZE, rect.y % TILE_SIZE,
+					  0, 0,
+					  rect.x - extents->x, rect.y - extents->y,
+					  rect.width, rect.height);
+		image->base.is_clear = FALSE;
+	    }
+	}
+    }
+
+    cairo_surface_set_device_offset (&image->base, -extents->x, -extents->y);
+    return image;
+}
+
+static cairo_surface_t *
+_cairo_tiled_surface_source (void		   *abstract_surface,
+			     cairo_rectangle_int_t *extents)
+{
+    cairo_tiled_surface_t *surface = abstract_surface;
+
+    if (extents) {
+	extents->x = extents->y = 0;
+	extents->width  = surface->width;
+	extents->height = surface->height;
+    }
+
+    return &surface->base;
+}
+
+static cairo_status_t
+_cairo_tiled_surface_acquire_source_image (void			  *abstract_surface,
+					   cairo_image_surface_t **image_out,
+					   void			 **image_extra)
+{
+    cairo_tiled_surface_t *surface = abstract_surface;
+    cairo_rectangle_int_t extents;
+    cairo_image_surface_t *image;
+
+    extents.x = extents.y = 0;
+    extents.width  = surface->width;
+    extents.height = surface->height;
+
+    image = _cairo_tiled_surface_map_to_image (surface, &extents);
+    if (unlikely (image->base.status)) {
+	cairo_status_t status = image->base.status;
+	cairo_surface_destroy (&image->base);
+	return status;
+    }
+
+    *image_out = image;
+    *image_extra = NULL;
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static void
+_cairo_tiled_surface_release_source_image (void			 *abstract_surface,
+					   cairo_image_surface_t *image,
+					   void			 *image_extra)
+{
+    cairo_surface_destroy (&image->base);
+}
+
+static cairo_bool_t
+_cairo_tiled_surface_get_extents (void			*abstract_surface,
+				  cairo_rectangle_int_t	*rectangle)
+{
+    cairo_tiled_surface_t *surface = abstract_surface;
+
+    rectangle->x = 0;
+    rectangle->y = 0;
+    rectangle->width  = surface->width;
+    rectangle->height = surface->height;
+
+    return TRUE;
+}
+
+static void
+_cairo_tiled_surface_get_font_options (void                  *abstract_surface,
+				       cairo_font_options_t  *options)
+{
+    _cairo_font_options_init_default (options);
+
+    cairo_font_options_set_hint_metrics (options, CAIRO_HINT_METRICS_ON);
+    _cairo_font_options_set_round_glyph_positions (options, CAIRO_ROUND_GLYPH_POS_ON);
+}
+
+typedef struct _cairo_tiled_paint {
+    cairo_operator_t op;
+    const cairo_pattern_t *source;
+    const cairo_clip_t *clip;
+} cairo_tiled_paint_t;
+
+static cairo_status_t
+_paint_tile (cairo_surface_wrapper_t *wrapper, const void *closure)
+{
+    const cairo_tiled_paint_t *args = closure;
+
+    return _cairo_surface_wrapper_paint (wrapper,
+					 args->op, args->source,
+					 args->clip);
+}
+
+static cairo_int_status_t
+_cairo_tiled_surface_paint (void			*abstract_surface,
+			    cairo_operator_t		 op,
+			    const cairo_pattern_t	*source,
+			    const cairo_clip_t		*clip)
+{
+    cairo_tiled_surface_t *surface = abstract_surface;
+    cairo_composite_rectangles_t composite;
+    const cairo_color_t *color = NULL;
+    cairo_tiled_paint_t args;
+    cairo_int_status_t status;
+
+    status = _cairo_composite_rectangles_init_for_paint (&composite,
+							 &surface->base,
+							 op, source, clip);
+    if (unlikely (status))
+	return status;
+
+    /* Covering a whole tile with a single color just records the color */
+    if (op == CAIRO_OPERATOR_CLEAR) {
+	color = CAIRO_COLOR_TRANSPARENT;
+    } else if (source->type == CAIRO_PATTERN_TYPE_SOLID) {
+	const cairo_color_t *solid = &((cairo_solid_pattern_t *) source)->color;
+
+	if (op == CAIRO_OPERATOR_SOURCE ||
+	    (op == CAIRO_OPERATOR_OVER && CAIRO_COLOR_IS_OPAQUE (solid)))
+	{
+	    color = solid;
+	}
+    }
+
+    args.op = op;
+    args.source = source;
+    args.clip = clip;
+
+    status = _cairo_tiled_surface_composite (surface, &composite, color,
+					     _paint_tile, &args);
+
+    _cairo_composite_rectangles_fini (&composite);
+    return status;
+}
+
+typedef struct _cairo_tiled_mask {
+    cairo_operator_t op;
+    const cairo_pattern_t *source;
+    const cairo_pattern_t *mask;
+    const cairo_clip_t *clip;
+} cairo_tiled_mask_t;
+
+static cairo_status_t
+_mask_tile (cairo_surface_wrapper_t *wrapper, const void *closure)
+{
+    const cairo_tiled_mask_t *args = closure;
+
+    return _cairo_surface_wrapper_mask (wrapper,
+					args->op, args->source, args->mask,
+					args->clip);
+}
+
+static cairo_int_status_t
+_cairo_tiled_surface_mask (void				*abstract_surface,
+			   cairo_operator_t		 op,
+			   const cairo_pattern_t	*source,
+			   const cairo_pattern_t	*mask,
+			   const cairo_clip_t		*clip)
+{
+    cairo_tiled_surface_t *surface = abstract_surface;
+    cairo_composite_rectangles_t composite;
+    cairo_tiled_mask_t args;
+    cairo_int_status_t status;
+
+    status = _cairo_composite_rectangles_init_for_mask (&composite,
+							&surface->base,
+							op, source, mask, clip);
+    if (unlikely (status))
+	return status;
+
+    args.op = op;
+    args.source = source;
+    args.mask = mask;
+    args.clip = clip;
+
+    status = _cairo_tiled_surface_composite (surface, &composite, NULL,
+					     _mask_tile, &args);
+
+    _cairo_composite_rectangles_fini (&composite);
+    return status;
+}
+
+typedef struct _cairo_tiled_stroke {
+    cairo_operator_t op;
+    const cairo_pattern_t *source;
+    const cairo_path_fixed_t *path;
+    const cairo_stroke_style_t *style;
+    const cairo_matrix_t *ctm;
+    const cairo_matrix_t *ctm_inverse;
+    double tolerance;
+    cairo_antialias_t antialias;
+    const cairo_clip_t *clip;
+} cairo_tiled_stroke_t;
+
+static cairo_status_t
+_stroke_tile (cairo_surface_wrapper_t *wrapper, const void *closure)
+{
+    const cairo_tiled_stroke_t *args = closure;
+
+    return _cairo_surface_wrapper_stroke (wrapper,
+					  args->op, args->source,
+					  args->path, args->style,
+					  args->ctm, args->ctm_inverse,
+					  args->tolerance, args->antialias,
+					  args->clip);
+}
+
+static cairo_int_status_t
+_cairo_tiled_surface_stroke (void			*abstract_surface,
+			     cairo_operator_t		 op,
+			     const cairo_pattern_t	*source,
+			     const cairo_path_fixed_t	*path,
+			     const cairo_stroke_style_t	*style,
+			     const cairo_matrix_t	*ctm,
+			     const cairo_matrix_t	*ctm_inverse,
+			     double			 tolerance,
+			     cairo_antialias_t		 antialias,
+			     const cairo_clip_t		*clip)
+{
+    cairo_tiled_surface_t *surface = abstract_surface;
+    cairo_composite_rectangles_t composite;
+    cairo_tiled_stroke_t args;
+    cairo_int_status_t status;
+
+    status = _cairo_composite_rectangles_init_for_stroke (&composite,
+							  &surface->base,
+							  op, source,
+							  path, style, ctm,
+							  clip);
+    if (unlikely (status))
+	return status;
+
+    args.op = op;
+    args.source = source;
+    args.path = path;
+    args.style = style;
+    args.ctm = ctm;
+    args.ctm_inverse = ctm_inverse;
+    args.tolerance = tolerance;
+    args.antialias = antialias;
+    args.clip = clip;
+
+    status = _cairo_tiled_surface_composite (surface, &composite, NULL,
+					     _stroke_tile, &args);
+
+    _cairo_composite_rectangles_fini (&composite);
+    return status;
+}
+
+typedef struct _cairo_tiled_fill {
+    cairo_operator_t op;
+    const cairo_pattern_t *source;
+    const cairo_path_fixed_t *path;
+    cairo_fill_rule_t fill_rule;
+    double tolerance;
+    cairo_antialias_t antialias;
+    const cairo_clip_t *clip;
+} cairo_tiled_fill_t;
+
+static cairo_status_t
+_fill_tile (cairo_surface_wrapper_t *wrapper, const void *closure)
+{
+    const cairo_tiled_fill_t *args = closure;
+
+    return _cairo_surface_wrapper_fill (wrapper,
+					args->op, args->source,
+					args->path, args->fill_rule,
+					args->tolerance, args->antialias,
+					args->clip);
+}
+
+static cairo_int_status_t
+_cairo_tiled_surface_fill (void				*abstract_surface,
+			   cairo_operator_t		 op,
+			   const cairo_pattern_t	*source,
+			   const cairo_path_fixed_t	*path,
+			   cairo_fill_rule_t		 fill_rule,
+			   double			 tolerance,
+			   cairo_antialias_t		 antialias,
+			   const cairo_clip_t		*clip)
+{
+    cairo_tiled_surface_t *surface = abstract_surface;
+    cairo_composite_rectangles_t composite;
+    cairo_tiled_fill_t args;
+    cairo_int_status_t status;
+
+    status = _cairo_composite_rectangles_init_for_fill (&composite,
+							&surface->base,
+							op, source, path,
+							clip);
+    if (unlikely (status))
+	return status;
+
+    args.op = op;
+    args.source = source;
+    args.path = path;
+    args.fill_rule = fill_rule;
+    args.tolerance = tolerance;
+    args.antialias = antialias;
+    args.clip = clip;
+
+    status = _cairo_tiled_surface_composite (surface, &composite, NULL,
+					     _fill_tile, &args);
+
+    _cairo_composite_rectangles_fini (&composite);
+    return status;
+}
+
+typedef struct _cairo_tiled_glyphs {
+    cairo_operator_t op;
+    const cairo_pattern_t *source;
+    const cairo_glyph_t *glyphs;
+    int num_glyphs;
+    cairo_scaled_font_t *scaled_font;
+    const cairo_clip_t *clip;
+} cairo_tiled_glyphs_t;
+
+static cairo_status_t
+_glyphs_tile (cairo_surface_wrapper_t *wrapper, const void *closure)
+{
+    const cairo_tiled_glyphs_t *args = closure;
+
+    return _cairo_surface_wrapper_show_text_glyphs (wrapper,
+						    args->op, args->source,
+						    NULL, 0,
+						    args->glyphs,
+						    args->num_glyphs,
+						    NULL, 0, 0,
+						    args->scaled_font,
+						    args->clip);
+}
+
+static cairo_int_status_t
+_cairo_tiled_surface_glyphs (void			*abstract_surface,
+			     cairo_operator_t		 op,
+			     const cairo_pattern_t	*source,
+			     cairo_glyph_t		*glyphs,
+			     int			 num_glyphs,
+			     cairo_scaled_font_t	*scaled_font,
+			     const cairo_clip_t		*clip)
+{
+    cairo_tiled_surface_t *surface = abstract_surface;
+    cairo_composite_rectangles_t composite;
+    cairo_tiled_glyphs_t args;
+    cairo_int_status_t status;
+    cairo_bool_t overlap;
+
+    status = _cairo_composite_rectangles_init_for_glyphs (&composite,
+							  &surface->base,
+							  op, source,
+							  scaled_font,
+							  glyphs, num_glyphs,
+							  clip,
+							  &overlap);
+    if (unlikely (status))
+	return status;
+
+    args.op = op;
+    args.source = source;
+    args.glyphs = glyphs;
+    args.num_glyphs = num_glyphs;
+    args.scaled_font = scaled_font;
+    args.clip = clip;
+
+    status = _cairo_tiled_surface_composite (surface, &composite, NULL,
+					     _glyphs_tile, &args);
+
+    _cairo_composite_rectangles_fini (&composite);
+    return status;
+}
+
+static const cairo_surface_backend_t _cairo_tiled_surface_backend = {
+    CAIRO_SURFACE_TYPE_TILED,
+    _cairo_tiled_surface_finish,
+
+    _cairo_default_context_create,
+
+    _cairo_tiled_surface_create_similar,
+    NULL, /* create similar image */
+    _cairo_tiled_surface_map_to_image,
+    NULL, /* unmap image: written back through paint */
+
+    _cairo_tiled_surface_source,
+    _cairo_tiled_surface_acquire_source_image,
+    _cairo_tiled_surface_release_source_image,
+    NULL, /* snapshot */
+
+    NULL, /* copy_page */
+    NULL, /* show_page */
+
+    _cairo_tiled_surface_get_extents,
+    _cairo_tiled_surface_get_font_options,
+
+    NULL, /* flush */
+    NULL, /* mark_dirty_rectangle */
+
+    _cairo_tiled_surface_paint,
+    _cairo_tiled_surface_mask,
+    _cairo_tiled_surface_stroke,
+    _cairo_tiled_surface_fill,
+    NULL, /* fill_stroke */
+    _cairo_tiled_surface_glyphs,
+};
+
+/**
+ * cairo_tiled_surface_create:
+ * @format: format of pixels in the surface to create
+ * @width: width of the surface, in pixels
+ * @height: height of the surface, in pixels
+ *
+ * Creates a tiled surface of the specified format and dimensions.
+ * Unlike cairo_image_surface_create(), no pixel storage is allocated
+ * up front: the surface is divided into tiles that are allocated when
+ * first drawn to, and its initial contents are transparent.  The
+ * dimensions may far exceed those permitted for an image surface.
+ *
+ * The pixels may be accessed using cairo_surface_map_to_image().
+ *
+ * Return value: a pointer to the newly created surface. The caller
+ * owns the surface and should call cairo_surface_destroy() when done
+ * with it.
+ *
+ * This function always returns a valid pointer, but it will return a
+ * pointer to a "nil" surface if an error such as out of memory
+ * occurs. You can use cairo_surface_status() to check for this.
+ *
+ * Since: 1.18
+ **/
+cairo_surface_t *
+cairo_tiled_surface_create (cairo_format_t	format,
+			    int			width,
+			    int			height)
+{
+    cairo_tiled_surface_t *surface;
+    int tiles_x, tiles_y;
+
+    if (! CAIRO_FORMAT_VALID (format))
+	return _cairo_surface_create_in_error (_cairo_error (CAIRO_STATUS_INVALID_FORMAT));
+
+    if (width <= 0 || width > CAIRO_RECT_INT_MAX ||
+	height <= 0 || height > CAIRO_RECT_INT_MAX)
+    {
+	return _cairo_surface_create_in_error (_cairo_error (CAIRO_STATUS_INVALID_SIZE));
+    }
+
+    tiles_x = (width  + TILE_SIZE - 1) / TILE_SIZE;
+    tiles_y = (height + TILE_SIZE - 1) / TILE_SIZE;
+
+    surface = _cairo_malloc (sizeof (cairo_tiled_surface_t));
+    if (unlikely (surface == NULL))
+	return _cairo_surface_create_in_error (_cairo_error (CAIRO_STATUS_NO_MEMORY));
+
+    surface->tiles = calloc (tiles_x * tiles_y,
+			    sizeof (cairo_tiled_surface_tile_t));
+    if (unlikely (surface->tiles == NULL)) {
+	free (surface);
+	return _cairo_surface_create_in_error (_cairo_error (CAIRO_STATUS_NO_MEMORY));
+    }
+
+    _cairo_surface_init (&surface->base,
+			 &_cairo_tiled_surface_backend,
+			 NULL, /* device */
+			 _cairo_content_from_format (format),
+			 FALSE); /* is_vector */
+
+    surface->format = format;
+    surface->width = width;
+    surface->height = height;
+    surface->tiles_x = tiles_x;
+    surface->tiles_y = tiles_y;
+
+    surface->base.is_clear = TRUE;
+
+    return &surface->base;
+}
@@ -360,34 +360,51 @@ error:
     goto out;
 }
 
+/* The returned mask is shared with the other operations under the same
+ * clip and must not be modified.  It covers at least @extents, with its
+ * origin at (*tx, *ty). */
 static cairo_surface_t *
 traps_get_clip_surface (const cairo_traps_compositor_t *compositor,
 			const cairo_composite_rectangles_t *composite,
-			const cairo_rectangle_int_t *extents)
+			const cairo_rectangle_int_t *extents,
+			int *tx, int *ty)
 {
     cairo_surface_t *surface = NULL;
+    cairo_rectangle_int_t r;
     cairo_int_status_t status;
 
     TRACE ((stderr, "%s\n", __FUNCTION__));
 
-    status = __clip_to_surface (compositor, composite, extents, &surface);
+    surface = _cairo_clip_lookup_mask (composite->clip, composite->surface,
+				       extents, tx, ty);
+    if (surface != NULL)
+	return surface;
+
+    _cairo_clip_get_mask_extents (composite->clip, composite->surface,
+				  extents, &r);
+
+    status = __clip_to_surface (compositor, composite, &r, &surface);
     if (status == CAIRO_INT_STATUS_UNSUPPORTED) {
 	surface = _cairo_surface_create_scratch (composite->surface,
 						 CAIRO_CONTENT_ALPHA,
-						 extents->width,
-						 extents->height,
+						 r.width,
+						 r.height,
 						 CAIRO_COLOR_WHITE);
 	if (unlikely (surface->status))
 	    return surface;
 
 	status = _cairo_clip_combine_with_surface (composite->clip, surface,
-						   extents->x, extents->y);
+						   r.x, r.y);
     }
     if (unlikely (status)) {
 	cairo_surface_destroy (surface);
-	surface = _cairo_surface_create_in_error (status);
+	return _cairo_surface_create_in_error (status);
     }
 
+    _cairo_clip_cache_mask (composite->clip, composite->surface, &r, surface);
+
+    *tx = r.x;
+    *ty = r.y;
     return surface;
 }
 
@@ -589,6 +606,7 @@ clip_and_composite_combine (const cairo_traps_compositor_t *compositor,
     cairo_surface_t *dst = extents->surface;
     cairo_surface_t *tmp, *clip;
     cairo_status_t status;
+    int clip_x, clip_y;
 
     TRACE ((stderr, "%s\n", __FUNCTION__));
 
@@ -621,20 +639,23 @@ clip_and_composite_combine (const cairo_traps_compositor_t *compositor,
     if (unlikely (status))
 	goto cleanup;
 
-    clip = traps_get_clip_surface (compositor, extents, &extents->bounded);
+    clip = traps_get_clip_surface (compositor, extents, &extents->bounded,
+				   &clip_x, &clip_y);
     if (unlikely ((status = clip->status)))
 	goto cleanup;
 
     if (dst->is_clear) {
 	compositor->composite (dst, CAIRO_OPERATOR_SOURCE, tmp, clip,
 			       0, 0,
-			       0, 0,
+			       extents->bounded.x - clip_x,
+			       extents->bounded.y - clip_y,
 			       extents->bounded.x,      extents->bounded.y,
 			       extents->bounded.width,  extents->bounded.height);
     } else {
 	compositor->lerp (dst, tmp, clip,
 			  0, 0,
-			  0,0,
+			  extents->bounded.x - clip_x,
+			  extents->bounded.y - clip_y,
 			  extents->bounded.x,     extents->bounded.y,
 			  extents->bounded.width, extents->bounded.height);
     }
@@ -727,11 +748,12 @@ fixup_unbounded_with_mask (const cairo_traps_compositor_t *compositor,
 {
     cairo_surface_t *dst = extents->surface;
     cairo_surface_t *mask;
+    int mask_x, mask_y;
 
     TRACE ((stderr, "%s\n", __FUNCTION__));
 
-    /* XXX can we avoid querying the clip surface again? */
-    mask = traps_get_clip_surface (compositor, extents, &extents->unbounded);
+    mask = traps_get_clip_surface (compositor, extents, &extents->unbounded,
+				   &mask_x, &mask_y);
     if (unlikely (mask->status))
 	return mask->status;
 
@@ -743,7 +765,7 @@ fixup_unbounded_with_mask (const cairo_traps_compositor_t *compositor,
 	int height = extents->bounded.y - y;
 
 	compositor->composite (dst, CAIRO_OPERATOR_DEST_OUT, mask, NULL,
-			       0, 0,
+			       x - mask_x, y - mask_y,
 			       0, 0,
 			       x, y,
 			       width, height);
@@ -757,7 +779,7 @@ fixup_unbounded_with_mask (const cairo_traps_compositor_t *compositor,
 	int height = extents->bounded.height;
 
 	compositor->composite (dst, CAIRO_OPERATOR_DEST_OUT, mask, NULL,
-			       0, y - extents->unbounded.y,
+			       x - mask_x, y - mask_y,
 			       0, 0,
 			       x, y,
 			       width, height);
@@ -771,7 +793,7 @@ fixup_unbounded_with_mask (const cairo_traps_compositor_t *compositor,
 	int height = extents->bounded.height;
 
 	compositor->composite (dst, CAIRO_OPERATOR_DEST_OUT, mask, NULL,
-			       x - extents->unbounded.x, y - extents->unbounded.y,
+			       x - mask_x, y - mask_y,
 			       0, 0,
 			       x, y,
 			       width, height);
@@ -785,7 +807,7 @@ fixup_unbounded_with_mask (const cairo_traps_compositor_t *compositor,
 	int height = extents->unbounded.y + extents->unbounded.height - y;
 
 	compositor->composite (dst, CAIRO_OPERATOR_DEST_OUT, mask, NULL,
-			       0, y - extents->unbounded.y,
+			       x - mask_x, y - mask_y,
 			       0, 0,
 			       x, y,
 			       width, height);
@@ -1275,12 +1297,13 @@ composite_aligned_boxes (const cairo_traps_compositor_t *compositor,
 
 	if (need_clip_mask) {
 	    mask = traps_get_clip_surface (compositor,
-					   extents, &extents->bounded);
+					   extents, &extents->bounded,
+					   &mask_x, &mask_y);
 	    if (unlikely (mask->status))
 		return mask->status;
 
-	    mask_x = -extents->bounded.x;
-	    mask_y = -extents->bounded.y;
+	    mask_x = -mask_x;
+	    mask_y = -mask_y;
 
 	    if (op == CAIRO_OPERATOR_CLEAR) {
 		source = NULL;
@@ -170,26 +170,26 @@ _cairo_truetype_font_create (cairo_scaled_font_subset_t  *scaled_font_subset,
     }
 
     size = sizeof (tt_head_t);
-    status = backend->load_truetype_table (scaled_font_subset->scaled_font,
-                                          TT_TAG_head, 0,
-					  (unsigned char *) &head,
-                                          &size);
+    status = _cairo_scaled_font_subset_load_table (scaled_font_subset,
+						   TT_TAG_head, 0,
+						   (unsigned char *) &head,
+						   &size);
     if (unlikely (status))
 	return status;
 
     size = sizeof (tt_maxp_t);
-    status = backend->load_truetype_table (scaled_font_subset->scaled_font,
-                                           TT_TAG_maxp, 0,
-					   (unsigned char *) &maxp,
-					   &size);
+    status = _cairo_scaled_font_subset_load_table (scaled_font_subset,
+						   TT_TAG_maxp, 0,
+						   (unsigned char *) &maxp,
+						   &size);
     if (unlikely (status))
 	return status;
 
     size = sizeof (tt_hhea_t);
-    status = backend->load_truetype_table (scaled_font_subset->scaled_font,
-                                           TT_TAG_hhea, 0,
-					   (unsigned char *) &hhea,
-					   &size);
+    status = _cairo_scaled_font_subset_load_table (scaled_font_subset,
+						   TT_TAG_hhea, 0,
+						   (unsigned char *) &hhea,
+						   &size);
     if (unlikely (status))
 	return status;
 
@@ -521,8 +521,8 @@ cairo_truetype_font_write_generic_table (cairo_truetype_font_t *font,
 	return font->status;
 
     size = 0;
-    status = font->backend->load_truetype_table(font->scaled_font_subset->scaled_font,
-					        tag, 0, NULL, &size);
+    status = _cairo_scaled_font_subset_load_table (font->scaled_font_subset,
+						   tag, 0, NULL, &size);
     if (unlikely (status))
         return _cairo_truetype_font_set_error (font, status);
 
@@ -530,8 +530,8 @@ cairo_truetype_font_write_generic_table (cairo_truetype_font_t *font,
     if (unlikely (status))
 	return _cairo_truetype_font_set_error (font, status);
 
-    status = font->backend->load_truetype_table (font->scaled_font_subset->scaled_font,
-						 tag, 0, buffer, &size);
+    status = _cairo_scaled_font_subset_load_table (font->scaled_font_subset,
+						   tag, 0, buffer, &size);
     if (unlikely (status))
 	return _cairo_truetype_font_set_error (font, status);
 
@@ -611,9 +611,9 @@ cairo_truetype_font_write_glyf_table (cairo_truetype_font_t *font,
 	return font->status;
 
     size = sizeof (tt_head_t);
-    status = font->backend->load_truetype_table (font->scaled_font_subset->scaled_font,
-						 TT_TAG_head, 0,
-						 (unsigned char*) &header, &size);
+    status = _cairo_scaled_font_subset_load_table (font->scaled_font_subset,
+						   TT_TAG_head, 0,
+						   (unsigned char*) &header, &size);
     if (unlikely (status))
 	return _cairo_truetype_font_set_error (font, status);
 
@@ -626,8 +626,8 @@ cairo_truetype_font_write_glyf_table (cairo_truetype_font_t *font,
     if (unlikely (u.bytes == NULL))
 	return _cairo_truetype_font_set_error (font, CAIRO_STATUS_NO_MEMORY);
 
-    status = font->backend->load_truetype_table (font->scaled_font_subset->scaled_font,
-                                                 TT_TAG_loca, 0, u.bytes, &size);
+    status = _cairo_scaled_font_subset_load_table (font->scaled_font_subset,
+						   TT_TAG_loca, 0, u.bytes, &size);
     if (unlikely (status))
 	return _cairo_truetype_font_set_error (font, status);
 
@@ -668,8 +668,8 @@ cairo_truetype_font_write_glyf_table (cairo_truetype_font_t *font,
 	    tt_glyph_data_t *glyph_data;
 	    int num_contours;
 
-	    status = font->backend->load_truetype_table (font->scaled_font_subset->scaled_font,
-							 TT_TAG_glyf, begin, buffer, &size);
+	    status = _cairo_scaled_font_subset_load_table (font->scaled_font_subset,
+							   TT_TAG_glyf, begin, buffer, &size);
 	    if (unlikely (status))
 		goto FAIL;
 
@@ -719,8 +719,8 @@ cairo_truetype_font_write_head_table (cairo_truetype_font_t *font,
 	return font->status;
 
     size = 0;
-    status = font->backend->load_truetype_table (font->scaled_font_subset->scaled_font,
-						 tag, 0, NULL, &size);
+    status = _cairo_scaled_font_subset_load_table (font->scaled_font_subset,
+						   tag, 0, NULL, &size);
     if (unlikely (status))
 	return _cairo_truetype_font_set_error (font, status);
 
@@ -729,8 +729,8 @@ cairo_truetype_font_write_head_table (cairo_truetype_font_t *font,
     if (unlikely (status))
 	return _cairo_truetype_font_set_error (font, status);
 
-    status = font->backend->load_truetype_table (font->scaled_font_subset->scaled_font,
-						 tag, 0, buffer, &size);
+    status = _cairo_scaled_font_subset_load_table (font->scaled_font_subset,
+						   tag, 0, buffer, &size);
     if (unlikely (status))
 	return _cairo_truetype_font_set_error (font, status);
 
@@ -755,8 +755,8 @@ cairo_truetype_font_write_hhea_table (cairo_truetype_font_t *font, unsigned long
     if (unlikely (status))
 	return _cairo_truetype_font_set_error (font, status);
 
-    status = font->backend->load_truetype_table (font->scaled_font_subset->scaled_font,
-						 tag, 0, (unsigned char *) hhea, &size);
+    status = _cairo_scaled_font_subset_load_table (font->scaled_font_subset,
+						   tag, 0, (unsigned char *) hhea, &size);
     if (unlikely (status))
 	return _cairo_truetype_font_set_error (font, status);
 
@@ -782,9 +782,9 @@ cairo_truetype_font_write_hmtx_table (cairo_truetype_font_t *font,
 	return font->status;
 
     size = sizeof (tt_hhea_t);
-    status = font->backend->load_truetype_table (font->scaled_font_subset->scaled_font,
-						 TT_TAG_hhea, 0,
-						 (unsigned char*) &hhea, &size);
+    status = _cairo_scaled_font_subset_load_table (font->scaled_font_subset,
+						   TT_TAG_hhea, 0,
+						   (unsigned char*) &hhea, &size);
     if (unlikely (status))
 	return _cairo_truetype_font_set_error (font, status);
 
@@ -800,27 +800,27 @@ cairo_truetype_font_write_hmtx_table (cairo_truetype_font_t *font,
 	    return _cairo_truetype_font_set_error (font, status);
 
         if (font->glyphs[i].parent_index < num_hmetrics) {
-            status = font->backend->load_truetype_table (font->scaled_font_subset->scaled_font,
-                                                         TT_TAG_hmtx,
-                                                         font->glyphs[i].parent_index * long_entry_size,
-                                                         (unsigned char *) p, &long_entry_size);
+            status = _cairo_scaled_font_subset_load_table (font->scaled_font_subset,
+							   TT_TAG_hmtx,
+							   font->glyphs[i].parent_index * long_entry_size,
+							   (unsigned char *) p, &long_entry_size);
 	    if (unlikely (status))
 		return _cairo_truetype_font_set_error (font, status);
         }
         else
         {
-            status = font->backend->load_truetype_table (font->scaled_font_subset->scaled_font,
-                                                         TT_TAG_hmtx,
-							 (num_hmetrics - 1) * long_entry_size,
-							 (unsigned char *) p, &short_entry_size);
+            status = _cairo_scaled_font_subset_load_table (font->scaled_font_subset,
+							   TT_TAG_hmtx,
+							   (num_hmetrics - 1) * long_entry_size,
+							   (unsigned char *) p, &short_entry_size);
 	    if (unlikely (status))
 		return _cairo_truetype_font_set_error (font, status);
 
-            status = font->backend->load_truetype_table (font->scaled_font_subset->scaled_font,
-							 TT_TAG_hmtx,
-							 num_hmetrics * long_entry_size +
-							 (font->glyphs[i].parent_index - num_hmetrics) * short_entry_size,
-							 (unsigned char *) (p + 1), &short_entry_size);
+            status = _cairo_scaled_font_subset_load_table (font->scaled_font_subset,
+							   TT_TAG_hmtx,
+							   num_hmetrics * long_entry_size +
+							   (font->glyphs[i].parent_index - num_hmetrics) * short_entry_size,
+							   (unsigned char *) (p + 1), &short_entry_size);
 	    if (unlikely (status))
 		return _cairo_truetype_font_set_error (font, status);
         }
@@ -843,9 +843,9 @@ cairo_truetype_font_write_loca_table (cairo_truetype_font_t *font,
 	return font->status;
 
     size = sizeof(tt_head_t);
-    status = font->backend->load_truetype_table (font->scaled_font_subset->scaled_font,
-						 TT_TAG_head, 0,
-						 (unsigned char*) &header, &size);
+    status = _cairo_scaled_font_subset_load_table (font->scaled_font_subset,
+						   TT_TAG_head, 0,
+						   (unsigned char*) &header, &size);
     if (unlikely (status))
 	return _cairo_truetype_font_set_error (font, status);
 
@@ -877,8 +877,8 @@ cairo_truetype_font_write_maxp_table (cairo_truetype_font_t *font,
     if (unlikely (status))
 	return _cairo_truetype_font_set_error (font, status);
 
-    status = font->backend->load_truetype_table (font->scaled_font_subset->scaled_font,
-						 tag, 0, (unsigned char *) maxp, &size);
+    status = _cairo_scaled_font_subset_load_table (font->scaled_font_subset,
+						   tag, 0, (unsigned char *) maxp, &size);
     if (unlikely (status))
 	return _cairo_truetype_font_set_error (font, status);
 
@@ -1084,21 +1084,21 @@ cairo_truetype_font_create_truetype_table_list (cairo_truetype_font_t *font)
     int pos;
 
     size = 0;
-    if (font->backend->load_truetype_table (font->scaled_font_subset->scaled_font,
-                                      TT_TAG_cvt, 0, NULL,
-                                      &size) == CAIRO_INT_STATUS_SUCCESS)
+    if (_cairo_scaled_font_subset_load_table (font->scaled_font_subset,
+					      TT_TAG_cvt, 0, NULL,
+					      &size) == CAIRO_INT_STATUS_SUCCESS)
         has_cvt = TRUE;
 
     size = 0;
-    if (font->backend->load_truetype_table (font->scaled_font_subset->scaled_font,
-                                      TT_TAG_fpgm, 0, NULL,
-                                      &size) == CAIRO_INT_STATUS_SUCCESS)
+    if (_cairo_scaled_font_subset_load_table (font->scaled_font_subset,
+					      TT_TAG_fpgm, 0, NULL,
+					      &size) == CAIRO_INT_STATUS_SUCCESS)
         has_fpgm = TRUE;
 
     size = 0;
-    if (font->backend->load_truetype_table (font->scaled_font_subset->scaled_font,
-                                      TT_TAG_prep, 0, NULL,
-                                      &size) == CAIRO_INT_STATUS_SUCCESS)
+    if (_cairo_scaled_font_subset_load_table (font->scaled_font_subset,
+					      TT_TAG_prep, 0, NULL,
+					      &size) == CAIRO_INT_STATUS_SUCCESS)
         has_prep = TRUE;
 
     font->num_tables = 0;
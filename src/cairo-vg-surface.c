@@ -194,6 +194,7 @@ _vg_context_init (cairo_vg_context_t *context)
 				16*1024*1024);
     if (unlikely (status))
 	return status;
+    _cairo_cache_set_policy (&context->snapshot_cache, CAIRO_CACHE_POLICY_LRU);
 
     context->target_id = 0;
     context->source = NULL;
@@ -454,6 +454,13 @@ _cairo_xcb_render_compositor_glyphs (const cairo_compositor_t     *compositor,
 				     cairo_glyph_t                *glyphs,
 				     int                           num_glyphs,
 				     cairo_bool_t                  overlap);
+
+cairo_private cairo_status_t
+_cairo_xcb_surface_prefetch_glyphs (cairo_xcb_surface_t	*surface,
+				    cairo_scaled_font_t	*scaled_font,
+				    const cairo_glyph_t	*glyphs,
+				    int			 num_glyphs);
+
 cairo_private void
 _cairo_xcb_surface_scaled_font_fini (cairo_scaled_font_t *scaled_font);
 
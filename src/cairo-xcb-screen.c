@@ -280,6 +280,8 @@ _cairo_xcb_screen_get (xcb_connection_t *xcb_connection,
 				16);
     if (unlikely (status))
 	goto error_screen;
+    _cairo_cache_set_policy (&screen->linear_pattern_cache,
+			     CAIRO_CACHE_POLICY_LRU);
 
     status = _cairo_cache_init (&screen->radial_pattern_cache,
 				_radial_pattern_cache_entry_equal,
@@ -288,6 +290,8 @@ _cairo_xcb_screen_get (xcb_connection_t *xcb_connection,
 				4);
     if (unlikely (status))
 	goto error_linear;
+    _cairo_cache_set_policy (&screen->radial_pattern_cache,
+			     CAIRO_CACHE_POLICY_LRU);
 
     cairo_list_add (&screen->link, &connection->screens);
 
@@ -4374,10 +4374,121 @@ _cairo_xcb_glyph_attach (cairo_xcb_connection_t  *c,
     return CAIRO_STATUS_SUCCESS;
 }
 
+/* Glyphs seen for the first time are collected here and sent to the
+ * server together, one AddGlyphs request per glyphset and as many glyphs
+ * as fit into a request, rather than one request per glyph.  The batch
+ * must be flushed before any request that references its glyphs.
+ */
+#define GLYPH_UPLOAD_MAX 128
+
+typedef struct {
+    cairo_xcb_font_glyphset_info_t *info;
+
+    int num_glyphs;
+    uint32_t glyph_ids[GLYPH_UPLOAD_MAX];
+    xcb_render_glyphinfo_t glyph_info[GLYPH_UPLOAD_MAX];
+
+    uint8_t *data;
+    unsigned int data_len, data_size;
+    uint8_t buf[CAIRO_STACK_BUFFER_SIZE];
+} cairo_xcb_glyph_upload_t;
+
+static void
+_cairo_xcb_glyph_upload_init (cairo_xcb_glyph_upload_t *upload)
+{
+    upload->info = NULL;
+    upload->num_glyphs = 0;
+    upload->data = upload->buf;
+    upload->data_len = 0;
+    upload->data_size = sizeof (upload->buf);
+}
+
+static void
+_cairo_xcb_glyph_upload_flush (cairo_xcb_connection_t   *connection,
+			       cairo_xcb_glyph_upload_t *upload)
+{
+    if (upload->num_glyphs == 0)
+	return;
+
+    _cairo_xcb_connection_render_add_glyphs (connection,
+					     upload->info->glyphset,
+					     upload->num_glyphs,
+					     upload->glyph_ids,
+					     upload->glyph_info,
+					     upload->data_len,
+					     upload->data);
+
+    upload->num_glyphs = 0;
+    upload->data_len = 0;
+}
+
+static void
+_cairo_xcb_glyph_upload_fini (cairo_xcb_connection_t   *connection,
+			      cairo_xcb_glyph_upload_t *upload)
+{
+    _cairo_xcb_glyph_upload_flush (connection, upload);
+    if (upload->data != upload->buf)
+	free (upload->data);
+}
+
 static cairo_status_t
-_cairo_xcb_surface_add_glyph (cairo_xcb_connection_t *connection,
-			       cairo_scaled_font_t   *font,
-			       cairo_scaled_glyph_t **scaled_glyph_out)
+_cairo_xcb_glyph_upload_append (cairo_xcb_connection_t		*connection,
+				cairo_xcb_glyph_upload_t	*upload,
+				cairo_xcb_font_glyphset_info_t	*info,
+				uint32_t			 glyph_index,
+				const xcb_render_glyphinfo_t	*glyph_info,
+				const uint8_t			*data,
+				unsigned int			 len)
+{
+    unsigned int request_size;
+
+    /* AddGlyphs: header, glyphset and count, then per glyph an id and a
+     * glyphinfo, followed by the image data */
+    request_size = 12 + (upload->num_glyphs + 1) * 16 + upload->data_len + len;
+    if (upload->info != info ||
+	upload->num_glyphs == GLYPH_UPLOAD_MAX ||
+	request_size > connection->maximum_request_length - 64)
+    {
+	_cairo_xcb_glyph_upload_flush (connection, upload);
+	upload->info = info;
+    }
+
+    if (upload->data_len + len > upload->data_size) {
+	unsigned int size = upload->data_size;
+	uint8_t *new_data;
+
+	do
+	    size *= 2;
+	while (upload->data_len + len > size);
+
+	if (upload->data == upload->buf) {
+	    new_data = _cairo_malloc (size);
+	    if (likely (new_data != NULL))
+		memcpy (new_data, upload->data, upload->data_len);
+	} else
+	    new_data = realloc (upload->data, size);
+	if (unlikely (new_data == NULL))
+	    return _cairo_error (CAIRO_STATUS_NO_MEMORY);
+
+	upload->data = new_data;
+	upload->data_size = size;
+    }
+
+    upload->glyph_ids[upload->num_glyphs] = glyph_index;
+    upload->glyph_info[upload->num_glyphs] = *glyph_info;
+    upload->num_glyphs++;
+
+    memcpy (upload->data + upload->data_len, data, len);
+    upload->data_len += len;
+
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_status_t
+_cairo_xcb_glyph_upload_add (cairo_xcb_connection_t   *connection,
+			     cairo_xcb_glyph_upload_t *upload,
+			     cairo_scaled_font_t      *font,
+			     cairo_scaled_glyph_t    **scaled_glyph_out)
 {
     xcb_render_glyphinfo_t glyph_info;
     uint32_t glyph_index;
@@ -4525,16 +4636,16 @@ _cairo_xcb_surface_add_glyph (cairo_xcb_connection_t *connection,
     }
     /* XXX assume X server wants pixman padding. Xft assumes this as well */
 
-    _cairo_xcb_connection_render_add_glyphs (connection,
-					     info->glyphset,
-					     1, &glyph_index, &glyph_info,
-					     glyph_surface->stride * glyph_surface->height,
-					     data);
+    status = _cairo_xcb_glyph_upload_append (connection, upload, info,
+					     glyph_index, &glyph_info,
+					     data,
+					     glyph_surface->stride * glyph_surface->height);
 
     if (data != glyph_surface->data)
 	free (data);
 
-    status = _cairo_xcb_glyph_attach (connection, scaled_glyph, info);
+    if (likely (status == CAIRO_STATUS_SUCCESS))
+	status = _cairo_xcb_glyph_attach (connection, scaled_glyph, info);
 
  BAIL:
     if (glyph_surface != scaled_glyph->surface)
@@ -4552,6 +4663,97 @@ _cairo_xcb_surface_add_glyph (cairo_xcb_connection_t *connection,
     return status;
 }
 
+static cairo_status_t
+_cairo_xcb_surface_add_glyph (cairo_xcb_connection_t *connection,
+			       cairo_scaled_font_t   *font,
+			       cairo_scaled_glyph_t **scaled_glyph_out)
+{
+    cairo_xcb_glyph_upload_t upload;
+    cairo_status_t status;
+
+    _cairo_xcb_glyph_upload_init (&upload);
+    status = _cairo_xcb_glyph_upload_add (connection, &upload,
+					  font, scaled_glyph_out);
+    _cairo_xcb_glyph_upload_fini (connection, &upload);
+
+    return status;
+}
+
+/* Send all the glyphs of a run that are not yet known to the server,
+ * batched into as few AddGlyphs requests as possible.  The caller must
+ * hold the connection and have frozen the font cache.
+ */
+static cairo_status_t
+_cairo_xcb_surface_upload_glyphs (cairo_xcb_connection_t *connection,
+				  cairo_scaled_font_t	 *font,
+				  const cairo_glyph_t	 *glyphs,
+				  int			  num_glyphs)
+{
+    unsigned long glyph_cache[64];
+    cairo_xcb_glyph_upload_t upload;
+    cairo_status_t status = CAIRO_STATUS_SUCCESS;
+    int i;
+
+    /* As in _can_composite_glyphs(), 0 cannot be hashed into slot 0 */
+    memset (glyph_cache, 0, sizeof (glyph_cache));
+    glyph_cache[0] = 1;
+
+    _cairo_xcb_glyph_upload_init (&upload);
+    for (i = 0; i < num_glyphs; i++) {
+	unsigned long glyph_index = glyphs[i].index;
+	int g = glyph_index % ARRAY_LENGTH (glyph_cache);
+	cairo_scaled_glyph_t *glyph;
+
+	if (glyph_cache[g] == glyph_index)
+	    continue;
+
+	status = _cairo_scaled_glyph_lookup (font,
+					     glyph_index,
+					     CAIRO_SCALED_GLYPH_INFO_METRICS,
+					     &glyph);
+	if (unlikely (status))
+	    break;
+
+	if (glyph->dev_private_key != connection) {
+	    status = _cairo_xcb_glyph_upload_add (connection, &upload,
+						  font, &glyph);
+	    if (unlikely (status))
+		break;
+	}
+
+	glyph_cache[g] = glyph_index;
+    }
+    _cairo_xcb_glyph_upload_fini (connection, &upload);
+
+    return status;
+}
+
+cairo_status_t
+_cairo_xcb_surface_prefetch_glyphs (cairo_xcb_surface_t	*surface,
+				    cairo_scaled_font_t	*scaled_font,
+				    const cairo_glyph_t	*glyphs,
+				    int			 num_glyphs)
+{
+    cairo_status_t status;
+
+    if ((surface->connection->flags & CAIRO_XCB_RENDER_HAS_COMPOSITE_GLYPHS) == 0)
+	return CAIRO_STATUS_SUCCESS;
+
+    status = _cairo_xcb_connection_acquire (surface->connection);
+    if (unlikely (status))
+	return status;
+
+    _cairo_scaled_font_freeze_cache (scaled_font);
+    status = _cairo_xcb_surface_upload_glyphs (surface->connection,
+					       scaled_font,
+					       glyphs, num_glyphs);
+    _cairo_scaled_font_thaw_cache (scaled_font);
+
+    _cairo_xcb_connection_release (surface->connection);
+
+    return status;
+}
+
 typedef void (*cairo_xcb_render_composite_text_func_t)
 	      (cairo_xcb_connection_t       *connection,
 	       uint8_t                          op,
@@ -4836,6 +5038,16 @@ _cairo_xcb_render_compositor_glyphs (const cairo_compositor_t     *compositor,
 
 	status = _can_composite_glyphs (surface, &composite->bounded,
 					scaled_font, glyphs, &num_glyphs);
+	if (likely (status == CAIRO_INT_STATUS_SUCCESS)) {
+	    /* Upload the new glyphs of the whole run ahead of the text */
+	    status = _cairo_xcb_connection_acquire (surface->connection);
+	    if (likely (status == CAIRO_INT_STATUS_SUCCESS)) {
+		status = _cairo_xcb_surface_upload_glyphs (surface->connection,
+							   scaled_font,
+							   glyphs, num_glyphs);
+		_cairo_xcb_connection_release (surface->connection);
+	    }
+	}
 	if (likely (status == CAIRO_INT_STATUS_SUCCESS)) {
 	    composite_glyphs_info_t info;
 	    unsigned flags = 0;
@@ -1529,3 +1529,55 @@ cairo_xcb_surface_set_drawable (cairo_surface_t *abstract_surface,
 #if CAIRO_HAS_XLIB_XCB_FUNCTIONS
 slim_hidden_def (cairo_xcb_surface_set_drawable);
 #endif
+
+/**
+ * cairo_xcb_surface_prefetch_glyphs:
+ * @surface: a #cairo_surface_t for the XCB backend
+ * @scaled_font: the #cairo_scaled_font_t the glyphs will be shown with
+ * @glyphs: array of glyphs; only their indices are used
+ * @num_glyphs: number of glyphs in @glyphs
+ *
+ * Renders and uploads the given glyphs of @scaled_font to the X server
+ * ahead of their first use on @surface (or any other surface on the
+ * same connection), sending all those that are not already there in as
+ * few requests as possible. Calling this with the glyphs of the text
+ * about to be shown, for instance as returned by
+ * cairo_scaled_font_text_to_glyphs(), lets the uploads overlap with
+ * other work instead of delaying the first paint.
+ *
+ * This is only a hint and has no effect if the server cannot draw
+ * glyphs itself.
+ *
+ * Since: 1.18
+ **/
+void
+cairo_xcb_surface_prefetch_glyphs (cairo_surface_t		*abstract_surface,
+				   cairo_scaled_font_t		*scaled_font,
+				   const cairo_glyph_t		*glyphs,
+				   int				 num_glyphs)
+{
+    cairo_status_t status;
+
+    if (unlikely (abstract_surface->status))
+	return;
+    if (unlikely (abstract_surface->finished)) {
+	_cairo_surface_set_error (abstract_surface,
+				  _cairo_error (CAIRO_STATUS_SURFACE_FINISHED));
+	return;
+    }
+
+    if ( !_cairo_surface_is_xcb(abstract_surface)) {
+	_cairo_surface_set_error (abstract_surface,
+				  _cairo_error (CAIRO_STATUS_SURFACE_TYPE_MISMATCH));
+	return;
+    }
+
+    if (scaled_font == NULL || scaled_font->status || num_glyphs <= 0)
+	return;
+
+    status = _cairo_xcb_surface_prefetch_glyphs ((cairo_xcb_surface_t *) abstract_surface,
+						 scaled_font,
+						 glyphs, num_glyphs);
+    if (unlikely (status))
+	_cairo_surface_set_error (abstract_surface, status);
+}
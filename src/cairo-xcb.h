@@ -81,6 +81,12 @@ cairo_xcb_surface_set_drawable (cairo_surface_t *surface,
 				int		width,
 				int		height);
 
+cairo_public void
+cairo_xcb_surface_prefetch_glyphs (cairo_surface_t		*surface,
+				   cairo_scaled_font_t		*scaled_font,
+				   const cairo_glyph_t		*glyphs,
+				   int				 num_glyphs);
+
 cairo_public xcb_connection_t *
 cairo_xcb_device_get_connection (cairo_device_t *device);
 
@@ -65,6 +65,9 @@ typedef struct _cairo_xlib_surface cairo_xlib_surface_t;
 #define RAMP_SIZE 16
 /* maximum number of cached GC's */
 #define GC_CACHE_SIZE 4
+/* number of extra shm buffers to render fallbacks into while the
+ * previous upload is still in flight */
+#define CAIRO_XLIB_SHM_SPARE 2
 
 struct _cairo_xlib_display {
     cairo_device_t base;
@@ -175,6 +178,8 @@ struct _cairo_xlib_surface {
 
     const cairo_compositor_t *compositor;
     cairo_surface_t *shm;
+    /* earlier fallback buffers, possibly still being read by the server */
+    cairo_surface_t *shm_spare[CAIRO_XLIB_SHM_SPARE];
     int fallback;
 
     cairo_xlib_display_t *display;
@@ -432,6 +437,9 @@ _cairo_xlib_surface_get_shm (cairo_xlib_surface_t *surface,
 cairo_private cairo_int_status_t
 _cairo_xlib_surface_put_shm (cairo_xlib_surface_t *surface);
 
+cairo_private cairo_bool_t
+_cairo_xlib_surface_swap_shm (cairo_xlib_surface_t *surface);
+
 cairo_private cairo_surface_t *
 _cairo_xlib_surface_create_shm (cairo_xlib_surface_t *other,
 				pixman_format_code_t format,
@@ -131,6 +131,12 @@ _cairo_xlib_shm_surface_is_idle (cairo_surface_t *surface)
     return TRUE;
 }
 
+cairo_bool_t
+_cairo_xlib_surface_swap_shm (cairo_xlib_surface_t *surface)
+{
+    return FALSE;
+}
+
 void _cairo_xlib_display_fini_shm (cairo_xlib_display_t *display) {}
 
 #else
@@ -184,6 +190,9 @@ struct _cairo_xlib_shm_surface {
     Pixmap pixmap;
     unsigned long active;
     int idle;
+
+    /* for a spare buffer, the area the live buffer has changed since */
+    cairo_region_t *stale;
 };
 
 /* the parent is always given by index/2 */
@@ -722,6 +731,11 @@ _cairo_xlib_shm_surface_finish (void *abstract_surface)
 	shm->image.base.damage = _cairo_damage_create_in_error (CAIRO_STATUS_SURFACE_FINISHED);
     }
 
+    if (shm->stale) {
+	cairo_region_destroy (shm->stale);
+	shm->stale = NULL;
+    }
+
     status = _cairo_xlib_display_acquire (shm->image.base.device, &display);
     if (unlikely (status))
 	return status;
@@ -850,6 +864,7 @@ _cairo_xlib_shm_surface_create (cairo_xlib_surface_t *other,
     }
     shm->active = shm->info->last_request;
     shm->idle = -5;
+    shm->stale = NULL;
 
     assert (shm->active == 0 || will_sync);
 
@@ -869,6 +884,69 @@ cleanup_shm:
     return NULL;
 }
 
+static void
+_cairo_xlib_surface_mark_spare_shm (cairo_xlib_surface_t *surface,
+				    const cairo_region_t *region)
+{
+    int i;
+
+    for (i = 0; i < CAIRO_XLIB_SHM_SPARE; i++) {
+	cairo_xlib_shm_surface_t *spare;
+
+	spare = (cairo_xlib_shm_surface_t *) surface->shm_spare[i];
+	if (spare == NULL)
+	    continue;
+
+	if (region == NULL || spare->stale == NULL) {
+	    cairo_rectangle_int_t r;
+
+	    r.x = r.y = 0;
+	    r.width  = spare->image.width;
+	    r.height = spare->image.height;
+
+	    if (spare->stale)
+		cairo_region_destroy (spare->stale);
+	    spare->stale = region ?
+		cairo_region_copy (region) : cairo_region_create_rectangle (&r);
+	} else
+	    cairo_region_union (spare->stale, region);
+    }
+}
+
+static void
+_cairo_xlib_shm_surface_copy_region (cairo_xlib_shm_surface_t *dst,
+				     cairo_xlib_shm_surface_t *src,
+				     const cairo_region_t *region)
+{
+    cairo_rectangle_int_t r;
+    int n, i;
+
+    if (unlikely (cairo_region_status (region))) {
+	/* lost track, so refresh the whole buffer */
+	r.x = r.y = 0;
+	r.width  = src->image.width;
+	r.height = src->image.height;
+	pixman_image_composite32 (PIXMAN_OP_SRC,
+				  src->image.pixman_image, NULL,
+				  dst->image.pixman_image,
+				  0, 0, 0, 0, 0, 0,
+				  r.width, r.height);
+	return;
+    }
+
+    n = cairo_region_num_rectangles (region);
+    for (i = 0; i < n; i++) {
+	cairo_region_get_rectangle (region, i, &r);
+	pixman_image_composite32 (PIXMAN_OP_SRC,
+				  src->image.pixman_image, NULL,
+				  dst->image.pixman_image,
+				  r.x, r.y,
+				  0, 0,
+				  r.x, r.y,
+				  r.width, r.height);
+    }
+}
+
 static void
 _cairo_xlib_surface_update_shm (cairo_xlib_surface_t *surface)
 {
@@ -880,6 +958,9 @@ _cairo_xlib_surface_update_shm (cairo_xlib_surface_t *surface)
     damage = _cairo_damage_reduce (surface->base.damage);
     surface->base.damage = _cairo_damage_create();
 
+    _cairo_xlib_surface_mark_spare_shm (surface,
+					damage->status ? NULL : damage->region);
+
     if (_cairo_xlib_display_acquire (surface->base.device, &display))
 	goto cleanup_damage;
 
@@ -973,6 +1054,8 @@ _cairo_xlib_surface_clear_shm (cairo_xlib_surface_t *surface)
 
     memset (shm->image.data, 0, shm->image.stride * shm->image.height);
     shm->image.base.is_clear = TRUE;
+
+    _cairo_xlib_surface_mark_spare_shm (surface, NULL);
 }
 
 static void inc_idle (cairo_surface_t *surface)
@@ -1045,6 +1128,10 @@ _cairo_xlib_surface_get_shm (cairo_xlib_surface_t *surface,
     if (!surface->base.is_clear && surface->base.damage->dirty)
 	_cairo_xlib_surface_update_shm (surface);
 
+    /* Rather than wait for the last upload, carry on in a spare buffer */
+    if (_cairo_xlib_shm_surface_is_active (surface->shm))
+	_cairo_xlib_surface_swap_shm (surface);
+
     _cairo_xlib_shm_surface_flush (surface->shm, 1);
 
     if (surface->base.is_clear && surface->base.damage->dirty)
@@ -1055,6 +1142,99 @@ done:
     return surface->shm;
 }
 
+/* Replace the live shm buffer, whose contents are still being copied
+ * to the drawable by the server, with an idle spare so that the next
+ * fallback can be rendered while that upload is in flight.
+ *
+ * Each upload is fenced by its request number: send_event() queues a
+ * ShmCompletion to ourselves behind it, and once that (or any later
+ * reply) has been read the server has finished with the buffer and it
+ * may be reused.  A spare only lags the live buffer by the regions
+ * uploaded or read back since it was last swapped out, so bringing it
+ * up to date is a copy of those regions rather than of the whole image.
+ *
+ * Returns FALSE if no spare buffer is available, in which case the
+ * caller has to wait upon the live buffer as before.
+ */
+cairo_bool_t
+_cairo_xlib_surface_swap_shm (cairo_xlib_surface_t *surface)
+{
+    cairo_xlib_shm_surface_t *shm = (cairo_xlib_shm_surface_t *) surface->shm;
+    cairo_xlib_shm_surface_t *next = NULL;
+    cairo_xlib_display_t *display;
+    cairo_rectangle_int_t r;
+    cairo_damage_t *damage;
+    int i;
+
+    if (_cairo_xlib_display_acquire (surface->base.device, &display))
+	return FALSE;
+
+    /* Let the server tell us as soon as it is done with the last upload */
+    send_event (display, shm->info, shm->active);
+    XEventsQueued (display->display, QueuedAfterReading);
+
+    for (i = 0; i < CAIRO_XLIB_SHM_SPARE; i++) {
+	next = (cairo_xlib_shm_surface_t *) surface->shm_spare[i];
+	if (next == NULL) {
+	    next = _cairo_xlib_shm_surface_create (surface,
+						   shm->image.pixman_format,
+						   shm->image.width,
+						   shm->image.height,
+						   FALSE, 1);
+	    if (next == NULL)
+		break;
+	    if (unlikely (next->image.base.status || next->pixmap == 0)) {
+		cairo_surface_finish (&next->image.base);
+		cairo_surface_destroy (&next->image.base);
+		next = NULL;
+		break;
+	    }
+
+	    r.x = r.y = 0;
+	    r.width  = next->image.width;
+	    r.height = next->image.height;
+	    next->stale = cairo_region_create_rectangle (&r);
+	    next->image.base.damage = _cairo_damage_create ();
+	    surface->shm_spare[i] = &next->image.base;
+	    break;
+	}
+
+	if (! active (next, display->display)) {
+	    next->active = 0;
+	    break;
+	}
+
+	next = NULL;
+    }
+    cairo_device_release (&display->base);
+
+    if (next == NULL)
+	return FALSE;
+
+    /* Anything drawn but not yet uploaded travels with the new buffer */
+    damage = shm->image.base.damage = _cairo_damage_reduce (shm->image.base.damage);
+    if (damage->status)
+	_cairo_xlib_surface_mark_spare_shm (surface, NULL);
+    else if (damage->region)
+	_cairo_xlib_surface_mark_spare_shm (surface, damage->region);
+
+    if (next->stale) {
+	_cairo_xlib_shm_surface_copy_region (next, shm, next->stale);
+	cairo_region_destroy (next->stale);
+	next->stale = NULL;
+    }
+
+    shm->image.base.damage = next->image.base.damage;
+    next->image.base.damage = damage;
+    next->image.base.is_clear = shm->image.base.is_clear;
+    next->idle = shm->idle;
+
+    surface->shm_spare[i] = &shm->image.base;
+    surface->shm = &next->image.base;
+
+    return TRUE;
+}
+
 cairo_int_status_t
 _cairo_xlib_surface_put_shm (cairo_xlib_surface_t *surface)
 {
@@ -1081,6 +1261,8 @@ _cairo_xlib_surface_put_shm (cairo_xlib_surface_t *surface)
 
 	TRACE ((stderr, "%s: flushing damage x %d\n", __FUNCTION__,
 		damage->region ? cairo_region_num_rectangles (damage->region) : 0));
+	_cairo_xlib_surface_mark_spare_shm (surface,
+					    damage->status ? NULL : damage->region);
 	if (damage->status == CAIRO_STATUS_SUCCESS && damage->region) {
 	    XRectangle stack_rects[CAIRO_STACK_ARRAY_LENGTH (XRectangle)];
 	    XRectangle *rects = stack_rects;
@@ -356,6 +356,8 @@ _cairo_xlib_surface_create_similar (void	       *abstract_src,
 static void
 _cairo_xlib_surface_discard_shm (cairo_xlib_surface_t *surface)
 {
+    int i;
+
     if (surface->shm == NULL)
 	return;
 
@@ -367,6 +369,15 @@ _cairo_xlib_surface_discard_shm (cairo_xlib_surface_t *surface)
     cairo_surface_destroy (surface->shm);
     surface->shm = NULL;
 
+    for (i = 0; i < CAIRO_XLIB_SHM_SPARE; i++) {
+	if (surface->shm_spare[i] == NULL)
+	    continue;
+
+	cairo_surface_finish (surface->shm_spare[i]);
+	cairo_surface_destroy (surface->shm_spare[i]);
+	surface->shm_spare[i] = NULL;
+    }
+
     _cairo_damage_destroy (surface->base.damage);
     surface->base.damage = NULL;
 
@@ -1542,7 +1553,8 @@ get_compositor (cairo_xlib_surface_t **surface,
 	assert (s->base.damage != NULL);
 	assert (s->shm != NULL);
 	assert (s->shm->damage != NULL);
-	if (! _cairo_xlib_shm_surface_is_active (s->shm)) {
+	if (! _cairo_xlib_shm_surface_is_active (s->shm) ||
+	    _cairo_xlib_surface_swap_shm (s)) {
 	    *surface = (cairo_xlib_surface_t *) s->shm;
 	    *compositor = ((cairo_image_surface_t *) s->shm)->compositor;
 	    s->fallback++;
@@ -1800,6 +1812,7 @@ found:
     surface->screen = screen;
     surface->compositor = display->compositor;
     surface->shm = NULL;
+    memset (surface->shm_spare, 0, sizeof (surface->shm_spare));
     surface->fallback = 0;
 
     surface->drawable = drawable;
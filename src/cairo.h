@@ -2373,6 +2373,7 @@ cairo_surface_status (cairo_surface_t *surface);
  * @CAIRO_SURFACE_TYPE_SUBSURFACE: The surface is a subsurface created with
  *   cairo_surface_create_for_rectangle(), since 1.10
  * @CAIRO_SURFACE_TYPE_COGL: This surface is of type Cogl, since 1.12
+ * @CAIRO_SURFACE_TYPE_TILED: The surface is a tiled image surface, since 1.18
  *
  * #cairo_surface_type_t is used to describe the type of a given
  * surface. The surface types are also known as "backends" or "surface
@@ -2423,7 +2424,8 @@ typedef enum _cairo_surface_type {
     CAIRO_SURFACE_TYPE_XML,
     CAIRO_SURFACE_TYPE_SKIA,
     CAIRO_SURFACE_TYPE_SUBSURFACE,
-    CAIRO_SURFACE_TYPE_COGL
+    CAIRO_SURFACE_TYPE_COGL,
+    CAIRO_SURFACE_TYPE_TILED
 } cairo_surface_type_t;
 
 cairo_public cairo_surface_type_t
@@ -2443,6 +2445,88 @@ cairo_surface_write_to_png_stream (cairo_surface_t	*surface,
 				   cairo_write_func_t	write_func,
 				   void			*closure);
 
+/**
+ * cairo_png_options_t:
+ *
+ * An opaque set of options controlling how PNG images are encoded by
+ * cairo_surface_write_to_png_with_options() and
+ * cairo_surface_write_to_png_stream_with_options(), and decoded by
+ * cairo_image_surface_create_from_png_with_options(),
+ * cairo_image_surface_create_from_png_stream_with_options() and
+ * #cairo_png_decoder_t.
+ *
+ * Since: 1.18
+ **/
+typedef struct _cairo_png_options cairo_png_options_t;
+
+/**
+ * cairo_png_filter_t:
+ * @CAIRO_PNG_FILTER_DEFAULT: choose the best filter for each row (Since 1.18)
+ * @CAIRO_PNG_FILTER_NONE: no filtering, the fastest (Since 1.18)
+ * @CAIRO_PNG_FILTER_SUB: difference with the pixel to the left (Since 1.18)
+ * @CAIRO_PNG_FILTER_UP: difference with the pixel above (Since 1.18)
+ * @CAIRO_PNG_FILTER_AVERAGE: difference with the average of the pixels
+ *   to the left and above (Since 1.18)
+ * @CAIRO_PNG_FILTER_PAETH: the Paeth predictor (Since 1.18)
+ *
+ * The filter applied to the rows of an image before compression.
+ *
+ * Since: 1.18
+ **/
+typedef enum _cairo_png_filter {
+    CAIRO_PNG_FILTER_DEFAULT,
+    CAIRO_PNG_FILTER_NONE,
+    CAIRO_PNG_FILTER_SUB,
+    CAIRO_PNG_FILTER_UP,
+    CAIRO_PNG_FILTER_AVERAGE,
+    CAIRO_PNG_FILTER_PAETH
+} cairo_png_filter_t;
+
+cairo_public cairo_png_options_t *
+cairo_png_options_create (void);
+
+cairo_public void
+cairo_png_options_destroy (cairo_png_options_t *options);
+
+cairo_public void
+cairo_png_options_set_compression_level (cairo_png_options_t	*options,
+					 int			 level);
+
+cairo_public int
+cairo_png_options_get_compression_level (const cairo_png_options_t *options);
+
+cairo_public void
+cairo_png_options_set_filter (cairo_png_options_t	*options,
+			      cairo_png_filter_t	 filter);
+
+cairo_public cairo_png_filter_t
+cairo_png_options_get_filter (const cairo_png_options_t *options);
+
+cairo_public void
+cairo_png_options_set_parallel (cairo_png_options_t	*options,
+				cairo_bool_t		 parallel);
+
+cairo_public cairo_bool_t
+cairo_png_options_get_parallel (const cairo_png_options_t *options);
+
+cairo_public void
+cairo_png_options_set_decode_scale (cairo_png_options_t	*options,
+				    int			 scale);
+
+cairo_public int
+cairo_png_options_get_decode_scale (const cairo_png_options_t *options);
+
+cairo_public cairo_status_t
+cairo_surface_write_to_png_with_options (cairo_surface_t		*surface,
+					 const char			*filename,
+					 const cairo_png_options_t	*options);
+
+cairo_public cairo_status_t
+cairo_surface_write_to_png_stream_with_options (cairo_surface_t		*surface,
+						cairo_write_func_t		 write_func,
+						void				*closure,
+						const cairo_png_options_t	*options);
+
 #endif
 
 cairo_public void *
@@ -2575,6 +2659,14 @@ cairo_image_surface_get_height (cairo_surface_t *surface);
 cairo_public int
 cairo_image_surface_get_stride (cairo_surface_t *surface);
 
+cairo_public cairo_surface_t *
+cairo_image_surface_create_shared (cairo_format_t	format,
+				   int			width,
+				   int			height);
+
+cairo_public int
+cairo_image_surface_get_shared_fd (cairo_surface_t *surface);
+
 #if CAIRO_HAS_PNG_FUNCTIONS
 
 cairo_public cairo_surface_t *
@@ -2584,6 +2676,64 @@ cairo_public cairo_surface_t *
 cairo_image_surface_create_from_png_stream (cairo_read_func_t	read_func,
 					    void		*closure);
 
+cairo_public cairo_surface_t *
+cairo_image_surface_create_from_png_with_options (const char			*filename,
+						  const cairo_png_options_t	*options);
+
+cairo_public cairo_surface_t *
+cairo_image_surface_create_from_png_stream_with_options (cairo_read_func_t		 read_func,
+							 void				*closure,
+							 const cairo_png_options_t	*options);
+
+/**
+ * cairo_png_decoder_t:
+ *
+ * A #cairo_png_decoder_t decodes a PNG image from data pushed into it
+ * with cairo_png_decoder_write(), making the rows available as soon as
+ * they have been decoded.
+ *
+ * Since: 1.18
+ **/
+typedef struct _cairo_png_decoder cairo_png_decoder_t;
+
+/**
+ * cairo_png_decoder_rows_func_t:
+ * @closure: the closure passed to cairo_png_decoder_set_rows_func()
+ * @y: the first row of the surface that has been decoded
+ * @height: the number of rows
+ *
+ * The type of function called by a #cairo_png_decoder_t when rows of
+ * its surface have been decoded. It must not call back into the
+ * decoder, other than cairo_png_decoder_get_surface().
+ *
+ * Since: 1.18
+ **/
+typedef void (*cairo_png_decoder_rows_func_t) (void	*closure,
+					       int	 y,
+					       int	 height);
+
+cairo_public cairo_png_decoder_t *
+cairo_png_decoder_create (const cairo_png_options_t *options);
+
+cairo_public void
+cairo_png_decoder_destroy (cairo_png_decoder_t *decoder);
+
+cairo_public void
+cairo_png_decoder_set_rows_func (cairo_png_decoder_t		*decoder,
+				 cairo_png_decoder_rows_func_t	 rows_func,
+				 void				*closure);
+
+cairo_public cairo_status_t
+cairo_png_decoder_write (cairo_png_decoder_t	*decoder,
+			 const unsigned char	*data,
+			 unsigned int		 length);
+
+cairo_public cairo_surface_t *
+cairo_png_decoder_get_surface (cairo_png_decoder_t *decoder);
+
+cairo_public cairo_surface_t *
+cairo_png_decoder_finish (cairo_png_decoder_t *decoder);
+
 #endif
 
 /* Recording-surface functions */
@@ -2603,6 +2753,13 @@ cairo_public cairo_bool_t
 cairo_recording_surface_get_extents (cairo_surface_t *surface,
 				     cairo_rectangle_t *extents);
 
+/* Tiled-surface functions */
+
+cairo_public cairo_surface_t *
+cairo_tiled_surface_create (cairo_format_t	format,
+			    int			width,
+			    int			height);
+
 /* raster-source pattern (callback) functions */
 
 /**
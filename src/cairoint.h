@@ -420,6 +420,28 @@ _cairo_user_data_array_foreach (cairo_user_data_array_t     *array,
 
 #define _CAIRO_HASH_INIT_VALUE 5381
 
+/* Incremental state for hashing data that is not contiguous in memory,
+ * such as the buffers of a path. The result only depends upon the
+ * concatenated bytes, not how they were split between updates. */
+typedef struct _cairo_hash_state {
+    uint64_t v[4];
+    uint64_t length;
+    unsigned char buf[32];
+    unsigned int buf_len;
+} cairo_hash_state_t;
+
+cairo_private void
+_cairo_hash_state_init (cairo_hash_state_t *state,
+			unsigned long seed);
+
+cairo_private void
+_cairo_hash_state_update (cairo_hash_state_t *state,
+			  const void *bytes,
+			  size_t length);
+
+cairo_private unsigned long
+_cairo_hash_state_finish (const cairo_hash_state_t *state);
+
 cairo_private unsigned long
 _cairo_hash_string (const char *c);
 
@@ -507,6 +529,9 @@ typedef struct _cairo_scaled_font_subset {
     cairo_bool_t is_composite;
     cairo_bool_t is_scaled;
     cairo_bool_t is_latin;
+
+    /* Font tables shared by all subsets of the font, may be NULL */
+    struct _cairo_font_table_cache *table_cache;
 } cairo_scaled_font_subset_t;
 
 struct _cairo_scaled_font_backend {
@@ -2141,6 +2166,9 @@ _cairo_debug_print_traps (FILE *file, const cairo_traps_t *traps);
 cairo_private void
 _cairo_debug_print_clip (FILE *stream, const cairo_clip_t *clip);
 
+cairo_private void
+_cairo_debug_print_cache (FILE *stream, const cairo_cache_t *cache);
+
 #if 0
 #define TRACE(x) fprintf (stderr, "%s: ", __FILE__), fprintf x
 #define TRACE_(x) x
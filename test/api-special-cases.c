@@ -1458,6 +1458,31 @@ test_cairo_xcb_surface_set_drawable (cairo_surface_t *surface)
     return CAIRO_TEST_SUCCESS;
 }
 
+static cairo_test_status_t
+test_cairo_xcb_surface_prefetch_glyphs (cairo_surface_t *surface)
+{
+    cairo_glyph_t glyph = { 1, 0, 0 };
+    cairo_font_face_t *font_face;
+    cairo_font_options_t *options;
+    cairo_scaled_font_t *scaled_font;
+    cairo_matrix_t identity;
+
+    font_face = cairo_toy_font_face_create (CAIRO_TEST_FONT_FAMILY " Sans",
+					    CAIRO_FONT_SLANT_NORMAL,
+					    CAIRO_FONT_WEIGHT_NORMAL);
+    options = cairo_font_options_create ();
+    cairo_matrix_init_identity (&identity);
+    scaled_font = cairo_scaled_font_create (font_face, &identity, &identity,
+					    options);
+    cairo_font_options_destroy (options);
+    cairo_font_face_destroy (font_face);
+
+    cairo_xcb_surface_prefetch_glyphs (surface, scaled_font, &glyph, 1);
+
+    cairo_scaled_font_destroy (scaled_font);
+    return CAIRO_TEST_SUCCESS;
+}
+
 #endif
 
 #if CAIRO_HAS_XLIB_SURFACE
@@ -1708,6 +1733,7 @@ struct {
 #if CAIRO_HAS_XCB_SURFACE
     TEST (cairo_xcb_surface_set_size, CAIRO_SURFACE_TYPE_XCB, TRUE),
     TEST (cairo_xcb_surface_set_drawable, CAIRO_SURFACE_TYPE_XCB, TRUE),
+    TEST (cairo_xcb_surface_prefetch_glyphs, CAIRO_SURFACE_TYPE_XCB, TRUE),
 #endif
 #if CAIRO_HAS_XLIB_SURFACE
     TEST (cairo_xlib_surface_set_size, CAIRO_SURFACE_TYPE_XLIB, TRUE),
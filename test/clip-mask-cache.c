@@ -0,0 +1,166 @@
+/*
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of
+ * the authors not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The authors make no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL,
+ * INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* A run of operations under one clip reuses the clip mask that the
+ * target rendered for the first of them: the second operation renders
+ * the whole clip, and the ones after it hit.  Check that every step
+ * draws exactly what it does on a fresh surface, which starts without
+ * a mask, including after the clip changes to another shape with the
+ * same extents, which has to miss.
+ */
+
+#include "cairo-test.h"
+
+#define SIZE 200
+
+static const struct step {
+    double corner;		/* of the rounded rectangle clip */
+    cairo_operator_t op;
+    double x, y, width, height;	/* of the filled rectangle, or a paint */
+    double red, green, blue, alpha;
+} steps[] = {
+    { 40, CAIRO_OPERATOR_OVER, 10, 10, 60, 60, 1, 0, 0, 1 },
+    { 40, CAIRO_OPERATOR_OVER, 100, 100, 90, 90, 0, 1, 0, 1 },
+    { 40, CAIRO_OPERATOR_OVER, 60, 30, 80, 40, 0, 0, 1, .5 },
+    { 40, CAIRO_OPERATOR_OVER, 0, 0, 0, 0, 1, 1, 0, .3 },
+    { 40, CAIRO_OPERATOR_IN, 30, 30, 100, 100, 0, 0, 0, .8 },
+    /* same extents, another shape */
+    { 70, CAIRO_OPERATOR_OVER, 0, 0, 0, 0, 0, 1, 1, .5 },
+    { 70, CAIRO_OPERATOR_OVER, 20, 120, 160, 60, 1, 0, 1, 1 },
+    { 40, CAIRO_OPERATOR_OVER, 20, 20, 160, 160, 1, .5, 0, .5 },
+    { 40, CAIRO_OPERATOR_SOURCE, 50, 50, 50, 50, 0, 0, 0, .2 },
+};
+
+static void
+rounded_rectangle (cairo_t *cr, double x, double y, double w, double h, double r)
+{
+    cairo_new_sub_path (cr);
+    cairo_arc (cr, x + w - r, y + r, r, -M_PI / 2, 0);
+    cairo_arc (cr, x + w - r, y + h - r, r, 0, M_PI / 2);
+    cairo_arc (cr, x + r, y + h - r, r, M_PI / 2, M_PI);
+    cairo_arc (cr, x + r, y + r, r, M_PI, 3 * M_PI / 2);
+    cairo_close_path (cr);
+}
+
+static void
+draw_step (cairo_t *cr, const struct step *step)
+{
+    cairo_save (cr);
+    rounded_rectangle (cr, 20, 20, SIZE - 40, SIZE - 40, step->corner);
+    cairo_clip (cr);
+
+    cairo_set_operator (cr, step->op);
+    cairo_set_source_rgba (cr, step->red, step->green, step->blue, step->alpha);
+    if (step->width) {
+	cairo_rectangle (cr, step->x, step->y, step->width, step->height);
+	cairo_fill (cr);
+    } else
+	cairo_paint (cr);
+    cairo_restore (cr);
+}
+
+static cairo_test_status_t
+compare (const cairo_test_context_t *ctx,
+	 cairo_surface_t *expected,
+	 cairo_surface_t *image,
+	 int step)
+{
+    const uint8_t *a, *b;
+    int stride_a, stride_b;
+    int x, y;
+
+    a = cairo_image_surface_get_data (expected);
+    b = cairo_image_surface_get_data (image);
+    stride_a = cairo_image_surface_get_stride (expected);
+    stride_b = cairo_image_surface_get_stride (image);
+
+    for (y = 0; y < SIZE; y++) {
+	const uint32_t *ra = (const uint32_t *) (a + y * stride_a);
+	const uint32_t *rb = (const uint32_t *) (b + y * stride_b);
+
+	for (x = 0; x < SIZE; x++) {
+	    if (ra[x] != rb[x]) {
+		cairo_test_log (ctx,
+				"Error: after step %d, pixel (%d, %d) is %08x, expected %08x\n",
+				step, x, y, rb[x], ra[x]);
+		return CAIRO_TEST_FAILURE;
+	    }
+	}
+    }
+
+    return CAIRO_TEST_SUCCESS;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    cairo_surface_t *image, *expected, *fresh;
+    cairo_test_status_t status = CAIRO_TEST_SUCCESS;
+    cairo_t *cr, *cr_fresh;
+    int n;
+
+    image = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, SIZE, SIZE);
+    expected = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, SIZE, SIZE);
+
+    cr = cairo_create (image);
+    cairo_set_source_rgb (cr, 1, 1, 1);
+    cairo_paint (cr);
+
+    for (n = 0; n < ARRAY_LENGTH (steps); n++) {
+	draw_step (cr, &steps[n]);
+	cairo_surface_flush (image);
+
+	/* replay the same step on a surface that has never seen a clip */
+	fresh = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, SIZE, SIZE);
+	cr_fresh = cairo_create (fresh);
+	if (n == 0) {
+	    cairo_set_source_rgb (cr_fresh, 1, 1, 1);
+	} else {
+	    cairo_set_source_surface (cr_fresh, expected, 0, 0);
+	    cairo_set_operator (cr_fresh, CAIRO_OPERATOR_SOURCE);
+	}
+	cairo_paint (cr_fresh);
+	cairo_set_operator (cr_fresh, CAIRO_OPERATOR_OVER);
+	draw_step (cr_fresh, &steps[n]);
+	cairo_destroy (cr_fresh);
+	cairo_surface_flush (fresh);
+
+	cairo_surface_destroy (expected);
+	expected = fresh;
+
+	status = compare (ctx, expected, image, n);
+	if (status != CAIRO_TEST_SUCCESS)
+	    break;
+    }
+
+    cairo_destroy (cr);
+    cairo_surface_destroy (expected);
+    cairo_surface_destroy (image);
+
+    return status;
+}
+
+CAIRO_TEST (clip_mask_cache,
+	    "Check that clip masks reused across operations match freshly rendered ones",
+	    "clip", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
@@ -0,0 +1,156 @@
+/*
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of
+ * the authors not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The authors make no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL,
+ * INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+/* Fill and stroke through a pixel-aligned clip made of many rectangles,
+ * which is applied to the spans as they are rendered, and check the
+ * result against drawing through each rectangle of the clip in turn.
+ */
+
+#include "cairo-test.h"
+
+#define SIZE 256
+#define CELL 16
+
+static void
+draw_shapes (cairo_t *cr)
+{
+    cairo_set_source_rgba (cr, 0.8, 0.2, 0.1, 0.7);
+    cairo_arc (cr, SIZE / 2, SIZE / 2, SIZE / 3, 0, 2 * M_PI);
+    cairo_fill (cr);
+
+    cairo_set_source_rgba (cr, 0.1, 0.3, 0.9, 0.6);
+    cairo_set_line_width (cr, 9);
+    cairo_move_to (cr, 10, 20);
+    cairo_curve_to (cr, SIZE, 0, 0, SIZE, SIZE - 10, SIZE - 30);
+    cairo_stroke (cr);
+
+    cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+    cairo_set_source_rgba (cr, 0, 0.7, 0.2, 0.5);
+    cairo_move_to (cr, 0, SIZE);
+    cairo_line_to (cr, SIZE / 3, SIZE / 4);
+    cairo_line_to (cr, SIZE, SIZE / 2);
+    cairo_close_path (cr);
+    cairo_fill (cr);
+    cairo_set_operator (cr, CAIRO_OPERATOR_OVER);
+}
+
+static void
+cell (cairo_t *cr, int x, int y)
+{
+    cairo_rectangle (cr, x * CELL, y * CELL, CELL - (x & 3), CELL - (y % 3));
+}
+
+static cairo_surface_t *
+create_white (void)
+{
+    cairo_surface_t *surface;
+    cairo_t *cr;
+
+    surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, SIZE, SIZE);
+    cr = cairo_create (surface);
+    cairo_set_source_rgb (cr, 1, 1, 1);
+    cairo_paint (cr);
+    cairo_destroy (cr);
+
+    return surface;
+}
+
+static cairo_test_status_t
+compare (const cairo_test_context_t *ctx,
+	 cairo_surface_t *expected,
+	 cairo_surface_t *image)
+{
+    const uint8_t *a, *b;
+    int stride_a, stride_b;
+    int x, y;
+
+    cairo_surface_flush (expected);
+    cairo_surface_flush (image);
+
+    a = cairo_image_surface_get_data (expected);
+    b = cairo_image_surface_get_data (image);
+    stride_a = cairo_image_surface_get_stride (expected);
+    stride_b = cairo_image_surface_get_stride (image);
+
+    for (y = 0; y < SIZE; y++) {
+	const uint32_t *ra = (const uint32_t *) (a + y * stride_a);
+	const uint32_t *rb = (const uint32_t *) (b + y * stride_b);
+
+	for (x = 0; x < SIZE; x++) {
+	    if (ra[x] != rb[x]) {
+		cairo_test_log (ctx,
+				"Error: pixel (%d, %d) is %08x, expected %08x\n",
+				x, y, rb[x], ra[x]);
+		return CAIRO_TEST_FAILURE;
+	    }
+	}
+    }
+
+    return CAIRO_TEST_SUCCESS;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    cairo_surface_t *expected, *image;
+    cairo_test_status_t status;
+    cairo_t *cr;
+    int x, y;
+
+    /* one rectangle of the checkerboard at a time */
+    expected = create_white ();
+    cr = cairo_create (expected);
+    for (y = 0; y < SIZE / CELL; y++) {
+	for (x = (y & 1); x < SIZE / CELL; x += 2) {
+	    cairo_save (cr);
+	    cell (cr, x, y);
+	    cairo_clip (cr);
+	    draw_shapes (cr);
+	    cairo_restore (cr);
+	}
+    }
+    cairo_destroy (cr);
+
+    /* and the whole checkerboard as a single clip */
+    image = create_white ();
+    cr = cairo_create (image);
+    for (y = 0; y < SIZE / CELL; y++) {
+	for (x = (y & 1); x < SIZE / CELL; x += 2)
+	    cell (cr, x, y);
+    }
+    cairo_clip (cr);
+    draw_shapes (cr);
+    cairo_destroy (cr);
+
+    status = compare (ctx, expected, image);
+
+    cairo_surface_destroy (image);
+    cairo_surface_destroy (expected);
+    return status;
+}
+
+CAIRO_TEST (clip_region_spans,
+	    "Check drawing through a clip of many pixel-aligned rectangles",
+	    "clip", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
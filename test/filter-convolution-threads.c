@@ -0,0 +1,222 @@
+/*
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of
+ * the authors not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The authors make no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL,
+ * INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+/* Downscaling with the GOOD and BEST filters goes through cached
+ * convolution kernels, and large composites are split into bands of
+ * rows that run on the worker threads.  Render a set of scales with a
+ * single thread, then again with several threads, going through enough
+ * other scales in between to evict every cached kernel, and check that
+ * the results are identical.  A scaled subsurface of the destination
+ * drawn over itself must not be banded, and must also give the same
+ * result with several threads.
+ */
+
+#include "cairo-test.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define SOURCE_SIZE 1024
+#define SIZE 320
+#define NUM_SCALES 3
+#define NUM_EVICTING_SCALES 20
+
+#if CAIRO_HAS_PTHREAD
+static const double scales[NUM_SCALES] = { 0.5, 0.4, 0.75 };
+
+static cairo_surface_t *
+create_source (void)
+{
+    cairo_surface_t *source;
+    cairo_pattern_t *pattern;
+    cairo_t *cr;
+    int x, y;
+
+    source = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+					 SOURCE_SIZE, SOURCE_SIZE);
+    cr = cairo_create (source);
+
+    pattern = cairo_pattern_create_linear (0, 0, SOURCE_SIZE, SOURCE_SIZE);
+    cairo_pattern_add_color_stop_rgba (pattern, 0, 1, 0, 0, 1);
+    cairo_pattern_add_color_stop_rgba (pattern, 1, 0, 0, 1, .5);
+    cairo_set_source (cr, pattern);
+    cairo_pattern_destroy (pattern);
+    cairo_paint (cr);
+
+    /* fine detail, so that every kernel tap matters */
+    cairo_set_source_rgb (cr, 1, 1, 1);
+    for (y = 0; y < SOURCE_SIZE; y += 8) {
+	for (x = (y / 8) % 2 * 4; x < SOURCE_SIZE; x += 8)
+	    cairo_rectangle (cr, x, y, 3, 3);
+    }
+    cairo_fill (cr);
+
+    cairo_destroy (cr);
+    return source;
+}
+
+static cairo_surface_t *
+downscale (cairo_surface_t *source, cairo_filter_t filter, double scale)
+{
+    cairo_surface_t *image;
+    cairo_t *cr;
+
+    image = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, SIZE, SIZE);
+    cr = cairo_create (image);
+    cairo_scale (cr, scale, scale);
+    cairo_set_source_surface (cr, source, 0, 0);
+    cairo_pattern_set_filter (cairo_get_source (cr), filter);
+    cairo_paint (cr);
+    cairo_destroy (cr);
+
+    return image;
+}
+
+/* Draws the middle of the image, halved, over its own top-left corner. */
+static cairo_surface_t *
+downscale_over_itself (cairo_surface_t *source)
+{
+    cairo_surface_t *image, *subsurface;
+    cairo_t *cr;
+
+    image = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, 800, 800);
+    cr = cairo_create (image);
+    cairo_scale (cr, 800. / SOURCE_SIZE, 800. / SOURCE_SIZE);
+    cairo_set_source_surface (cr, source, 0, 0);
+    cairo_paint (cr);
+    cairo_destroy (cr);
+
+    subsurface = cairo_surface_create_for_rectangle (image, 100, 100, 600, 600);
+    cr = cairo_create (image);
+    cairo_scale (cr, .5, .5);
+    cairo_set_source_surface (cr, subsurface, 0, 0);
+    cairo_pattern_set_filter (cairo_get_source (cr), CAIRO_FILTER_BEST);
+    cairo_paint (cr);
+    cairo_destroy (cr);
+    cairo_surface_destroy (subsurface);
+
+    return image;
+}
+
+static cairo_bool_t
+same_pixels (cairo_surface_t *a, cairo_surface_t *b)
+{
+    uint8_t *a_data, *b_data;
+    int a_stride, b_stride;
+    int width, height, y;
+
+    cairo_surface_flush (a);
+    cairo_surface_flush (b);
+
+    a_data = cairo_image_surface_get_data (a);
+    b_data = cairo_image_surface_get_data (b);
+    a_stride = cairo_image_surface_get_stride (a);
+    b_stride = cairo_image_surface_get_stride (b);
+    width = cairo_image_surface_get_width (a);
+    height = cairo_image_surface_get_height (a);
+
+    for (y = 0; y < height; y++) {
+	if (memcmp (a_data + y * a_stride, b_data + y * b_stride, 4 * width))
+	    return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void
+set_num_threads (const char *num_threads)
+{
+    setenv ("CAIRO_NUM_THREADS", num_threads, 1);
+    cairo_debug_reset_static_data ();
+}
+#endif
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+#if CAIRO_HAS_PTHREAD
+    static const cairo_filter_t filters[] = {
+	CAIRO_FILTER_GOOD,
+	CAIRO_FILTER_BEST,
+    };
+    cairo_surface_t *source, *serial[2][NUM_SCALES], *serial_alias;
+    cairo_surface_t *image;
+    cairo_test_status_t result = CAIRO_TEST_SUCCESS;
+    int f, i, pass;
+
+    source = create_source ();
+
+    set_num_threads ("1");
+    for (f = 0; f < 2; f++) {
+	for (i = 0; i < NUM_SCALES; i++)
+	    serial[f][i] = downscale (source, filters[f], scales[i]);
+    }
+    serial_alias = downscale_over_itself (source);
+
+    set_num_threads ("4");
+    for (pass = 0; pass < 2; pass++) {
+	for (f = 0; f < 2; f++) {
+	    for (i = 0; i < NUM_SCALES; i++) {
+		image = downscale (source, filters[f], scales[i]);
+		if (! same_pixels (image, serial[f][i])) {
+		    cairo_test_log (ctx, "Error: %s downscale by %g differs with several threads%s\n",
+				    f ? "BEST" : "GOOD", scales[i],
+				    pass ? ", after evicting its kernel" : "");
+		    result = CAIRO_TEST_FAILURE;
+		}
+		cairo_surface_destroy (image);
+	    }
+	}
+
+	/* cycle through more scales than the kernel cache holds */
+	for (i = 0; pass == 0 && i < NUM_EVICTING_SCALES; i++) {
+	    image = downscale (source, filters[i % 2], .35 + .025 * i);
+	    cairo_surface_destroy (image);
+	}
+    }
+
+    image = downscale_over_itself (source);
+    if (! same_pixels (image, serial_alias)) {
+	cairo_test_log (ctx, "Error: downscaling a subsurface over itself differs with several threads\n");
+	result = CAIRO_TEST_FAILURE;
+    }
+    cairo_surface_destroy (image);
+
+    cairo_surface_destroy (serial_alias);
+    for (f = 0; f < 2; f++) {
+	for (i = 0; i < NUM_SCALES; i++)
+	    cairo_surface_destroy (serial[f][i]);
+    }
+    cairo_surface_destroy (source);
+
+    return result;
+#else
+    return CAIRO_TEST_UNTESTED;
+#endif
+}
+
+CAIRO_TEST (filter_convolution_threads,
+	    "Check convolution filters give the same result across threads and kernel cache evictions",
+	    "filter, scale", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
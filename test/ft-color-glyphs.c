@@ -0,0 +1,227 @@
+/*
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of
+ * the authors not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The authors make no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL,
+ * INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+/* Color glyphs shown without clusters on an image surface are
+ * composited in a single batch, while those shown with clusters are
+ * still painted one at a time.  Show the same glyphs from a color font
+ * both ways, unclipped, through a rectangular clip and with a device
+ * scale, and check that the results are identical.  With a device
+ * scale, the result must also match the same glyphs drawn through a
+ * scaled CTM.
+ */
+
+#include "cairo-test.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <cairo-ft.h>
+
+#define FONT_SIZE 16
+#define COLUMNS 20
+#define ROWS 10
+#define NUM_GLYPHS (COLUMNS * ROWS) /* more than fit on the stack */
+#define WIDTH (COLUMNS * FONT_SIZE * 5 / 4)
+#define HEIGHT (ROWS * FONT_SIZE * 5 / 4)
+
+typedef enum {
+    UNCLIPPED,
+    CLIPPED,
+    DEVICE_SCALE,
+    CTM_SCALE,
+} draw_mode_t;
+
+static const char *mode_names[] = {
+    "unclipped", "clipped", "with a device scale", "with a scaled CTM"
+};
+
+static cairo_font_face_t *
+create_color_font_face (void)
+{
+#ifdef FC_COLOR
+    cairo_font_face_t *font_face = NULL;
+    FcObjectSet *os;
+    FcPattern *pattern;
+    FcFontSet *fs;
+
+    pattern = FcPatternCreate ();
+    FcPatternAddBool (pattern, FC_COLOR, FcTrue);
+    os = FcObjectSetBuild (FC_FILE, FC_INDEX, NULL);
+    fs = FcFontList (NULL, pattern, os);
+    FcObjectSetDestroy (os);
+    FcPatternDestroy (pattern);
+
+    if (fs != NULL && fs->nfont > 0)
+	font_face = cairo_ft_font_face_create_for_pattern (fs->fonts[0]);
+    if (fs != NULL)
+	FcFontSetDestroy (fs);
+
+    return font_face;
+#else
+    return NULL;
+#endif
+}
+
+static cairo_surface_t *
+draw (cairo_font_face_t *font_face, draw_mode_t mode, cairo_bool_t with_clusters)
+{
+    cairo_glyph_t glyphs[NUM_GLYPHS];
+    cairo_text_cluster_t clusters[NUM_GLYPHS];
+    char utf8[NUM_GLYPHS];
+    cairo_surface_t *image;
+    cairo_t *cr;
+    int scale = mode >= DEVICE_SCALE ? 2 : 1;
+    int i;
+
+    for (i = 0; i < NUM_GLYPHS; i++) {
+	/* repeat glyphs, and leave a few positions off the pixel grid */
+	glyphs[i].index = 1 + i % 40;
+	glyphs[i].x = (i % COLUMNS) * FONT_SIZE * 5 / 4 + (i % 7 == 0 ? .3 : 0);
+	glyphs[i].y = (i / COLUMNS + 1) * FONT_SIZE * 5 / 4 - FONT_SIZE / 4;
+	clusters[i].num_bytes = 1;
+	clusters[i].num_glyphs = 1;
+	utf8[i] = 'x';
+    }
+
+    image = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+					scale * WIDTH, scale * HEIGHT);
+    if (mode == DEVICE_SCALE)
+	cairo_surface_set_device_scale (image, scale, scale);
+
+    cr = cairo_create (image);
+    if (mode == CTM_SCALE)
+	cairo_scale (cr, scale, scale);
+
+    cairo_set_source_rgb (cr, 1, 1, 1);
+    cairo_paint (cr);
+
+    if (mode == CLIPPED) {
+	cairo_rectangle (cr, WIDTH / 4, HEIGHT / 4 + 1, WIDTH / 2, HEIGHT / 2);
+	cairo_clip (cr);
+    }
+
+    /* for any glyphs that are not in color */
+    cairo_set_source_rgb (cr, 0, 0, 0.5);
+    cairo_set_font_face (cr, font_face);
+    cairo_set_font_size (cr, FONT_SIZE);
+
+    if (with_clusters)
+	cairo_show_text_glyphs (cr, utf8, NUM_GLYPHS, glyphs, NUM_GLYPHS,
+				clusters, NUM_GLYPHS, 0);
+    else
+	cairo_show_glyphs (cr, glyphs, NUM_GLYPHS);
+
+    cairo_destroy (cr);
+
+    cairo_surface_flush (image);
+    return image;
+}
+
+static cairo_bool_t
+same_pixels (cairo_surface_t *a, cairo_surface_t *b)
+{
+    uint8_t *a_data = cairo_image_surface_get_data (a);
+    uint8_t *b_data = cairo_image_surface_get_data (b);
+    int stride = cairo_image_surface_get_stride (a);
+    int y;
+
+    for (y = 0; y < cairo_image_surface_get_height (a); y++) {
+	if (memcmp (a_data + y * stride, b_data + y * stride,
+		    4 * cairo_image_surface_get_width (a)))
+	    return FALSE;
+    }
+
+    return TRUE;
+}
+
+static cairo_bool_t
+has_color (cairo_surface_t *image)
+{
+    uint8_t *data = cairo_image_surface_get_data (image);
+    int stride = cairo_image_surface_get_stride (image);
+    int x, y;
+
+    for (y = 0; y < cairo_image_surface_get_height (image); y++) {
+	const uint32_t *row = (const uint32_t *) (data + y * stride);
+
+	for (x = 0; x < cairo_image_surface_get_width (image); x++) {
+	    /* the source color blended over white keeps red and green equal */
+	    if (((row[x] >> 16) & 0xff) != ((row[x] >> 8) & 0xff))
+		return TRUE;
+	}
+    }
+
+    return FALSE;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    cairo_font_face_t *font_face;
+    cairo_surface_t *batched, *one_by_one, *device_scaled = NULL;
+    cairo_test_status_t result = CAIRO_TEST_SUCCESS;
+    draw_mode_t mode;
+
+    font_face = create_color_font_face ();
+    if (font_face == NULL) {
+	cairo_test_log (ctx, "No color font found\n");
+	return CAIRO_TEST_UNTESTED;
+    }
+
+    for (mode = UNCLIPPED; mode <= CTM_SCALE; mode++) {
+	batched = draw (font_face, mode, FALSE);
+	one_by_one = draw (font_face, mode, TRUE);
+
+	if (mode == UNCLIPPED && ! has_color (batched)) {
+	    cairo_test_log (ctx, "The color font has no color glyphs to show\n");
+	    result = CAIRO_TEST_UNTESTED;
+	} else if (! same_pixels (batched, one_by_one)) {
+	    cairo_test_log (ctx, "Error: color glyphs shown %s differ when batched\n",
+			    mode_names[mode]);
+	    result = CAIRO_TEST_FAILURE;
+	} else if (mode == CTM_SCALE && ! same_pixels (batched, device_scaled)) {
+	    cairo_test_log (ctx, "Error: color glyphs differ with a device scale and a scaled CTM\n");
+	    result = CAIRO_TEST_FAILURE;
+	}
+
+	cairo_surface_destroy (one_by_one);
+	if (mode == DEVICE_SCALE)
+	    device_scaled = batched;
+	else
+	    cairo_surface_destroy (batched);
+
+	if (result != CAIRO_TEST_SUCCESS)
+	    break;
+    }
+
+    cairo_surface_destroy (device_scaled);
+    cairo_font_face_destroy (font_face);
+
+    return result;
+}
+
+CAIRO_TEST (ft_color_glyphs,
+	    "Check that batched color glyphs match glyphs painted one at a time",
+	    "ft, text", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
@@ -0,0 +1,113 @@
+/*
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of
+ * the authors not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The authors make no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL,
+ * INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+/* Render into a shared-memory image surface and read the pixels back
+ * through its file descriptor, as another process would.
+ */
+
+#include "cairo-test.h"
+
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#define WIDTH 37
+#define HEIGHT 29
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    cairo_surface_t *surface, *image;
+    cairo_test_status_t status = CAIRO_TEST_SUCCESS;
+    int fd, stride;
+    cairo_t *cr;
+
+    image = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, WIDTH, HEIGHT);
+    fd = cairo_image_surface_get_shared_fd (image);
+    cairo_surface_destroy (image);
+    if (fd != -1) {
+	cairo_test_log (ctx, "Error: plain image surface has a shared fd\n");
+	return CAIRO_TEST_FAILURE;
+    }
+
+    surface = cairo_image_surface_create_shared (CAIRO_FORMAT_ARGB32,
+						 WIDTH, HEIGHT);
+    if (cairo_surface_status (surface)) {
+	cairo_test_log (ctx, "Error: failed to create shared surface: %s\n",
+			cairo_status_to_string (cairo_surface_status (surface)));
+	cairo_surface_destroy (surface);
+	return CAIRO_TEST_FAILURE;
+    }
+
+    fd = cairo_image_surface_get_shared_fd (surface);
+    if (fd == -1) {
+	cairo_surface_destroy (surface);
+	return CAIRO_TEST_UNTESTED;
+    }
+
+    stride = cairo_image_surface_get_stride (surface);
+    if (stride % 64) {
+	cairo_test_log (ctx, "Error: stride %d is not 64-byte aligned\n", stride);
+	cairo_surface_destroy (surface);
+	return CAIRO_TEST_FAILURE;
+    }
+
+    cr = cairo_create (surface);
+    cairo_set_source_rgb (cr, 1, 0, 0);
+    cairo_paint (cr);
+    cairo_rectangle (cr, 5, 5, 20, 10);
+    cairo_set_source_rgba (cr, 0, 0, 1, 0.5);
+    cairo_fill (cr);
+    cairo_destroy (cr);
+
+    cairo_surface_flush (surface);
+
+#if HAVE_UNISTD_H
+    {
+	const unsigned char *data = cairo_image_surface_get_data (surface);
+	unsigned char *row = xmalloc (stride);
+	int y;
+
+	for (y = 0; y < HEIGHT; y++) {
+	    if (pread (fd, row, stride, (off_t) y * stride) != stride ||
+		memcmp (row, data + y * stride, WIDTH * 4))
+	    {
+		cairo_test_log (ctx, "Error: row %d differs in the shared file\n", y);
+		status = CAIRO_TEST_FAILURE;
+		break;
+	    }
+	}
+
+	free (row);
+    }
+#endif
+
+    cairo_surface_destroy (surface);
+    return status;
+}
+
+CAIRO_TEST (image_surface_shared,
+	    "Check that a shared image surface can be read through its fd",
+	    "image, api", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
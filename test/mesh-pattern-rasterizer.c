@@ -0,0 +1,199 @@
+/*
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of
+ * the authors not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The authors make no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL,
+ * INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+/* Checks the pixels produced by the mesh pattern rasterizer directly,
+ * rather than against a reference image: a patch of a single color
+ * must be filled with that color, and a patch shaded from
+ * black on the left to white on the right must hold a ramp whose
+ * value follows the position of each pixel.
+ */
+
+#include "cairo-test.h"
+
+#define SIZE 64
+#define X0 8
+#define X1 56
+
+/* A patch covers every pixel it touches, so only check the pixels
+ * well inside and well outside of it. */
+#define INSIDE(v) ((v) > X0 && (v) < X1 - 1)
+#define OUTSIDE(v) ((v) < X0 - 1 || (v) > X1 + 1)
+
+static void
+add_square_patch (cairo_pattern_t *mesh,
+		  double r0, double g0, double b0,
+		  double r1, double g1, double b1)
+{
+    cairo_mesh_pattern_begin_patch (mesh);
+    cairo_mesh_pattern_move_to (mesh, X0, X0);
+    cairo_mesh_pattern_line_to (mesh, X1, X0);
+    cairo_mesh_pattern_line_to (mesh, X1, X1);
+    cairo_mesh_pattern_line_to (mesh, X0, X1);
+    cairo_mesh_pattern_set_corner_color_rgb (mesh, 0, r0, g0, b0);
+    cairo_mesh_pattern_set_corner_color_rgb (mesh, 1, r1, g1, b1);
+    cairo_mesh_pattern_set_corner_color_rgb (mesh, 2, r1, g1, b1);
+    cairo_mesh_pattern_set_corner_color_rgb (mesh, 3, r0, g0, b0);
+    cairo_mesh_pattern_end_patch (mesh);
+}
+
+static cairo_surface_t *
+rasterize (cairo_pattern_t *mesh)
+{
+    cairo_surface_t *image;
+    cairo_t *cr;
+
+    image = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, SIZE, SIZE);
+    cr = cairo_create (image);
+    cairo_set_operator (cr, CAIRO_OPERATOR_SOURCE);
+    cairo_set_source (cr, mesh);
+    cairo_paint (cr);
+    cairo_destroy (cr);
+
+    cairo_surface_flush (image);
+    return image;
+}
+
+static int
+channel (uint32_t pixel, int shift)
+{
+    return (pixel >> shift) & 0xff;
+}
+
+static cairo_bool_t
+is_close (int value, int expected, int tolerance)
+{
+    return value >= expected - tolerance && value <= expected + tolerance;
+}
+
+static cairo_test_status_t
+check_solid (cairo_test_context_t *ctx)
+{
+    cairo_pattern_t *mesh;
+    cairo_surface_t *image;
+    uint8_t *data;
+    int stride, x, y;
+    cairo_test_status_t result = CAIRO_TEST_SUCCESS;
+
+    mesh = cairo_pattern_create_mesh ();
+    add_square_patch (mesh, .25, .5, .75, .25, .5, .75);
+    image = rasterize (mesh);
+    cairo_pattern_destroy (mesh);
+
+    data = cairo_image_surface_get_data (image);
+    stride = cairo_image_surface_get_stride (image);
+
+    for (y = 0; y < SIZE && result == CAIRO_TEST_SUCCESS; y++) {
+	uint32_t *row = (uint32_t *) (data + y * stride);
+
+	for (x = 0; x < SIZE; x++) {
+	    uint32_t pixel = row[x];
+	    cairo_bool_t ok = TRUE;
+
+	    if (INSIDE (x) && INSIDE (y)) {
+		ok = channel (pixel, 24) == 0xff &&
+		     is_close (channel (pixel, 16), 64, 1) &&
+		     is_close (channel (pixel, 8), 128, 1) &&
+		     is_close (channel (pixel, 0), 191, 1);
+	    } else if (OUTSIDE (x) || OUTSIDE (y)) {
+		ok = pixel == 0;
+	    }
+
+	    if (! ok) {
+		cairo_test_log (ctx, "Error: solid patch, pixel (%d, %d) is %08x\n",
+				x, y, pixel);
+		result = CAIRO_TEST_FAILURE;
+		break;
+	    }
+	}
+    }
+
+    cairo_surface_destroy (image);
+    return result;
+}
+
+static cairo_test_status_t
+check_ramp (cairo_test_context_t *ctx)
+{
+    cairo_pattern_t *mesh;
+    cairo_surface_t *image;
+    uint8_t *data;
+    int stride, x, y;
+    cairo_test_status_t result = CAIRO_TEST_SUCCESS;
+
+    mesh = cairo_pattern_create_mesh ();
+    add_square_patch (mesh, 0, 0, 0, 1, 1, 1);
+    image = rasterize (mesh);
+    cairo_pattern_destroy (mesh);
+
+    data = cairo_image_surface_get_data (image);
+    stride = cairo_image_surface_get_stride (image);
+
+    for (y = X0 + 1; y < X1 - 1 && result == CAIRO_TEST_SUCCESS; y++) {
+	uint32_t *row = (uint32_t *) (data + y * stride);
+	int last = 0;
+
+	for (x = X0 + 1; x < X1 - 1; x++) {
+	    uint32_t pixel = row[x];
+	    int value = channel (pixel, 16);
+	    int expected = (255 * (2 * (x - X0) + 1) + (X1 - X0)) / (2 * (X1 - X0));
+
+	    /* The color of a pixel may be sampled anywhere inside it,
+	     * which is up to half a pixel (about 3 levels) away from
+	     * its centre. */
+	    if (channel (pixel, 24) != 0xff ||
+		channel (pixel, 8) != value ||
+		channel (pixel, 0) != value ||
+		! is_close (value, expected, 4) ||
+		value < last)
+	    {
+		cairo_test_log (ctx, "Error: ramp patch, pixel (%d, %d) is %08x, expected gray %02x\n",
+				x, y, pixel, expected);
+		result = CAIRO_TEST_FAILURE;
+		break;
+	    }
+
+	    last = value;
+	}
+    }
+
+    cairo_surface_destroy (image);
+    return result;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    cairo_test_status_t result;
+
+    result = check_solid (ctx);
+    if (result == CAIRO_TEST_SUCCESS)
+	result = check_ramp (ctx);
+
+    return result;
+}
+
+CAIRO_TEST (mesh_pattern_rasterizer,
+	    "Check the pixels of solid and linearly shaded mesh patches",
+	    "gradient, mesh", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
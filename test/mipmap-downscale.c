@@ -0,0 +1,148 @@
+/*
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of
+ * the authors not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The authors make no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL,
+ * INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* Paint a large image at 1/16 scale with the GOOD filter, which goes
+ * through a pyramid of halved copies of the image when
+ * CAIRO_IMAGE_MIPMAP is set, and check that the pyramid is rebuilt
+ * after the image is drawn to or marked dirty.
+ */
+
+#include "cairo-test.h"
+
+#define SOURCE_SIZE 1024
+#define SIZE 64
+
+static cairo_bool_t
+pixel_equal (uint32_t a, uint32_t b)
+{
+    int shift;
+
+    for (shift = 0; shift < 32; shift += 8) {
+	int da = (a >> shift) & 0xff;
+	int db = (b >> shift) & 0xff;
+	if (abs (da - db) > 1)
+	    return FALSE;
+    }
+
+    return TRUE;
+}
+
+static cairo_test_status_t
+check (const cairo_test_context_t *ctx,
+       cairo_surface_t *source,
+       uint32_t left, uint32_t right)
+{
+    cairo_surface_t *image;
+    const uint32_t *row;
+    cairo_t *cr;
+
+    image = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, SIZE, SIZE);
+    cr = cairo_create (image);
+    cairo_scale (cr, (double) SIZE / SOURCE_SIZE, (double) SIZE / SOURCE_SIZE);
+    cairo_set_source_surface (cr, source, 0, 0);
+    cairo_pattern_set_filter (cairo_get_source (cr), CAIRO_FILTER_GOOD);
+    cairo_paint (cr);
+    cairo_destroy (cr);
+    cairo_surface_flush (image);
+
+    row = (const uint32_t *) (cairo_image_surface_get_data (image) +
+			      SIZE / 2 * cairo_image_surface_get_stride (image));
+    if (! pixel_equal (row[SIZE / 8], left) ||
+	! pixel_equal (row[SIZE - SIZE / 8], right))
+    {
+	cairo_test_log (ctx,
+			"Error: expected %08x and %08x, found %08x and %08x\n",
+			left, right, row[SIZE / 8], row[SIZE - SIZE / 8]);
+	cairo_surface_destroy (image);
+	return CAIRO_TEST_FAILURE;
+    }
+
+    cairo_surface_destroy (image);
+    return CAIRO_TEST_SUCCESS;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    cairo_surface_t *source;
+    cairo_test_status_t status;
+    uint32_t *data;
+    int stride, x, y;
+    cairo_t *cr;
+
+    setenv ("CAIRO_IMAGE_MIPMAP", "1", 1);
+
+    source = cairo_image_surface_create (CAIRO_FORMAT_ARGB32,
+					 SOURCE_SIZE, SOURCE_SIZE);
+    cr = cairo_create (source);
+    cairo_set_source_rgb (cr, 1, 0, 0);
+    cairo_paint (cr);
+    cairo_rectangle (cr, SOURCE_SIZE / 2, 0, SOURCE_SIZE / 2, SOURCE_SIZE);
+    cairo_set_source_rgb (cr, 0, 0, 1);
+    cairo_fill (cr);
+    cairo_destroy (cr);
+
+    status = check (ctx, source, 0xffff0000, 0xff0000ff);
+
+    /* drawing to the source must discard its pyramid */
+    if (status == CAIRO_TEST_SUCCESS) {
+	cr = cairo_create (source);
+	cairo_set_source_rgb (cr, 0, 1, 0);
+	cairo_paint (cr);
+	cairo_destroy (cr);
+
+	status = check (ctx, source, 0xff00ff00, 0xff00ff00);
+    }
+
+    /* and so must modifying its pixels and marking it dirty */
+    if (status == CAIRO_TEST_SUCCESS) {
+	cairo_surface_flush (source);
+	data = (uint32_t *) cairo_image_surface_get_data (source);
+	stride = cairo_image_surface_get_stride (source) / sizeof (uint32_t);
+	for (y = 0; y < SOURCE_SIZE; y++)
+	    for (x = 0; x < SOURCE_SIZE / 2; x++)
+		data[y * stride + x] = 0xffffffff;
+	cairo_surface_mark_dirty (source);
+
+	status = check (ctx, source, 0xffffffff, 0xff00ff00);
+    }
+
+    /* even without a flush, as nothing was drawn since the last one */
+    if (status == CAIRO_TEST_SUCCESS) {
+	for (y = 0; y < SOURCE_SIZE; y++)
+	    for (x = SOURCE_SIZE / 2; x < SOURCE_SIZE; x++)
+		data[y * stride + x] = 0xff000000;
+	cairo_surface_mark_dirty (source);
+
+	status = check (ctx, source, 0xffffffff, 0xff000000);
+    }
+
+    cairo_surface_destroy (source);
+    unsetenv ("CAIRO_IMAGE_MIPMAP");
+    return status;
+}
+
+CAIRO_TEST (mipmap_downscale,
+	    "Check minifying an image with the GOOD filter follows changes to the image",
+	    "filter, image", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
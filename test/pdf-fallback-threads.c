@@ -0,0 +1,169 @@
+/*
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of
+ * the authors not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The authors make no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL,
+ * INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+/* The fallback images of a PDF page are rasterized in bands on the
+ * worker threads.  Write the same page, with one large and several
+ * small fallback regions, once with a single thread and once with
+ * several, and check that the two documents are identical.
+ */
+
+#include "cairo-test.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <cairo-pdf.h>
+
+#define WIDTH 400
+#define HEIGHT 500
+
+#if CAIRO_HAS_PTHREAD
+typedef struct _buffer {
+    unsigned char *data;
+    size_t length, size;
+} buffer_t;
+
+static cairo_status_t
+write_buffer (void *closure, const unsigned char *data, unsigned int length)
+{
+    buffer_t *buffer = closure;
+
+    if (buffer->length + length > buffer->size) {
+	size_t size = 2 * (buffer->length + length);
+	unsigned char *new_data = realloc (buffer->data, size);
+	if (new_data == NULL)
+	    return CAIRO_STATUS_NO_MEMORY;
+	buffer->data = new_data;
+	buffer->size = size;
+    }
+
+    memcpy (buffer->data + buffer->length, data, length);
+    buffer->length += length;
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static void
+draw (cairo_t *cr)
+{
+    cairo_pattern_t *pattern;
+    int i;
+
+    pattern = cairo_pattern_create_linear (0, 0, WIDTH, HEIGHT);
+    cairo_pattern_add_color_stop_rgb (pattern, 0, 1, 1, 0);
+    cairo_pattern_add_color_stop_rgb (pattern, 1, 0, 0.5, 1);
+    cairo_set_source (cr, pattern);
+    cairo_pattern_destroy (pattern);
+    cairo_paint (cr);
+
+    /* XOR cannot be expressed in PDF, so each shape is a fallback */
+    cairo_set_operator (cr, CAIRO_OPERATOR_XOR);
+
+    /* one region tall enough to be cut into many bands */
+    cairo_set_source_rgba (cr, 1, 0, 0, 0.6);
+    cairo_arc (cr, WIDTH / 2, HEIGHT / 2, HEIGHT / 3, 0, 2 * M_PI);
+    cairo_fill (cr);
+
+    /* and a row of small ones */
+    for (i = 0; i < 8; i++) {
+	cairo_set_source_rgba (cr, i & 1, (i >> 1) & 1, (i >> 2) & 1, 0.7);
+	cairo_rectangle (cr, 10 + i * 48, HEIGHT - 40, 30, 30);
+	cairo_fill (cr);
+    }
+}
+
+static cairo_status_t
+write_pdf (buffer_t *buffer)
+{
+    cairo_surface_t *surface;
+    cairo_status_t status;
+    cairo_t *cr;
+
+    memset (buffer, 0, sizeof (buffer_t));
+    surface = cairo_pdf_surface_create_for_stream (write_buffer, buffer,
+						   WIDTH, HEIGHT);
+    cairo_pdf_surface_set_metadata (surface, CAIRO_PDF_METADATA_CREATE_DATE,
+				    "2000-01-01T00:00:00Z");
+
+    cr = cairo_create (surface);
+    draw (cr);
+    cairo_destroy (cr);
+
+    cairo_surface_finish (surface);
+    status = cairo_surface_status (surface);
+    cairo_surface_destroy (surface);
+
+    return status;
+}
+
+static cairo_status_t
+write_pdf_with_threads (const char *num_threads, buffer_t *buffer)
+{
+    /* the worker threads are started on first use */
+    setenv ("CAIRO_NUM_THREADS", num_threads, 1);
+    cairo_debug_reset_static_data ();
+
+    return write_pdf (buffer);
+}
+#endif
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+#if CAIRO_HAS_PTHREAD
+    buffer_t serial, parallel;
+    cairo_test_status_t result = CAIRO_TEST_SUCCESS;
+    cairo_status_t status;
+
+    if (! cairo_test_is_target_enabled (ctx, "pdf"))
+	return CAIRO_TEST_UNTESTED;
+
+    status = write_pdf_with_threads ("1", &serial);
+    if (status == CAIRO_STATUS_SUCCESS)
+	status = write_pdf_with_threads ("4", &parallel);
+    else
+	memset (&parallel, 0, sizeof (parallel));
+    if (status) {
+	cairo_test_log (ctx, "Error: failed to write the PDF: %s\n",
+			cairo_status_to_string (status));
+	result = CAIRO_TEST_FAILURE;
+    } else if (serial.length != parallel.length ||
+	       memcmp (serial.data, parallel.data, serial.length))
+    {
+	cairo_test_log (ctx,
+			"Error: the PDF written with 4 threads differs from the one written with 1\n");
+	result = CAIRO_TEST_FAILURE;
+    }
+
+    free (serial.data);
+    free (parallel.data);
+    return result;
+#else
+    return CAIRO_TEST_UNTESTED;
+#endif
+}
+
+CAIRO_TEST (pdf_fallback_threads,
+	    "Check that fallback images do not depend upon the number of threads",
+	    "pdf, fallback", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
@@ -0,0 +1,238 @@
+/*
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of
+ * the authors not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The authors make no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL,
+ * INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+/* The font subsets of a PDF or PS document are generated on the worker
+ * threads, several at a time, and written out in order.  Write the same
+ * text, in several faces and in more than one script, once with a
+ * single thread and once with several, and check that the two
+ * documents are identical.
+ */
+
+#include "cairo-test.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <cairo-pdf.h>
+#if CAIRO_HAS_PS_SURFACE
+#include <cairo-ps.h>
+#endif
+
+#define WIDTH 400
+#define HEIGHT 500
+
+#if CAIRO_HAS_PTHREAD
+typedef struct _buffer {
+    unsigned char *data;
+    size_t length, size;
+} buffer_t;
+
+static cairo_status_t
+write_buffer (void *closure, const unsigned char *data, unsigned int length)
+{
+    buffer_t *buffer = closure;
+
+    if (buffer->length + length > buffer->size) {
+	size_t size = 2 * (buffer->length + length);
+	unsigned char *new_data = realloc (buffer->data, size);
+	if (new_data == NULL)
+	    return CAIRO_STATUS_NO_MEMORY;
+	buffer->data = new_data;
+	buffer->size = size;
+    }
+
+    memcpy (buffer->data + buffer->length, data, length);
+    buffer->length += length;
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static void
+draw (cairo_t *cr)
+{
+    static const char *families[] = { "serif", "sans-serif", "monospace" };
+    static const char *lines[] = {
+	"The quick brown fox jumps over the lazy dog",
+	/* Greek and Cyrillic glyphs do not fit in the latin subsets */
+	"\xce\xb1\xce\xb2\xce\xb3\xce\xb4\xce\xb5 \xd0\xb0\xd0\xb1\xd0\xb2\xd0\xb3\xd0\xb4",
+    };
+    int family, style, line;
+    double y = 20;
+
+    cairo_set_source_rgb (cr, 0, 0, 0);
+    cairo_set_font_size (cr, 12);
+
+    for (family = 0; family < ARRAY_LENGTH (families); family++) {
+	for (style = 0; style < 4; style++) {
+	    cairo_select_font_face (cr, families[family],
+				    style & 1 ? CAIRO_FONT_SLANT_ITALIC : CAIRO_FONT_SLANT_NORMAL,
+				    style & 2 ? CAIRO_FONT_WEIGHT_BOLD : CAIRO_FONT_WEIGHT_NORMAL);
+	    for (line = 0; line < ARRAY_LENGTH (lines); line++) {
+		cairo_move_to (cr, 10, y);
+		cairo_show_text (cr, lines[line]);
+		y += 20;
+	    }
+	}
+    }
+}
+
+static cairo_status_t
+write_document (cairo_surface_t *surface)
+{
+    cairo_status_t status;
+    cairo_t *cr;
+
+    cr = cairo_create (surface);
+    draw (cr);
+    cairo_destroy (cr);
+
+    cairo_surface_finish (surface);
+    status = cairo_surface_status (surface);
+    cairo_surface_destroy (surface);
+
+    return status;
+}
+
+static cairo_status_t
+write_pdf (buffer_t *buffer)
+{
+    cairo_surface_t *surface;
+
+    memset (buffer, 0, sizeof (buffer_t));
+    surface = cairo_pdf_surface_create_for_stream (write_buffer, buffer,
+						   WIDTH, HEIGHT);
+    cairo_pdf_surface_set_metadata (surface, CAIRO_PDF_METADATA_CREATE_DATE,
+				    "2000-01-01T00:00:00Z");
+
+    return write_document (surface);
+}
+
+#if CAIRO_HAS_PS_SURFACE
+/* The header of a PS document holds the time it was written at */
+static void
+remove_creation_date (buffer_t *buffer)
+{
+    static const char comment[] = "%%CreationDate:";
+    size_t len = sizeof (comment) - 1;
+    size_t i, end;
+
+    for (i = 0; i + len <= buffer->length; i++) {
+	if (memcmp (buffer->data + i, comment, len) == 0)
+	    break;
+    }
+    if (i + len > buffer->length)
+	return;
+
+    for (end = i; end < buffer->length && buffer->data[end] != '\n'; end++)
+	;
+
+    memmove (buffer->data + i, buffer->data + end, buffer->length - end);
+    buffer->length -= end - i;
+}
+
+static cairo_status_t
+write_ps (buffer_t *buffer)
+{
+    cairo_surface_t *surface;
+    cairo_status_t status;
+
+    memset (buffer, 0, sizeof (buffer_t));
+    surface = cairo_ps_surface_create_for_stream (write_buffer, buffer,
+						  WIDTH, HEIGHT);
+
+    status = write_document (surface);
+    if (status == CAIRO_STATUS_SUCCESS)
+	remove_creation_date (buffer);
+
+    return status;
+}
+#endif
+
+static cairo_test_status_t
+compare_with_threads (cairo_test_context_t *ctx,
+		      const char *name,
+		      cairo_status_t (*write) (buffer_t *))
+{
+    buffer_t serial, parallel;
+    cairo_test_status_t result = CAIRO_TEST_SUCCESS;
+    cairo_status_t status;
+
+    /* the worker threads are started on first use */
+    setenv ("CAIRO_NUM_THREADS", "1", 1);
+    cairo_debug_reset_static_data ();
+    status = write (&serial);
+
+    setenv ("CAIRO_NUM_THREADS", "4", 1);
+    cairo_debug_reset_static_data ();
+    if (status == CAIRO_STATUS_SUCCESS)
+	status = write (&parallel);
+    else
+	memset (&parallel, 0, sizeof (parallel));
+
+    if (status) {
+	cairo_test_log (ctx, "Error: failed to write the %s: %s\n",
+			name, cairo_status_to_string (status));
+	result = CAIRO_TEST_FAILURE;
+    } else if (serial.length != parallel.length ||
+	       memcmp (serial.data, parallel.data, serial.length))
+    {
+	cairo_test_log (ctx,
+			"Error: the %s written with 4 threads differs from the one written with 1\n",
+			name);
+	result = CAIRO_TEST_FAILURE;
+    }
+
+    free (serial.data);
+    free (parallel.data);
+    return result;
+}
+#endif
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+#if CAIRO_HAS_PTHREAD
+    cairo_test_status_t result = CAIRO_TEST_UNTESTED;
+
+    if (cairo_test_is_target_enabled (ctx, "pdf"))
+	result = compare_with_threads (ctx, "PDF", write_pdf);
+
+#if CAIRO_HAS_PS_SURFACE
+    if (result != CAIRO_TEST_FAILURE &&
+	(cairo_test_is_target_enabled (ctx, "ps2") ||
+	 cairo_test_is_target_enabled (ctx, "ps3")))
+    {
+	result = compare_with_threads (ctx, "PS", write_ps);
+    }
+#endif
+
+    return result;
+#else
+    return CAIRO_TEST_UNTESTED;
+#endif
+}
+
+CAIRO_TEST (pdf_font_subsets_threads,
+	    "Check that font subsets do not depend upon the number of threads",
+	    "pdf, ps, font", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
@@ -0,0 +1,380 @@
+/*
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of
+ * the authors not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The authors make no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL,
+ * INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* Feed a PNG to a cairo_png_decoder_t a few bytes at a time and check
+ * that it decodes to the same image as
+ * cairo_image_surface_create_from_png_stream(), reporting every row on
+ * the way, and that a reduced decode matches a box filtered copy of the
+ * full image.  The drawn image is not a multiple of the scale in either
+ * direction, so that the last band is partial, and an interlaced PNG
+ * checks the passes being combined at full size before being reduced.
+ * Finally check that a truncated file fails.
+ */
+
+#include "cairo-test.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define WIDTH 301
+#define HEIGHT 203
+#define SCALE 4
+
+#define INTERLACED_PNG "png-interlaced.png"
+
+typedef struct _buffer {
+    unsigned char *data;
+    size_t length, size;
+    size_t pos;
+} buffer_t;
+
+static cairo_status_t
+write_buffer (void *closure, const unsigned char *data, unsigned int length)
+{
+    buffer_t *buffer = closure;
+
+    if (buffer->length + length > buffer->size) {
+	size_t size = 2 * (buffer->length + length);
+	unsigned char *new_data = realloc (buffer->data, size);
+	if (new_data == NULL)
+	    return CAIRO_STATUS_NO_MEMORY;
+	buffer->data = new_data;
+	buffer->size = size;
+    }
+
+    memcpy (buffer->data + buffer->length, data, length);
+    buffer->length += length;
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_status_t
+read_buffer (void *closure, unsigned char *data, unsigned int length)
+{
+    buffer_t *buffer = closure;
+
+    if (buffer->pos + length > buffer->length)
+	return CAIRO_STATUS_READ_ERROR;
+
+    memcpy (data, buffer->data + buffer->pos, length);
+    buffer->pos += length;
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_status_t
+read_file (const cairo_test_context_t *ctx, const char *name, buffer_t *buffer)
+{
+    unsigned char data[4096];
+    char *filename;
+    cairo_status_t status = CAIRO_STATUS_SUCCESS;
+    size_t n;
+    FILE *file;
+
+    xasprintf (&filename, "%s/%s", ctx->srcdir, name);
+    file = fopen (filename, "rb");
+    free (filename);
+    if (file == NULL)
+	return CAIRO_STATUS_FILE_NOT_FOUND;
+
+    while (status == CAIRO_STATUS_SUCCESS &&
+	   (n = fread (data, 1, sizeof (data), file)) > 0)
+    {
+	status = write_buffer (buffer, data, n);
+    }
+
+    fclose (file);
+    return status;
+}
+
+static void
+count_rows (void *closure, int y, int height)
+{
+    int *rows = closure;
+
+    *rows += height;
+}
+
+static cairo_surface_t *
+decode (const buffer_t *buffer, size_t length, int scale, int *rows)
+{
+    cairo_png_options_t *options;
+    cairo_png_decoder_t *decoder;
+    cairo_surface_t *surface;
+    size_t pos;
+
+    options = cairo_png_options_create ();
+    cairo_png_options_set_decode_scale (options, scale);
+    decoder = cairo_png_decoder_create (options);
+    cairo_png_options_destroy (options);
+
+    *rows = 0;
+    cairo_png_decoder_set_rows_func (decoder, count_rows, rows);
+
+    /* in uneven pieces, as they might come off a socket */
+    for (pos = 0; pos < length; pos += 97) {
+	unsigned int n = length - pos < 97 ? length - pos : 97;
+
+	if (cairo_png_decoder_write (decoder, buffer->data + pos, n))
+	    break;
+    }
+
+    surface = cairo_png_decoder_finish (decoder);
+    cairo_png_decoder_destroy (decoder);
+
+    return surface;
+}
+
+static cairo_surface_t *
+read_scaled (buffer_t *buffer, int scale)
+{
+    cairo_png_options_t *options;
+    cairo_surface_t *surface;
+
+    options = cairo_png_options_create ();
+    cairo_png_options_set_decode_scale (options, scale);
+    buffer->pos = 0;
+    surface = cairo_image_surface_create_from_png_stream_with_options (read_buffer,
+								       buffer,
+								       options);
+    cairo_png_options_destroy (options);
+
+    return surface;
+}
+
+/* Averages each @scale by @scale block of @image, or as much of it as
+ * lies within the image, rounding to nearest. */
+static cairo_surface_t *
+downscale (cairo_surface_t *image, int scale)
+{
+    cairo_surface_t *reduced;
+    const uint8_t *src;
+    uint8_t *dst;
+    int width, height, src_stride, dst_stride;
+    int x, y, i, j, c;
+
+    width = cairo_image_surface_get_width (image);
+    height = cairo_image_surface_get_height (image);
+    src = cairo_image_surface_get_data (image);
+    src_stride = cairo_image_surface_get_stride (image);
+
+    reduced = cairo_image_surface_create (cairo_image_surface_get_format (image),
+					  (width + scale - 1) / scale,
+					  (height + scale - 1) / scale);
+    cairo_surface_flush (reduced);
+    dst = cairo_image_surface_get_data (reduced);
+    dst_stride = cairo_image_surface_get_stride (reduced);
+
+    for (y = 0; y < height; y += scale) {
+	uint32_t *row = (uint32_t *) (dst + y / scale * dst_stride);
+
+	for (x = 0; x < width; x += scale) {
+	    uint32_t sum[4] = { 0, 0, 0, 0 };
+	    uint32_t n = 0, pixel = 0;
+
+	    for (j = y; j < y + scale && j < height; j++) {
+		const uint32_t *s = (const uint32_t *) (src + j * src_stride);
+
+		for (i = x; i < x + scale && i < width; i++) {
+		    for (c = 0; c < 4; c++)
+			sum[c] += (s[i] >> (8 * c)) & 0xff;
+		    n++;
+		}
+	    }
+
+	    for (c = 0; c < 4; c++)
+		pixel |= (sum[c] + n / 2) / n << (8 * c);
+	    row[x / scale] = pixel;
+	}
+    }
+
+    cairo_surface_mark_dirty (reduced);
+    return reduced;
+}
+
+static cairo_bool_t
+same_pixels (const cairo_test_context_t *ctx,
+	     cairo_surface_t *a,
+	     cairo_surface_t *b)
+{
+    int x, y, width, height;
+
+    width = cairo_image_surface_get_width (a);
+    height = cairo_image_surface_get_height (a);
+    if (width != cairo_image_surface_get_width (b) ||
+	height != cairo_image_surface_get_height (b))
+    {
+	cairo_test_log (ctx, "Error: the image is %dx%d, expected %dx%d\n",
+			cairo_image_surface_get_width (b),
+			cairo_image_surface_get_height (b),
+			width, height);
+	return FALSE;
+    }
+
+    for (y = 0; y < height; y++) {
+	const uint32_t *ra, *rb;
+
+	ra = (const uint32_t *) (cairo_image_surface_get_data (a) + y * cairo_image_surface_get_stride (a));
+	rb = (const uint32_t *) (cairo_image_surface_get_data (b) + y * cairo_image_surface_get_stride (b));
+	for (x = 0; x < width; x++) {
+	    if (ra[x] != rb[x]) {
+		cairo_test_log (ctx,
+				"Error: pixel (%d, %d) is %08x, expected %08x\n",
+				x, y, rb[x], ra[x]);
+		return FALSE;
+	    }
+	}
+    }
+
+    return TRUE;
+}
+
+static cairo_test_status_t
+check_png (const cairo_test_context_t *ctx,
+	   const char *name,
+	   buffer_t *buffer,
+	   cairo_bool_t interlaced)
+{
+    cairo_surface_t *expected, *reduced, *decoded = NULL;
+    cairo_test_status_t result = CAIRO_TEST_FAILURE;
+    int height, rows;
+
+    buffer->pos = 0;
+    expected = cairo_image_surface_create_from_png_stream (read_buffer, buffer);
+    if (cairo_surface_status (expected)) {
+	cairo_test_log (ctx, "Error: failed to read %s: %s\n", name,
+			cairo_status_to_string (cairo_surface_status (expected)));
+	cairo_surface_destroy (expected);
+	return CAIRO_TEST_FAILURE;
+    }
+    height = cairo_image_surface_get_height (expected);
+    reduced = downscale (expected, SCALE);
+
+    decoded = decode (buffer, buffer->length, 1, &rows);
+    if (cairo_surface_status (decoded)) {
+	cairo_test_log (ctx, "Error: failed to decode %s: %s\n", name,
+			cairo_status_to_string (cairo_surface_status (decoded)));
+	goto out;
+    }
+    if (! same_pixels (ctx, expected, decoded)) {
+	cairo_test_log (ctx, "Error: the decoded %s image differs\n", name);
+	goto out;
+    }
+    /* the passes of an interlaced image report their rows again */
+    if (interlaced ? rows < height : rows != height) {
+	cairo_test_log (ctx, "Error: %d rows of %s were reported, expected %d\n",
+			rows, name, height);
+	goto out;
+    }
+    cairo_surface_destroy (decoded);
+
+    decoded = decode (buffer, buffer->length, SCALE, &rows);
+    if (cairo_surface_status (decoded)) {
+	cairo_test_log (ctx, "Error: failed to decode reduced %s: %s\n", name,
+			cairo_status_to_string (cairo_surface_status (decoded)));
+	goto out;
+    }
+    if (! same_pixels (ctx, reduced, decoded)) {
+	cairo_test_log (ctx, "Error: the reduced decoded %s image differs\n", name);
+	goto out;
+    }
+    if (rows != cairo_image_surface_get_height (reduced)) {
+	cairo_test_log (ctx, "Error: %d rows of reduced %s were reported, expected %d\n",
+			rows, name, cairo_image_surface_get_height (reduced));
+	goto out;
+    }
+    cairo_surface_destroy (decoded);
+
+    decoded = read_scaled (buffer, SCALE);
+    if (cairo_surface_status (decoded) || ! same_pixels (ctx, reduced, decoded)) {
+	cairo_test_log (ctx, "Error: the reduced %s image read from a stream differs\n",
+			name);
+	goto out;
+    }
+
+    result = CAIRO_TEST_SUCCESS;
+
+out:
+    cairo_surface_destroy (decoded);
+    cairo_surface_destroy (reduced);
+    cairo_surface_destroy (expected);
+    return result;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    buffer_t buffer = { NULL, 0, 0, 0 };
+    cairo_surface_t *surface, *decoded;
+    cairo_test_status_t result;
+    cairo_pattern_t *pattern;
+    cairo_status_t status;
+    int rows;
+    cairo_t *cr;
+
+    surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, WIDTH, HEIGHT);
+    cr = cairo_create (surface);
+    pattern = cairo_pattern_create_linear (0, 0, WIDTH, HEIGHT);
+    cairo_pattern_add_color_stop_rgba (pattern, 0, 1, 0, 0, 1);
+    cairo_pattern_add_color_stop_rgba (pattern, 1, 0, 0, 1, 0.2);
+    cairo_set_source (cr, pattern);
+    cairo_pattern_destroy (pattern);
+    cairo_arc (cr, WIDTH / 2, HEIGHT / 2, HEIGHT / 3, 0, 2 * M_PI);
+    cairo_fill (cr);
+    cairo_destroy (cr);
+
+    cairo_surface_write_to_png_stream (surface, write_buffer, &buffer);
+    cairo_surface_destroy (surface);
+
+    result = check_png (ctx, "drawn", &buffer, FALSE);
+
+    if (result == CAIRO_TEST_SUCCESS) {
+	decoded = decode (&buffer, buffer.length / 2, 1, &rows);
+	if (cairo_surface_status (decoded) != CAIRO_STATUS_READ_ERROR) {
+	    cairo_test_log (ctx, "Error: a truncated image returned %s\n",
+			    cairo_status_to_string (cairo_surface_status (decoded)));
+	    result = CAIRO_TEST_FAILURE;
+	}
+	cairo_surface_destroy (decoded);
+    }
+
+    free (buffer.data);
+
+    if (result == CAIRO_TEST_SUCCESS) {
+	memset (&buffer, 0, sizeof (buffer));
+	status = read_file (ctx, INTERLACED_PNG, &buffer);
+	if (status) {
+	    cairo_test_log (ctx, "Error: failed to read %s: %s\n",
+			    INTERLACED_PNG, cairo_status_to_string (status));
+	    result = CAIRO_TEST_FAILURE;
+	} else {
+	    result = check_png (ctx, INTERLACED_PNG, &buffer, TRUE);
+	}
+	free (buffer.data);
+    }
+
+    return result;
+}
+
+CAIRO_TEST (png_decoder,
+	    "Check incremental and reduced decoding of PNG data",
+	    "png, api", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
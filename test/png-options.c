@@ -0,0 +1,304 @@
+/*
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of
+ * the authors not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The authors make no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL,
+ * INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+/* Check that every combination of PNG encoder options, including the
+ * multi-threaded path, produces an image that decodes to exactly the
+ * same pixels as the default encoder.
+ */
+
+#include "cairo-test.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* big enough for the parallel encoder */
+#define WIDTH 1024
+#define HEIGHT 768
+
+typedef struct _buffer {
+    unsigned char *data;
+    size_t length, size;
+    size_t pos;
+} buffer_t;
+
+static cairo_status_t
+write_buffer (void *closure, const unsigned char *data, unsigned int length)
+{
+    buffer_t *buffer = closure;
+
+    if (buffer->length + length > buffer->size) {
+	size_t size = 2 * (buffer->length + length);
+	unsigned char *new_data = realloc (buffer->data, size);
+	if (new_data == NULL)
+	    return CAIRO_STATUS_NO_MEMORY;
+	buffer->data = new_data;
+	buffer->size = size;
+    }
+
+    memcpy (buffer->data + buffer->length, data, length);
+    buffer->length += length;
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_status_t
+read_buffer (void *closure, unsigned char *data, unsigned int length)
+{
+    buffer_t *buffer = closure;
+
+    if (buffer->pos + length > buffer->length)
+	return CAIRO_STATUS_READ_ERROR;
+
+    memcpy (data, buffer->data + buffer->pos, length);
+    buffer->pos += length;
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_status_t
+encode (cairo_surface_t *surface,
+	const cairo_png_options_t *options,
+	buffer_t *buffer)
+{
+    cairo_status_t status;
+
+    memset (buffer, 0, sizeof (buffer_t));
+    status = cairo_surface_write_to_png_stream_with_options (surface,
+							     write_buffer,
+							     buffer,
+							     options);
+    if (status) {
+	free (buffer->data);
+	buffer->data = NULL;
+    }
+
+    return status;
+}
+
+static cairo_surface_t *
+round_trip (cairo_surface_t *surface, const cairo_png_options_t *options)
+{
+    buffer_t buffer;
+    cairo_surface_t *image;
+
+    if (encode (surface, options, &buffer))
+	return cairo_image_surface_create (CAIRO_FORMAT_INVALID, 0, 0);
+
+    image = cairo_image_surface_create_from_png_stream (read_buffer, &buffer);
+    free (buffer.data);
+
+    return image;
+}
+
+#if HAVE_ZLIB && CAIRO_HAS_PTHREAD
+/* The bands of the parallel encoder are each flushed to a byte
+ * boundary, so if it ran the stream cannot match the serial one. */
+static cairo_bool_t
+encoded_in_parallel (cairo_surface_t *surface, cairo_png_options_t *options)
+{
+    buffer_t serial, parallel;
+    cairo_bool_t ret;
+
+    cairo_png_options_set_parallel (options, FALSE);
+    if (encode (surface, options, &serial))
+	return FALSE;
+
+    cairo_png_options_set_parallel (options, TRUE);
+    if (encode (surface, options, &parallel)) {
+	free (serial.data);
+	return FALSE;
+    }
+
+    ret = serial.length != parallel.length ||
+	  memcmp (serial.data, parallel.data, serial.length);
+
+    free (serial.data);
+    free (parallel.data);
+    return ret;
+}
+#endif
+
+static cairo_bool_t
+same_pixels (cairo_surface_t *a, cairo_surface_t *b)
+{
+    int stride = cairo_image_surface_get_stride (a);
+    int y;
+
+    if (cairo_surface_status (a) || cairo_surface_status (b) ||
+	cairo_image_surface_get_format (a) != cairo_image_surface_get_format (b) ||
+	cairo_image_surface_get_stride (b) != stride)
+	return FALSE;
+
+    for (y = 0; y < HEIGHT; y++) {
+	if (memcmp (cairo_image_surface_get_data (a) + y * stride,
+		    cairo_image_surface_get_data (b) + y * stride,
+		    WIDTH * 4))
+	    return FALSE;
+    }
+
+    return TRUE;
+}
+
+static void
+draw (cairo_surface_t *surface)
+{
+    cairo_pattern_t *gradient;
+    cairo_t *cr;
+
+    cr = cairo_create (surface);
+
+    gradient = cairo_pattern_create_linear (0, 0, WIDTH, HEIGHT);
+    cairo_pattern_add_color_stop_rgba (gradient, 0, 1, 0, 0, 1);
+    cairo_pattern_add_color_stop_rgba (gradient, 0.5, 0, 1, 0, 0.3);
+    cairo_pattern_add_color_stop_rgba (gradient, 1, 0, 0, 1, 0);
+    cairo_set_source (cr, gradient);
+    cairo_pattern_destroy (gradient);
+    cairo_paint (cr);
+
+    cairo_arc (cr, WIDTH / 2, HEIGHT / 2, HEIGHT / 3, 0, 2 * M_PI);
+    cairo_set_source_rgba (cr, 1, 1, 0, 0.7);
+    cairo_fill (cr);
+
+    cairo_destroy (cr);
+}
+
+/* Colour channels greater than alpha are not valid premultiplied
+ * colours, but they have always been written out modulo 256 rather
+ * than being allowed to spill into the neighbouring channel. */
+static cairo_test_status_t
+check_out_of_range (const cairo_test_context_t *ctx)
+{
+    cairo_surface_t *surface, *image;
+    cairo_test_status_t result = CAIRO_TEST_SUCCESS;
+    uint32_t *data;
+    int stride, x, y;
+
+    surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, WIDTH, HEIGHT);
+    cairo_surface_flush (surface);
+    data = (uint32_t *) cairo_image_surface_get_data (surface);
+    stride = cairo_image_surface_get_stride (surface) / sizeof (uint32_t);
+    for (y = 0; y < HEIGHT; y++)
+	for (x = 0; x < WIDTH; x++)
+	    data[y * stride + x] = (x & 0x7f) << 24 | 0xff00ff;
+    cairo_surface_mark_dirty (surface);
+
+    image = round_trip (surface, NULL);
+    if (cairo_surface_status (image)) {
+	result = CAIRO_TEST_FAILURE;
+	goto done;
+    }
+
+    data = (uint32_t *) cairo_image_surface_get_data (image);
+    stride = cairo_image_surface_get_stride (image) / sizeof (uint32_t);
+    for (y = 0; y < HEIGHT && result == CAIRO_TEST_SUCCESS; y++) {
+	for (x = 0; x < WIDTH; x++) {
+	    uint32_t pixel = data[y * stride + x];
+
+	    if (pixel >> 24 != (x & 0x7f) || (pixel & 0xff00) != 0) {
+		cairo_test_log (ctx,
+				"Error: out of range pixel (%d, %d) written as %08x\n",
+				x, y, pixel);
+		result = CAIRO_TEST_FAILURE;
+		break;
+	    }
+	}
+    }
+
+done:
+    cairo_surface_destroy (image);
+    cairo_surface_destroy (surface);
+    return result;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    static const cairo_format_t formats[] = {
+	CAIRO_FORMAT_ARGB32,
+	CAIRO_FORMAT_RGB24,
+    };
+    cairo_test_status_t result = CAIRO_TEST_SUCCESS;
+    unsigned int f;
+
+#if CAIRO_HAS_PTHREAD
+    /* the worker threads are started on first use, with as many
+     * threads as CPUs unless told otherwise; make sure that there
+     * is more than one so that the parallel encoder is used */
+    setenv ("CAIRO_NUM_THREADS", "4", 1);
+    cairo_debug_reset_static_data ();
+#endif
+
+    for (f = 0; f < ARRAY_LENGTH (formats); f++) {
+	cairo_surface_t *surface, *expected;
+	int filter, parallel;
+
+	surface = cairo_image_surface_create (formats[f], WIDTH, HEIGHT);
+	draw (surface);
+
+	expected = round_trip (surface, NULL);
+
+	for (filter = CAIRO_PNG_FILTER_DEFAULT; filter <= CAIRO_PNG_FILTER_PAETH; filter++) {
+	    for (parallel = 0; parallel <= 1; parallel++) {
+		cairo_png_options_t *options;
+		cairo_surface_t *image;
+
+		options = cairo_png_options_create ();
+		cairo_png_options_set_filter (options, filter);
+		cairo_png_options_set_compression_level (options, filter);
+		cairo_png_options_set_parallel (options, parallel);
+
+		image = round_trip (surface, options);
+		if (! same_pixels (expected, image)) {
+		    cairo_test_log (ctx,
+				    "Error: format %d, filter %d, parallel %d does not round-trip\n",
+				    formats[f], filter, parallel);
+		    result = CAIRO_TEST_FAILURE;
+		}
+
+#if HAVE_ZLIB && CAIRO_HAS_PTHREAD
+		if (parallel && ! encoded_in_parallel (surface, options)) {
+		    cairo_test_log (ctx,
+				    "Error: format %d, filter %d was not encoded in parallel\n",
+				    formats[f], filter);
+		    result = CAIRO_TEST_FAILURE;
+		}
+#endif
+
+		cairo_surface_destroy (image);
+		cairo_png_options_destroy (options);
+	    }
+	}
+
+	cairo_surface_destroy (expected);
+	cairo_surface_destroy (surface);
+    }
+
+    if (result == CAIRO_TEST_SUCCESS)
+	result = check_out_of_range (ctx);
+
+    return result;
+}
+
+CAIRO_TEST (png_options,
+	    "Check PNG encoder options against the default encoder",
+	    "png, api", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
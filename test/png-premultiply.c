@@ -0,0 +1,176 @@
+/*
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of
+ * the authors not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The authors make no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL,
+ * INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* Write every premultiplied color and alpha to a PNG and read it back,
+ * checking the results against the reference unpremultiply and
+ * premultiply arithmetic.  The odd width leaves a remainder after each
+ * vectorized block of pixels.
+ */
+
+#include "cairo-test.h"
+
+#include <string.h>
+
+#define WIDTH 259
+#define HEIGHT 256
+
+typedef struct _buffer {
+    unsigned char *data;
+    size_t length, size;
+    size_t pos;
+} buffer_t;
+
+static cairo_status_t
+write_buffer (void *closure, const unsigned char *data, unsigned int length)
+{
+    buffer_t *buffer = closure;
+
+    if (buffer->length + length > buffer->size) {
+	size_t size = 2 * (buffer->length + length);
+	unsigned char *new_data = realloc (buffer->data, size);
+	if (new_data == NULL)
+	    return CAIRO_STATUS_NO_MEMORY;
+	buffer->data = new_data;
+	buffer->size = size;
+    }
+
+    memcpy (buffer->data + buffer->length, data, length);
+    buffer->length += length;
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_status_t
+read_buffer (void *closure, unsigned char *data, unsigned int length)
+{
+    buffer_t *buffer = closure;
+
+    if (buffer->pos + length > buffer->length)
+	return CAIRO_STATUS_READ_ERROR;
+
+    memcpy (data, buffer->data + buffer->pos, length);
+    buffer->pos += length;
+    return CAIRO_STATUS_SUCCESS;
+}
+
+/* what a premultiplied channel becomes after a trip through 8-bit
+ * unpremultiplied RGBA */
+static uint32_t
+round_trip_channel (uint32_t alpha, uint32_t color)
+{
+    uint32_t t;
+
+    if (alpha == 0)
+	return 0;
+
+    color = (color * 255 + alpha / 2) / alpha;
+    if (alpha == 255)
+	return color;
+
+    t = alpha * color + 0x80;
+    return (t + (t >> 8)) >> 8;
+}
+
+static uint32_t
+pixel_for (int x, int y)
+{
+    uint32_t alpha = y;
+    uint32_t color = x % 256;
+
+    if (color > alpha)
+	color = alpha;
+
+    return alpha << 24 | color << 16 | (alpha - color) << 8 | color / 2;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    buffer_t buffer = { NULL, 0, 0, 0 };
+    cairo_surface_t *surface, *image;
+    cairo_test_status_t result = CAIRO_TEST_SUCCESS;
+    cairo_status_t status;
+    uint8_t *data;
+    int stride, x, y;
+
+    surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, WIDTH, HEIGHT);
+    data = cairo_image_surface_get_data (surface);
+    stride = cairo_image_surface_get_stride (surface);
+    for (y = 0; y < HEIGHT; y++) {
+	uint32_t *row = (uint32_t *) (data + y * stride);
+
+	for (x = 0; x < WIDTH; x++)
+	    row[x] = pixel_for (x, y);
+    }
+    cairo_surface_mark_dirty (surface);
+
+    status = cairo_surface_write_to_png_stream (surface, write_buffer, &buffer);
+    cairo_surface_destroy (surface);
+    if (status) {
+	cairo_test_log (ctx, "Error: failed to write the png: %s\n",
+			cairo_status_to_string (status));
+	free (buffer.data);
+	return CAIRO_TEST_FAILURE;
+    }
+
+    image = cairo_image_surface_create_from_png_stream (read_buffer, &buffer);
+    free (buffer.data);
+    status = cairo_surface_status (image);
+    if (status) {
+	cairo_test_log (ctx, "Error: failed to read the png back: %s\n",
+			cairo_status_to_string (status));
+	cairo_surface_destroy (image);
+	return CAIRO_TEST_FAILURE;
+    }
+
+    data = cairo_image_surface_get_data (image);
+    stride = cairo_image_surface_get_stride (image);
+    for (y = 0; y < HEIGHT && result == CAIRO_TEST_SUCCESS; y++) {
+	const uint32_t *row = (const uint32_t *) (data + y * stride);
+
+	for (x = 0; x < WIDTH; x++) {
+	    uint32_t p = pixel_for (x, y);
+	    uint32_t alpha = p >> 24;
+	    uint32_t expected;
+
+	    expected = alpha << 24 |
+		       round_trip_channel (alpha, (p >> 16) & 0xff) << 16 |
+		       round_trip_channel (alpha, (p >>  8) & 0xff) <<  8 |
+		       round_trip_channel (alpha, (p >>  0) & 0xff) <<  0;
+	    if (row[x] != expected) {
+		cairo_test_log (ctx,
+				"Error: pixel %08x came back as %08x, expected %08x\n",
+				p, row[x], expected);
+		result = CAIRO_TEST_FAILURE;
+		break;
+	    }
+	}
+    }
+
+    cairo_surface_destroy (image);
+    return result;
+}
+
+CAIRO_TEST (png_premultiply,
+	    "Check the unpremultiply and premultiply of every color through a PNG",
+	    "png, api", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
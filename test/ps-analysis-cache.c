@@ -0,0 +1,166 @@
+/*
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of
+ * the authors not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The authors make no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL,
+ * INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+/* A recording surface drawn unchanged on several pages should only be
+ * analysed the first time, and analysed again once it is modified.
+ * The recording holds a translucent raster source over an opaque fill,
+ * and the PostScript analysis acquires the raster source to check its
+ * transparency, so counting acquisitions per page tells whether the
+ * analysis was replayed or reused.
+ */
+
+#include "cairo-test.h"
+
+#include <cairo-ps.h>
+
+#define SIZE 200
+
+static int acquired;
+
+static cairo_surface_t *
+acquire (cairo_pattern_t *pattern, void *closure,
+	 cairo_surface_t *target,
+	 const cairo_rectangle_int_t *extents)
+{
+    acquired++;
+    return cairo_surface_reference (closure);
+}
+
+static void
+release (cairo_pattern_t *pattern, void *closure,
+	 cairo_surface_t *surface)
+{
+    cairo_surface_destroy (surface);
+}
+
+static cairo_status_t
+write_nothing (void *closure, const unsigned char *data, unsigned int length)
+{
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static int
+show_page (cairo_surface_t *target, cairo_surface_t *recording)
+{
+    cairo_t *cr;
+    int before = acquired;
+
+    cr = cairo_create (target);
+    cairo_set_source_surface (cr, recording, 10, 10);
+    cairo_paint (cr);
+    cairo_show_page (cr);
+    cairo_destroy (cr);
+
+    return acquired - before;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    cairo_surface_t *image, *recording, *target;
+    cairo_pattern_t *raster;
+    cairo_rectangle_t extents = { 0, 0, SIZE, SIZE };
+    cairo_t *cr;
+    int first, second, third;
+    cairo_test_status_t result = CAIRO_TEST_SUCCESS;
+
+    if (! (cairo_test_is_target_enabled (ctx, "ps2") ||
+	   cairo_test_is_target_enabled (ctx, "ps3")))
+    {
+	return CAIRO_TEST_UNTESTED;
+    }
+
+    image = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, SIZE / 2, SIZE / 2);
+    cr = cairo_create (image);
+    cairo_set_source_rgba (cr, 1, 0, 0, .5);
+    cairo_paint (cr);
+    cairo_destroy (cr);
+
+    raster = cairo_pattern_create_raster_source (image,
+						 CAIRO_CONTENT_COLOR_ALPHA,
+						 SIZE / 2, SIZE / 2);
+    cairo_raster_source_pattern_set_acquire (raster, acquire, release);
+
+    recording = cairo_recording_surface_create (CAIRO_CONTENT_COLOR_ALPHA, &extents);
+    cr = cairo_create (recording);
+    cairo_set_source_rgb (cr, 0, 0, 1);
+    cairo_paint (cr);
+    cairo_save (cr);
+    cairo_translate (cr, SIZE / 4, SIZE / 4);
+    cairo_set_source (cr, raster);
+    cairo_paint (cr);
+    cairo_restore (cr);
+
+    target = cairo_ps_surface_create_for_stream (write_nothing, NULL,
+						 SIZE + 20, SIZE + 20);
+
+    first = show_page (target, recording);
+    second = show_page (target, recording);
+
+    /* modify the recording without touching the fallback regions */
+    cairo_set_source_rgb (cr, 0, 1, 0);
+    cairo_rectangle (cr, SIZE - 20, SIZE - 20, 10, 10);
+    cairo_fill (cr);
+    cairo_destroy (cr);
+
+    third = show_page (target, recording);
+
+    cairo_surface_finish (target);
+    if (cairo_surface_status (target)) {
+	cairo_test_log (ctx, "Error: PostScript output failed: %s\n",
+			cairo_status_to_string (cairo_surface_status (target)));
+	result = CAIRO_TEST_FAILURE;
+    }
+
+    if (first == 0) {
+	cairo_test_log (ctx, "Error: the raster source was never acquired\n");
+	result = CAIRO_TEST_FAILURE;
+    }
+
+    if (second >= first) {
+	cairo_test_log (ctx, "Error: the analysis of an unchanged recording was not reused "
+			"(%d acquisitions on the first page, %d on the second)\n",
+			first, second);
+	result = CAIRO_TEST_FAILURE;
+    }
+
+    if (third <= second) {
+	cairo_test_log (ctx, "Error: a modified recording reused a stale analysis "
+			"(%d acquisitions on the second page, %d on the third)\n",
+			second, third);
+	result = CAIRO_TEST_FAILURE;
+    }
+
+    cairo_surface_destroy (target);
+    cairo_surface_destroy (recording);
+    cairo_pattern_destroy (raster);
+    cairo_surface_destroy (image);
+
+    return result;
+}
+
+CAIRO_TEST (ps_analysis_cache,
+	    "Check that the analysis of an unchanged recording is reused across pages",
+	    "ps, recording", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
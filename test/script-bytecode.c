@@ -0,0 +1,245 @@
+/*
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of
+ * the authors not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The authors make no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL,
+ * INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* Compile a script to bytecode and check that replaying it, either
+ * directly or by feeding it to the scanner in place of the text, draws
+ * exactly what interpreting the text does.
+ */
+
+#include "cairo-test.h"
+
+#include <cairo-script-interpreter.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+#define SIZE 64
+
+static const char script[] =
+    "%!CairoScript\n"
+    "/cell { % cr i -- cr\n"
+    "  16 mul 2 add dup 12 12 rectangle\n"
+    "} bind def\n"
+    "dict\n"
+    "  /width 64 set\n"
+    "  /height 64 set\n"
+    "  surface context\n"
+    "1 1 1 set-source-rgb paint\n"
+    "0 0.5 1 set-source-rgb\n"
+    "0 1 3 { cell } for fill\n"
+    "1 0 0 0.5 set-source-rgba\n"
+    "32 32 20 0 6.2832 arc fill\n"
+    "pop\n";
+
+typedef struct _buffer {
+    unsigned char *data;
+    unsigned long length, size;
+} buffer_t;
+
+static cairo_status_t
+write_buffer (void *closure, const unsigned char *data, unsigned int length)
+{
+    buffer_t *buf = closure;
+
+    if (buf->length + length > buf->size) {
+	unsigned long size = buf->size ? 2 * buf->size : 4096;
+	unsigned char *new_data;
+
+	while (size < buf->length + length)
+	    size *= 2;
+
+	new_data = realloc (buf->data, size);
+	if (new_data == NULL)
+	    return CAIRO_STATUS_NO_MEMORY;
+
+	buf->data = new_data;
+	buf->size = size;
+    }
+
+    memcpy (buf->data + buf->length, data, length);
+    buf->length += length;
+    return CAIRO_STATUS_SUCCESS;
+}
+
+static cairo_surface_t *
+_create_image (void *closure,
+	       cairo_content_t content,
+	       double width, double height,
+	       long uid)
+{
+    cairo_surface_t **out = closure;
+
+    *out = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, width, height);
+    return cairo_surface_reference (*out);
+}
+
+typedef enum {
+    RUN_TEXT,
+    RUN_BYTECODE,
+    FEED_BYTECODE,
+} run_mode_t;
+
+static cairo_surface_t *
+render (const cairo_test_context_t *ctx,
+	run_mode_t mode,
+	const buffer_t *bytecode)
+{
+    cairo_script_interpreter_t *csi;
+    cairo_surface_t *surface = NULL;
+    cairo_status_t status;
+    const cairo_script_interpreter_hooks_t hooks = {
+	&surface,
+	_create_image,
+	NULL, /* surface_destroy */
+	NULL, /* context_create */
+	NULL, /* context_destroy */
+	NULL, /* show_page */
+	NULL  /* copy_page */
+    };
+
+    csi = cairo_script_interpreter_create ();
+    cairo_script_interpreter_install_hooks (csi, &hooks);
+    switch (mode) {
+    default:
+    case RUN_TEXT:
+	status = cairo_script_interpreter_feed_string (csi, script,
+						       strlen (script));
+	break;
+    case RUN_BYTECODE:
+	status = cairo_script_interpreter_run_bytecode (csi,
+							bytecode->data,
+							bytecode->length);
+	break;
+    case FEED_BYTECODE:
+	status = cairo_script_interpreter_feed_string (csi,
+						       (const char *) bytecode->data,
+						       bytecode->length);
+	break;
+    }
+    if (status == CAIRO_STATUS_SUCCESS)
+	status = cairo_script_interpreter_destroy (csi);
+    else
+	cairo_script_interpreter_destroy (csi);
+
+    if (status || surface == NULL) {
+	cairo_test_log (ctx, "Error: replay %d failed: %s\n",
+			mode, cairo_status_to_string (status));
+	cairo_surface_destroy (surface);
+	return NULL;
+    }
+
+    cairo_surface_flush (surface);
+    return surface;
+}
+
+static cairo_test_status_t
+compare (const cairo_test_context_t *ctx,
+	 cairo_surface_t *expected,
+	 cairo_surface_t *image)
+{
+    const uint8_t *a, *b;
+    int stride_a, stride_b;
+    int x, y;
+
+    if (cairo_image_surface_get_width (image) != SIZE ||
+	cairo_image_surface_get_height (image) != SIZE)
+    {
+	cairo_test_log (ctx, "Error: replay drew a %dx%d surface\n",
+			cairo_image_surface_get_width (image),
+			cairo_image_surface_get_height (image));
+	return CAIRO_TEST_FAILURE;
+    }
+
+    a = cairo_image_surface_get_data (expected);
+    b = cairo_image_surface_get_data (image);
+    stride_a = cairo_image_surface_get_stride (expected);
+    stride_b = cairo_image_surface_get_stride (image);
+
+    for (y = 0; y < SIZE; y++) {
+	const uint32_t *ra = (const uint32_t *) (a + y * stride_a);
+	const uint32_t *rb = (const uint32_t *) (b + y * stride_b);
+
+	for (x = 0; x < SIZE; x++) {
+	    if (ra[x] != rb[x]) {
+		cairo_test_log (ctx,
+				"Error: pixel (%d, %d) is %08x, expected %08x\n",
+				x, y, rb[x], ra[x]);
+		return CAIRO_TEST_FAILURE;
+	    }
+	}
+    }
+
+    return CAIRO_TEST_SUCCESS;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    cairo_surface_t *expected, *image;
+    cairo_test_status_t result;
+    buffer_t bytecode = { NULL, 0, 0 };
+    cairo_status_t status;
+    FILE *file;
+
+    file = tmpfile ();
+    if (file == NULL)
+	return CAIRO_TEST_UNTESTED;
+
+    fputs (script, file);
+    rewind (file);
+    status = cairo_script_interpreter_compile_stream (file,
+						      write_buffer,
+						      &bytecode);
+    fclose (file);
+    if (status) {
+	cairo_test_log (ctx, "Error: failed to compile the script: %s\n",
+			cairo_status_to_string (status));
+	free (bytecode.data);
+	return CAIRO_TEST_FAILURE;
+    }
+
+    expected = render (ctx, RUN_TEXT, NULL);
+    if (expected == NULL) {
+	free (bytecode.data);
+	return CAIRO_TEST_FAILURE;
+    }
+
+    image = render (ctx, RUN_BYTECODE, &bytecode);
+    result = image ? compare (ctx, expected, image) : CAIRO_TEST_FAILURE;
+    cairo_surface_destroy (image);
+
+    if (result == CAIRO_TEST_SUCCESS) {
+	image = render (ctx, FEED_BYTECODE, &bytecode);
+	result = image ? compare (ctx, expected, image) : CAIRO_TEST_FAILURE;
+	cairo_surface_destroy (image);
+    }
+
+    cairo_surface_destroy (expected);
+    free (bytecode.data);
+    return result;
+}
+
+CAIRO_TEST (script_bytecode,
+	    "Check that compiled scripts replay exactly as the source does",
+	    "script", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
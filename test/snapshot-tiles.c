@@ -0,0 +1,189 @@
+/*
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of
+ * the authors not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The authors make no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL,
+ * INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* A large image that has been used as a source by a recording surface
+ * is snapshotted, and the snapshot only takes over the tiles of the
+ * image that are drawn to afterwards. Check that the recording still
+ * replays the image as it was, however the image is modified next.
+ */
+
+#include "cairo-test.h"
+
+#define SIZE 1000
+
+static void
+draw_original (cairo_t *cr)
+{
+    cairo_set_source_rgb (cr, 1, 0, 0);
+    cairo_paint (cr);
+    cairo_rectangle (cr, 100, 100, 700, 300);
+    cairo_set_source_rgb (cr, 0, 0, 1);
+    cairo_fill (cr);
+}
+
+static cairo_test_status_t
+compare (const cairo_test_context_t *ctx,
+	 cairo_surface_t *expected,
+	 cairo_surface_t *image)
+{
+    const uint8_t *a, *b;
+    int stride_a, stride_b;
+    int x, y;
+
+    a = cairo_image_surface_get_data (expected);
+    b = cairo_image_surface_get_data (image);
+    stride_a = cairo_image_surface_get_stride (expected);
+    stride_b = cairo_image_surface_get_stride (image);
+
+    for (y = 0; y < SIZE; y++) {
+	const uint32_t *ra = (const uint32_t *) (a + y * stride_a);
+	const uint32_t *rb = (const uint32_t *) (b + y * stride_b);
+
+	for (x = 0; x < SIZE; x++) {
+	    if (ra[x] != rb[x]) {
+		cairo_test_log (ctx,
+				"Error: pixel (%d, %d) is %08x, expected %08x\n",
+				x, y, rb[x], ra[x]);
+		return CAIRO_TEST_FAILURE;
+	    }
+	}
+    }
+
+    return CAIRO_TEST_SUCCESS;
+}
+
+static cairo_test_status_t
+check_recording (const cairo_test_context_t *ctx,
+		 cairo_surface_t *expected,
+		 cairo_surface_t *recording)
+{
+    cairo_test_status_t status;
+    cairo_surface_t *image;
+    cairo_t *cr;
+
+    image = cairo_image_surface_create (CAIRO_FORMAT_RGB24, SIZE, SIZE);
+    cr = cairo_create (image);
+    cairo_set_source_surface (cr, recording, 0, 0);
+    cairo_paint (cr);
+    cairo_destroy (cr);
+    cairo_surface_flush (image);
+
+    status = compare (ctx, expected, image);
+    cairo_surface_destroy (image);
+
+    return status;
+}
+
+static cairo_surface_t *
+record (cairo_surface_t *source)
+{
+    cairo_surface_t *recording;
+    cairo_t *cr;
+
+    recording = cairo_recording_surface_create (CAIRO_CONTENT_COLOR, NULL);
+    cr = cairo_create (recording);
+    cairo_set_source_surface (cr, source, 0, 0);
+    cairo_paint (cr);
+    cairo_destroy (cr);
+
+    return recording;
+}
+
+static cairo_surface_t *
+create_original (void)
+{
+    cairo_surface_t *image;
+    cairo_t *cr;
+
+    image = cairo_image_surface_create (CAIRO_FORMAT_RGB24, SIZE, SIZE);
+    cr = cairo_create (image);
+    draw_original (cr);
+    cairo_destroy (cr);
+
+    return image;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    cairo_surface_t *expected, *source, *recording;
+    cairo_test_status_t status;
+    uint32_t *data;
+    int stride, x, y;
+    cairo_t *cr;
+
+    expected = create_original ();
+    cairo_surface_flush (expected);
+
+    /* partial redraws, straddling tiles */
+    source = create_original ();
+    recording = record (source);
+    cr = cairo_create (source);
+    cairo_rectangle (cr, 10, 10, 90, 90);
+    cairo_set_source_rgb (cr, 0, 1, 0);
+    cairo_fill (cr);
+    cairo_arc (cr, 500, 500, 100, 0, 2 * M_PI);
+    cairo_stroke (cr);
+    cairo_destroy (cr);
+    status = check_recording (ctx, expected, recording);
+    cairo_surface_destroy (recording);
+    cairo_surface_destroy (source);
+
+    /* writing to the pixels directly */
+    if (status == CAIRO_TEST_SUCCESS) {
+	source = create_original ();
+	recording = record (source);
+	cairo_surface_flush (source);
+	data = (uint32_t *) cairo_image_surface_get_data (source);
+	stride = cairo_image_surface_get_stride (source) / sizeof (uint32_t);
+	for (y = 300; y < 700; y++)
+	    for (x = 0; x < SIZE; x++)
+		data[y * stride + x] = 0xffffff;
+	cairo_surface_mark_dirty (source);
+	status = check_recording (ctx, expected, recording);
+	cairo_surface_destroy (recording);
+	cairo_surface_destroy (source);
+    }
+
+    /* destroying the original after a redraw */
+    if (status == CAIRO_TEST_SUCCESS) {
+	source = create_original ();
+	recording = record (source);
+	cr = cairo_create (source);
+	cairo_rectangle (cr, 600, 600, 50, 50);
+	cairo_set_source_rgb (cr, 1, 1, 1);
+	cairo_fill (cr);
+	cairo_destroy (cr);
+	cairo_surface_destroy (source);
+	status = check_recording (ctx, expected, recording);
+	cairo_surface_destroy (recording);
+    }
+
+    cairo_surface_destroy (expected);
+    return status;
+}
+
+CAIRO_TEST (snapshot_tiles,
+	    "Check that snapshots of large images survive partial redraws of the image",
+	    "snapshot, image", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
@@ -0,0 +1,160 @@
+/*
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of
+ * the authors not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The authors make no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL,
+ * INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* Render the same scene to an image surface and to a region of a huge
+ * tiled surface, straddling many tile boundaries, and check that the
+ * results are identical.
+ */
+
+#include "cairo-test.h"
+
+#define SIZE 600
+#define HUGE_SIZE 100000
+
+static void
+draw_scene (cairo_t *cr)
+{
+    /* solid paints that cover some tiles completely */
+    cairo_set_source_rgb (cr, 0.2, 0.4, 0.6);
+    cairo_paint (cr);
+
+    cairo_rectangle (cr, 100, 100, 400, 300);
+    cairo_clip (cr);
+    cairo_set_source_rgba (cr, 1, 0, 0, 0.5);
+    cairo_paint (cr);
+    cairo_reset_clip (cr);
+
+    cairo_set_operator (cr, CAIRO_OPERATOR_CLEAR);
+    cairo_rectangle (cr, 0, 256, 512, 256);
+    cairo_fill (cr);
+    cairo_set_operator (cr, CAIRO_OPERATOR_OVER);
+
+    /* and geometry across the tile seams */
+    cairo_arc (cr, 256, 256, 200, 0, 2 * M_PI);
+    cairo_set_source_rgb (cr, 0, 0.8, 0);
+    cairo_fill_preserve (cr);
+    cairo_set_line_width (cr, 13);
+    cairo_set_source_rgba (cr, 0, 0, 0, 0.7);
+    cairo_stroke (cr);
+
+    cairo_set_operator (cr, CAIRO_OPERATOR_IN);
+    cairo_rectangle (cr, 200, 200, 200, 200);
+    cairo_clip (cr);
+    cairo_set_source_rgba (cr, 1, 1, 1, 0.5);
+    cairo_paint (cr);
+}
+
+static cairo_test_status_t
+compare (const cairo_test_context_t *ctx,
+	 cairo_surface_t *expected,
+	 cairo_surface_t *image)
+{
+    const uint8_t *a, *b;
+    int stride_a, stride_b;
+    int x, y;
+
+    a = cairo_image_surface_get_data (expected);
+    b = cairo_image_surface_get_data (image);
+    stride_a = cairo_image_surface_get_stride (expected);
+    stride_b = cairo_image_surface_get_stride (image);
+
+    for (y = 0; y < SIZE; y++) {
+	const uint32_t *ra = (const uint32_t *) (a + y * stride_a);
+	const uint32_t *rb = (const uint32_t *) (b + y * stride_b);
+
+	for (x = 0; x < SIZE; x++) {
+	    if (ra[x] != rb[x]) {
+		cairo_test_log (ctx,
+				"Error: pixel (%d, %d) is %08x, expected %08x\n",
+				x, y, rb[x], ra[x]);
+		return CAIRO_TEST_FAILURE;
+	    }
+	}
+    }
+
+    return CAIRO_TEST_SUCCESS;
+}
+
+static cairo_test_status_t
+check_tiled (const cairo_test_context_t *ctx,
+	     cairo_surface_t *expected,
+	     int size, int offset)
+{
+    cairo_rectangle_int_t extents;
+    cairo_surface_t *tiled, *image;
+    cairo_test_status_t status;
+    cairo_t *cr;
+
+    tiled = cairo_tiled_surface_create (CAIRO_FORMAT_ARGB32, size, size);
+    if (cairo_surface_status (tiled)) {
+	cairo_test_log (ctx, "Error: failed to create a %dx%d tiled surface: %s\n",
+			size, size,
+			cairo_status_to_string (cairo_surface_status (tiled)));
+	cairo_surface_destroy (tiled);
+	return CAIRO_TEST_FAILURE;
+    }
+
+    cr = cairo_create (tiled);
+    cairo_translate (cr, offset, offset);
+    cairo_rectangle (cr, 0, 0, SIZE, SIZE);
+    cairo_clip (cr);
+    draw_scene (cr);
+    cairo_destroy (cr);
+
+    extents.x = extents.y = offset;
+    extents.width = extents.height = SIZE;
+    image = cairo_surface_map_to_image (tiled, &extents);
+    status = compare (ctx, expected, image);
+    cairo_surface_unmap_image (tiled, image);
+
+    cairo_surface_destroy (tiled);
+    return status;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    cairo_surface_t *expected;
+    cairo_test_status_t status;
+    cairo_t *cr;
+
+    expected = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, SIZE, SIZE);
+    cr = cairo_create (expected);
+    cairo_rectangle (cr, 0, 0, SIZE, SIZE);
+    cairo_clip (cr);
+    draw_scene (cr);
+    cairo_destroy (cr);
+    cairo_surface_flush (expected);
+
+    status = check_tiled (ctx, expected, SIZE, 0);
+    if (status == CAIRO_TEST_SUCCESS)
+	status = check_tiled (ctx, expected, HUGE_SIZE, HUGE_SIZE / 2 - 100);
+
+    cairo_surface_destroy (expected);
+    return status;
+}
+
+CAIRO_TEST (tiled_surface,
+	    "Check rendering to a tiled surface against an image surface",
+	    "tiled, api", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
@@ -0,0 +1,226 @@
+/*
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of
+ * the authors not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The authors make no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL,
+ * INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+/* The glyphs of a run that are new to the X server are uploaded in a
+ * single AddGlyphs request before the run is composited, rather than
+ * one request per glyph.  Count the requests sent for a run of
+ * distinct glyphs by comparing sequence numbers either side of it, and
+ * check that the run is then drawn with no further uploads, both after
+ * it was shown once and after it was prefetched.
+ */
+
+#include "cairo-test.h"
+
+#include <cairo-xcb.h>
+
+#define WIDTH 800
+#define HEIGHT 100
+
+static const char text[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789";
+
+static xcb_render_pictforminfo_t *
+find_depth (xcb_connection_t *connection, int depth, void **formats_out)
+{
+    xcb_render_query_pict_formats_reply_t	*formats;
+    xcb_render_query_pict_formats_cookie_t cookie;
+    xcb_render_pictforminfo_iterator_t i;
+
+    cookie = xcb_render_query_pict_formats (connection);
+    xcb_flush (connection);
+
+    formats = xcb_render_query_pict_formats_reply (connection, cookie, 0);
+    if (formats == NULL)
+	return NULL;
+
+    for (i = xcb_render_query_pict_formats_formats_iterator (formats);
+	 i.rem;
+	 xcb_render_pictforminfo_next (&i))
+    {
+	if (XCB_RENDER_PICT_TYPE_DIRECT != i.data->type)
+	    continue;
+
+	if (depth != i.data->depth)
+	    continue;
+
+	*formats_out = formats;
+	return i.data;
+    }
+
+    free (formats);
+    return NULL;
+}
+
+/* The number of requests issued since the last call */
+static unsigned int
+count_requests (xcb_connection_t *connection, unsigned int *sequence)
+{
+    xcb_get_input_focus_cookie_t cookie;
+    unsigned int count;
+
+    cookie = xcb_get_input_focus (connection);
+    free (xcb_get_input_focus_reply (connection, cookie, NULL));
+
+    count = cookie.sequence - *sequence - 1;
+    *sequence = cookie.sequence;
+    return count;
+}
+
+static unsigned int
+show_text (cairo_surface_t *surface,
+	   xcb_connection_t *connection,
+	   unsigned int *sequence,
+	   double size,
+	   const char *utf8)
+{
+    cairo_t *cr;
+
+    cr = cairo_create (surface);
+    cairo_select_font_face (cr, CAIRO_TEST_FONT_FAMILY " Sans",
+			    CAIRO_FONT_SLANT_NORMAL,
+			    CAIRO_FONT_WEIGHT_NORMAL);
+    cairo_set_font_size (cr, size);
+    cairo_move_to (cr, 0, HEIGHT / 2);
+    cairo_show_text (cr, utf8);
+    cairo_destroy (cr);
+    cairo_surface_flush (surface);
+
+    return count_requests (connection, sequence);
+}
+
+static unsigned int
+prefetch_text (cairo_surface_t *surface,
+	       xcb_connection_t *connection,
+	       unsigned int *sequence,
+	       double size,
+	       const char *utf8)
+{
+    cairo_scaled_font_t *scaled_font;
+    cairo_glyph_t *glyphs = NULL;
+    int num_glyphs;
+    cairo_t *cr;
+
+    cr = cairo_create (surface);
+    cairo_select_font_face (cr, CAIRO_TEST_FONT_FAMILY " Sans",
+			    CAIRO_FONT_SLANT_NORMAL,
+			    CAIRO_FONT_WEIGHT_NORMAL);
+    cairo_set_font_size (cr, size);
+    scaled_font = cairo_get_scaled_font (cr);
+
+    cairo_scaled_font_text_to_glyphs (scaled_font, 0, 0, utf8, -1,
+				      &glyphs, &num_glyphs,
+				      NULL, NULL, NULL);
+    cairo_xcb_surface_prefetch_glyphs (surface, scaled_font,
+				       glyphs, num_glyphs);
+    cairo_glyph_free (glyphs);
+    cairo_destroy (cr);
+    cairo_surface_flush (surface);
+
+    return count_requests (connection, sequence);
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    xcb_connection_t *connection;
+    xcb_render_pictforminfo_t *render_format;
+    xcb_screen_t *root;
+    xcb_pixmap_t pixmap;
+    cairo_surface_t *surface;
+    cairo_test_status_t status = CAIRO_TEST_SUCCESS;
+    const int num_glyphs = sizeof (text) - 1;
+    unsigned int sequence = 0, count;
+    void *formats;
+
+    if (! cairo_test_is_target_enabled (ctx, "xcb"))
+	return CAIRO_TEST_UNTESTED;
+
+    connection = xcb_connect (NULL, NULL);
+    if (xcb_connection_has_error (connection)) {
+	cairo_test_log (ctx, "xcb-glyph-requests: Cannot open display, skipping\n");
+	xcb_disconnect (connection);
+	return CAIRO_TEST_UNTESTED;
+    }
+
+    render_format = find_depth (connection, 32, &formats);
+    if (render_format == NULL) {
+	xcb_disconnect (connection);
+	return CAIRO_TEST_UNTESTED;
+    }
+
+    root = xcb_setup_roots_iterator (xcb_get_setup (connection)).data;
+    pixmap = xcb_generate_id (connection);
+    xcb_create_pixmap (connection, 32, pixmap, root->root, WIDTH, HEIGHT);
+
+    surface = cairo_xcb_surface_create_with_xrender_format (connection,
+							    root,
+							    pixmap,
+							    render_format,
+							    WIDTH, HEIGHT);
+    free (formats);
+
+    /* set up the glyphset and the source picture before counting */
+    show_text (surface, connection, &sequence, 20, ".");
+
+    count = show_text (surface, connection, &sequence, 20, text);
+    cairo_test_log (ctx, "%d new glyphs shown in %u requests\n",
+		    num_glyphs, count);
+    if (count >= num_glyphs / 4)
+	status = CAIRO_TEST_FAILURE;
+
+    count = show_text (surface, connection, &sequence, 20, text);
+    cairo_test_log (ctx, "%d cached glyphs shown in %u requests\n",
+		    num_glyphs, count);
+    if (count > 4)
+	status = CAIRO_TEST_FAILURE;
+
+    count = prefetch_text (surface, connection, &sequence, 30, text);
+    cairo_test_log (ctx, "%d new glyphs prefetched in %u requests\n",
+		    num_glyphs, count);
+    if (count >= num_glyphs / 4)
+	status = CAIRO_TEST_FAILURE;
+
+    count = show_text (surface, connection, &sequence, 30, text);
+    cairo_test_log (ctx, "%d prefetched glyphs shown in %u requests\n",
+		    num_glyphs, count);
+    if (count > 4)
+	status = CAIRO_TEST_FAILURE;
+
+    if (cairo_surface_status (surface))
+	status = CAIRO_TEST_FAILURE;
+
+    cairo_surface_finish (surface);
+    cairo_device_finish (cairo_surface_get_device (surface));
+    cairo_surface_destroy (surface);
+
+    xcb_free_pixmap (connection, pixmap);
+    xcb_disconnect (connection);
+
+    return status;
+}
+
+CAIRO_TEST (xcb_glyph_requests,
+	    "Check that new glyphs are uploaded to the X server in batches",
+	    "xcb, text", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
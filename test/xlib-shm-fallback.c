@@ -0,0 +1,195 @@
+/*
+ * Permission to use, copy, modify, distribute, and sell this software
+ * and its documentation for any purpose is hereby granted without
+ * fee, provided that the above copyright notice appear in all copies
+ * and that both that copyright notice and this permission notice
+ * appear in supporting documentation, and that the name of
+ * the authors not be used in advertising or publicity pertaining to
+ * distribution of the software without specific, written prior
+ * permission. The authors make no representations about the
+ * suitability of this software for any purpose.  It is provided "as
+ * is" without express or implied warranty.
+ *
+ * THE AUTHORS DISCLAIM ALL WARRANTIES WITH REGARD TO THIS
+ * SOFTWARE, INCLUDING ALL IMPLIED WARRANTIES OF MERCHANTABILITY AND
+ * FITNESS, IN NO EVENT SHALL THE AUTHORS BE LIABLE FOR ANY SPECIAL,
+ * INDIRECT OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES WHATSOEVER
+ * RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR
+ * IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+
+/* Fallback rendering into an xlib surface goes through a shared
+ * memory image that is uploaded to the drawable on flush.  While an
+ * upload is still in flight the next fallback carries on in a spare
+ * buffer, which must first be brought up to date with whatever was
+ * drawn since it was last live.  Alternate fallbacks with server-side
+ * drawing, so that each fallback starts while the previous upload may
+ * still be pending, and check the final contents against the same
+ * sequence drawn on an image surface.
+ */
+
+#include "cairo-test.h"
+
+#include "cairo-xlib.h"
+
+#define SIZE 256
+#define FRAMES 16
+#define BAND (SIZE / FRAMES)
+
+static void
+fallback (cairo_surface_t *surface, int frame)
+{
+    cairo_surface_t *image;
+    cairo_t *cr;
+
+    /* draw straight into the mapped image, bypassing the server */
+    image = cairo_surface_map_to_image (surface, NULL);
+    cr = cairo_create (image);
+    cairo_rectangle (cr, frame * BAND, 0, BAND, SIZE);
+    cairo_set_source_rgb (cr, frame & 1, (frame >> 1) & 1, (frame >> 2) & 1);
+    cairo_fill (cr);
+    cairo_destroy (cr);
+    cairo_surface_unmap_image (surface, image);
+}
+
+static void
+render (cairo_surface_t *surface, int frame)
+{
+    cairo_t *cr;
+
+    cr = cairo_create (surface);
+    cairo_rectangle (cr, 0, frame * BAND, SIZE, BAND / 2);
+    cairo_set_source_rgb (cr, (frame >> 2) & 1, frame & 1, 1);
+    cairo_fill (cr);
+    cairo_destroy (cr);
+    cairo_surface_flush (surface);
+}
+
+static void
+draw (cairo_surface_t *surface)
+{
+    cairo_t *cr;
+    int frame;
+
+    cr = cairo_create (surface);
+    cairo_set_source_rgb (cr, 1, 1, 1);
+    cairo_paint (cr);
+    cairo_destroy (cr);
+
+    for (frame = 0; frame < FRAMES; frame++) {
+	fallback (surface, frame);
+	render (surface, frame);
+    }
+}
+
+static cairo_surface_t *
+read_back (cairo_surface_t *surface)
+{
+    cairo_surface_t *image;
+    cairo_t *cr;
+
+    image = cairo_image_surface_create (CAIRO_FORMAT_RGB24, SIZE, SIZE);
+    cr = cairo_create (image);
+    cairo_set_source_surface (cr, surface, 0, 0);
+    cairo_paint (cr);
+    cairo_destroy (cr);
+    cairo_surface_flush (image);
+
+    return image;
+}
+
+static cairo_test_status_t
+compare (const cairo_test_context_t *ctx,
+	 cairo_surface_t *expected,
+	 cairo_surface_t *image)
+{
+    const uint8_t *a, *b;
+    int stride_a, stride_b;
+    int x, y;
+
+    a = cairo_image_surface_get_data (expected);
+    b = cairo_image_surface_get_data (image);
+    stride_a = cairo_image_surface_get_stride (expected);
+    stride_b = cairo_image_surface_get_stride (image);
+
+    for (y = 0; y < SIZE; y++) {
+	const uint32_t *ra = (const uint32_t *) (a + y * stride_a);
+	const uint32_t *rb = (const uint32_t *) (b + y * stride_b);
+
+	for (x = 0; x < SIZE; x++) {
+	    if ((ra[x] ^ rb[x]) & 0xffffff) {
+		cairo_test_log (ctx,
+				"Error: pixel (%d, %d) is %06x, expected %06x\n",
+				x, y, rb[x] & 0xffffff, ra[x] & 0xffffff);
+		return CAIRO_TEST_FAILURE;
+	    }
+	}
+    }
+
+    return CAIRO_TEST_SUCCESS;
+}
+
+static cairo_test_status_t
+preamble (cairo_test_context_t *ctx)
+{
+    cairo_surface_t *expected, *surface, *image;
+    cairo_test_status_t status;
+    Display *dpy;
+    Pixmap pixmap;
+    int screen;
+
+    if (! cairo_test_is_target_enabled (ctx, "xlib"))
+	return CAIRO_TEST_UNTESTED;
+
+    dpy = XOpenDisplay (NULL);
+    if (! dpy) {
+	cairo_test_log (ctx, "xlib-shm-fallback: Cannot open display, skipping\n");
+	return CAIRO_TEST_UNTESTED;
+    }
+
+    screen = DefaultScreen (dpy);
+    if (DefaultDepth (dpy, screen) < 24) {
+	cairo_test_log (ctx, "xlib-shm-fallback: default depth is less than 24, skipping\n");
+	XCloseDisplay (dpy);
+	return CAIRO_TEST_UNTESTED;
+    }
+
+    expected = cairo_image_surface_create (CAIRO_FORMAT_RGB24, SIZE, SIZE);
+    draw (expected);
+    cairo_surface_flush (expected);
+
+    pixmap = XCreatePixmap (dpy, DefaultRootWindow (dpy),
+			    SIZE, SIZE, DefaultDepth (dpy, screen));
+    surface = cairo_xlib_surface_create (dpy, pixmap,
+					 DefaultVisual (dpy, screen),
+					 SIZE, SIZE);
+    draw (surface);
+
+    image = read_back (surface);
+    status = compare (ctx, expected, image);
+    cairo_surface_destroy (image);
+
+    /* and again, now that the spare buffers are warm */
+    if (status == CAIRO_TEST_SUCCESS) {
+	draw (surface);
+	image = read_back (surface);
+	status = compare (ctx, expected, image);
+	cairo_surface_destroy (image);
+    }
+
+    cairo_surface_destroy (surface);
+    XFreePixmap (dpy, pixmap);
+    XCloseDisplay (dpy);
+
+    cairo_surface_destroy (expected);
+    return status;
+}
+
+CAIRO_TEST (xlib_shm_fallback,
+	    "Check fallbacks to xlib surfaces overlapping pending shm uploads",
+	    "xlib", /* keywords */
+	    NULL, /* requirements */
+	    0, 0,
+	    preamble, NULL)
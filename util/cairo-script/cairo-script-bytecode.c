@@ -0,0 +1,928 @@
+/*
+ * This library is free software; you can redistribute it and/or
+ * modify it either under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * (the "LGPL") or, at your option, under the terms of the Mozilla
+ * Public License Version 1.1 (the "MPL"). If you do not alter this
+ * notice, a recipient may use your version of this file under either
+ * the MPL or the LGPL.
+ *
+ * You should have received a copy of the LGPL along with this library
+ * in the file COPYING-LGPL-2.1; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Suite 500, Boston, MA 02110-1335, USA
+ * You should have received a copy of the MPL along with this library
+ * in the file COPYING-MPL-1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.1 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY
+ * OF ANY KIND, either express or implied. See the LGPL or the MPL for
+ * the specific language governing rights and limitations.
+ *
+ * The Original Code is the cairo graphics library.
+ *
+ * The Initial Developer of the Original Code is Chris Wilson.
+ */
+
+/*
+ * Compiled scripts.
+ *
+ * The binary tokens understood by the scanner still need to be scanned
+ * one byte at a time, every executable name is looked up through the
+ * dictionary stack and every procedure is rebuilt token by token.  For
+ * traces that are replayed many times over, we can instead do all of that
+ * work once: the script is run through the scanner in bind mode and
+ * written out as a flat instruction stream that refers to a table of
+ * symbols.  Operators are resolved against systemdict when the table is
+ * loaded, so that executing one is simply an indirect call.
+ *
+ * Layout, all multi-byte integers being unsigned LEB128 varints:
+ *
+ *   header:  0x9f 'C' 'S' 'B' <version> <num-symbols>
+ *   symbol:  <kind> <length> <bytes>
+ *   code:    <instruction>*
+ *
+ * The first byte is unassigned in the binary token encoding, which is how
+ * the scanner recognises a compiled script fed to it in place of a text
+ * one.
+ */
+
+#include "config.h"
+
+#include "cairo-script-private.h"
+
+#include <limits.h> /* INT_MAX */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#define BYTECODE_VERSION 1
+
+enum {
+    SYMBOL_NAME,
+    SYMBOL_OPERATOR,
+};
+
+enum {
+    BC_OPERATOR,
+    BC_OPERATOR_LITERAL,
+    BC_NAME,
+    BC_NAME_LITERAL,
+    BC_INTEGER,
+    BC_REAL,
+    BC_STRING,
+    BC_STRING_COMPRESSED,
+    BC_TRUE,
+    BC_FALSE,
+    BC_NULL,
+    BC_PROC_BEGIN,
+    BC_PROC_END,
+    BC_LINE,
+
+    /* the first few operators to be used are encoded in a single byte */
+    BC_OPERATOR_SHORT = 32,
+};
+
+static const uint8_t bytecode_magic[4] = { 0x9f, 'C', 'S', 'B' };
+
+/* compiler */
+
+typedef struct _bc_buffer {
+    uint8_t *data;
+    int len, size;
+} bc_buffer_t;
+
+struct _compile_closure {
+    csi_dictionary_t *operators; /* operator -> name */
+    csi_dictionary_t *symbols; /* name or operator -> symbol index */
+    int num_symbols;
+    int depth;
+    unsigned int line_number;
+
+    bc_buffer_t table;
+    bc_buffer_t code;
+};
+
+static csi_status_t
+_bc_buffer_grow (csi_t *ctx, bc_buffer_t *buf, int len)
+{
+    uint8_t *data;
+    int size;
+
+    size = buf->size ? buf->size : 4096;
+    while (size - buf->len < len) {
+	if (_csi_unlikely (size > INT_MAX / 2))
+	    return _csi_error (CSI_STATUS_NO_MEMORY);
+	size *= 2;
+    }
+
+    data = _csi_realloc (ctx, buf->data, size);
+    if (_csi_unlikely (data == NULL))
+	return _csi_error (CSI_STATUS_NO_MEMORY);
+
+    buf->data = data;
+    buf->size = size;
+    return CSI_STATUS_SUCCESS;
+}
+
+static csi_status_t
+_bc_write (csi_t *ctx, bc_buffer_t *buf, const void *data, int len)
+{
+    if (_csi_unlikely (buf->size - buf->len < len)) {
+	csi_status_t status;
+
+	status = _bc_buffer_grow (ctx, buf, len);
+	if (_csi_unlikely (status))
+	    return status;
+    }
+
+    memcpy (buf->data + buf->len, data, len);
+    buf->len += len;
+    return CSI_STATUS_SUCCESS;
+}
+
+static int
+_encode_uint (uint8_t *p, uint64_t v)
+{
+    int len = 0;
+
+    while (v >= 0x80) {
+	p[len++] = (v & 0x7f) | 0x80;
+	v >>= 7;
+    }
+    p[len++] = v;
+
+    return len;
+}
+
+static csi_status_t
+_bc_write_uint (csi_t *ctx, bc_buffer_t *buf, uint64_t v)
+{
+    uint8_t tmp[10];
+
+    return _bc_write (ctx, buf, tmp, _encode_uint (tmp, v));
+}
+
+static csi_status_t
+_bc_write_op (csi_t *ctx, bc_buffer_t *buf, int op, uint64_t v)
+{
+    uint8_t tmp[11];
+
+    tmp[0] = op;
+    return _bc_write (ctx, buf, tmp, 1 + _encode_uint (tmp + 1, v));
+}
+
+static csi_status_t
+_compile_symbol (csi_t *ctx,
+		 struct _compile_closure *closure,
+		 csi_name_t key,
+		 int kind,
+		 const char *name,
+		 int *index_out)
+{
+    csi_dictionary_entry_t *entry;
+    csi_object_t obj;
+    csi_status_t status;
+    uint8_t u8 = kind;
+    int len;
+
+    entry = _csi_hash_table_lookup (&closure->symbols->hash_table,
+				    (csi_hash_entry_t *) &key);
+    if (entry != NULL) {
+	*index_out = entry->value.datum.integer;
+	return CSI_STATUS_SUCCESS;
+    }
+
+    len = strlen (name);
+    status = _bc_write (ctx, &closure->table, &u8, 1);
+    if (_csi_unlikely (status))
+	return status;
+    status = _bc_write_uint (ctx, &closure->table, len);
+    if (_csi_unlikely (status))
+	return status;
+    status = _bc_write (ctx, &closure->table, name, len);
+    if (_csi_unlikely (status))
+	return status;
+
+    csi_integer_new (&obj, closure->num_symbols);
+    status = csi_dictionary_put (ctx, closure->symbols, key, &obj);
+    if (_csi_unlikely (status))
+	return status;
+
+    *index_out = closure->num_symbols++;
+    return CSI_STATUS_SUCCESS;
+}
+
+static csi_status_t
+_compile_operator (csi_t *ctx,
+		   struct _compile_closure *closure,
+		   csi_operator_t op,
+		   csi_boolean_t executable)
+{
+    csi_dictionary_entry_t *entry;
+    csi_status_t status;
+    int index;
+
+    entry = _csi_hash_table_lookup (&closure->operators->hash_table,
+				    (csi_hash_entry_t *) &op);
+    if (_csi_unlikely (entry == NULL))
+	return _csi_error (CSI_STATUS_INVALID_SCRIPT);
+
+    status = _compile_symbol (ctx, closure,
+			      (csi_name_t) op, SYMBOL_OPERATOR,
+			      (const char *) entry->value.datum.name,
+			      &index);
+    if (_csi_unlikely (status))
+	return status;
+
+    if (! executable)
+	return _bc_write_op (ctx, &closure->code, BC_OPERATOR_LITERAL, index);
+
+    if (index < 256 - BC_OPERATOR_SHORT) {
+	uint8_t u8 = BC_OPERATOR_SHORT + index;
+	return _bc_write (ctx, &closure->code, &u8, 1);
+    }
+
+    return _bc_write_op (ctx, &closure->code, BC_OPERATOR, index);
+}
+
+static csi_status_t
+_compile_name (csi_t *ctx,
+	       struct _compile_closure *closure,
+	       csi_name_t name,
+	       csi_boolean_t executable)
+{
+    const char *str = (const char *) name;
+    csi_status_t status;
+    int index;
+
+    if (executable) {
+	csi_dictionary_t *systemdict;
+	csi_dictionary_entry_t *entry;
+	uint8_t u8;
+
+	/* The scanner leaves procedures to us when binding. */
+	if (str[0] == '{' && str[1] == '\0') {
+	    closure->depth++;
+	    u8 = BC_PROC_BEGIN;
+	    return _bc_write (ctx, &closure->code, &u8, 1);
+	}
+	if (str[0] == '}' && str[1] == '\0') {
+	    if (_csi_unlikely (closure->depth == 0))
+		return _csi_error (CSI_STATUS_INVALID_SCRIPT);
+
+	    closure->depth--;
+	    u8 = BC_PROC_END;
+	    return _bc_write (ctx, &closure->code, &u8, 1);
+	}
+
+	/* Bind executable names to system operators, as does translation.
+	 * XXX This may break some scripts that overload system operators.
+	 */
+	systemdict = ctx->dstack.objects[0].datum.dictionary;
+	entry = _csi_hash_table_lookup (&systemdict->hash_table,
+					(csi_hash_entry_t *) &name);
+	if (entry != NULL &&
+	    csi_object_get_type (&entry->value) == CSI_OBJECT_TYPE_OPERATOR)
+	{
+	    return _compile_operator (ctx, closure,
+				      entry->value.datum.op, TRUE);
+	}
+    }
+
+    status = _compile_symbol (ctx, closure,
+			      name, SYMBOL_NAME, str,
+			      &index);
+    if (_csi_unlikely (status))
+	return status;
+
+    return _bc_write_op (ctx, &closure->code,
+			 executable ? BC_NAME : BC_NAME_LITERAL,
+			 index);
+}
+
+static csi_status_t
+_compile_string (csi_t *ctx,
+		 struct _compile_closure *closure,
+		 csi_string_t *string)
+{
+    csi_status_t status;
+
+    if (string->method == NONE) {
+	status = _bc_write_op (ctx, &closure->code, BC_STRING, string->len);
+    } else {
+	uint8_t u8 = string->method;
+
+	status = _bc_write_op (ctx, &closure->code,
+			       BC_STRING_COMPRESSED, string->len);
+	if (_csi_unlikely (status))
+	    return status;
+
+	status = _bc_write_uint (ctx, &closure->code, string->deflate);
+	if (_csi_unlikely (status))
+	    return status;
+
+	status = _bc_write (ctx, &closure->code, &u8, 1);
+    }
+    if (_csi_unlikely (status))
+	return status;
+
+    return _bc_write (ctx, &closure->code, string->string, string->len);
+}
+
+static csi_status_t
+_compile_object (csi_t *ctx, csi_object_t *obj, csi_boolean_t executable)
+{
+    struct _compile_closure *closure = ctx->scanner.closure;
+    csi_status_t status;
+    uint8_t u8;
+
+    if (ctx->scanner.line_number != closure->line_number) {
+	closure->line_number = ctx->scanner.line_number;
+	status = _bc_write_op (ctx, &closure->code,
+			       BC_LINE, closure->line_number);
+	if (_csi_unlikely (status))
+	    return status;
+    }
+
+    switch (csi_object_get_type (obj)) {
+    case CSI_OBJECT_TYPE_NAME:
+	return _compile_name (ctx, closure, obj->datum.name, executable);
+
+    case CSI_OBJECT_TYPE_OPERATOR:
+	return _compile_operator (ctx, closure, obj->datum.op, executable);
+
+    case CSI_OBJECT_TYPE_INTEGER:
+	/* zig-zag encode so that small negative values stay short */
+	return _bc_write_op (ctx, &closure->code, BC_INTEGER,
+			     ((uint64_t) obj->datum.integer << 1) ^
+			     (uint64_t) (obj->datum.integer < 0 ? -1 : 0));
+
+    case CSI_OBJECT_TYPE_REAL:
+	{
+	    union {
+		csi_real_t f;
+		uint32_t u32;
+	    } u;
+	    uint8_t buf[5];
+
+	    u.f = obj->datum.real;
+	    buf[0] = BC_REAL;
+	    buf[1] = u.u32 >>  0;
+	    buf[2] = u.u32 >>  8;
+	    buf[3] = u.u32 >> 16;
+	    buf[4] = u.u32 >> 24;
+	    return _bc_write (ctx, &closure->code, buf, 5);
+	}
+
+    case CSI_OBJECT_TYPE_STRING:
+	return _compile_string (ctx, closure, obj->datum.string);
+
+    case CSI_OBJECT_TYPE_BOOLEAN:
+	u8 = obj->datum.boolean ? BC_TRUE : BC_FALSE;
+	return _bc_write (ctx, &closure->code, &u8, 1);
+
+    case CSI_OBJECT_TYPE_NULL:
+	u8 = BC_NULL;
+	return _bc_write (ctx, &closure->code, &u8, 1);
+
+    case CSI_OBJECT_TYPE_MARK:
+    case CSI_OBJECT_TYPE_ARRAY:
+    case CSI_OBJECT_TYPE_DICTIONARY:
+    case CSI_OBJECT_TYPE_FILE:
+    case CSI_OBJECT_TYPE_MATRIX:
+    case CSI_OBJECT_TYPE_CONTEXT:
+    case CSI_OBJECT_TYPE_FONT:
+    case CSI_OBJECT_TYPE_PATTERN:
+    case CSI_OBJECT_TYPE_SCALED_FONT:
+    case CSI_OBJECT_TYPE_SURFACE:
+	break;
+    }
+
+    return _csi_error (CSI_STATUS_INVALID_SCRIPT);
+}
+
+static csi_status_t
+_compile_push (csi_t *ctx, csi_object_t *obj)
+{
+    csi_status_t status;
+
+    status = _compile_object (ctx, obj, FALSE);
+    csi_object_free (ctx, obj);
+
+    return status;
+}
+
+static csi_status_t
+_compile_execute (csi_t *ctx, csi_object_t *obj)
+{
+    return _compile_object (ctx, obj, TRUE);
+}
+
+/* Maps each operator back to its name, for writing scripts out again. */
+csi_status_t
+_csi_build_operator_names (csi_t *ctx, csi_dictionary_t **out)
+{
+    const csi_operator_def_t *def;
+    csi_dictionary_t *dict;
+    csi_object_t obj;
+    csi_status_t status;
+
+    status = csi_dictionary_new (ctx, &obj);
+    if (_csi_unlikely (status))
+	return status;
+
+    dict = obj.datum.dictionary;
+    for (def = _csi_operators (); def->name != NULL; def++) {
+	if (def->op == NULL ||
+	    csi_dictionary_has (dict, (csi_name_t) def->op))
+	{
+	    continue;
+	}
+
+	status = csi_name_new_static (ctx, &obj, def->name);
+	if (_csi_unlikely (status))
+	    goto FAIL;
+
+	status = csi_dictionary_put (ctx, dict, (csi_name_t) def->op, &obj);
+	if (_csi_unlikely (status))
+	    goto FAIL;
+    }
+
+    *out = dict;
+    return CSI_STATUS_SUCCESS;
+
+FAIL:
+    csi_dictionary_free (ctx, dict);
+    return status;
+}
+
+csi_status_t
+_csi_compile_file (csi_t *ctx,
+		   csi_file_t *file,
+		   cairo_write_func_t write_func,
+		   void *closure)
+{
+    struct _compile_closure compiler;
+    csi_status_t (*push) (csi_t *ctx, csi_object_t *obj);
+    csi_status_t (*execute) (csi_t *ctx, csi_object_t *obj);
+    csi_object_t obj;
+    csi_status_t status;
+    uint8_t header[16];
+    int len;
+
+    memset (&compiler, 0, sizeof (compiler));
+
+    status = _csi_build_operator_names (ctx, &compiler.operators);
+    if (_csi_unlikely (status))
+	return status;
+
+    status = csi_dictionary_new (ctx, &obj);
+    if (_csi_unlikely (status))
+	goto BAIL;
+    compiler.symbols = obj.datum.dictionary;
+
+    push = ctx->scanner.push;
+    execute = ctx->scanner.execute;
+
+    ctx->scanner.closure = &compiler;
+    ctx->scanner.bind = 1;
+    ctx->scanner.push = _compile_push;
+    ctx->scanner.execute = _compile_execute;
+
+    status = _csi_scan_file (ctx, file);
+
+    ctx->scanner.bind = 0;
+    ctx->scanner.push = push;
+    ctx->scanner.execute = execute;
+    ctx->scanner.closure = NULL;
+
+    if (status == CSI_STATUS_SUCCESS && compiler.depth)
+	status = _csi_error (CSI_STATUS_INVALID_SCRIPT);
+    if (_csi_unlikely (status))
+	goto BAIL;
+
+    memcpy (header, bytecode_magic, sizeof (bytecode_magic));
+    len = sizeof (bytecode_magic);
+    header[len++] = BYTECODE_VERSION;
+    len += _encode_uint (header + len, compiler.num_symbols);
+
+    status = write_func (closure, header, len);
+    if (status == CSI_STATUS_SUCCESS && compiler.table.len)
+	status = write_func (closure, compiler.table.data, compiler.table.len);
+    if (status == CSI_STATUS_SUCCESS && compiler.code.len)
+	status = write_func (closure, compiler.code.data, compiler.code.len);
+
+BAIL:
+    _csi_free (ctx, compiler.table.data);
+    _csi_free (ctx, compiler.code.data);
+    if (compiler.symbols != NULL)
+	csi_dictionary_free (ctx, compiler.symbols);
+    csi_dictionary_free (ctx, compiler.operators);
+
+    return status;
+}
+
+/* executor */
+
+typedef struct _bc_reader {
+    const uint8_t *ptr;
+    const uint8_t *end;
+} bc_reader_t;
+
+static csi_boolean_t
+_read_uint (bc_reader_t *r, uint64_t *out)
+{
+    uint64_t v = 0;
+    int shift = 0;
+
+    do {
+	if (_csi_unlikely (r->ptr == r->end || shift > 63))
+	    return FALSE;
+
+	v |= (uint64_t) (*r->ptr & 0x7f) << shift;
+	shift += 7;
+    } while (*r->ptr++ & 0x80);
+
+    *out = v;
+    return TRUE;
+}
+
+static csi_boolean_t
+_read_length (bc_reader_t *r, int *out)
+{
+    uint64_t v;
+
+    if (_csi_unlikely (! _read_uint (r, &v)))
+	return FALSE;
+
+    if (_csi_unlikely (v > (uint64_t) (r->end - r->ptr)))
+	return FALSE;
+
+    *out = v;
+    return TRUE;
+}
+
+static csi_boolean_t
+_read_index (bc_reader_t *r, int num_symbols, int *out)
+{
+    uint64_t v;
+
+    if (_csi_unlikely (! _read_uint (r, &v)))
+	return FALSE;
+
+    if (_csi_unlikely (v >= (uint64_t) num_symbols))
+	return FALSE;
+
+    *out = v;
+    return TRUE;
+}
+
+static csi_status_t
+_load_symbols (csi_t *ctx,
+	       bc_reader_t *r,
+	       csi_object_t **symbols_out,
+	       int *num_symbols_out)
+{
+    csi_dictionary_t *systemdict;
+    csi_object_t *symbols;
+    csi_status_t status;
+    int num_symbols, n;
+
+    /* every symbol takes at least two bytes */
+    if (_csi_unlikely (! _read_length (r, &num_symbols) ||
+		       num_symbols > (r->end - r->ptr) / 2))
+    {
+	return _csi_error (CSI_STATUS_INVALID_SCRIPT);
+    }
+
+    if (num_symbols == 0) {
+	*symbols_out = NULL;
+	*num_symbols_out = 0;
+	return CSI_STATUS_SUCCESS;
+    }
+
+    symbols = _csi_alloc (ctx, num_symbols * sizeof (csi_object_t));
+    if (_csi_unlikely (symbols == NULL))
+	return _csi_error (CSI_STATUS_NO_MEMORY);
+
+    systemdict = ctx->dstack.objects[0].datum.dictionary;
+    for (n = 0; n < num_symbols; n++) {
+	int kind, len;
+
+	if (_csi_unlikely (r->ptr == r->end))
+	    goto INVALID;
+
+	kind = *r->ptr++;
+	if (_csi_unlikely (! _read_length (r, &len)))
+	    goto INVALID;
+
+	status = csi_name_new (ctx, &symbols[n], (const char *) r->ptr, len);
+	if (_csi_unlikely (status))
+	    goto FAIL;
+	r->ptr += len;
+
+	if (kind == SYMBOL_OPERATOR) {
+	    csi_dictionary_entry_t *entry;
+
+	    /* resolve operators by name once, here */
+	    entry = _csi_hash_table_lookup (&systemdict->hash_table,
+					    (csi_hash_entry_t *)
+					    &symbols[n].datum.name);
+	    if (_csi_unlikely (entry == NULL ||
+			       csi_object_get_type (&entry->value) !=
+			       CSI_OBJECT_TYPE_OPERATOR))
+	    {
+		goto INVALID;
+	    }
+
+	    symbols[n] = entry->value;
+	} else if (_csi_unlikely (kind != SYMBOL_NAME))
+	    goto INVALID;
+    }
+
+    *symbols_out = symbols;
+    *num_symbols_out = num_symbols;
+    return CSI_STATUS_SUCCESS;
+
+INVALID:
+    status = _csi_error (CSI_STATUS_INVALID_SCRIPT);
+FAIL:
+    _csi_free (ctx, symbols);
+    return status;
+}
+
+static inline csi_status_t
+_bc_push (csi_t *ctx, csi_stack_t *procs, csi_object_t *obj)
+{
+    if (procs->len)
+	return csi_array_append (ctx,
+				 procs->objects[procs->len - 1].datum.array,
+				 obj);
+
+    return _csi_push_ostack (ctx, obj);
+}
+
+static csi_status_t
+_bc_string (csi_t *ctx,
+	    bc_reader_t *r,
+	    csi_mapping_t *mapping,
+	    csi_stack_t *procs,
+	    csi_boolean_t compressed)
+{
+    csi_object_t obj;
+    csi_status_t status;
+    uint64_t deflate = 0;
+    int len, method = NONE;
+
+    if (_csi_unlikely (! _read_length (r, &len)))
+	return _csi_error (CSI_STATUS_INVALID_SCRIPT);
+
+    if (compressed) {
+	if (_csi_unlikely (! _read_uint (r, &deflate) ||
+			   deflate > INT_MAX ||
+			   r->ptr == r->end))
+	{
+	    return _csi_error (CSI_STATUS_INVALID_SCRIPT);
+	}
+
+	method = *r->ptr++;
+	if (_csi_unlikely (method != ZLIB && method != LZO))
+	    return _csi_error (CSI_STATUS_INVALID_SCRIPT);
+    }
+
+    if (_csi_unlikely (len > r->end - r->ptr))
+	return _csi_error (CSI_STATUS_INVALID_SCRIPT);
+
+    if (mapping != NULL && len >= CSI_MAPPED_STRING_MIN) {
+	status = csi_string_new_for_mapping (ctx, &obj, mapping,
+					     (const char *) r->ptr, len);
+    } else
+	status = csi_string_new (ctx, &obj, (const char *) r->ptr, len);
+    if (_csi_unlikely (status))
+	return status;
+    r->ptr += len;
+
+    obj.datum.string->deflate = deflate;
+    obj.datum.string->method = method;
+
+    status = _bc_push (ctx, procs, &obj);
+    if (_csi_unlikely (status))
+	csi_object_free (ctx, &obj);
+
+    return status;
+}
+
+static csi_status_t
+_bc_execute (csi_t *ctx,
+	     bc_reader_t *r,
+	     csi_mapping_t *mapping,
+	     const csi_object_t *symbols,
+	     int num_symbols,
+	     csi_stack_t *procs)
+{
+    csi_object_t obj;
+    csi_status_t status;
+    uint64_t v;
+    int index;
+
+    while (r->ptr < r->end) {
+	int op = *r->ptr++;
+
+	/* executable operators are by far the most common instruction */
+	if (_csi_likely (op >= BC_OPERATOR_SHORT)) {
+	    index = op - BC_OPERATOR_SHORT;
+	    if (_csi_unlikely (index >= num_symbols))
+		return _csi_error (CSI_STATUS_INVALID_SCRIPT);
+	    goto OPERATOR;
+	}
+
+	switch (op) {
+	case BC_OPERATOR:
+	    if (_csi_unlikely (! _read_index (r, num_symbols, &index)))
+		return _csi_error (CSI_STATUS_INVALID_SCRIPT);
+OPERATOR:
+	    if (_csi_unlikely (csi_object_get_type (&symbols[index]) !=
+			       CSI_OBJECT_TYPE_OPERATOR))
+	    {
+		return _csi_error (CSI_STATUS_INVALID_SCRIPT);
+	    }
+
+	    if (procs->len) {
+		obj = symbols[index];
+		status = _bc_push (ctx, procs, &obj);
+	    } else
+		status = symbols[index].datum.op (ctx);
+	    break;
+
+	case BC_OPERATOR_LITERAL:
+	    if (_csi_unlikely (! _read_index (r, num_symbols, &index) ||
+			       csi_object_get_type (&symbols[index]) !=
+			       CSI_OBJECT_TYPE_OPERATOR))
+	    {
+		return _csi_error (CSI_STATUS_INVALID_SCRIPT);
+	    }
+
+	    obj = symbols[index];
+	    obj.type &= ~CSI_OBJECT_ATTR_EXECUTABLE;
+	    status = _bc_push (ctx, procs, &obj);
+	    break;
+
+	case BC_NAME:
+	case BC_NAME_LITERAL:
+	    if (_csi_unlikely (! _read_index (r, num_symbols, &index) ||
+			       csi_object_get_type (&symbols[index]) !=
+			       CSI_OBJECT_TYPE_NAME))
+	    {
+		return _csi_error (CSI_STATUS_INVALID_SCRIPT);
+	    }
+
+	    obj = symbols[index];
+	    if (op == BC_NAME) {
+		obj.type |= CSI_OBJECT_ATTR_EXECUTABLE;
+		if (procs->len == 0) {
+		    status = csi_object_execute (ctx, &obj);
+		    break;
+		}
+	    }
+	    status = _bc_push (ctx, procs, &obj);
+	    break;
+
+	case BC_INTEGER:
+	    if (_csi_unlikely (! _read_uint (r, &v)))
+		return _csi_error (CSI_STATUS_INVALID_SCRIPT);
+
+	    csi_integer_new (&obj, (csi_integer_t) ((v >> 1) ^ -(v & 1)));
+	    status = _bc_push (ctx, procs, &obj);
+	    break;
+
+	case BC_REAL:
+	    {
+		union {
+		    csi_real_t f;
+		    uint32_t u32;
+		} u;
+
+		if (_csi_unlikely (r->end - r->ptr < 4))
+		    return _csi_error (CSI_STATUS_INVALID_SCRIPT);
+
+		u.u32 = (uint32_t) r->ptr[0] |
+			(uint32_t) r->ptr[1] << 8 |
+			(uint32_t) r->ptr[2] << 16 |
+			(uint32_t) r->ptr[3] << 24;
+		r->ptr += 4;
+
+		csi_real_new (&obj, u.f);
+		status = _bc_push (ctx, procs, &obj);
+	    }
+	    break;
+
+	case BC_STRING:
+	case BC_STRING_COMPRESSED:
+	    status = _bc_string (ctx, r, mapping, procs,
+				 op == BC_STRING_COMPRESSED);
+	    break;
+
+	case BC_TRUE:
+	case BC_FALSE:
+	    csi_boolean_new (&obj, op == BC_TRUE);
+	    status = _bc_push (ctx, procs, &obj);
+	    break;
+
+	case BC_NULL:
+	    obj.type = CSI_OBJECT_TYPE_NULL;
+	    status = _bc_push (ctx, procs, &obj);
+	    break;
+
+	case BC_PROC_BEGIN:
+	    status = csi_array_new (ctx, 0, &obj);
+	    if (_csi_unlikely (status))
+		return status;
+
+	    obj.type |= CSI_OBJECT_ATTR_EXECUTABLE;
+	    status = _csi_stack_push (ctx, procs, &obj);
+	    if (_csi_unlikely (status))
+		csi_object_free (ctx, &obj);
+	    break;
+
+	case BC_PROC_END:
+	    if (_csi_unlikely (procs->len == 0))
+		return _csi_error (CSI_STATUS_INVALID_SCRIPT);
+
+	    /* a completed procedure is pushed, never executed */
+	    obj = procs->objects[--procs->len];
+	    status = _bc_push (ctx, procs, &obj);
+	    if (_csi_unlikely (status))
+		csi_object_free (ctx, &obj);
+	    break;
+
+	case BC_LINE:
+	    if (_csi_unlikely (! _read_uint (r, &v)))
+		return _csi_error (CSI_STATUS_INVALID_SCRIPT);
+
+	    ctx->scanner.line_number = v;
+	    status = CSI_STATUS_SUCCESS;
+	    break;
+
+	default:
+	    return _csi_error (CSI_STATUS_INVALID_SCRIPT);
+	}
+
+	if (_csi_unlikely (status))
+	    return status;
+    }
+
+    if (_csi_unlikely (procs->len))
+	return _csi_error (CSI_STATUS_INVALID_SCRIPT);
+
+    return CSI_STATUS_SUCCESS;
+}
+
+csi_status_t
+_csi_bytecode_execute (csi_t *ctx,
+		       const uint8_t *data,
+		       unsigned long length,
+		       csi_mapping_t *mapping)
+{
+    csi_object_t *symbols;
+    csi_stack_t procs;
+    csi_status_t status;
+    bc_reader_t r;
+    unsigned int old_line_number;
+    int num_symbols;
+
+    if (_csi_unlikely (length <= sizeof (bytecode_magic) ||
+		       memcmp (data, bytecode_magic, sizeof (bytecode_magic)) ||
+		       data[sizeof (bytecode_magic)] != BYTECODE_VERSION))
+    {
+	return _csi_error (CSI_STATUS_INVALID_SCRIPT);
+    }
+
+    r.ptr = data + sizeof (bytecode_magic) + 1;
+    r.end = data + length;
+
+    status = _load_symbols (ctx, &r, &symbols, &num_symbols);
+    if (_csi_unlikely (status))
+	return status;
+
+    status = _csi_stack_init (ctx, &procs, 4);
+    if (_csi_unlikely (status))
+	goto BAIL;
+
+    old_line_number = ctx->scanner.line_number;
+    ctx->scanner.line_number = 0;
+
+    status = _bc_execute (ctx, &r, mapping, symbols, num_symbols, &procs);
+
+    if (status == CSI_STATUS_SUCCESS)
+	ctx->scanner.line_number = old_line_number;
+
+    _csi_stack_fini (ctx, &procs);
+BAIL:
+    _csi_free (ctx, symbols);
+
+    return status;
+}
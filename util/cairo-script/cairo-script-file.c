@@ -45,10 +45,88 @@
 #include <lzo/lzo2a.h>
 #endif
 
+#ifdef HAVE_MMAP
+# ifdef HAVE_UNISTD_H
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+# else
+#  undef HAVE_MMAP
+# endif
+#endif
+
 #define CHUNK_SIZE 32768
 
 #define OWN_STREAM 0x1
 
+csi_mapping_t *
+_csi_mapping_reference (csi_mapping_t *mapping)
+{
+    mapping->ref++;
+    return mapping;
+}
+
+void
+_csi_mapping_destroy (csi_t *ctx, csi_mapping_t *mapping)
+{
+    if (--mapping->ref)
+	return;
+
+#ifdef HAVE_MMAP
+    munmap (mapping->data, mapping->length);
+#endif
+    _csi_slab_free (ctx, mapping, sizeof (csi_mapping_t));
+}
+
+/* Map a regular file for reading, so that the scanner can walk through it
+ * without copying and large strings can point straight into it.
+ */
+static csi_mapping_t *
+_csi_mapping_create (csi_t *ctx, const char *path)
+{
+#ifdef HAVE_MMAP
+    csi_mapping_t *mapping;
+    struct stat st;
+    void *data;
+    int fd;
+
+    fd = open (path, O_RDONLY);
+    if (fd == -1)
+	return NULL;
+
+    /* the file offsets are tracked in an int */
+    if (fstat (fd, &st) || ! S_ISREG (st.st_mode) ||
+	st.st_size == 0 || st.st_size > INT_MAX)
+    {
+	close (fd);
+	return NULL;
+    }
+
+    data = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close (fd);
+    if (data == MAP_FAILED)
+	return NULL;
+
+#ifdef MADV_SEQUENTIAL
+    madvise (data, st.st_size, MADV_SEQUENTIAL);
+#endif
+
+    mapping = _csi_slab_alloc (ctx, sizeof (csi_mapping_t));
+    if (mapping == NULL) {
+	munmap (data, st.st_size);
+	return NULL;
+    }
+
+    mapping->ref = 1;
+    mapping->data = data;
+    mapping->length = st.st_size;
+    return mapping;
+#else
+    return NULL;
+#endif
+}
+
 csi_status_t
 csi_file_new (csi_t *ctx,
 	      csi_object_t *obj,
@@ -62,6 +140,22 @@ csi_file_new (csi_t *ctx,
 
     file->base.type = CSI_OBJECT_TYPE_FILE;
     file->base.ref = 1;
+    file->mapping = NULL;
+
+    if (mode[0] == 'r' && strchr (mode, '+') == NULL)
+	file->mapping = _csi_mapping_create (ctx, path);
+    if (file->mapping != NULL) {
+	file->type = BYTES;
+	file->flags = 0;
+	file->src  = file->mapping->data;
+	file->data = file->mapping->data;
+	file->bp   = file->mapping->data;
+	file->rem  = file->mapping->length;
+
+	obj->type = CSI_OBJECT_TYPE_FILE;
+	obj->datum.file = file;
+	return CAIRO_STATUS_SUCCESS;
+    }
 
     file->data = NULL;
     file->type = STDIO;
@@ -98,6 +192,7 @@ csi_file_new_for_stream (csi_t *ctx,
 
     file->base.type = CSI_OBJECT_TYPE_FILE;
     file->base.ref = 1;
+    file->mapping = NULL;
 
     file->data = NULL;
     file->type = STDIO;
@@ -135,6 +230,7 @@ csi_file_new_for_bytes (csi_t *ctx,
 
     file->base.type = CSI_OBJECT_TYPE_FILE;
     file->base.ref = 1;
+    file->mapping = NULL;
 
     file->type = BYTES;
     file->src  = (uint8_t *) bytes;
@@ -160,6 +256,7 @@ csi_file_new_from_string (csi_t *ctx,
 
     file->base.type = CSI_OBJECT_TYPE_FILE;
     file->base.ref = 1;
+    file->mapping = NULL;
 
     if (src->deflate) {
 	uLongf len = src->deflate;
@@ -207,6 +304,8 @@ csi_file_new_from_string (csi_t *ctx,
 	file->src  = src; src->base.ref++;
 	file->data = src->string;
 	file->rem  = src->len;
+	if (src->mapping != NULL)
+	    file->mapping = _csi_mapping_reference (src->mapping);
     }
     file->type = BYTES;
     file->bp   = file->data;
@@ -236,6 +335,7 @@ _csi_file_new_filter (csi_t *ctx,
 
     file->base.type = CSI_OBJECT_TYPE_FILE;
     file->base.ref = 1;
+    file->mapping = NULL;
 
     file->type = FILTER;
     file->data = data;
@@ -1025,6 +1125,11 @@ csi_file_close (csi_t *ctx, csi_file_t *file)
 	break;
     }
     file->src = NULL;
+
+    if (file->mapping != NULL) {
+	_csi_mapping_destroy (ctx, file->mapping);
+	file->mapping = NULL;
+    }
 }
 
 void
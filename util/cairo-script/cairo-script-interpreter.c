@@ -623,6 +623,21 @@ cairo_script_interpreter_feed_string (csi_t *ctx, const char *line, int len)
     return ctx->status;
 }
 
+cairo_status_t
+cairo_script_interpreter_run_bytecode (csi_t *ctx,
+				       const unsigned char *data,
+				       unsigned long length)
+{
+    if (ctx->status)
+	return ctx->status;
+    if (ctx->finished)
+	return ctx->status = CSI_STATUS_INTERPRETER_FINISHED;
+
+    ctx->status = _csi_bytecode_execute (ctx, data, length, NULL);
+
+    return ctx->status;
+}
+
 unsigned int
 cairo_script_interpreter_get_line_number (csi_t *ctx)
 {
@@ -709,3 +724,51 @@ BAIL:
 
     return status;
 }
+
+cairo_status_t
+cairo_script_interpreter_compile_stream (FILE *stream,
+					 cairo_write_func_t write_func,
+					 void *closure)
+{
+    csi_t ctx;
+    csi_object_t src;
+    csi_status_t status;
+
+    _csi_init (&ctx);
+
+    status = csi_file_new_for_stream (&ctx, &src, stream);
+    if (status)
+	goto BAIL;
+
+    status = _csi_compile_file (&ctx, src.datum.file, write_func, closure);
+
+BAIL:
+    csi_object_free (&ctx, &src);
+    _csi_fini (&ctx);
+
+    return status;
+}
+
+cairo_status_t
+cairo_script_interpreter_untranslate_stream (FILE *stream,
+					     cairo_write_func_t write_func,
+					     void *closure)
+{
+    csi_t ctx;
+    csi_object_t src;
+    csi_status_t status;
+
+    _csi_init (&ctx);
+
+    status = csi_file_new_for_stream (&ctx, &src, stream);
+    if (status)
+	goto BAIL;
+
+    status = _csi_untranslate_file (&ctx, src.datum.file, write_func, closure);
+
+BAIL:
+    csi_object_free (&ctx, &src);
+    _csi_fini (&ctx);
+
+    return status;
+}
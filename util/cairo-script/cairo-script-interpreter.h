@@ -102,6 +102,11 @@ cairo_script_interpreter_feed_string (cairo_script_interpreter_t *ctx,
 				      const char *line,
 				      int len);
 
+cairo_public cairo_status_t
+cairo_script_interpreter_run_bytecode (cairo_script_interpreter_t *ctx,
+				       const unsigned char *data,
+				       unsigned long length);
+
 cairo_public unsigned int
 cairo_script_interpreter_get_line_number (cairo_script_interpreter_t *ctx);
 
@@ -119,6 +124,16 @@ cairo_script_interpreter_translate_stream (FILE *stream,
 	                                   cairo_write_func_t write_func,
 					   void *closure);
 
+cairo_public cairo_status_t
+cairo_script_interpreter_compile_stream (FILE *stream,
+					 cairo_write_func_t write_func,
+					 void *closure);
+
+cairo_public cairo_status_t
+cairo_script_interpreter_untranslate_stream (FILE *stream,
+					     cairo_write_func_t write_func,
+					     void *closure);
+
 CAIRO_END_DECLS
 
 #endif /*CAIRO_SCRIPT_INTERPRETER_H*/
@@ -511,6 +511,8 @@ csi_string_new (csi_t *ctx,
     string->len = len;
     string->deflate = 0;
     string->method = NONE;
+    string->mapping = NULL;
+    string->terminated = FALSE;
 
     string->base.type = CSI_OBJECT_TYPE_STRING;
     string->base.ref = 1;
@@ -542,6 +544,63 @@ csi_string_deflate_new (csi_t *ctx,
     return CSI_STATUS_SUCCESS;
 }
 
+csi_status_t
+csi_string_new_for_mapping (csi_t *ctx,
+			    csi_object_t *obj,
+			    csi_mapping_t *mapping,
+			    const char *bytes,
+			    int len)
+{
+    csi_string_t *string;
+
+    string = _csi_slab_alloc (ctx, sizeof (csi_string_t));
+    if (_csi_unlikely (string == NULL))
+	return _csi_error (CSI_STATUS_NO_MEMORY);
+
+    string->string = (char *) bytes;
+    string->len = len;
+    string->deflate = 0;
+    string->method = NONE;
+    string->mapping = _csi_mapping_reference (mapping);
+    string->terminated = FALSE;
+
+    string->base.type = CSI_OBJECT_TYPE_STRING;
+    string->base.ref = 1;
+
+    obj->type = CSI_OBJECT_TYPE_STRING;
+    obj->datum.string = string;
+
+    return CSI_STATUS_SUCCESS;
+}
+
+/* Strings borrowed from a mapping are not nul-terminated, so before one
+ * is handed to a C string consumer, give it a copy of its own.
+ *
+ * The mapped bytes may already have been passed on, e.g. as mime data or
+ * as the data of a FreeType face, by something holding a reference on
+ * the string, so the mapping is only released along with the string.
+ */
+csi_status_t
+csi_string_terminate (csi_t *ctx, csi_string_t *string)
+{
+    char *bytes;
+
+    if (string->mapping == NULL || string->terminated)
+	return CSI_STATUS_SUCCESS;
+
+    bytes = _csi_alloc (ctx, string->len + 1);
+    if (_csi_unlikely (bytes == NULL))
+	return _csi_error (CSI_STATUS_NO_MEMORY);
+
+    memcpy (bytes, string->string, string->len);
+    bytes[string->len] = '\0';
+
+    string->string = bytes;
+    string->terminated = TRUE;
+
+    return CSI_STATUS_SUCCESS;
+}
+
 csi_status_t
 csi_string_new_from_bytes (csi_t *ctx,
 	                   csi_object_t *obj,
@@ -561,6 +620,8 @@ csi_string_new_from_bytes (csi_t *ctx,
     string->len = len;
     string->deflate = 0;
     string->method = NONE;
+    string->mapping = NULL;
+    string->terminated = FALSE;
 
     string->base.type = CSI_OBJECT_TYPE_STRING;
     string->base.ref = 1;
@@ -593,6 +654,14 @@ _csi_string_execute (csi_t *ctx, csi_string_t *string)
 void
 csi_string_free (csi_t *ctx, csi_string_t *string)
 {
+    if (string->mapping != NULL) {
+	if (string->terminated)
+	    _csi_free (ctx, string->string);
+	_csi_mapping_destroy (ctx, string->mapping);
+	_csi_slab_free (ctx, string, sizeof (csi_string_t));
+	return;
+    }
+
 #if CSI_DEBUG_MALLOC
     _csi_free (ctx, string->string);
     _csi_slab_free (ctx, string, sizeof (csi_string_t));
@@ -158,6 +158,24 @@ _csi_blob_hash (csi_blob_t *blob, const uint32_t *data, int len)
     blob->hash = hash;
 }
 
+/* as above, for words that may be unaligned, such as a mapped string */
+static void
+_csi_blob_hash_bytes (csi_blob_t *blob, const void *data, int len)
+{
+    const uint8_t *bytes = data;
+    unsigned long hash = blob->hash;
+
+    while (len--) {
+	uint32_t c;
+
+	memcpy (&c, bytes, sizeof (c));
+	bytes += sizeof (c);
+	hash *= 33;
+	hash ^= c;
+    }
+    blob->hash = hash;
+}
+
 static csi_boolean_t
 _csi_blob_equal (const csi_list_t *link, void *data)
 {
@@ -378,6 +396,9 @@ _csi_ostack_get_scaled_font (csi_t *ctx, unsigned int i,
     return CSI_STATUS_SUCCESS;
 }
 
+static csi_status_t
+_image_realize (csi_t *ctx, cairo_surface_t *surface);
+
 static csi_status_t
 _csi_ostack_get_surface (csi_t *ctx, unsigned int i, cairo_surface_t **out)
 {
@@ -392,7 +413,7 @@ _csi_ostack_get_surface (csi_t *ctx, unsigned int i, cairo_surface_t **out)
 	break;
     case CSI_OBJECT_TYPE_SURFACE:
 	*out = obj->datum.surface;
-	break;
+	return _image_realize (ctx, obj->datum.surface);
     default:
 	return _csi_error (CSI_STATUS_INVALID_SCRIPT);
     }
@@ -547,10 +568,24 @@ _csi_ostack_get_string (csi_t *ctx, unsigned int i, csi_string_t **out)
     return CSI_STATUS_SUCCESS;
 }
 
+/* as above, for strings that are passed on as nul-terminated C strings */
+static csi_status_t
+_csi_ostack_get_c_string (csi_t *ctx, unsigned int i, csi_string_t **out)
+{
+    csi_status_t status;
+
+    status = _csi_ostack_get_string (ctx, i, out);
+    if (_csi_unlikely (status))
+	return status;
+
+    return csi_string_terminate (ctx, *out);
+}
+
 static csi_status_t
 _csi_ostack_get_string_constant (csi_t *ctx, unsigned int i, const char **out)
 {
     csi_object_t *obj;
+    csi_status_t status;
     int type;
 
     obj = _csi_peek_ostack (ctx, i);
@@ -560,6 +595,9 @@ _csi_ostack_get_string_constant (csi_t *ctx, unsigned int i, const char **out)
 	*out = (const char *) obj->datum.name;
 	break;
     case CSI_OBJECT_TYPE_STRING:
+	status = csi_string_terminate (ctx, obj->datum.string);
+	if (_csi_unlikely (status))
+	    return status;
 	*out = obj->datum.string->string;
 	break;
     default:
@@ -1819,7 +1857,7 @@ _ft_create_for_source (csi_t *ctx,
     /* check for an existing FT_Face (kept alive by the font cache) */
     /* XXX index/flags */
     _csi_blob_init (&tmpl, (uint8_t *) source->string, source->len);
-    _csi_blob_hash (&tmpl, (uint32_t *) source->string, source->len / sizeof (uint32_t));
+    _csi_blob_hash_bytes (&tmpl, source->string, source->len / sizeof (uint32_t));
     link = _csi_list_find (ctx->_faces, _csi_blob_equal, &tmpl);
     if (link) {
 	if (--source->base.ref == 0)
@@ -1929,7 +1967,7 @@ _ft_create_for_pattern (csi_t *ctx,
     void *bytes;
 
     _csi_blob_init (&tmpl, (uint8_t *) string->string, string->len);
-    _csi_blob_hash (&tmpl, (uint32_t *) string->string, string->len / sizeof (uint32_t));
+    _csi_blob_hash_bytes (&tmpl, string->string, string->len / sizeof (uint32_t));
     link = _csi_list_find (ctx->_faces, _csi_blob_equal, &tmpl);
     if (link) {
 	if (--string->base.ref == 0)
@@ -2174,8 +2212,13 @@ _ft_fallback_create_for_pattern (csi_t *ctx,
 				 csi_string_t *string,
 				 cairo_font_face_t **font_face_out)
 {
+    csi_status_t status;
     char *str, *name;
 
+    status = csi_string_terminate (ctx, string);
+    if (_csi_unlikely (status))
+	return status;
+
     str = string->string;
 #if 0
     name = strstr (str, "fullname=");
@@ -2906,29 +2949,20 @@ _ifelse (csi_t *ctx)
 }
 
 static csi_status_t
-_image_read_raw (csi_t *ctx,
-		 csi_object_t *src,
-		 cairo_format_t format,
-		 int width, int height,
-		 cairo_surface_t **image_out)
+_image_create_raw (csi_t *ctx,
+		   cairo_format_t format,
+		   int width, int height,
+		   cairo_surface_t **image_out)
 {
     cairo_surface_t *image;
-    uint8_t *bp, *data;
-    int rem, len, ret, x, rowlen, instride, stride;
+    uint8_t *data;
+    int stride;
     cairo_status_t status;
 
-    if (width == 0 || height == 0) {
-	*image_out = cairo_image_surface_create (format, 0, 0);
-	return CSI_STATUS_SUCCESS;
-    }
-
     if (ctx->hooks.create_source_image != NULL) {
 	image = ctx->hooks.create_source_image (ctx->hooks.closure,
 						format, width, height,
 						0);
-
-	stride = cairo_image_surface_get_stride (image);
-	data = cairo_image_surface_get_data (image);
     } else {
 	stride = cairo_format_stride_for_width (format, width);
 	data = malloc (stride * height);
@@ -2947,6 +2981,25 @@ _image_read_raw (csi_t *ctx,
 	}
     }
 
+    *image_out = image;
+    return CSI_STATUS_SUCCESS;
+}
+
+/* Decode the raw pixels from src into an image of the given size */
+static csi_status_t
+_image_fill_raw (csi_t *ctx,
+		 csi_object_t *src,
+		 cairo_format_t format,
+		 int width, int height,
+		 cairo_surface_t *image)
+{
+    uint8_t *bp, *data;
+    int rem, len, ret, x, rowlen, instride, stride;
+    cairo_status_t status;
+
+    stride = cairo_image_surface_get_stride (image);
+    data = cairo_image_surface_get_data (image);
+
     switch (format) {
     case CAIRO_FORMAT_A1:
 	instride = rowlen = (width+7)/8;
@@ -2987,7 +3040,6 @@ _image_read_raw (csi_t *ctx,
 	default:
 	case NONE:
 err_decompress:
-	    cairo_surface_destroy (image);
 	    return _csi_error (CSI_STATUS_READ_ERROR);
 
 	case ZLIB:
@@ -3013,17 +3065,15 @@ err_decompress:
 	csi_object_t file;
 
 	status = csi_object_as_file (ctx, src, &file);
-	if (_csi_unlikely (status)) {
-	    cairo_surface_destroy (image);
+	if (_csi_unlikely (status))
 	    return status;
-	}
 
 	bp = data;
 	rem = len;
 	while (rem) {
 	    ret = csi_file_read (file.datum.file, bp, rem);
 	    if (_csi_unlikely (ret == 0)) {
-		cairo_surface_destroy (image);
+		csi_object_free (ctx, &file);
 		return _csi_error (CSI_STATUS_READ_ERROR);
 	    }
 	    rem -= ret;
@@ -3215,6 +3265,34 @@ err_decompress:
     }
 
     cairo_surface_mark_dirty (image);
+    return CSI_STATUS_SUCCESS;
+}
+
+static csi_status_t
+_image_read_raw (csi_t *ctx,
+		 csi_object_t *src,
+		 cairo_format_t format,
+		 int width, int height,
+		 cairo_surface_t **image_out)
+{
+    cairo_surface_t *image;
+    csi_status_t status;
+
+    if (width == 0 || height == 0) {
+	*image_out = cairo_image_surface_create (format, 0, 0);
+	return CSI_STATUS_SUCCESS;
+    }
+
+    status = _image_create_raw (ctx, format, width, height, &image);
+    if (_csi_unlikely (status))
+	return status;
+
+    status = _image_fill_raw (ctx, src, format, width, height, image);
+    if (_csi_unlikely (status)) {
+	cairo_surface_destroy (image);
+	return status;
+    }
+
     *image_out = image;
     return CSI_STATUS_SUCCESS;
 }
@@ -3320,6 +3398,176 @@ _image_cached (csi_t *ctx, cairo_surface_t *surface)
     return surface;
 }
 
+/* Images decoded from a string are only filled in when first used.
+ *
+ * Large traces carry many images that are never, or only much later,
+ * drawn, and the string is usually a compressed blob referenced straight
+ * from the mapped trace.  Keeping hold of the string also lets us spot
+ * repeated images by their (much smaller) encoding, without having to
+ * decode them first.
+ */
+struct _image_source_tag {
+    csi_t *ctx;
+    csi_list_t list;
+    csi_object_t source;
+    cairo_format_t format;
+    int width, height;
+    unsigned long hash;
+    cairo_surface_t *surface;
+    csi_boolean_t pending;
+};
+
+static const cairo_user_data_key_t _image_source_key;
+
+static void
+_image_source_tag_done (void *closure)
+{
+    struct _image_source_tag *tag = closure;
+    csi_t *ctx = tag->ctx;
+
+    ctx->_image_sources = _csi_list_unlink (ctx->_image_sources, &tag->list);
+    csi_object_free (ctx, &tag->source);
+    _csi_slab_free (ctx, tag, sizeof (*tag));
+    cairo_script_interpreter_destroy (ctx);
+}
+
+static csi_boolean_t
+_image_source_equal (const csi_list_t *link, void *data)
+{
+    struct _image_source_tag *a, *b;
+    csi_string_t *sa, *sb;
+
+    a = csi_container_of (link, struct _image_source_tag, list);
+    b = data;
+
+    if (a->hash != b->hash)
+	return FALSE;
+
+    if (a->format != b->format ||
+	a->width != b->width ||
+	a->height != b->height)
+    {
+	return FALSE;
+    }
+
+    sa = a->source.datum.string;
+    sb = b->source.datum.string;
+    if (sa == sb)
+	return TRUE;
+
+    return sa->len == sb->len &&
+	   sa->deflate == sb->deflate &&
+	   sa->method == sb->method &&
+	   memcmp (sa->string, sb->string, sa->len) == 0;
+}
+
+static unsigned long
+_image_source_hash (const struct _image_source_tag *tag)
+{
+    const csi_string_t *string = tag->source.datum.string;
+    csi_blob_t blob;
+    uint32_t value[5];
+    int len;
+
+    _csi_blob_init (&blob, NULL, 0);
+
+    value[0] = tag->format;
+    value[1] = tag->width;
+    value[2] = tag->height;
+    value[3] = string->len;
+    value[4] = string->deflate;
+    _csi_blob_hash (&blob, value, 5);
+
+    /* only sample the start of the source, memcmp() settles the rest */
+    len = string->len / sizeof (uint32_t);
+    if (len > 256)
+	len = 256;
+    _csi_blob_hash_bytes (&blob, string->string, len);
+
+    return blob.hash;
+}
+
+static csi_status_t
+_image_realize (csi_t *ctx, cairo_surface_t *surface)
+{
+    struct _image_source_tag *tag;
+    csi_status_t status;
+
+    tag = cairo_surface_get_user_data (surface, &_image_source_key);
+    if (_csi_likely (tag == NULL || ! tag->pending))
+	return CSI_STATUS_SUCCESS;
+
+    status = _image_fill_raw (ctx, &tag->source,
+			      tag->format, tag->width, tag->height,
+			      surface);
+    if (_csi_unlikely (status))
+	return status;
+
+    tag->pending = FALSE;
+    return CSI_STATUS_SUCCESS;
+}
+
+static csi_status_t
+_image_defer_raw (csi_t *ctx,
+		  csi_object_t *src,
+		  cairo_format_t format,
+		  int width, int height,
+		  cairo_surface_t **image_out)
+{
+    struct _image_source_tag tmpl, *tag;
+    cairo_surface_t *image;
+    csi_list_t *link;
+    csi_status_t status;
+
+    tmpl.source = *src;
+    tmpl.format = format;
+    tmpl.width = width;
+    tmpl.height = height;
+    tmpl.hash = _image_source_hash (&tmpl);
+
+    link = _csi_list_find (ctx->_image_sources, _image_source_equal, &tmpl);
+    if (link) {
+	tag = csi_container_of (link, struct _image_source_tag, list);
+	*image_out = cairo_surface_reference (tag->surface);
+	return CSI_STATUS_SUCCESS;
+    }
+
+    status = _image_create_raw (ctx, format, width, height, &image);
+    if (_csi_unlikely (status))
+	return status;
+
+    tag = _csi_slab_alloc (ctx, sizeof (struct _image_source_tag));
+    if (_csi_unlikely (tag == NULL))
+	goto DECODE;
+
+    *tag = tmpl;
+    tag->ctx = cairo_script_interpreter_reference (ctx);
+    tag->source = *csi_object_reference (src);
+    tag->surface = image;
+    tag->pending = TRUE;
+    ctx->_image_sources = _csi_list_prepend (ctx->_image_sources, &tag->list);
+
+    if (cairo_surface_set_user_data (image, &_image_source_key,
+				     tag, _image_source_tag_done))
+    {
+	_image_source_tag_done (tag);
+	goto DECODE;
+    }
+
+    *image_out = image;
+    return CSI_STATUS_SUCCESS;
+
+DECODE:
+    status = _image_fill_raw (ctx, src, format, width, height, image);
+    if (_csi_unlikely (status)) {
+	cairo_surface_destroy (image);
+	return status;
+    }
+
+    *image_out = _image_cached (ctx, image);
+    return CSI_STATUS_SUCCESS;
+}
+
 static csi_status_t
 _image_load_from_dictionary (csi_t *ctx,
 			     csi_dictionary_t *dict,
@@ -3375,6 +3623,9 @@ _image_load_from_dictionary (csi_t *ctx,
 	    type = csi_object_get_type (&type_obj);
 	    switch (type) {
 	    case CSI_OBJECT_TYPE_STRING:
+		status = csi_string_terminate (ctx, type_obj.datum.string);
+		if (_csi_unlikely (status))
+		    return status;
 		type_str = type_obj.datum.string->string;
 		break;
 	    case CSI_OBJECT_TYPE_NAME:
@@ -3393,6 +3644,19 @@ _image_load_from_dictionary (csi_t *ctx,
 
 	switch (mime_type) {
 	case MIME_TYPE_NONE:
+	    if (csi_object_get_type (&obj) == CSI_OBJECT_TYPE_STRING &&
+		width > 0 && height > 0)
+	    {
+		status = _image_defer_raw (ctx, &obj,
+					   format, width, height,
+					   &image);
+		if (_csi_unlikely (status))
+		    return status;
+
+		*image_out = image;
+		return CSI_STATUS_SUCCESS;
+	    }
+
 	    status = _image_read_raw (ctx, &obj, format, width, height, &image);
 	    break;
 	case MIME_TYPE_PNG:
@@ -4662,7 +4926,7 @@ _select_font_face (csi_t *ctx)
     status = _csi_ostack_get_integer (ctx, 1, &slant);
     if (_csi_unlikely (status))
 	return status;
-    status = _csi_ostack_get_string (ctx, 2, &family);
+    status = _csi_ostack_get_c_string (ctx, 2, &family);
     if (_csi_unlikely (status))
 	return status;
     status = _csi_ostack_get_context (ctx, 3, &cr);
@@ -5756,7 +6020,7 @@ _show_text (csi_t *ctx)
 
     check (2);
 
-    status = _csi_ostack_get_string (ctx, 0, &text);
+    status = _csi_ostack_get_c_string (ctx, 0, &text);
     if (_csi_unlikely (status))
 	return status;
     status = _csi_ostack_get_context (ctx, 1, &cr);
@@ -6238,7 +6502,7 @@ _text_path (csi_t *ctx)
 
     check (2);
 
-    status = _csi_ostack_get_string (ctx, 0, &text);
+    status = _csi_ostack_get_c_string (ctx, 0, &text);
     if (_csi_unlikely (status))
 	return status;
     status = _csi_ostack_get_context (ctx, 1, &cr);
@@ -6309,7 +6573,7 @@ _write_to_png (csi_t *ctx)
 
     check (2);
 
-    status = _csi_ostack_get_string (ctx, 0, &filename);
+    status = _csi_ostack_get_c_string (ctx, 0, &filename);
     if (_csi_unlikely (status))
 	return status;
     status = _csi_ostack_get_surface (ctx, 1, &surface);
@@ -6337,7 +6601,7 @@ _write_to_script (csi_t *ctx)
 
     check (2);
 
-    status = _csi_ostack_get_string (ctx, 0, &filename);
+    status = _csi_ostack_get_c_string (ctx, 0, &filename);
     if (_csi_unlikely (status))
 	return status;
     status = _csi_ostack_get_surface (ctx, 1, &record);
@@ -6445,7 +6709,8 @@ _debug_print (csi_t *ctx)
 		 obj->datum.matrix->matrix.y0);
 	break;
     case CSI_OBJECT_TYPE_STRING:
-	fprintf (stderr, "string: %s\n", obj->datum.string->string);
+	fprintf (stderr, "string: %.*s\n",
+		 (int) obj->datum.string->len, obj->datum.string->string);
 	break;
 
 	/* cairo */
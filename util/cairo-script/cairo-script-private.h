@@ -296,6 +296,7 @@ typedef struct _csi_hash_entry csi_hash_entry_t;
 typedef struct _csi_hash_table csi_hash_table_t;
 typedef struct _csi_hash_table_arrangement csi_hash_table_arrangement_t;
 typedef struct _csi_list csi_list_t;
+typedef struct _csi_mapping csi_mapping_t;
 typedef struct _csi_matrix csi_matrix_t;
 typedef struct _csi_object csi_object_t;
 typedef struct _csi_scanner csi_scanner_t;
@@ -408,6 +409,19 @@ struct _csi_string {
 	LZO,
     } method;
     char *string;
+    /* if set, the string holds a reference on the mapping and, unless it
+     * has been terminated, string points into it and is not nul-terminated */
+    csi_mapping_t *mapping;
+    csi_boolean_t terminated;
+};
+
+/* a script file mapped into memory, shared by the file and its strings */
+#define CSI_MAPPED_STRING_MIN 4096 /* smaller strings are still copied */
+
+struct _csi_mapping {
+    int ref;
+    void *data;
+    size_t length;
 };
 
 typedef struct _csi_filter_funcs {
@@ -431,6 +445,7 @@ struct _csi_file {
     uint8_t *bp;
     int rem;
     const csi_filter_funcs_t *filter;
+    csi_mapping_t *mapping;
 };
 
 union _csi_union_object {
@@ -499,6 +514,7 @@ struct _cairo_script_interpreter {
 
     /* caches of live data */
     csi_list_t *_images;
+    csi_list_t *_image_sources;
     csi_list_t *_faces;
 };
 
@@ -517,6 +533,23 @@ typedef struct _csi_real_constant_def {
     csi_real_t value;
 } csi_real_constant_def_t;
 
+/* cairo-script-bytecode.c */
+
+csi_private csi_status_t
+_csi_compile_file (csi_t *ctx,
+		   csi_file_t *file,
+		   cairo_write_func_t write_func,
+		   void *closure);
+
+csi_private csi_status_t
+_csi_bytecode_execute (csi_t *ctx,
+		       const uint8_t *data,
+		       unsigned long length,
+		       csi_mapping_t *mapping);
+
+csi_private csi_status_t
+_csi_build_operator_names (csi_t *ctx, csi_dictionary_t **out);
+
 /* cairo-script-file.c */
 
 csi_private csi_status_t
@@ -555,6 +588,12 @@ csi_file_new_deflate_decode (csi_t *ctx,
 csi_private csi_status_t
 _csi_file_execute (csi_t *ctx, csi_file_t *obj);
 
+csi_private csi_mapping_t *
+_csi_mapping_reference (csi_mapping_t *mapping);
+
+csi_private void
+_csi_mapping_destroy (csi_t *ctx, csi_mapping_t *mapping);
+
 csi_private int
 csi_file_getc (csi_file_t *obj);
 
@@ -784,6 +823,16 @@ csi_string_deflate_new (csi_t *ctx,
 			int in_len,
 			int out_len);
 
+csi_private csi_status_t
+csi_string_new_for_mapping (csi_t *ctx,
+			    csi_object_t *obj,
+			    csi_mapping_t *mapping,
+			    const char *bytes,
+			    int len);
+
+csi_private csi_status_t
+csi_string_terminate (csi_t *ctx, csi_string_t *string);
+
 csi_private csi_status_t
 csi_string_new_from_bytes (csi_t *ctx,
 	                   csi_object_t *obj,
@@ -842,6 +891,12 @@ _csi_translate_file (csi_t *ctx,
 		     cairo_write_func_t write_func,
 		     void *closure);
 
+csi_private csi_status_t
+_csi_untranslate_file (csi_t *ctx,
+		       csi_file_t *file,
+		       cairo_write_func_t write_func,
+		       void *closure);
+
 csi_private void
 _csi_scanner_fini (csi_t *ctx, csi_scanner_t *scanner);
 
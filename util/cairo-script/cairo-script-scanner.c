@@ -798,21 +798,96 @@ string_read (csi_t *ctx,
 	     csi_object_t *obj)
 {
     csi_status_t status;
+    uint32_t deflate = 0;
 
-    status = csi_string_new (ctx, obj, NULL, len);
-    if (_csi_unlikely (status))
-	longjmp (scan->jump_buffer, status);
+    if (compressed) {
+	scan_read (scan, src, &deflate, 4);
+	deflate = be32 (deflate);
+    }
+
+    if (src->mapping != NULL &&
+	len >= CSI_MAPPED_STRING_MIN && src->rem >= len)
+    {
+	/* reference large blobs in place rather than copying them */
+	status = csi_string_new_for_mapping (ctx, obj, src->mapping,
+					     (const char *) src->bp, len);
+	if (_csi_unlikely (status))
+	    longjmp (scan->jump_buffer, status);
+
+	src->bp += len;
+	src->rem -= len;
+    } else {
+	status = csi_string_new (ctx, obj, NULL, len);
+	if (_csi_unlikely (status))
+	    longjmp (scan->jump_buffer, status);
+
+	if (_csi_likely (len))
+	    scan_read (scan, src, obj->datum.string->string, len);
+	obj->datum.string->string[len] = '\0';
+    }
 
     if (compressed) {
-	uint32_t u32;
-	scan_read (scan, src, &u32, 4);
-	obj->datum.string->deflate = be32 (u32);
+	obj->datum.string->deflate = deflate;
 	obj->datum.string->method = compressed;
     }
+}
 
-    if (_csi_likely (len))
-	scan_read (scan, src, obj->datum.string->string, len);
-    obj->datum.string->string[len] = '\0';
+static void
+bytecode_execute (csi_t *ctx, csi_scanner_t *scan, csi_file_t *src)
+{
+    csi_status_t status;
+    uint8_t *data;
+    int len, size, ret;
+
+    /* A compiled script is only ever found in place of an entire file,
+     * see cairo-script-bytecode.c, so slurp the rest and hand it over.
+     */
+    if (_csi_unlikely (scan->bind ||
+		       scan->build_procedure.type != CSI_OBJECT_TYPE_NULL))
+    {
+	longjmp (scan->jump_buffer, _csi_error (CSI_STATUS_INVALID_SCRIPT));
+    }
+
+    /* execute straight out of a mapped file, the magic byte included */
+    if (src->mapping != NULL) {
+	status = _csi_bytecode_execute (ctx, src->bp - 1, src->rem + 1,
+					src->mapping);
+	src->bp += src->rem;
+	src->rem = 0;
+	if (_csi_unlikely (status))
+	    longjmp (scan->jump_buffer, status);
+	return;
+    }
+
+    size = 8192;
+    data = _csi_alloc (ctx, size);
+    if (_csi_unlikely (data == NULL))
+	longjmp (scan->jump_buffer, _csi_error (CSI_STATUS_NO_MEMORY));
+
+    data[0] = 159;
+    len = 1;
+    while ((ret = csi_file_read (src, data + len, size - len)) > 0) {
+	len += ret;
+	if (len == size) {
+	    uint8_t *new_data;
+
+	    new_data = NULL;
+	    if (_csi_likely (size < INT_MAX / 2))
+		new_data = _csi_realloc (ctx, data, 2 * size);
+	    if (_csi_unlikely (new_data == NULL)) {
+		_csi_free (ctx, data);
+		longjmp (scan->jump_buffer, _csi_error (CSI_STATUS_NO_MEMORY));
+	    }
+
+	    data = new_data;
+	    size *= 2;
+	}
+    }
+
+    status = _csi_bytecode_execute (ctx, data, len, NULL);
+    _csi_free (ctx, data);
+    if (_csi_unlikely (status))
+	longjmp (scan->jump_buffer, status);
 }
 
 static void
@@ -1009,12 +1084,16 @@ scan_none:
 	    string_read (ctx, scan, src, be32 (u.u32), LZO, &obj);
 	    break;
 
+#define BYTECODE 159
+	case BYTECODE:
+	    bytecode_execute (ctx, scan, src);
+	    break;
+
 	    /* unassigned */
 	case 155:
 	case 156:
 	case 157:
 	case 158:
-	case 159:
 	    longjmp (scan->jump_buffer, _csi_error (CSI_STATUS_INVALID_SCRIPT));
 
 	case '#': /* PDF 1.2 escape code */
@@ -1902,3 +1981,273 @@ _csi_translate_file (csi_t *ctx,
 
     return CSI_STATUS_SUCCESS;
 }
+
+struct _untranslate_closure {
+    csi_dictionary_t *names;
+    cairo_write_func_t write_func;
+    void *closure;
+};
+
+static void
+_untranslate_write (csi_t *ctx,
+		    struct _untranslate_closure *closure,
+		    const char *data,
+		    int length)
+{
+    csi_status_t status;
+
+    status = closure->write_func (closure->closure,
+				  (const unsigned char *) data, length);
+    if (_csi_unlikely (status))
+	longjmp (ctx->scanner.jump_buffer, status);
+}
+
+static void
+_untranslate_base85 (csi_t *ctx,
+		     struct _untranslate_closure *closure,
+		     const uint8_t *data,
+		     unsigned long length)
+{
+    char buf[5*64];
+    int len = 0;
+
+    while (length) {
+	uint8_t four_tuple[4] = { 0, 0, 0, 0 };
+	uint32_t value;
+	int n, count;
+
+	count = length < 4 ? length : 4;
+	memcpy (four_tuple, data, count);
+	data += count;
+	length -= count;
+
+	value = four_tuple[0] << 24 | four_tuple[1] << 16 |
+		four_tuple[2] << 8 | four_tuple[3];
+	if (value == 0 && count == 4) {
+	    buf[len++] = 'z';
+	} else {
+	    for (n = 4; n >= 0; n--) {
+		buf[len + n] = value % 85 + '!';
+		value /= 85;
+	    }
+	    len += count + 1;
+	}
+
+	if (len > (int) sizeof (buf) - 5) {
+	    _untranslate_write (ctx, closure, buf, len);
+	    len = 0;
+	}
+    }
+
+    _untranslate_write (ctx, closure, buf, len);
+}
+
+static void
+_untranslate_string (csi_t *ctx,
+		     csi_string_t *string,
+		     struct _untranslate_closure *closure)
+{
+    char buf[256];
+    int n, len;
+
+    if (string->method == ZLIB) {
+	uint32_t u32 = to_be32 (string->deflate);
+
+	/* <| carries the inflated length ahead of the zlib data */
+	_untranslate_write (ctx, closure, "<|", 2);
+	_untranslate_base85 (ctx, closure, (uint8_t *) &u32, 4);
+	_untranslate_base85 (ctx, closure,
+			     (uint8_t *) string->string, string->len);
+	_untranslate_write (ctx, closure, "~> ", 3);
+	return;
+    }
+
+    if (_csi_unlikely (string->method != NONE))
+	longjmp (ctx->scanner.jump_buffer,
+		 _csi_error (CSI_STATUS_INVALID_SCRIPT));
+
+    for (n = 0; n < string->len; n++) {
+	uint8_t c = string->string[n];
+	if (c >= 0x7f || (c < 0x20 && c != '\n'))
+	    break;
+    }
+    if (n < string->len) {
+	_untranslate_write (ctx, closure, "<~", 2);
+	_untranslate_base85 (ctx, closure,
+			     (uint8_t *) string->string, string->len);
+	_untranslate_write (ctx, closure, "~> ", 3);
+	return;
+    }
+
+    len = 0;
+    buf[len++] = '(';
+    for (n = 0; n < string->len; n++) {
+	char c = string->string[n];
+
+	if (len > (int) sizeof (buf) - 4) {
+	    _untranslate_write (ctx, closure, buf, len);
+	    len = 0;
+	}
+
+	switch (c) {
+	case '\n':
+	    buf[len++] = '\\';
+	    buf[len++] = 'n';
+	    break;
+	case '\\':
+	case '(':
+	case ')':
+	    buf[len++] = '\\';
+	    /* fall-through */
+	default:
+	    buf[len++] = c;
+	    break;
+	}
+    }
+    buf[len++] = ')';
+    buf[len++] = ' ';
+    _untranslate_write (ctx, closure, buf, len);
+}
+
+static void
+_untranslate_real (csi_t *ctx,
+		   csi_real_t real,
+		   struct _untranslate_closure *closure)
+{
+    char buf[64];
+    int precision, len;
+
+    /* use the shortest form that reads back as the same float */
+    for (precision = 6; precision < 9; precision++) {
+	len = snprintf (buf, sizeof (buf), "%.*g ", precision, real);
+	if ((csi_real_t) strtod (buf, NULL) == real)
+	    break;
+    }
+    if (precision == 9)
+	len = snprintf (buf, sizeof (buf), "%.9g ", real);
+
+    _untranslate_write (ctx, closure, buf, len);
+}
+
+static csi_status_t
+_untranslate_object (csi_t *ctx, csi_object_t *obj, csi_boolean_t executable)
+{
+    struct _untranslate_closure *closure = ctx->scanner.closure;
+    csi_dictionary_entry_t *entry;
+    const char *name;
+    char buf[64];
+    int len;
+
+    switch (csi_object_get_type (obj)) {
+    case CSI_OBJECT_TYPE_NAME:
+	name = (const char *) obj->datum.name;
+	if (! executable)
+	    _untranslate_write (ctx, closure, "/", 1);
+	_untranslate_write (ctx, closure, name, strlen (name));
+	_untranslate_write (ctx, closure, executable ? "\n" : " ", 1);
+	break;
+
+    case CSI_OBJECT_TYPE_OPERATOR:
+	entry = _csi_hash_table_lookup (&closure->names->hash_table,
+					(csi_hash_entry_t *) &obj->datum.op);
+	if (_csi_unlikely (entry == NULL))
+	    longjmp (ctx->scanner.jump_buffer,
+		     _csi_error (CSI_STATUS_INVALID_SCRIPT));
+
+	name = (const char *) entry->value.datum.name;
+	if (! executable)
+	    _untranslate_write (ctx, closure, "//", 2);
+	_untranslate_write (ctx, closure, name, strlen (name));
+	_untranslate_write (ctx, closure, executable ? "\n" : " ", 1);
+	break;
+
+    case CSI_OBJECT_TYPE_INTEGER:
+	len = snprintf (buf, sizeof (buf), "%ld ", obj->datum.integer);
+	_untranslate_write (ctx, closure, buf, len);
+	break;
+
+    case CSI_OBJECT_TYPE_REAL:
+	_untranslate_real (ctx, obj->datum.real, closure);
+	break;
+
+    case CSI_OBJECT_TYPE_BOOLEAN:
+	if (obj->datum.boolean)
+	    _untranslate_write (ctx, closure, "true ", 5);
+	else
+	    _untranslate_write (ctx, closure, "false ", 6);
+	break;
+
+    case CSI_OBJECT_TYPE_NULL:
+	_untranslate_write (ctx, closure, "null ", 5);
+	break;
+
+    case CSI_OBJECT_TYPE_STRING:
+	_untranslate_string (ctx, obj->datum.string, closure);
+	break;
+
+    case CSI_OBJECT_TYPE_MARK:
+    case CSI_OBJECT_TYPE_ARRAY:
+    case CSI_OBJECT_TYPE_DICTIONARY:
+    case CSI_OBJECT_TYPE_FILE:
+    case CSI_OBJECT_TYPE_MATRIX:
+    case CSI_OBJECT_TYPE_CONTEXT:
+    case CSI_OBJECT_TYPE_FONT:
+    case CSI_OBJECT_TYPE_PATTERN:
+    case CSI_OBJECT_TYPE_SCALED_FONT:
+    case CSI_OBJECT_TYPE_SURFACE:
+	longjmp (ctx->scanner.jump_buffer,  _csi_error (CSI_STATUS_INVALID_SCRIPT));
+	break;
+    }
+
+    return CSI_STATUS_SUCCESS;
+}
+
+static csi_status_t
+_untranslate_push (csi_t *ctx, csi_object_t *obj)
+{
+    _untranslate_object (ctx, obj, FALSE);
+    csi_object_free (ctx, obj);
+    return CSI_STATUS_SUCCESS;
+}
+
+static csi_status_t
+_untranslate_execute (csi_t *ctx, csi_object_t *obj)
+{
+    return _untranslate_object (ctx, obj, TRUE);
+}
+
+csi_status_t
+_csi_untranslate_file (csi_t *ctx,
+		       csi_file_t *file,
+		       cairo_write_func_t write_func,
+		       void *closure)
+{
+    csi_status_t status;
+    struct _untranslate_closure printer;
+
+    status = _csi_build_operator_names (ctx, &printer.names);
+    if (_csi_unlikely (status))
+	return status;
+
+    if ((status = setjmp (ctx->scanner.jump_buffer)))
+	goto BAIL;
+
+    printer.write_func = write_func;
+    printer.closure = closure;
+    ctx->scanner.closure = &printer;
+
+    ctx->scanner.bind = 1;
+    ctx->scanner.push = _untranslate_push;
+    ctx->scanner.execute = _untranslate_execute;
+
+    _scan_file (ctx, file);
+
+BAIL:
+    ctx->scanner.bind = 0;
+    ctx->scanner.push = _scan_push;
+    ctx->scanner.execute = _scan_execute;
+
+    csi_dictionary_free (ctx, printer.names);
+
+    return status;
+}
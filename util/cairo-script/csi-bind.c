@@ -39,6 +39,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 static cairo_status_t
 write_func (void *closure,
@@ -55,9 +56,24 @@ int
 main (int argc, char **argv)
 {
     FILE *in = stdin, *out = stdout;
+    cairo_status_t (*translate) (FILE *, cairo_write_func_t, void *);
     cairo_status_t status;
     int i;
 
+    /* -c produces a compiled script rather than binary tokens,
+     * -t converts binary tokens (such as a binary trace) back to text
+     */
+    translate = cairo_script_interpreter_translate_stream;
+    if (argc > 1 && strcmp (argv[1], "-c") == 0) {
+	translate = cairo_script_interpreter_compile_stream;
+	argv++;
+	argc--;
+    } else if (argc > 1 && strcmp (argv[1], "-t") == 0) {
+	translate = cairo_script_interpreter_untranslate_stream;
+	argv++;
+	argc--;
+    }
+
     if (argc >= 3) {
 	if (strcmp (argv[argc-1], "-")) {
 	    out = fopen (argv[argc-1], "w");
@@ -76,7 +92,7 @@ main (int argc, char **argv)
 		return 1;
 	    }
 
-	    status = cairo_script_interpreter_translate_stream (in, write_func, out);
+	    status = translate (in, write_func, out);
 	    fclose (in);
 
 	    if (status)
@@ -93,7 +109,7 @@ main (int argc, char **argv)
 	    }
 	}
 
-	status = cairo_script_interpreter_translate_stream (in, write_func, out);
+	status = translate (in, write_func, out);
 
 	if (in != stdin)
 	    fclose (in);
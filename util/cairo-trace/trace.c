@@ -209,6 +209,8 @@ static cairo_bool_t _flush;
 static cairo_bool_t _error;
 static cairo_bool_t _line_info;
 static cairo_bool_t _mark_dirty;
+static cairo_bool_t _binary;
+static cairo_bool_t _async;
 static const cairo_user_data_key_t destroy_key;
 static pthread_once_t once_control = PTHREAD_ONCE_INIT;
 static pthread_key_t counter_key;
@@ -493,10 +495,219 @@ _init_trace (void)
     _type_create ("cairo_surface_t", SURFACE, "s");
 }
 
+/* With CAIRO_TRACE_ASYNC the traced threads only copy into a small pool
+ * of buffers, and a separate thread hands the full buffers to the kernel.
+ * Once every buffer is in flight, tracing blocks until one is returned,
+ * so a slow disk throttles the application instead of losing data.
+ */
+#define WRITE_BUFFER_SIZE (256 * 1024)
+#define WRITE_BUFFER_MAX 16
+
+struct _write_buffer {
+    struct _write_buffer *next;
+    size_t length;
+    unsigned char data[WRITE_BUFFER_SIZE];
+};
+
+static struct _writer {
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t pending_cond;
+    pthread_cond_t free_cond;
+    struct _write_buffer *current;
+    struct _write_buffer *pending, **pending_tail;
+    struct _write_buffer *free;
+    int num_buffers;
+    cairo_bool_t finish;
+} Writer = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .pending_cond = PTHREAD_COND_INITIALIZER,
+    .free_cond = PTHREAD_COND_INITIALIZER,
+    .pending_tail = &Writer.pending,
+};
+
+static void
+_write_fd (const unsigned char *data, size_t length)
+{
+    int fd = fileno (logfile);
+
+    while (length) {
+	ssize_t ret = write (fd, data, length);
+	if (ret < 0) {
+	    if (errno == EINTR)
+		continue;
+
+	    _error = TRUE;
+	    return;
+	}
+
+	data += ret;
+	length -= ret;
+    }
+}
+
+static void *
+_writer_thread (void *closure)
+{
+    pthread_mutex_lock (&Writer.mutex);
+    for (;;) {
+	struct _write_buffer *list, *b;
+
+	while (Writer.pending == NULL && ! Writer.finish)
+	    pthread_cond_wait (&Writer.pending_cond, &Writer.mutex);
+
+	list = Writer.pending;
+	if (list == NULL)
+	    break;
+
+	Writer.pending = NULL;
+	Writer.pending_tail = &Writer.pending;
+	pthread_mutex_unlock (&Writer.mutex);
+
+	for (b = list; b->next != NULL; b = b->next)
+	    _write_fd (b->data, b->length);
+	_write_fd (b->data, b->length);
+
+	pthread_mutex_lock (&Writer.mutex);
+	b->next = Writer.free;
+	Writer.free = list;
+	pthread_cond_broadcast (&Writer.free_cond);
+    }
+    pthread_mutex_unlock (&Writer.mutex);
+
+    return NULL;
+}
+
+static struct _write_buffer *
+_writer_get_buffer (void)
+{
+    struct _write_buffer *b;
+
+    pthread_mutex_lock (&Writer.mutex);
+    for (;;) {
+	b = Writer.free;
+	if (b != NULL) {
+	    Writer.free = b->next;
+	    break;
+	}
+
+	if (Writer.num_buffers < WRITE_BUFFER_MAX) {
+	    b = malloc (sizeof (struct _write_buffer));
+	    if (b != NULL) {
+		Writer.num_buffers++;
+		break;
+	    }
+	}
+
+	/* nothing in flight to wait for, write through instead */
+	if (Writer.num_buffers == 0)
+	    break;
+
+	pthread_cond_wait (&Writer.free_cond, &Writer.mutex);
+    }
+    pthread_mutex_unlock (&Writer.mutex);
+
+    if (b != NULL)
+	b->length = 0;
+    return b;
+}
+
+static void
+_writer_submit (void)
+{
+    struct _write_buffer *b = Writer.current;
+
+    if (b == NULL || b->length == 0)
+	return;
+
+    Writer.current = NULL;
+
+    pthread_mutex_lock (&Writer.mutex);
+    b->next = NULL;
+    *Writer.pending_tail = b;
+    Writer.pending_tail = &b->next;
+    pthread_cond_signal (&Writer.pending_cond);
+    pthread_mutex_unlock (&Writer.mutex);
+}
+
+static void
+_writer_start (void)
+{
+    if (pthread_create (&Writer.thread, NULL, _writer_thread, NULL)) {
+	fprintf (stderr,
+		 "cairo-trace: Failed to start writer thread, writing synchronously\n");
+	_async = FALSE;
+    }
+}
+
+static void
+_writer_finish (void)
+{
+    struct _write_buffer *b;
+
+    _writer_submit ();
+
+    pthread_mutex_lock (&Writer.mutex);
+    Writer.finish = TRUE;
+    pthread_cond_signal (&Writer.pending_cond);
+    pthread_mutex_unlock (&Writer.mutex);
+
+    pthread_join (Writer.thread, NULL);
+    _async = FALSE;
+
+    while ((b = Writer.free) != NULL) {
+	Writer.free = b->next;
+	free (b);
+    }
+    Writer.num_buffers = 0;
+}
+
+static void
+_trace_write (const void *data, size_t length)
+{
+    const unsigned char *bytes = data;
+
+    if (! _async) {
+	int ret_ignored;
+
+	ret_ignored = fwrite (data, 1, length, logfile);
+	(void) ret_ignored;
+	return;
+    }
+
+    while (length) {
+	struct _write_buffer *b = Writer.current;
+	size_t count;
+
+	if (b == NULL) {
+	    b = Writer.current = _writer_get_buffer ();
+	    if (b == NULL) {
+		_write_fd (bytes, length);
+		return;
+	    }
+	}
+
+	count = WRITE_BUFFER_SIZE - b->length;
+	if (count > length)
+	    count = length;
+
+	memcpy (b->data + b->length, bytes, count);
+	b->length += count;
+	bytes += count;
+	length -= count;
+
+	if (b->length == WRITE_BUFFER_SIZE)
+	    _writer_submit ();
+    }
+}
+
 static void
 _close_trace (void)
 {
     if (logfile != NULL) {
+	if (_async)
+	    _writer_finish ();
+
 	fclose (logfile);
 	logfile = NULL;
     }
@@ -604,6 +815,176 @@ _trace_dtostr (char *buffer, size_t size, double d)
     }
 }
 
+/* The binary tokens understood by the cairo-script scanner, see
+ * util/cairo-script/cairo-script-scanner.c.  CAIRO_TRACE_BINARY writes
+ * numbers, strings and image data using these in native byte order,
+ * which avoids all of the formatting above and the base85 expansion of
+ * the data.  The result is still a valid script and csi-bind -t turns it
+ * back into text.
+ */
+#define BINARY_INT8 128
+#define BINARY_UINT8 129
+#define BINARY_STRING_1 142
+#define BINARY_STRING_DEFLATE 1
+#if WORDS_BIGENDIAN
+#define BINARY_INT16 130
+#define BINARY_UINT16 131
+#define BINARY_INT32 132
+#define BINARY_FLOAT32 140
+#define BINARY_STRING_2 144
+#define BINARY_STRING_4 148
+#else
+#define BINARY_INT16 133
+#define BINARY_UINT16 134
+#define BINARY_INT32 135
+#define BINARY_FLOAT32 141
+#define BINARY_STRING_2 146
+#define BINARY_STRING_4 150
+#endif
+
+/* A binary token may contain a newline, so none may be written within
+ * a comment, nor may one be glued to the end of a preceding name.
+ */
+static cairo_bool_t _comment;
+static int _last_char = '\n';
+
+static cairo_bool_t
+_can_emit_binary (void)
+{
+    if (! _binary || _comment)
+	return FALSE;
+
+    switch (_last_char) {
+    case ' ':
+    case '\t':
+    case '\n':
+    case '[':
+    case ']':
+    case '{':
+    case '}':
+    case ')':
+	return TRUE;
+    default:
+	return FALSE;
+    }
+}
+
+static void
+_trace_write_text (const char *text, size_t length)
+{
+    if (length) {
+	_last_char = text[length - 1];
+	_trace_write (text, length);
+    }
+}
+
+static void
+_emit_binary (const void *token, size_t length)
+{
+    _trace_write (token, length);
+    _last_char = ' ';
+}
+
+static void
+_emit_binary_integer (int32_t i)
+{
+    unsigned char buf[5];
+    union {
+	int8_t i8;
+	uint8_t u8;
+	int16_t i16;
+	uint16_t u16;
+	int32_t i32;
+    } u;
+    int len;
+
+    if (i < INT16_MIN) {
+	buf[0] = BINARY_INT32;
+	u.i32 = i;
+	len = 4;
+    } else if (i < INT8_MIN) {
+	buf[0] = BINARY_INT16;
+	u.i16 = i;
+	len = 2;
+    } else if (i < 0) {
+	buf[0] = BINARY_INT8;
+	u.i8 = i;
+	len = 1;
+    } else if (i <= UINT8_MAX) {
+	buf[0] = BINARY_UINT8;
+	u.u8 = i;
+	len = 1;
+    } else if (i <= UINT16_MAX) {
+	buf[0] = BINARY_UINT16;
+	u.u16 = i;
+	len = 2;
+    } else {
+	buf[0] = BINARY_INT32;
+	u.i32 = i;
+	len = 4;
+    }
+
+    memcpy (buf + 1, &u, len);
+    _emit_binary (buf, len + 1);
+}
+
+static void
+_emit_binary_real (double d)
+{
+    unsigned char buf[5];
+    float f;
+
+    if (d >= INT32_MIN && d <= INT32_MAX && d == (int32_t) d) {
+	_emit_binary_integer (d);
+	return;
+    }
+
+    /* the interpreter only works in single precision */
+    f = d;
+    buf[0] = BINARY_FLOAT32;
+    memcpy (buf + 1, &f, sizeof (f));
+    _emit_binary (buf, 5);
+}
+
+static void
+_emit_binary_string (const void *data, uint32_t length, uint32_t deflate)
+{
+    unsigned char buf[9];
+    union {
+	uint8_t u8;
+	uint16_t u16;
+	uint32_t u32;
+    } u;
+    int len;
+
+    if (length <= UINT8_MAX) {
+	buf[0] = BINARY_STRING_1;
+	u.u8 = length;
+	len = 1;
+    } else if (length <= UINT16_MAX) {
+	buf[0] = BINARY_STRING_2;
+	u.u16 = length;
+	len = 2;
+    } else {
+	buf[0] = BINARY_STRING_4;
+	u.u32 = length;
+	len = 4;
+    }
+    memcpy (buf + 1, &u, len);
+    len++;
+
+    /* the inflated length is always big-endian */
+    if (deflate) {
+	buf[0] |= BINARY_STRING_DEFLATE;
+	deflate = to_be32 (deflate);
+	memcpy (buf + len, &deflate, 4);
+	len += 4;
+    }
+
+    _trace_write (buf, len);
+    _emit_binary (data, length);
+}
+
 enum {
     LENGTH_MODIFIER_LONG = 0x100
 };
@@ -625,8 +1006,7 @@ _trace_vprintf (const char *fmt, va_list ap)
     char *p;
     const char *f, *start;
     int length_modifier, width;
-    cairo_bool_t var_width;
-    int ret_ignored;
+    cairo_bool_t var_width, binary;
 
     assert (_should_trace ());
 
@@ -634,6 +1014,8 @@ _trace_vprintf (const char *fmt, va_list ap)
     p = buffer;
     while (*f != '\0') {
 	if (*f != '%') {
+	    if (*f == '\n')
+		_comment = FALSE;
 	    *p++ = *f++;
 	    continue;
 	}
@@ -669,7 +1051,8 @@ _trace_vprintf (const char *fmt, va_list ap)
 	single_fmt[single_fmt_length] = '\0';
 
 	/* Flush contents of buffer before snprintf()'ing into it. */
-	ret_ignored = fwrite (buffer, 1, p-buffer, logfile);
+	_trace_write_text (buffer, p-buffer);
+	binary = ! var_width && _can_emit_binary ();
 
 	/* We group signed and unsigned together in this switch, the
 	 * only thing that matters here is the size of the arguments,
@@ -678,8 +1061,14 @@ _trace_vprintf (const char *fmt, va_list ap)
 	case '%':
 	    buffer[0] = *f;
 	    buffer[1] = 0;
+	    _comment = TRUE;
 	    break;
 	case 'd':
+	    if (binary) {
+		_emit_binary_integer (va_arg (ap, int));
+		goto BINARY;
+	    }
+	    /* fall through */
 	case 'u':
 	case 'o':
 	case 'x':
@@ -694,6 +1083,21 @@ _trace_vprintf (const char *fmt, va_list ap)
 	    break;
 	case 'd' | LENGTH_MODIFIER_LONG:
 	case 'u' | LENGTH_MODIFIER_LONG:
+	    if (binary) {
+		long int value = va_arg (ap, long int);
+
+		if (*f == 'd' ?
+		    value >= INT32_MIN && value <= INT32_MAX :
+		    (unsigned long int) value <= INT32_MAX)
+		{
+		    _emit_binary_integer (value);
+		    goto BINARY;
+		}
+
+		snprintf (buffer, sizeof buffer, single_fmt, value);
+		break;
+	    }
+	    /* fall through */
 	case 'o' | LENGTH_MODIFIER_LONG:
 	case 'x' | LENGTH_MODIFIER_LONG:
 	case 'X' | LENGTH_MODIFIER_LONG:
@@ -712,6 +1116,10 @@ _trace_vprintf (const char *fmt, va_list ap)
 	    break;
 	case 'f':
 	case 'g':
+	    if (binary) {
+		_emit_binary_real (va_arg (ap, double));
+		goto BINARY;
+	    }
 	    _trace_dtostr (buffer, sizeof buffer, va_arg (ap, double));
 	    break;
 	case 'c':
@@ -723,10 +1131,16 @@ _trace_vprintf (const char *fmt, va_list ap)
 	}
 	p = buffer + strlen (buffer);
 	f++;
+	continue;
+
+BINARY:
+	/* binary tokens need no separator */
+	p = buffer;
+	if (*++f == ' ')
+	    f++;
     }
 
-    ret_ignored = fwrite (buffer, 1, p-buffer, logfile);
-    (void)ret_ignored;
+    _trace_write_text (buffer, p-buffer);
 }
 
 static void CAIRO_PRINTF_FORMAT(1, 2)
@@ -807,6 +1221,14 @@ _init_logfile (void)
     if (env != NULL)
 	_mark_dirty = atoi (env);
 
+    env = getenv ("CAIRO_TRACE_BINARY");
+    if (env != NULL)
+	_binary = atoi (env);
+
+    env = getenv ("CAIRO_TRACE_ASYNC");
+    if (env != NULL)
+	_async = atoi (env);
+
     filename = getenv ("CAIRO_TRACE_FD");
     if (filename != NULL) {
 	int fd = atoi (filename);
@@ -856,6 +1278,8 @@ _init_logfile (void)
 
 done:
     atexit (_close_trace);
+    if (_async)
+	_writer_start ();
     _emit_header ();
     return TRUE;
 }
@@ -884,12 +1308,16 @@ _write_unlock (void)
     if (logfile == NULL)
 	return;
 
+    if (_flush) {
+	if (_async)
+	    _writer_submit ();
+	else
+	    fflush (logfile);
+    }
+
 #if HAVE_FLOCKFILE && HAVE_FUNLOCKFILE
     funlockfile (logfile);
 #endif
-
-    if (_flush)
-	fflush (logfile);
 }
 
 
@@ -1333,6 +1761,12 @@ struct _data_stream {
     unsigned char zout_buf[BUFFER_SIZE];
     unsigned char four_tuple[4];
     int base85_pending;
+
+    /* binary strings are prefixed by their length, so collect them */
+    cairo_bool_t binary;
+    uint32_t inflated_length;
+    unsigned char *binary_data;
+    size_t binary_length, binary_size;
 };
 
 static void
@@ -1385,7 +1819,6 @@ _write_base85_data (struct _data_stream *stream,
 		    unsigned long	   length)
 {
     unsigned char five_tuple[5];
-    int ret;
 
     assert (_should_trace ());
 
@@ -1393,15 +1826,40 @@ _write_base85_data (struct _data_stream *stream,
 	stream->four_tuple[stream->base85_pending++] = *data++;
 	if (stream->base85_pending == 4) {
 	    if (_expand_four_tuple_to_five (stream->four_tuple, five_tuple))
-		ret = fwrite ("z", 1, 1, logfile);
+		_trace_write ("z", 1);
 	    else
-		ret = fwrite (five_tuple, 5, 1, logfile);
-	    (void)ret;
+		_trace_write (five_tuple, 5);
 	    stream->base85_pending = 0;
 	}
     }
 }
 
+static void
+_write_binary_data (struct _data_stream *stream,
+		    const unsigned char	  *data,
+		    unsigned long	   length)
+{
+    if (stream->binary_length + length > stream->binary_size) {
+	size_t size = stream->binary_size ? 2 * stream->binary_size : BUFFER_SIZE;
+	unsigned char *new_data;
+
+	while (size < stream->binary_length + length)
+	    size *= 2;
+
+	new_data = realloc (stream->binary_data, size);
+	if (new_data == NULL) {
+	    _error = TRUE;
+	    return;
+	}
+
+	stream->binary_data = new_data;
+	stream->binary_size = size;
+    }
+
+    memcpy (stream->binary_data + stream->binary_length, data, length);
+    stream->binary_length += length;
+}
+
 static void
 _write_zlib_data (struct _data_stream *stream, cairo_bool_t flush)
 {
@@ -1410,9 +1868,15 @@ _write_zlib_data (struct _data_stream *stream, cairo_bool_t flush)
     do {
 	int ret = deflate (&stream->zlib_stream, flush ? Z_FINISH : Z_NO_FLUSH);
 	if (flush || stream->zlib_stream.avail_out == 0) {
-	    _write_base85_data (stream,
-				stream->zout_buf,
-				BUFFER_SIZE - stream->zlib_stream.avail_out);
+	    if (stream->binary) {
+		_write_binary_data (stream,
+				    stream->zout_buf,
+				    BUFFER_SIZE - stream->zlib_stream.avail_out);
+	    } else {
+		_write_base85_data (stream,
+				    stream->zout_buf,
+				    BUFFER_SIZE - stream->zlib_stream.avail_out);
+	    }
 	    stream->zlib_stream.next_out = stream->zout_buf;
 	    stream->zlib_stream.avail_out = BUFFER_SIZE;
 	}
@@ -1431,6 +1895,15 @@ static void
 _write_data_start (struct _data_stream *stream, uint32_t len)
 {
     _write_zlib_data_start (stream);
+
+    stream->binary = _can_emit_binary ();
+    if (stream->binary) {
+	stream->inflated_length = len;
+	stream->binary_data = NULL;
+	stream->binary_length = stream->binary_size = 0;
+	return;
+    }
+
     _write_base85_data_start (stream);
 
     _trace_printf ("<|");
@@ -1472,7 +1945,6 @@ static void
 _write_base85_data_end (struct _data_stream *stream)
 {
     unsigned char five_tuple[5];
-    int ret;
 
     assert (_should_trace ());
 
@@ -1480,8 +1952,7 @@ _write_base85_data_end (struct _data_stream *stream)
 	memset (stream->four_tuple + stream->base85_pending,
 		0, 4 - stream->base85_pending);
 	_expand_four_tuple_to_five (stream->four_tuple, five_tuple);
-	ret = fwrite (five_tuple, stream->base85_pending+1, 1, logfile);
-	(void) ret;
+	_trace_write (five_tuple, stream->base85_pending+1);
     }
 }
 
@@ -1489,6 +1960,21 @@ static void
 _write_data_end (struct _data_stream *stream)
 {
     _write_zlib_data_end (stream);
+
+    if (stream->binary) {
+	/* An inflated length of 0 marks a string that is stored as is,
+	 * so an empty payload has to be written out as an empty string
+	 * rather than as the zlib stream for nothing.
+	 */
+	if (stream->inflated_length == 0)
+	    stream->binary_length = 0;
+	_emit_binary_string (stream->binary_data,
+			     stream->binary_length,
+			     stream->inflated_length);
+	free (stream->binary_data);
+	return;
+    }
+
     _write_base85_data_end (stream);
 
     _trace_printf ("~>");
@@ -1656,12 +2142,18 @@ _emit_image (cairo_surface_t *image,
 		    image, *mime_type, &mime_data, &mime_length);
 	    if (mime_data != NULL) {
 		_trace_printf ("  /mime-type (%s) set\n"
-			       "  /source <~",
+			       "  /source ",
 			       *mime_type);
-		_write_base85_data_start (&stream);
-		_write_base85_data (&stream, mime_data, mime_length);
-		_write_base85_data_end (&stream);
-		_trace_printf ("~> set\n"
+		if (_can_emit_binary ()) {
+		    _emit_binary_string (mime_data, mime_length, 0);
+		} else {
+		    _trace_printf ("<~");
+		    _write_base85_data_start (&stream);
+		    _write_base85_data (&stream, mime_data, mime_length);
+		    _write_base85_data_end (&stream);
+		    _trace_printf ("~>");
+		}
+		_trace_printf (" set\n"
 			       "  image");
 		return;
 	    }
@@ -1888,6 +2380,11 @@ _emit_string_literal (const char *utf8, int len)
 	len = strlen (utf8);
     end = utf8 + len;
 
+    if (_can_emit_binary ()) {
+	_emit_binary_string (utf8, len, 0);
+	return;
+    }
+
     _trace_printf ("(");
     while (utf8 < end) {
 	switch ((c = *utf8++)) {
@@ -1917,11 +2414,9 @@ ESCAPED_CHAR:
 		_trace_printf ("%c", c);
 	    } else {
 		char buf[4] = { '\\' };
-		int ret_ignored;
 
 		to_octal (c, buf+1, 3);
-		ret_ignored = fwrite (buf, 4, 1, logfile);
-		(void)ret_ignored;
+		_trace_write_text (buf, 4);
 	    }
 	    break;
 	}